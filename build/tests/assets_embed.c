@@ -0,0 +1,100 @@
+/* Generated by forge-embed from tests/assets; do not edit. */
+#include "forge_embed.h"
+
+static const unsigned char file0[] = {
+    0x64,0x6f,0x63,0x75,0x6d,0x65,0x6e,0x74,0x2e,0x67,0x65,0x74,0x45,0x6c,0x65,0x6d,
+    0x65,0x6e,0x74,0x42,0x79,0x49,0x64,0x28,0x22,0x61,0x70,0x70,0x22,0x29,0x2e,0x64,
+    0x61,0x74,0x61,0x73,0x65,0x74,0x2e,0x72,0x65,0x61,0x64,0x79,0x20,0x3d,0x20,0x22,
+    0x31,0x22,0x3b,0x0a,
+};
+
+static const unsigned char file1[] = {
+    0x3c,0x21,0x64,0x6f,0x63,0x74,0x79,0x70,0x65,0x20,0x68,0x74,0x6d,0x6c,0x3e,0x0a,
+    0x3c,0x74,0x69,0x74,0x6c,0x65,0x3e,0x44,0x6f,0x63,0x73,0x3c,0x2f,0x74,0x69,0x74,
+    0x6c,0x65,0x3e,0x0a,
+};
+
+static const unsigned char file2[] = {
+    0x3c,0x21,0x64,0x6f,0x63,0x74,0x79,0x70,0x65,0x20,0x68,0x74,0x6d,0x6c,0x3e,0x0a,
+    0x3c,0x68,0x74,0x6d,0x6c,0x20,0x6c,0x61,0x6e,0x67,0x3d,0x22,0x65,0x6e,0x22,0x3e,
+    0x0a,0x3c,0x68,0x65,0x61,0x64,0x3e,0x0a,0x20,0x20,0x3c,0x6d,0x65,0x74,0x61,0x20,
+    0x63,0x68,0x61,0x72,0x73,0x65,0x74,0x3d,0x22,0x75,0x74,0x66,0x2d,0x38,0x22,0x3e,
+    0x0a,0x20,0x20,0x3c,0x74,0x69,0x74,0x6c,0x65,0x3e,0x46,0x6f,0x72,0x67,0x65,0x3c,
+    0x2f,0x74,0x69,0x74,0x6c,0x65,0x3e,0x0a,0x20,0x20,0x3c,0x73,0x63,0x72,0x69,0x70,
+    0x74,0x20,0x73,0x72,0x63,0x3d,0x22,0x2f,0x61,0x70,0x70,0x2e,0x6a,0x73,0x22,0x20,
+    0x64,0x65,0x66,0x65,0x72,0x3e,0x3c,0x2f,0x73,0x63,0x72,0x69,0x70,0x74,0x3e,0x0a,
+    0x3c,0x2f,0x68,0x65,0x61,0x64,0x3e,0x0a,0x3c,0x62,0x6f,0x64,0x79,0x3e,0x0a,0x20,
+    0x20,0x3c,0x6d,0x61,0x69,0x6e,0x20,0x69,0x64,0x3d,0x22,0x61,0x70,0x70,0x22,0x3e,
+    0x0a,0x20,0x20,0x20,0x20,0x3c,0x68,0x31,0x3e,0x46,0x6f,0x72,0x67,0x65,0x3c,0x2f,
+    0x68,0x31,0x3e,0x0a,0x20,0x20,0x20,0x20,0x3c,0x70,0x3e,0x45,0x6d,0x62,0x65,0x64,
+    0x64,0x65,0x64,0x20,0x61,0x73,0x73,0x65,0x74,0x20,0x66,0x69,0x78,0x74,0x75,0x72,
+    0x65,0x2e,0x20,0x45,0x6d,0x62,0x65,0x64,0x64,0x65,0x64,0x20,0x61,0x73,0x73,0x65,
+    0x74,0x20,0x66,0x69,0x78,0x74,0x75,0x72,0x65,0x2e,0x20,0x45,0x6d,0x62,0x65,0x64,
+    0x64,0x65,0x64,0x20,0x61,0x73,0x73,0x65,0x74,0x20,0x66,0x69,0x78,0x74,0x75,0x72,
+    0x65,0x2e,0x3c,0x2f,0x70,0x3e,0x0a,0x20,0x20,0x20,0x20,0x3c,0x70,0x3e,0x45,0x6d,
+    0x62,0x65,0x64,0x64,0x65,0x64,0x20,0x61,0x73,0x73,0x65,0x74,0x20,0x66,0x69,0x78,
+    0x74,0x75,0x72,0x65,0x2e,0x20,0x45,0x6d,0x62,0x65,0x64,0x64,0x65,0x64,0x20,0x61,
+    0x73,0x73,0x65,0x74,0x20,0x66,0x69,0x78,0x74,0x75,0x72,0x65,0x2e,0x20,0x45,0x6d,
+    0x62,0x65,0x64,0x64,0x65,0x64,0x20,0x61,0x73,0x73,0x65,0x74,0x20,0x66,0x69,0x78,
+    0x74,0x75,0x72,0x65,0x2e,0x3c,0x2f,0x70,0x3e,0x0a,0x20,0x20,0x3c,0x2f,0x6d,0x61,
+    0x69,0x6e,0x3e,0x0a,0x3c,0x2f,0x62,0x6f,0x64,0x79,0x3e,0x0a,0x3c,0x2f,0x68,0x74,
+    0x6d,0x6c,0x3e,0x0a,
+};
+
+static const unsigned char file2_gz[] = {
+    0x1f,0x8b,0x08,0x00,0x00,0x00,0x00,0x00,0x02,0x03,0xb5,0x90,0x3d,0x0e,0xc3,0x20,
+    0x0c,0x46,0xf7,0x9c,0xc2,0x65,0x6f,0x50,0xb7,0x0e,0x0e,0x5b,0x7b,0x0f,0x82,0x9d,
+    0x84,0x2a,0x3f,0x08,0x1c,0xa9,0xb9,0x7d,0x21,0xa8,0x07,0xe8,0xd0,0x09,0xf3,0x2c,
+    0x3f,0xfc,0x81,0x17,0xda,0x9c,0x1c,0x81,0x61,0x92,0x65,0x36,0x0d,0x96,0x03,0x66,
+    0xbb,0x8e,0x9d,0xe2,0x55,0x15,0xc0,0x96,0x4c,0x03,0x80,0x0b,0x8b,0x05,0x37,0xd9,
+    0x98,0x58,0x3a,0xb5,0xcb,0x70,0xbd,0xab,0xb3,0x21,0x5e,0x66,0x36,0xcf,0x2d,0x8e,
+    0x8c,0xba,0x5e,0x0a,0x4e,0x2e,0xfa,0x20,0x90,0xa2,0xeb,0x94,0xb6,0x21,0xb4,0xaf,
+    0xa4,0x80,0x78,0xe0,0x68,0x50,0xd7,0x66,0xd6,0xeb,0xea,0xc7,0x7e,0xa3,0xa3,0x3e,
+    0x63,0xfd,0x0a,0x9e,0x3a,0x95,0x47,0x4e,0x7f,0x66,0xd3,0xed,0xab,0xcf,0x55,0x45,
+    0xc1,0x3c,0x96,0x9e,0x89,0x98,0xc0,0xa6,0xbc,0x11,0x0c,0xfe,0x2d,0x7b,0xe4,0x16,
+    0x7e,0xe4,0xa8,0xc3,0x9f,0x94,0xa8,0x4b,0x96,0x92,0xb1,0x86,0xcb,0xdb,0x9f,0x7f,
+    0xfc,0x01,0x6b,0x73,0x4e,0x3d,0x74,0x01,0x00,0x00,
+};
+
+static const ForgeEmbedAsset assets[5] = {
+    {"/app.js", "text/javascript; charset=utf-8",
+        {"HTTP/1.1 200 OK\r\nContent-Type: text/javascript; charset=utf-8\r\nContent-Length: 52\r\nETag: \"71f1864114fa1f32\"\r\n", 109,
+         "ETag: \"71f1864114fa1f32\"\r\n", 26,
+         file0, 52, "\"71f1864114fa1f32\""},
+        {NULL, 0, NULL, 0, NULL, 0, NULL},
+    },
+    {"/docs/index.html", "text/html; charset=utf-8",
+        {"HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: 36\r\nETag: \"d095100eaab76e9d\"\r\n", 103,
+         "ETag: \"d095100eaab76e9d\"\r\n", 26,
+         file1, 36, "\"d095100eaab76e9d\""},
+        {NULL, 0, NULL, 0, NULL, 0, NULL},
+    },
+    {"/", "text/html; charset=utf-8",
+        {"HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: 372\r\nETag: \"54b285065fe5564f\"\r\nVary: Accept-Encoding\r\n", 127,
+         "ETag: \"54b285065fe5564f\"\r\nVary: Accept-Encoding\r\n", 49,
+         file2, 372, "\"54b285065fe5564f\""},
+        {"HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: 186\r\nETag: \"54b285065fe5564f-gz\"\r\nVary: Accept-Encoding\r\nContent-Encoding: gzip\r\n", 154,
+         "ETag: \"54b285065fe5564f-gz\"\r\nVary: Accept-Encoding\r\nContent-Encoding: gzip\r\n", 76,
+         file2_gz, 186, "\"54b285065fe5564f-gz\""},
+    },
+    {"/index.html", "text/html; charset=utf-8",
+        {"HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: 372\r\nETag: \"54b285065fe5564f\"\r\nVary: Accept-Encoding\r\n", 127,
+         "ETag: \"54b285065fe5564f\"\r\nVary: Accept-Encoding\r\n", 49,
+         file2, 372, "\"54b285065fe5564f\""},
+        {"HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: 186\r\nETag: \"54b285065fe5564f-gz\"\r\nVary: Accept-Encoding\r\nContent-Encoding: gzip\r\n", 154,
+         "ETag: \"54b285065fe5564f-gz\"\r\nVary: Accept-Encoding\r\nContent-Encoding: gzip\r\n", 76,
+         file2_gz, 186, "\"54b285065fe5564f-gz\""},
+    },
+    {"/docs/", "text/html; charset=utf-8",
+        {"HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: 36\r\nETag: \"d095100eaab76e9d\"\r\n", 103,
+         "ETag: \"d095100eaab76e9d\"\r\n", 26,
+         file1, 36, "\"d095100eaab76e9d\""},
+        {NULL, 0, NULL, 0, NULL, 0, NULL},
+    },
+};
+
+static const uint32_t seeds[2] = {
+    1u, 1u,
+};
+
+const ForgeEmbedTable test_assets = {assets, 5, seeds, 2};
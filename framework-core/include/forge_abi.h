@@ -12,6 +12,6 @@
  * - size/alignment changes
  * - calling convention changes
  */
-#define FORGE_ABI_VERSION 1
+#define FORGE_ABI_VERSION 6
 
 #endif /* FORGE_ABI_H */
@@ -0,0 +1,84 @@
+#ifndef FORGE_CACHE_H
+#define FORGE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* =========================================================
+   Response Cache
+   ========================================================= */
+
+/*
+ * Opt-in memoization of GET handlers. A cached route runs its
+ * handler once per key and TTL; until the entry expires, requests
+ * with the same method, path (query included) and Vary header
+ * values are answered from the stored response without calling the
+ * handler: one writev() of the pre-serialized head and body.
+ *
+ * Stored responses carry a strong ETag, and a matching
+ * If-None-Match is answered with 304. Only complete 200 responses
+ * up to FORGE_CACHE_MAX_ENTRY are stored, never ones that set
+ * cookies or say Cache-Control: no-store / private. Requests with
+ * Authorization bypass the cache unless it is a Vary header.
+ *
+ * Entries live in lock-striped shards, each with its own LRU list
+ * and an equal part of the byte budget. Middleware still runs on a
+ * hit; the handler does not.
+ */
+
+#define FORGE_CACHE_DEFAULT_BUDGET ((size_t)64 * 1024 * 1024)
+#define FORGE_CACHE_MAX_ENTRY ((size_t)1024 * 1024)
+#define FORGE_CACHE_MAX_VARY 4
+
+/*
+ * Cache responses of `method` `path` for `ttl_ms`. `vary` lists the
+ * request headers that select a variant, comma-separated ("Accept,
+ * Accept-Encoding"), or NULL. Works whether the route is registered
+ * before or after, and from a forge_router_on_reload() build: a
+ * change applies from the next published route table. 0 / -1.
+ */
+int forge_cache_route(const char *method,
+                      const char *path,
+                      unsigned ttl_ms,
+                      const char *vary);
+
+/*
+ * Coalesce concurrent identical requests to `method` `path` (same
+ * key as the cache: path, query and the route's Vary values). While
+ * one request runs the handler, the others wait up to `wait_ms` (0:
+ * FORGE_COALESCE_DEFAULT_WAIT_MS) and are answered from its response,
+ * so a popular entry that expires costs one handler call instead of
+ * one per queued request. Only responses the cache could store are
+ * shared; otherwise, and after the wait, a request runs the handler
+ * itself. On an event loop a waiting request is parked and the loop
+ * keeps serving, the leader's own included. Without
+ * forge_cache_route() nothing is kept once the response is out.
+ * Changes apply as for forge_cache_route(). 0 / -1.
+ */
+#define FORGE_COALESCE_DEFAULT_WAIT_MS 2000
+
+int forge_cache_coalesce(const char *method,
+                         const char *path,
+                         unsigned wait_ms);
+
+/* Total bytes for stored responses; set before launching */
+void forge_cache_set_budget(size_t bytes);
+
+/* Drop every stored response */
+void forge_cache_purge(void);
+
+typedef struct
+{
+   uint64_t hits;         /* served from the cache, 304s included */
+   uint64_t not_modified; /* hits answered with 304 */
+   uint64_t misses;       /* handler ran */
+   uint64_t stores;
+   uint64_t evictions;    /* pushed out by the budget, not expired */
+   uint64_t entries;
+   uint64_t bytes;
+   uint64_t coalesced;    /* answered with a concurrent request's response */
+} ForgeCacheStats;
+
+void forge_cache_stats(ForgeCacheStats *out);
+
+#endif /* FORGE_CACHE_H */
@@ -0,0 +1,91 @@
+#ifndef FORGE_CORE_H
+#define FORGE_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* =========================================================
+   Thread-per-Core Runtime
+   ========================================================= */
+
+/*
+ * launch_server_cores() runs one event loop per core. Every core
+ * owns its listener (SO_REUSEPORT), connections, request arena and
+ * stats; nothing on the request path is written by two cores.
+ * Cores talk to each other only through bounded lock-free queues
+ * (forge_core_post / forge_core_broadcast).
+ *
+ * Outside the runtime (launch_server(), handle_client()) the
+ * calling thread acts as core 0 of a single-core runtime.
+ */
+
+#define FORGE_MAX_CORES 256
+#define FORGE_CORE_QUEUE 1024 /* messages per inbox, power of two */
+
+typedef struct ForgeCore ForgeCore;
+
+/* Cross-core message, executed on the receiving core's thread */
+typedef void (*ForgeCoreFn)(ForgeCore *core, void *arg);
+
+typedef struct
+{
+  uint64_t accepted; /* connections accepted */
+  uint64_t active;   /* connections open now */
+  uint64_t requests; /* requests dispatched */
+  uint64_t bytes_out;
+  uint64_t messages; /* cross-core messages executed */
+
+  /* admission control (forge_server_set_admission) */
+  uint64_t shed;               /* requests answered 503 unserved */
+  uint64_t queue_delay_ns;     /* summed over admitted requests */
+  uint64_t queue_delay_max_ns; /* worst single request */
+  uint64_t overloaded;         /* cores shedding right now */
+
+  /* pinned cores (forge_server_pin_cpus): accepted off the receiving CPU */
+  uint64_t accepted_off_cpu;
+} ForgeCoreStats;
+
+/* The core running the calling thread (never NULL) */
+ForgeCore *forge_current_core(void);
+
+int forge_core_id(const ForgeCore *core);
+int forge_core_count(void);
+
+/*
+ * Request-scoped allocation from the core's arena: 16-byte aligned,
+ * released after the response is sent. Returns NULL on OOM.
+ */
+void *forge_core_alloc(ForgeCore *core, size_t size);
+
+/* Per-core application state (caches, counters, ...) */
+void forge_core_set_data(ForgeCore *core, void *data);
+void *forge_core_data(const ForgeCore *core);
+
+/* Run `fn` on every core thread before it starts serving */
+int forge_core_on_start(ForgeCoreFn fn, void *arg);
+
+/*
+ * Queue `fn(arg)` on core `core_id`. Returns 0, or -1 when the
+ * inbox is full or the core does not exist; the caller keeps
+ * ownership of `arg` on failure.
+ */
+int forge_core_post(int core_id, ForgeCoreFn fn, void *arg);
+
+/* Post to every core (the caller included); returns cores missed */
+int forge_core_broadcast(ForgeCoreFn fn, void *arg);
+
+/*
+ * Run `fn(core, arg)` on `core`'s loop every `interval_ms`, from
+ * its own thread: call it on that core (a start hook, a handler).
+ * Timers stay for the life of the core. Returns 0 / -1.
+ */
+int forge_core_every(ForgeCore *core, unsigned interval_ms,
+                     ForgeCoreFn fn, void *arg);
+
+/* Execute queued messages now; returns how many ran */
+int forge_core_drain(ForgeCore *core);
+
+/* Snapshot of one core's counters, or the sum with core_id -1 */
+void forge_core_stats(int core_id, ForgeCoreStats *out);
+
+#endif /* FORGE_CORE_H */
@@ -0,0 +1,30 @@
+#ifndef FORGE_DIGEST_H
+#define FORGE_DIGEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* =========================================================
+   SHA-256 (FIPS 180-4)
+   ========================================================= */
+
+/*
+ * Incremental SHA-256 for streamed data: init, any number of
+ * updates, then final. Used by the multipart parser and by
+ * forge-pm to verify downloaded packages. A context holds no
+ * allocations and may be copied.
+ */
+
+typedef struct
+{
+  uint32_t h[8];
+  uint64_t len;
+  unsigned char block[64];
+  size_t used;
+} ForgeSha256;
+
+void forge_sha256_init(ForgeSha256 *ctx);
+void forge_sha256_update(ForgeSha256 *ctx, const void *data, size_t len);
+void forge_sha256_final(ForgeSha256 *ctx, unsigned char out[32]);
+
+#endif /* FORGE_DIGEST_H */
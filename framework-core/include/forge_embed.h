@@ -0,0 +1,72 @@
+#ifndef FORGE_EMBED_H
+#define FORGE_EMBED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* =========================================================
+   Embedded Static Assets
+   ========================================================= */
+
+/*
+ * Tables of files compiled into the binary. `make` runs
+ * build/forge-embed over an assets directory and emits a C file
+ * holding, per file, the bytes, a gzip variant when that is
+ * smaller, and the serialized response heads (Content-Type,
+ * Content-Length, ETag, Vary). Paths are found with a perfect hash
+ * built by the generator, so nothing is parsed, hashed or
+ * allocated at startup, and a hit is one writev() of the constant
+ * head and body behind the common header block.
+ *
+ * An index.html is also served at its directory ("/docs/" and
+ * "/docs/index.html"). Only GET is routed.
+ */
+
+typedef struct
+{
+   const char *head;    /* HTTP/1.1 status line and entity headers */
+   size_t head_len;
+   const char *headers; /* the headers HTTP/2 cannot derive itself */
+   size_t headers_len;
+   const unsigned char *body; /* NULL: variant absent */
+   size_t body_len;
+   const char *etag; /* quoted, strong */
+} ForgeEmbedVariant;
+
+typedef struct
+{
+   const char *path; /* "/app.js" */
+   const char *content_type;
+   ForgeEmbedVariant identity;
+   ForgeEmbedVariant gzip;
+} ForgeEmbedAsset;
+
+/*
+ * Hash-and-displace table: forge_embed_hash(path, 0) picks a
+ * bucket, whose seed rehashes the path onto its asset.
+ */
+typedef struct
+{
+   const ForgeEmbedAsset *assets;
+   size_t count;
+   const uint32_t *seeds;
+   size_t buckets;
+} ForgeEmbedTable;
+
+/* Shared by the generator and the lookup */
+uint32_t forge_embed_hash(const char *s, size_t len, uint32_t seed);
+
+/* Asset at `path` (`len` bytes), or NULL */
+const ForgeEmbedAsset *forge_embed_find(const ForgeEmbedTable *table,
+                                        const char *path,
+                                        size_t len);
+
+/*
+ * Serve every asset of `table` as a GET route, before launch or from
+ * a forge_router_on_reload() build. Nothing is copied: the table is
+ * the generated constant data.
+ * Returns 0 / -1.
+ */
+int forge_embed_register(const ForgeEmbedTable *table);
+
+#endif /* FORGE_EMBED_H */
@@ -0,0 +1,77 @@
+#ifndef FORGE_H2_H
+#define FORGE_H2_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* =========================================================
+   HTTP/2 Cleartext (RFC 7540) Constants
+   ========================================================= */
+
+#define FORGE_H2_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define FORGE_H2_PREFACE_LEN 24
+
+#define FORGE_H2_FRAME_HEADER 9
+#define FORGE_H2_DEFAULT_FRAME 16384
+#define FORGE_H2_DEFAULT_WINDOW 65535
+#define FORGE_H2_MAX_WINDOW 0x7fffffff
+
+/* Limits this server advertises in its SETTINGS */
+#define FORGE_H2_MAX_STREAMS 100
+
+/* Frame types */
+#define FORGE_H2_DATA 0x0
+#define FORGE_H2_HEADERS 0x1
+#define FORGE_H2_PRIORITY 0x2
+#define FORGE_H2_RST_STREAM 0x3
+#define FORGE_H2_SETTINGS 0x4
+#define FORGE_H2_PUSH_PROMISE 0x5
+#define FORGE_H2_PING 0x6
+#define FORGE_H2_GOAWAY 0x7
+#define FORGE_H2_WINDOW_UPDATE 0x8
+#define FORGE_H2_CONTINUATION 0x9
+
+/* Frame flags */
+#define FORGE_H2_FLAG_END_STREAM 0x1
+#define FORGE_H2_FLAG_ACK 0x1
+#define FORGE_H2_FLAG_END_HEADERS 0x4
+#define FORGE_H2_FLAG_PADDED 0x8
+#define FORGE_H2_FLAG_PRIORITY 0x20
+
+/* SETTINGS identifiers */
+#define FORGE_H2_SETTINGS_HEADER_TABLE_SIZE 0x1
+#define FORGE_H2_SETTINGS_ENABLE_PUSH 0x2
+#define FORGE_H2_SETTINGS_MAX_CONCURRENT_STREAMS 0x3
+#define FORGE_H2_SETTINGS_INITIAL_WINDOW_SIZE 0x4
+#define FORGE_H2_SETTINGS_MAX_FRAME_SIZE 0x5
+#define FORGE_H2_SETTINGS_MAX_HEADER_LIST_SIZE 0x6
+
+/* Error codes */
+#define FORGE_H2_NO_ERROR 0x0
+#define FORGE_H2_PROTOCOL_ERROR 0x1
+#define FORGE_H2_INTERNAL_ERROR 0x2
+#define FORGE_H2_FLOW_CONTROL_ERROR 0x3
+#define FORGE_H2_STREAM_CLOSED 0x5
+#define FORGE_H2_FRAME_SIZE_ERROR 0x6
+#define FORGE_H2_REFUSED_STREAM 0x7
+#define FORGE_H2_COMPRESSION_ERROR 0x9
+
+/* =========================================================
+   Frame Codec
+   ========================================================= */
+
+typedef struct
+{
+   uint32_t length; /* 24-bit payload length */
+   uint8_t type;
+   uint8_t flags;
+   uint32_t stream_id; /* 31 bits, reserved bit cleared */
+} ForgeH2Frame;
+
+void forge_h2_pack_frame(uint8_t out[FORGE_H2_FRAME_HEADER],
+                         const ForgeH2Frame *frame);
+
+void forge_h2_unpack_frame(const uint8_t in[FORGE_H2_FRAME_HEADER],
+                           ForgeH2Frame *frame);
+
+#endif /* FORGE_H2_H */
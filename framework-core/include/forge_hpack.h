@@ -0,0 +1,101 @@
+#ifndef FORGE_HPACK_H
+#define FORGE_HPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* =========================================================
+   HPACK (RFC 7541) Limits
+   ========================================================= */
+
+#define FORGE_HPACK_DEFAULT_TABLE 4096
+
+/* Every entry costs at least 32 bytes, so this many always fit */
+#define FORGE_HPACK_MAX_ENTRIES (FORGE_HPACK_DEFAULT_TABLE / 32)
+
+/* =========================================================
+   Dynamic Table
+   ========================================================= */
+
+typedef struct
+{
+   char *name; /* one allocation: name bytes, then value bytes */
+   size_t name_len;
+   char *value;
+   size_t value_len;
+} ForgeHpackEntry;
+
+typedef struct
+{
+   ForgeHpackEntry entries[FORGE_HPACK_MAX_ENTRIES]; /* ring, newest at head */
+   size_t head;
+   size_t count;
+   size_t size;     /* RFC 7541 size: sum of name + value + 32 */
+   size_t max_size; /* current maximum (table size updates) */
+   size_t limit;    /* ceiling agreed through SETTINGS */
+   int pending_update; /* encoder: size update owed at next block */
+} ForgeHpackTable;
+
+void forge_hpack_init(ForgeHpackTable *t, size_t limit);
+void forge_hpack_free(ForgeHpackTable *t);
+
+/* Encoder side: the peer changed SETTINGS_HEADER_TABLE_SIZE */
+void forge_hpack_set_limit(ForgeHpackTable *t, size_t limit);
+
+/* =========================================================
+   Decoding
+   ========================================================= */
+
+/* Called once per decoded field; return non-zero to abort */
+typedef int (*ForgeHpackEmit)(const char *name, size_t name_len,
+                              const char *value, size_t value_len,
+                              void *user);
+
+/*
+ * Decode one complete header block. `scratch` receives Huffman
+ * and literal strings; emitted pointers are only valid during the
+ * callback. Returns 0, or -1 on a compression error.
+ */
+int forge_hpack_decode(ForgeHpackTable *t,
+                       const uint8_t *in, size_t len,
+                       char *scratch, size_t scratch_cap,
+                       ForgeHpackEmit emit, void *user);
+
+/* =========================================================
+   Encoding
+   ========================================================= */
+
+#define FORGE_HPACK_NO_INDEX 0 /* literal without indexing */
+#define FORGE_HPACK_INDEX 1    /* literal with incremental indexing */
+#define FORGE_HPACK_NEVER 2    /* never indexed (sensitive values) */
+
+/*
+ * Append one field (name must be lowercase). Exact static or
+ * dynamic matches become a single index; values are Huffman
+ * coded when that is shorter. Emits a pending table size update
+ * first. Returns bytes written or -1 when `cap` is too small.
+ */
+long forge_hpack_encode(ForgeHpackTable *t,
+                        uint8_t *out, size_t cap,
+                        const char *name,
+                        const char *value, size_t value_len,
+                        int mode);
+
+/* =========================================================
+   Primitives (exposed for the frame layer and tests)
+   ========================================================= */
+
+/* Prefix integer (RFC 7541 5.1); returns bytes or -1 */
+long forge_hpack_encode_int(uint8_t *out, size_t cap,
+                            uint8_t first, int prefix_bits,
+                            uint64_t value);
+long forge_hpack_decode_int(const uint8_t *in, size_t len,
+                            int prefix_bits, uint64_t *value);
+
+size_t forge_hpack_huffman_len(const uint8_t *in, size_t len);
+long forge_hpack_huffman_encode(const uint8_t *in, size_t len,
+                                uint8_t *out, size_t cap);
+long forge_hpack_huffman_decode(const uint8_t *in, size_t len,
+                                char *out, size_t cap);
+
+#endif /* FORGE_HPACK_H */
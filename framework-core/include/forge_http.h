@@ -10,25 +10,181 @@
 #define FORGE_MAX_METHOD 8
 #define FORGE_MAX_PATH 256
 #define FORGE_MAX_VER 16
+#define FORGE_MAX_HEADERS 32
+#define FORGE_MAX_QUERY 32 /* parameters indexed by forge_query_get */
+
+/* Request body limit for routes that do not set max_body */
+#define FORGE_DEFAULT_MAX_BODY (1024 * 1024)
 
 /* =========================================================
    HTTP Request Structure
    ========================================================= */
 
+/* Header name/value, pointing into the raw request buffer */
+typedef struct
+{
+   const char *name;
+   size_t name_len;
+   const char *value;
+   size_t value_len;
+} ForgeHttpHeader;
+
+/*
+ * Standard request headers. The parser classifies every name against
+ * these and records where the first of each is, so forge_header_get()
+ * is an array index; other headers are only in the headers list.
+ */
+typedef enum
+{
+   FORGE_HDR_ACCEPT,
+   FORGE_HDR_ACCEPT_CHARSET,
+   FORGE_HDR_ACCEPT_ENCODING,
+   FORGE_HDR_ACCEPT_LANGUAGE,
+   FORGE_HDR_ACCESS_CONTROL_REQUEST_HEADERS,
+   FORGE_HDR_ACCESS_CONTROL_REQUEST_METHOD,
+   FORGE_HDR_AUTHORIZATION,
+   FORGE_HDR_CACHE_CONTROL,
+   FORGE_HDR_CONNECTION,
+   FORGE_HDR_CONTENT_ENCODING,
+   FORGE_HDR_CONTENT_LENGTH,
+   FORGE_HDR_CONTENT_TYPE,
+   FORGE_HDR_COOKIE,
+   FORGE_HDR_DATE,
+   FORGE_HDR_EXPECT,
+   FORGE_HDR_FORWARDED,
+   FORGE_HDR_FROM,
+   FORGE_HDR_HOST,
+   FORGE_HDR_HTTP2_SETTINGS,
+   FORGE_HDR_IF_MATCH,
+   FORGE_HDR_IF_MODIFIED_SINCE,
+   FORGE_HDR_IF_NONE_MATCH,
+   FORGE_HDR_IF_RANGE,
+   FORGE_HDR_IF_UNMODIFIED_SINCE,
+   FORGE_HDR_KEEP_ALIVE,
+   FORGE_HDR_ORIGIN,
+   FORGE_HDR_PRAGMA,
+   FORGE_HDR_PROXY_AUTHORIZATION,
+   FORGE_HDR_RANGE,
+   FORGE_HDR_REFERER,
+   FORGE_HDR_SEC_WEBSOCKET_EXTENSIONS,
+   FORGE_HDR_SEC_WEBSOCKET_KEY,
+   FORGE_HDR_SEC_WEBSOCKET_PROTOCOL,
+   FORGE_HDR_SEC_WEBSOCKET_VERSION,
+   FORGE_HDR_TE,
+   FORGE_HDR_TRAILER,
+   FORGE_HDR_TRANSFER_ENCODING,
+   FORGE_HDR_UPGRADE,
+   FORGE_HDR_USER_AGENT,
+   FORGE_HDR_VIA,
+   FORGE_HDR_X_FORWARDED_FOR,
+   FORGE_HDR_X_FORWARDED_HOST,
+   FORGE_HDR_X_FORWARDED_PROTO,
+   FORGE_HDR_X_REQUEST_ID,
+   FORGE_HDR_COUNT
+} ForgeHeaderId;
+
+/* Connection the request arrived on (body source) */
+typedef struct ForgeConn ForgeConn;
+
+/* Decoded query parameter: offsets into ForgeHttpRequest.query_buf */
+typedef struct
+{
+   unsigned short key;
+   unsigned short key_len;
+   unsigned short value; /* 0: no '=' (empty value) */
+} ForgeQueryParam;
+
 typedef struct
 {
    char method[FORGE_MAX_METHOD];
-   char path[FORGE_MAX_PATH];
+   char path[FORGE_MAX_PATH];  /* decoded and normalized, no query */
+   char query[FORGE_MAX_PATH]; /* raw, after '?'; "" when absent */
    char version[FORGE_MAX_VER];
+
+   ForgeHttpHeader headers[FORGE_MAX_HEADERS];
+   int header_count;
+   unsigned char header_index[FORGE_HDR_COUNT]; /* 1 + position in headers, 0: absent */
+
+   long long content_length; /* -1 when absent */
+   int chunked;              /* Transfer-Encoding: chunked */
+   int expect_continue;      /* Expect: 100-continue */
+
+   ForgeConn *conn; /* NULL when parsed standalone */
+
+   /* Query index, built by the first forge_query_get() */
+   int query_indexed;
+   int query_count;
+   ForgeQueryParam query_params[FORGE_MAX_QUERY];
+   char query_buf[FORGE_MAX_PATH];
 } ForgeHttpRequest;
 
 /* =========================================================
    HTTP Parsing
    ========================================================= */
 
+/*
+ * Parse the request line and headers of `raw` (NUL-terminated).
+ * Header entries point into `raw`, which must outlive `req`.
+ *
+ * The target is split at '?'. The path is percent-decoded, "//"
+ * collapsed and "." / ".." segments resolved (never above "/"), so
+ * routes match canonical paths; %2F counts as a separator and %00
+ * or a malformed escape rejects the request.
+ *
+ * Returns 0, -1 for a malformed request, or FORGE_PARSE_UNSUPPORTED
+ * when the body uses a transfer coding other than chunked (answered
+ * with 501 Not Implemented).
+ */
+#define FORGE_PARSE_UNSUPPORTED -2
+
 int forge_parse_http_request(const char *raw,
                              ForgeHttpRequest *req);
 
+/*
+ * Decoded value of the first query parameter named `key` ('+' as
+ * space), "" for a bare "?key", NULL when absent. The query is only
+ * parsed on the first call per request.
+ */
+const char *forge_query_get(const ForgeHttpRequest *req, const char *key);
+
+/* Case-insensitive header lookup; NULL when absent. Known names are indexed */
+const ForgeHttpHeader *forge_http_header(const ForgeHttpRequest *req,
+                                         const char *name);
+
+/* First header `id` of the request: one array index; NULL when absent */
+const ForgeHttpHeader *forge_header_get(const ForgeHttpRequest *req,
+                                        ForgeHeaderId id);
+
+/* FORGE_HDR_* of a header name (any case), -1 for other names */
+int forge_header_id(const char *name, size_t len);
+
+/* Lowercase name of a known header; NULL for an invalid id */
+const char *forge_header_name(ForgeHeaderId id);
+
+/* =========================================================
+   Streaming Request Body
+   ========================================================= */
+
+#define FORGE_BODY_ERROR -1     /* I/O error or malformed framing */
+#define FORGE_BODY_TOO_LARGE -2 /* exceeded the route's max_body */
+#define FORGE_BODY_UNAVAILABLE -3 /* the server's spool budget is spent */
+
+/*
+ * Pull up to `cap` bytes of the (de-chunked) request body into
+ * `buf`. Returns bytes read, 0 at end of body, or FORGE_BODY_*.
+ * Only the caller's buffer is used, so memory stays constant
+ * regardless of body size.
+ */
+long forge_body_read(const ForgeHttpRequest *req, void *buf, size_t cap);
+
+/* Push-style variant: return a negative value from the callback to stop */
+typedef int (*ForgeBodyCallback)(const char *data, size_t len, void *user);
+
+/* Returns total body bytes, or FORGE_BODY_* / the callback's negative code */
+long long forge_body_stream(const ForgeHttpRequest *req,
+                            ForgeBodyCallback on_chunk,
+                            void *user);
+
 /* =========================================================
    HTTP Response Helpers (PUBLIC API)
    ========================================================= */
@@ -41,4 +197,14 @@ void forge_send_json(int client_socket,
                      const char *status,
                      const char *body);
 
+/*
+ * Add a header to the next response sent on `client_socket` by the
+ * current request (middleware such as CORS uses this before the
+ * handler runs). Returns -1 when the value contains CR/LF or the
+ * per-response header space is exhausted.
+ */
+int forge_response_header(int client_socket,
+                          const char *name,
+                          const char *value);
+
 #endif /* FORGE_HTTP_H */
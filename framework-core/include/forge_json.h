@@ -0,0 +1,81 @@
+#ifndef FORGE_JSON_H
+#define FORGE_JSON_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* =========================================================
+   Streaming JSON Response Writer
+   ========================================================= */
+
+/*
+ * Serializes JSON straight into the response: no intermediate
+ * strings, no second copy. A body that fits the writer's buffer
+ * goes out with Content-Length in one write; a larger one is sent
+ * as HTTP/1.1 chunks each time the buffer fills (HTTP/1.0 and h2
+ * responses grow the buffer instead).
+ *
+ *   ForgeJsonWriter w;
+ *   forge_json_begin(&w, client_socket, "200 OK");
+ *   forge_json_object_begin(&w);
+ *   forge_json_key(&w, "id");
+ *   forge_json_int(&w, 42);
+ *   forge_json_object_end(&w);
+ *   forge_json_end(&w);
+ *
+ * Misuse (a key outside an object, unbalanced containers, ...)
+ * is sticky: forge_json_end() then answers 500 if nothing was
+ * sent yet and returns -1.
+ */
+
+#define FORGE_JSON_BUFFER 8192
+#define FORGE_JSON_MAX_DEPTH 64
+
+typedef struct
+{
+   int client_socket;
+   const char *status;
+
+   char *buf; /* inline_buf, or the heap once grown */
+   size_t len;
+   size_t cap;
+
+   uint64_t objects; /* bit per nesting level: object, not array */
+   int depth;
+   int need_comma;
+   int after_key; /* inside an object: the value is due */
+   int complete;  /* the top-level value is closed */
+   int chunked;   /* head sent; the buffer flushes as chunks */
+   int error;
+
+   char inline_buf[FORGE_JSON_BUFFER];
+} ForgeJsonWriter;
+
+void forge_json_begin(ForgeJsonWriter *w,
+                      int client_socket,
+                      const char *status);
+
+void forge_json_object_begin(ForgeJsonWriter *w);
+void forge_json_object_end(ForgeJsonWriter *w);
+void forge_json_array_begin(ForgeJsonWriter *w);
+void forge_json_array_end(ForgeJsonWriter *w);
+
+/* Member name; must be followed by exactly one value */
+void forge_json_key(ForgeJsonWriter *w, const char *key);
+
+/* Escaped per RFC 8259; bytes >= 0x80 pass through as UTF-8 */
+void forge_json_string(ForgeJsonWriter *w, const char *s);
+void forge_json_string_n(ForgeJsonWriter *w, const char *s, size_t len);
+
+void forge_json_int(ForgeJsonWriter *w, long long v);
+
+/* Shortest round-tripping form where cheap; NaN/Inf become null */
+void forge_json_double(ForgeJsonWriter *w, double v);
+
+void forge_json_bool(ForgeJsonWriter *w, int v);
+void forge_json_null(ForgeJsonWriter *w);
+
+/* Send what is left and end the response; 0, or -1 on error */
+int forge_json_end(ForgeJsonWriter *w);
+
+#endif /* FORGE_JSON_H */
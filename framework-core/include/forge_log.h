@@ -0,0 +1,63 @@
+#ifndef FORGE_LOG_H
+#define FORGE_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "forge_http.h"
+
+/* =========================================================
+   Access Log Formats
+   ========================================================= */
+
+typedef enum
+{
+   FORGE_LOG_TEXT = 0,  /* one human-readable line per request */
+   FORGE_LOG_BINARY = 1 /* compact records, see forge_access_log_decode() */
+} ForgeLogFormat;
+
+/* Per-thread ring capacity in entries (power of two) */
+#define FORGE_LOG_RING_SIZE 4096
+
+/* Magic at the start of every binary access log */
+#define FORGE_LOG_MAGIC "FRGLOG1\n"
+
+/* =========================================================
+   Access Log API
+   ========================================================= */
+
+/*
+ * Open `path` for appending and start the background writer.
+ * Request threads only ever push into their own lock-free ring;
+ * the writer drains every ring in batches. Returns 0 / -1.
+ */
+int forge_access_log_open(const char *path, ForgeLogFormat format);
+
+/* Drain outstanding entries, stop the writer and close the file */
+void forge_access_log_close(void);
+
+/* Entries dropped because a ring was full (never blocks instead) */
+unsigned long long forge_access_log_dropped(void);
+
+/* Monotonic clock used for request durations */
+uint64_t forge_access_log_clock(void);
+
+/*
+ * Hot path: record one finished request. `req` may be NULL for
+ * requests that failed to parse. `peer_ipv4` is in network byte
+ * order (0 for unix sockets). No-op while the log is closed.
+ */
+void forge_access_log_record(const ForgeHttpRequest *req,
+                             int status,
+                             size_t bytes,
+                             uint32_t peer_ipv4,
+                             uint64_t start_ns);
+
+/*
+ * Offline decoder: convert a binary access log read from `in`
+ * into the text format on `out`. Returns records decoded or -1.
+ */
+long forge_access_log_decode(FILE *in, FILE *out);
+
+#endif /* FORGE_LOG_H */
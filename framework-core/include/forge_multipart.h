@@ -0,0 +1,86 @@
+#ifndef FORGE_MULTIPART_H
+#define FORGE_MULTIPART_H
+
+#include <stddef.h>
+
+#include "forge_http.h"
+
+/* =========================================================
+   multipart/form-data (RFC 7578)
+   ========================================================= */
+
+/*
+ * Streaming form parser: the body is fed in arbitrary pieces and
+ * every part is reported through callbacks while it arrives. The
+ * boundary is found with Boyer-Moore-Horspool, also when it straddles
+ * two pieces; only a boundary-sized tail is ever held back. Each
+ * part's SHA-256 is computed on the fly.
+ *
+ * With `spool_dir` set, file parts (those with a filename) go to a
+ * new file there instead of on_part_data; the file belongs to the
+ * caller from on_part_end on (rename or unlink it). A part that
+ * fails midway has its file removed.
+ *
+ * Memory use is one fixed parser state, whatever the upload size.
+ */
+
+#define FORGE_MULTIPART_MALFORMED -3 /* bad framing or part headers */
+#define FORGE_MULTIPART_IO -4        /* spool file could not be written */
+
+#define FORGE_MULTIPART_MAX_BOUNDARY 70
+#define FORGE_MULTIPART_MAX_HEADERS 4096 /* per part */
+
+typedef struct
+{
+   const char *name;         /* form field name, "" when missing */
+   const char *filename;     /* NULL unless a file field */
+   const char *content_type; /* "" when not given */
+   const char *spool_path;   /* file receiving the data, or NULL */
+
+   unsigned long long size;  /* data bytes so far */
+   unsigned char sha256[32]; /* of the data; set for on_part_end */
+} ForgeMultipartPart;
+
+/*
+ * Callbacks are optional. A negative return aborts parsing and is
+ * passed back to the caller; use values below -16.
+ */
+typedef struct
+{
+   int (*on_part_begin)(const ForgeMultipartPart *part, void *user);
+   int (*on_part_data)(const ForgeMultipartPart *part,
+                       const char *data, size_t len, void *user);
+   int (*on_part_end)(const ForgeMultipartPart *part, void *user);
+
+   const char *spool_dir; /* NULL: every part goes to on_part_data */
+} ForgeMultipartHandler;
+
+typedef struct ForgeMultipart ForgeMultipart;
+
+/*
+ * Parser for a body with Content-Type `content_type` (`len` bytes,
+ * not NUL-terminated). NULL unless it is multipart with a valid
+ * boundary, or on OOM. `handler` must outlive the parser.
+ */
+ForgeMultipart *forge_multipart_new(const char *content_type, size_t len,
+                                    const ForgeMultipartHandler *handler,
+                                    void *user);
+
+/* Parse the next piece of the body; 0 or a negative code */
+int forge_multipart_feed(ForgeMultipart *mp, const char *data, size_t len);
+
+/* After the last piece: number of parts, or MALFORMED when truncated */
+int forge_multipart_finish(ForgeMultipart *mp);
+
+/* Releases the parser; removes the spool file of an unfinished part */
+void forge_multipart_free(ForgeMultipart *mp);
+
+/*
+ * Parse `req`'s body with forge_body_stream(). Returns the number of
+ * parts, FORGE_BODY_* / FORGE_MULTIPART_*, or a callback's code.
+ */
+int forge_multipart_read(const ForgeHttpRequest *req,
+                         const ForgeMultipartHandler *handler,
+                         void *user);
+
+#endif /* FORGE_MULTIPART_H */
@@ -0,0 +1,47 @@
+#ifndef FORGE_POOL_H
+#define FORGE_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* =========================================================
+   I/O Buffer Pools
+   ========================================================= */
+
+/*
+ * Fixed-size buffers carved from 2 MB regions: explicit huge pages
+ * (MAP_HUGETLB) when the host reserved them, otherwise transparent
+ * huge pages (madvise). Each NUMA node has its own pools, and
+ * memory is bound to that node; a thread allocates from the pools
+ * of the node it first allocated on, so every core keeps its
+ * connection buffers local. A thread reuses slots it freed itself
+ * (up to 64 KB per size) without taking the pool lock. Regions are
+ * kept for reuse, never returned to the OS.
+ *
+ * Windows and hosts without mmap fall back to malloc().
+ */
+
+#define FORGE_POOL_REGION ((size_t)2 * 1024 * 1024)
+#define FORGE_POOL_MAX_NODES 8
+#define FORGE_POOL_CLASSES 5 /* slot sizes, 512 B to 64 KB */
+
+/* Smallest pooled buffer >= size, or NULL (too large / OOM) */
+void *forge_pool_alloc(size_t size);
+
+/* Release a forge_pool_alloc() buffer, from any thread */
+void forge_pool_free(void *buf);
+
+typedef struct
+{
+   int node;
+   size_t slot_size;
+   uint64_t slots_used;
+   uint64_t slots_total; /* carved and still unused slots included */
+   uint64_t regions;
+   uint64_t hugetlb_regions; /* the rest are THP-advised */
+} ForgePoolStats;
+
+/* Fill up to `max` entries, one per (node, size) pool in use */
+int forge_pool_stats(ForgePoolStats *out, int max);
+
+#endif /* FORGE_POOL_H */
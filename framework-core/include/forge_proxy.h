@@ -0,0 +1,73 @@
+#ifndef FORGE_PROXY_H
+#define FORGE_PROXY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* =========================================================
+   Reverse Proxy (POSIX only)
+   ========================================================= */
+
+/*
+ * Forwards requests to HTTP/1.1 backends. On the event loop the
+ * exchange is parked and forwarded from a proxy thread, so a slow
+ * backend never stalls a core. Each thread keeps its own idle
+ * keep-alive connections per upstream, so a proxied request
+ * normally costs no connect(). Request and response bodies
+ * are streamed through a fixed buffer (HTTP/2 clients get the
+ * response buffered, up to FORGE_PROXY_H2_MAX_BODY). An HTTP/1
+ * request body is not staged: the proxy thread forwards it as it
+ * arrives, so it takes no spool and the backend sees it early.
+ *
+ * Every request goes to the upstream with the fewest requests in
+ * flight across all threads. An upstream that refuses or times out
+ * a connect is skipped for a second while the request fails over
+ * to the next one; 502 once none is left. A request that reached a
+ * backend is not sent again: an error after that is a 502, unless
+ * it was idempotent and the pooled connection had closed unread.
+ */
+
+#define FORGE_PROXY_MAX_UPSTREAMS 8
+#define FORGE_PROXY_H2_MAX_BODY (8 * 1024 * 1024)
+#define FORGE_PROXY_DEFAULT_THREADS 64
+
+typedef struct ForgeProxy ForgeProxy;
+
+/*
+ * Upstreams are "host:port" (IPv4) or "unix:/path". Returns NULL
+ * on a malformed address or too many upstreams/proxies.
+ */
+ForgeProxy *forge_proxy_create(const char *const *upstreams, int count);
+
+/*
+ * Serve `method` `path` by forwarding to `proxy`. The request goes
+ * upstream as `upstream_path` (NULL: unchanged). `max_body` as in
+ * ForgeRoute. Register before launching the server or from a
+ * forge_router_on_reload() build; 0 / -1.
+ */
+int forge_proxy_route(ForgeProxy *proxy,
+                      const char *method,
+                      const char *path,
+                      const char *upstream_path,
+                      size_t max_body);
+
+typedef struct
+{
+   uint64_t requests;
+   uint64_t connect_failures;
+   uint64_t outstanding; /* in flight right now */
+   uint64_t reused;      /* served over a pooled connection */
+} ForgeUpstreamStats;
+
+/* Counters of upstream `index` of `proxy`; 0 / -1 */
+int forge_proxy_stats(const ForgeProxy *proxy, int index,
+                      ForgeUpstreamStats *out);
+
+/*
+ * Proxy threads, i.e. how many parked requests wait on backends at
+ * once; the rest queue. Set before launching, 0 =
+ * FORGE_PROXY_DEFAULT_THREADS.
+ */
+void forge_proxy_set_threads(unsigned threads);
+
+#endif /* FORGE_PROXY_H */
@@ -16,8 +16,28 @@ typedef struct
   const char *method;
   const char *path;
   ForgeRouteHandler handler;
+  size_t max_body; /* 0 = FORGE_DEFAULT_MAX_BODY */
+  void *arg;       /* handler data: forge_route_arg() */
 } ForgeRoute;
 
+/* =========================================================
+   Middleware Types
+   ========================================================= */
+
+#define FORGE_NEXT 0 /* continue with the next middleware / handler */
+#define FORGE_HALT 1 /* middleware already sent the response */
+
+/* Runs before the handler; returns FORGE_NEXT or FORGE_HALT */
+typedef int (*ForgeMiddlewareFn)(
+    const ForgeHttpRequest *req,
+    int client_socket);
+
+/* Runs after the response was sent, with its status code */
+typedef void (*ForgeMiddlewareDoneFn)(
+    const ForgeHttpRequest *req,
+    int client_socket,
+    int status);
+
 /* =========================================================
    Router API
    ========================================================= */
@@ -27,4 +47,85 @@ const ForgeRoute *forge_match_route(
     int count,
     const ForgeHttpRequest *req);
 
+/*
+ * Register application routes, normally before launch_server().
+ * Strings are not copied and must outlive the server. Application
+ * routes take precedence over the built-in ones; for a repeated
+ * method + path the first registration wins. Returns 0 / -1.
+ */
+int forge_router_add(const char *method,
+                     const char *path,
+                     ForgeRouteHandler handler);
+int forge_router_add_route(const ForgeRoute *route);
+
+/*
+ * `arg` of the route whose handler runs on this thread. It is
+ * published with the route, so a reload that registers the path
+ * again with new data switches both at once.
+ */
+void *forge_route_arg(void);
+
+/* Priority classes for forge_route_priority() */
+#define FORGE_PRIORITY_NORMAL 0
+#define FORGE_PRIORITY_HIGH 1 /* health checks, control plane */
+
+/*
+ * Tag an application or built-in route. HIGH requests are never shed
+ * by admission control and do not count toward its queue-delay
+ * estimate, and they are the only ones answered on the control
+ * listener (forge_server_listen_control), whose thread runs their
+ * handlers too: keep them thread-safe. Untagged, GET /health and
+ * GET /metrics are HIGH and everything else NORMAL. Before launch;
+ * returns 0 / -1.
+ */
+int forge_route_priority(const char *method,
+                         const char *path,
+                         int priority);
+
+/*
+ * Attach middleware to every route whose path is `prefix` or lies
+ * below it ("/api" covers "/api/x", not "/apix"). A NULL prefix
+ * covers all routes and unmatched (404) requests. `before` hooks run
+ * in registration order; `after` hooks run in reverse for every
+ * `before` that ran. Either hook may be NULL. Returns 0 / -1.
+ *
+ * Chains are compiled into one flat array per route when registered,
+ * so dispatch walks no lists per request.
+ */
+int forge_use(const char *prefix,
+              ForgeMiddlewareFn before,
+              ForgeMiddlewareDoneFn after);
+
+/* =========================================================
+   Hot Reload
+   ========================================================= */
+
+/* Registers the reloadable routes, middleware and priorities; 0 / -1 */
+typedef int (*ForgeRouterBuildFn)(void *arg);
+
+/*
+ * Make part of the routing configuration reloadable while serving.
+ * `build` runs now, and again on every forge_router_reload(), SIGHUP,
+ * or admin route (forge_handle_reload). A reload drops what `build`
+ * registered last time, runs it again, compiles the result off the
+ * request path and publishes it with one atomic pointer swap:
+ * requests already dispatched finish on the table they started
+ * with, which is freed once none is left. When `build` fails the
+ * previous registrations and table stay. Registrations made before
+ * this call are kept across reloads; make them first. Returns 0 / -1.
+ */
+int forge_router_on_reload(ForgeRouterBuildFn build, void *arg);
+
+/* Rebuild and publish now, from any thread (handlers too). 0 / -1 */
+int forge_router_reload(void);
+
+/*
+ * Handler for an admin route that runs forge_router_reload() and
+ * answers 200 or 500. Not mounted by default: register it yourself,
+ * e.g. tagged HIGH so the control listener serves it, behind auth
+ * middleware. SIGHUP reloads too (POSIX; pre-fork masters forward it
+ * to every worker).
+ */
+void forge_handle_reload(const ForgeHttpRequest *req, int client_socket);
+
 #endif /* FORGE_ROUTER_H */
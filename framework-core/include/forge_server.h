@@ -24,7 +24,7 @@
 #define ALIGNOF(T) offsetof(struct { char c; T member; }, member)
 
 STATIC_ASSERT(
-    FORGE_ABI_VERSION == 1,
+    FORGE_ABI_VERSION == 6,
     forge_server_abi_mismatch);
 /* =========================================================
    Forge Server Structure
@@ -40,6 +40,13 @@ typedef struct
     int port;
     int backlog;
     struct sockaddr_in address;
+
+    /* AF_UNIX stream listener (co-located proxies); -1 when unused */
+#ifdef _WIN32
+    SOCKET unix_fd;
+#else
+    int unix_fd;
+#endif
 } ForgeServer;
 
 /* =========================================================
@@ -65,8 +72,105 @@ STATIC_ASSERT(
    ========================================================= */
 
 ForgeServer create_forge_server(int port, int backlog);
+
+/*
+ * Unix domain socket listeners (POSIX only).
+ *
+ * create_forge_unix_server() listens on `path` instead of TCP;
+ * forge_server_listen_unix() adds `path` alongside an existing
+ * TCP listener. Both serve requests through the same handler.
+ * A stale socket file at `path` is replaced. Returns 0 / -1.
+ */
+ForgeServer create_forge_unix_server(const char *path, int backlog);
+int forge_server_listen_unix(ForgeServer *server, const char *path);
+
+/*
+ * Admission control. A request that waited in the server's queue
+ * (readable socket to handler start) longer than allowed is answered
+ * "503 Service Unavailable" with Retry-After, so overload costs a
+ * few pre-serialized bytes per request instead of a handler run.
+ * Requests may queue for `interval_ms`; once the best request of an
+ * interval waited more than `target_ms`, only `target_ms`.
+ * Defaults: 5ms / 100ms / 1s. target_ms 0 disables shedding; queue
+ * delay is still measured. Both show up in forge_core_stats() and
+ * GET /metrics.
+ */
+void forge_server_set_admission(unsigned target_ms,
+                                unsigned interval_ms,
+                                unsigned retry_after_s);
+
+#define FORGE_SPOOL_DEFAULT_BUDGET (4ULL * 1024 * 1024 * 1024)
+
+/*
+ * Request bodies too large for memory are staged in unlinked files
+ * under $TMPDIR before dispatch. `bytes` caps what all connections
+ * of the process hold there at once; a body that would pass it is
+ * answered 503 with Retry-After. Set before launching; 0 lifts the
+ * cap.
+ */
+void forge_server_set_spool_budget(unsigned long long bytes);
+
+/*
+ * Control-plane listener on the server's address at `port` (0: any
+ * free port). It is served by a thread of its own instead of the
+ * request cores, so orchestrator probes are answered even when every
+ * core is saturated. Only high-priority routes (forge_route_priority)
+ * are served there, one HTTP/1.x request per connection; anything
+ * else gets 404. Call before launching; POSIX only. Returns the bound
+ * port, or -1.
+ */
+int forge_server_listen_control(ForgeServer *server, int port);
+
 void launch_server(ForgeServer *server);
 
+/*
+ * Serve on `cores` threads (<= 0: one per online CPU), each running
+ * its own event loop; see forge_core.h. Register routes and
+ * middleware before calling. launch_server() is the one-core case.
+ * Windows serves sequentially on the calling thread.
+ */
+void launch_server_cores(ForgeServer *server, int cores);
+
+/*
+ * Pre-fork mode, for handlers that cannot share an address space
+ * with other threads (POSIX). The calling process becomes a master
+ * that forks `workers` processes (<= 0: one per online CPU), each
+ * running a single event loop. Workers accept from the listeners
+ * created before the call, which they inherit and share; a worker
+ * that exits is replaced, and SIGTERM / SIGINT stop them all.
+ * Counters live in a shared-memory segment, so GET /metrics in any
+ * worker reports the sum over all of them. Never returns. Windows
+ * serves as launch_server().
+ */
+#define FORGE_MAX_WORKERS 256
+
+void launch_server_workers(ForgeServer *server, int workers);
+
+/* Index of this pre-fork worker (0..workers-1), or -1 */
+int forge_worker_id(void);
+
+/*
+ * CPU placement for launch_server_cores() and launch_server_workers()
+ * (Linux). Core or worker i is pinned to cpus[i % count]; NULL pins
+ * to the CPUs the process may run on, in order. Pinned threads show
+ * connections accepted off their CPU as
+ * forge_connections_off_cpu_total in GET /metrics. Call before
+ * launching; returns 0, or -1 when unsupported or out of range.
+ */
+int forge_server_pin_cpus(const int *cpus, int count);
+
+/*
+ * With pinning, hand each connection to the core or worker pinned on
+ * the CPU that received its SYN (a reuseport BPF program), so its
+ * packets and its handler share a cache. Other CPUs fall back to the
+ * kernel's hash. Pays off when NIC queue interrupts are pinned to
+ * the same CPUs (RSS / irq affinity); that is left to the operator.
+ */
+int forge_server_steer_connections(int enable);
+
+/* "0-3,8" into cpus[]; returns the count, or -1 when malformed */
+int forge_parse_cpu_list(const char *list, int *cpus, int max);
+
 #ifdef _WIN32
 void handle_client(SOCKET client_socket);
 #else
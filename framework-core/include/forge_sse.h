@@ -0,0 +1,70 @@
+#ifndef FORGE_SSE_H
+#define FORGE_SSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* =========================================================
+   Server-Sent Events
+   ========================================================= */
+
+/*
+ * A topic fans events out to every connection subscribed through
+ * one of its routes (GET, answered with a text/event-stream that
+ * stays open). Publishing serializes the event once, chunk framing
+ * included, into a reference-counted buffer; each core queues a
+ * pointer to that buffer on its subscribers and writes their queues
+ * with one sendmsg() each. Nothing is copied per subscriber.
+ *
+ * A subscriber whose queue is full is disconnected (FORGE_SSE_DROP)
+ * or has its newest queued event replaced (FORGE_SSE_COALESCE), so a
+ * slow reader never holds more than `max_queue` events. Idle
+ * streams get a comment line every heartbeat interval.
+ *
+ * Subscriptions need the event loop (launch_server*) and an
+ * HTTP/1.1 client; HTTP/2 and handle_client() are refused.
+ */
+
+#define FORGE_SSE_DROP 0
+#define FORGE_SSE_COALESCE 1
+
+#define FORGE_SSE_DEFAULT_QUEUE 64
+#define FORGE_SSE_DEFAULT_HEARTBEAT 15 /* seconds */
+
+typedef struct ForgeSseTopic ForgeSseTopic;
+
+/* New topic; `max_queue` 0 = FORGE_SSE_DEFAULT_QUEUE. NULL on OOM */
+ForgeSseTopic *forge_sse_topic(int policy, size_t max_queue);
+
+/*
+ * Subscribe clients of GET `path` to `topic`, before launch or from a
+ * forge_router_on_reload() build. 0 / -1
+ */
+int forge_sse_route(const char *path, ForgeSseTopic *topic);
+
+/*
+ * Send an event to every current subscriber, from any thread.
+ * `event` names it (NULL for the default "message"); `data` may
+ * span lines. Returns the number of cores whose inbox was full and
+ * missed the event, or -1 on bad arguments / OOM.
+ */
+int forge_sse_publish(ForgeSseTopic *topic,
+                      const char *event,
+                      const char *data,
+                      size_t len);
+
+/* Heartbeat interval; set before launching, 0 disables */
+void forge_sse_set_heartbeat(unsigned seconds);
+
+typedef struct
+{
+   uint64_t subscribers; /* streams open now */
+   uint64_t published;   /* events accepted by forge_sse_publish */
+   uint64_t dropped;     /* subscribers disconnected for falling behind */
+   uint64_t coalesced;   /* queued events replaced by newer ones */
+} ForgeSseStats;
+
+/* One topic's counters, or the sum over all topics with NULL */
+void forge_sse_stats(const ForgeSseTopic *topic, ForgeSseStats *out);
+
+#endif /* FORGE_SSE_H */
@@ -0,0 +1,77 @@
+#ifndef FORGE_WS_H
+#define FORGE_WS_H
+
+#include <stddef.h>
+
+#include "forge_http.h"
+
+/* =========================================================
+   WebSocket (RFC 6455)
+   ========================================================= */
+
+/*
+ * A WebSocket route answers the HTTP/1.1 upgrade handshake (after
+ * the route's middleware ran) and then keeps the connection on the
+ * core that accepted it. Frames are parsed in the connection's own
+ * receive buffer and unmasked in place, 16 bytes at a time; only
+ * fragmented or buffer-sized messages are reassembled on the heap,
+ * and that memory is released once the message was delivered. An
+ * idle socket costs its connection slot and a small state block.
+ *
+ * Pings are answered automatically. A connection idle for the
+ * server's keep-alive timeout is pinged, and closed when the next
+ * timeout passes without a reply. HTTP/2 clients are refused
+ * (no extended CONNECT).
+ */
+
+#define FORGE_WS_DEFAULT_MAX_MESSAGE ((size_t)1024 * 1024)
+
+#define FORGE_WS_TEXT 0x1
+#define FORGE_WS_BINARY 0x2
+
+/* Close codes */
+#define FORGE_WS_NORMAL 1000
+#define FORGE_WS_GOING_AWAY 1001
+#define FORGE_WS_PROTOCOL_ERROR 1002
+#define FORGE_WS_INVALID_DATA 1007
+#define FORGE_WS_TOO_BIG 1009
+#define FORGE_WS_ABNORMAL 1006 /* reported only: no close frame seen */
+
+typedef struct ForgeWs ForgeWs;
+
+typedef struct
+{
+   /* After the 101 was sent; may send and set user data. Optional */
+   void (*on_open)(ForgeWs *ws, const ForgeHttpRequest *req);
+
+   /* A complete message; text is valid UTF-8. `data` is only valid
+      during the call */
+   void (*on_message)(ForgeWs *ws, int opcode, const char *data, size_t len);
+
+   /* Once per connection, with the peer's close code. Optional */
+   void (*on_close)(ForgeWs *ws, int code);
+
+   size_t max_message; /* 0 = FORGE_WS_DEFAULT_MAX_MESSAGE */
+} ForgeWsHandler;
+
+/*
+ * Serve WebSocket connections on GET `path`, before launch or from a
+ * forge_router_on_reload() build. `handler` is not copied and must
+ * outlive the server. Returns 0 / -1.
+ */
+int forge_ws_route(const char *path, const ForgeWsHandler *handler);
+
+/*
+ * Send one unfragmented message (FORGE_WS_TEXT / FORGE_WS_BINARY).
+ * Call from the connection's core, i.e. from the callbacks or a
+ * function posted with forge_core_post(). Returns 0 / -1.
+ */
+int forge_ws_send(ForgeWs *ws, int opcode, const void *data, size_t len);
+
+/* Start the closing handshake; the connection ends on the reply */
+int forge_ws_close(ForgeWs *ws, int code, const char *reason);
+
+void forge_ws_set_user(ForgeWs *ws, void *user);
+void *forge_ws_user(const ForgeWs *ws);
+
+#endif /* FORGE_WS_H */
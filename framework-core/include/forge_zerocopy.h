@@ -0,0 +1,46 @@
+#ifndef FORGE_ZEROCOPY_H
+#define FORGE_ZEROCOPY_H
+
+#include <stddef.h>
+
+/* =========================================================
+   Zero-Copy Response Bodies
+   ========================================================= */
+
+/*
+ * Opt-in send path for large bodies (reports, downloads) on Linux
+ * TCP: the body goes out with MSG_ZEROCOPY, so the kernel sends
+ * from the caller's pages instead of copying them into the socket
+ * buffer. The pages stay in use after the call returns, until the
+ * peer acknowledged them; completions are read from the socket's
+ * error queue by the connection's event loop, and only then is
+ * `release(user)` called, on that loop's thread.
+ *
+ * Smaller bodies, HTTP/2, cached routes, Unix sockets and other
+ * platforms take the regular copying path and release at once.
+ * Pinning pages and reaping completions costs more than copying a
+ * small body; tools/forge_zcbench.c measures where that turns.
+ */
+
+#ifndef FORGE_ZEROCOPY_MIN
+#define FORGE_ZEROCOPY_MIN (64 * 1024) /* smaller bodies are copied */
+#endif
+
+/* Bodies in flight per connection; beyond that sends copy */
+#define FORGE_ZEROCOPY_PENDING 16
+
+typedef void (*ForgeReleaseFn)(void *user);
+
+/*
+ * Like forge_http_respond(), but `body` must stay unchanged until
+ * `release(user)` runs (NULL: static data, nothing to release).
+ */
+void forge_send_zerocopy(int client_socket,
+                         const char *status,
+                         const char *content_type,
+                         const char *body,
+                         size_t body_len,
+                         ForgeReleaseFn release,
+                         void *user);
+
+#endif /* FORGE_ZEROCOPY_H */
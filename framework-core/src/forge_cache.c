@@ -0,0 +1,1106 @@
+#define _GNU_SOURCE
+#include "forge_cache.h"
+#include "forge_http.h"
+#include "forge_log.h"
+#include "forge_router.h"
+#include "forge_internal.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* =========================================================
+   Policies
+   ========================================================= */
+
+#define MAX_CACHE_POLICIES 64
+#define VARY_NAME_MAX 64
+
+struct ForgeCachePolicy
+{
+  const char *method;
+  const char *path;
+  uint64_t ttl_ns;    /* 0: only coalesced, nothing kept */
+  uint64_t wait_ns;   /* forge_cache_coalesce(); 0: requests never wait */
+  int vary_count;
+  char vary[FORGE_CACHE_MAX_VARY][VARY_NAME_MAX];
+  char vary_value[FORGE_CACHE_MAX_VARY * (VARY_NAME_MAX + 2)]; /* "a, b" */
+  int vary_auth; /* Authorization selects a variant */
+};
+
+/* Registered settings; published tables serve from copies of them */
+static ForgeCachePolicy policies[MAX_CACHE_POLICIES];
+static int policy_count;
+static size_t cache_budget = FORGE_CACHE_DEFAULT_BUDGET;
+
+static char ascii_lower(char c)
+{
+  return (c >= 'A' && c <= 'Z') ? (char)(c + 32) : c;
+}
+
+static int name_equals(const char *a, size_t a_len, const char *b)
+{
+  if (strlen(b) != a_len)
+    return 0;
+  for (size_t i = 0; i < a_len; i++)
+  {
+    if (ascii_lower(a[i]) != ascii_lower(b[i]))
+      return 0;
+  }
+  return 1;
+}
+
+/* Case-insensitive search of `needle` (lowercase) in s[0, len) */
+static int contains_lower(const char *s, size_t len, const char *needle)
+{
+  size_t n = strlen(needle);
+  for (size_t i = 0; i + n <= len; i++)
+  {
+    size_t j = 0;
+    while (j < n && ascii_lower(s[i + j]) == needle[j])
+      j++;
+    if (j == n)
+      return 1;
+  }
+  return 0;
+}
+
+/* The route's policy, added if it has none yet */
+static ForgeCachePolicy *policy_for(const char *method, const char *path)
+{
+  for (int i = 0; i < policy_count; i++)
+  {
+    if (strcmp(policies[i].method, method) == 0 &&
+        strcmp(policies[i].path, path) == 0)
+      return &policies[i];
+  }
+
+  if (policy_count == MAX_CACHE_POLICIES)
+    return NULL;
+
+  ForgeCachePolicy *p = &policies[policy_count++];
+  memset(p, 0, sizeof(*p));
+  p->method = method;
+  p->path = path;
+  return p;
+}
+
+int forge_cache_route(const char *method,
+                      const char *path,
+                      unsigned ttl_ms,
+                      const char *vary)
+{
+  if (!method || !path || ttl_ms == 0)
+    return -1;
+
+  /* Parsed aside: a bad list leaves the route as it was */
+  ForgeCachePolicy parsed;
+  memset(&parsed, 0, sizeof(parsed));
+  ForgeCachePolicy *p = &parsed;
+  size_t value_len = 0;
+
+  for (const char *s = vary; s && *s;)
+  {
+    while (*s == ' ' || *s == ',')
+      s++;
+    if (!*s)
+      break;
+
+    size_t len = strcspn(s, ", ");
+    if (p->vary_count == FORGE_CACHE_MAX_VARY || len >= VARY_NAME_MAX)
+      return -1;
+
+    char *name = p->vary[p->vary_count++];
+    memcpy(name, s, len);
+    name[len] = '\0';
+    p->vary_auth |= name_equals(name, len, "authorization");
+
+    size_t sep = p->vary_count > 1 ? 2 : 0;
+    if (value_len + sep + len >= sizeof(p->vary_value))
+      return -1;
+    memcpy(p->vary_value + value_len, ", ", sep);
+    memcpy(p->vary_value + value_len + sep, name, len);
+    value_len += sep + len;
+    p->vary_value[value_len] = '\0';
+    s += len;
+  }
+
+  ForgeCachePolicy *route = policy_for(method, path);
+  if (!route)
+    return -1;
+
+  parsed.method = route->method;
+  parsed.path = route->path;
+  parsed.ttl_ns = (uint64_t)ttl_ms * 1000000ULL;
+  parsed.wait_ns = route->wait_ns;
+  *route = parsed;
+  forge_router_invalidate();
+  return 0;
+}
+
+int forge_cache_coalesce(const char *method, const char *path, unsigned wait_ms)
+{
+  if (!method || !path)
+    return -1;
+
+  ForgeCachePolicy *route = policy_for(method, path);
+  if (!route)
+    return -1;
+
+  route->wait_ns = (uint64_t)(wait_ms ? wait_ms : FORGE_COALESCE_DEFAULT_WAIT_MS) *
+                   1000000ULL;
+  forge_router_invalidate();
+  return 0;
+}
+
+int forge_cache_policy_copy(const char *method, const char *path,
+                            ForgeCachePolicy **out)
+{
+  *out = NULL;
+  for (int i = 0; i < policy_count; i++)
+  {
+    if (strcmp(policies[i].method, method) == 0 &&
+        strcmp(policies[i].path, path) == 0)
+    {
+      /* Later changes republish; this copy never changes under a reader */
+      *out = malloc(sizeof(**out));
+      if (!*out)
+        return -1;
+      **out = policies[i];
+      return 0;
+    }
+  }
+  return 0;
+}
+
+void forge_cache_set_budget(size_t bytes)
+{
+  cache_budget = bytes;
+}
+
+/* =========================================================
+   Shards
+   ========================================================= */
+
+#define CACHE_SHARDS 16
+#define SHARD_BUCKETS 1024
+#define ETAG_MAX 64
+
+/*
+ * One allocation: the entry, its key, the HTTP/1 head and the
+ * body. `headers` points into `head` past the status line and
+ * framing, for HTTP/2 hits.
+ */
+typedef struct CacheEntry
+{
+  struct CacheEntry *chain; /* bucket */
+  struct CacheEntry *newer; /* LRU */
+  struct CacheEntry *older;
+  _Atomic int refs;         /* the shard's, plus one per hit in flight */
+
+  uint64_t hash;
+  uint64_t expires_ns;
+  size_t size;
+
+  const char *key;
+  size_t key_len;
+  char etag[ETAG_MAX];
+  char status[64];
+  char content_type[128];
+
+  const char *head;
+  size_t head_len;
+  const char *headers;
+  size_t headers_len;
+  const char *body;
+  size_t body_len;
+} CacheEntry;
+
+/* A request on a core loop parked behind a flight */
+typedef struct FlightWaiter
+{
+  struct FlightWaiter *next;
+  ForgeConn *conn;
+  int core;
+  uint64_t deadline_ns; /* then it runs the handler itself */
+  CacheEntry *result;   /* while a wake waits for room in the inbox */
+} FlightWaiter;
+
+/*
+ * A request whose handler is running for a coalesced key. Requests
+ * for the same key on a core loop park in `parked` and are resumed
+ * when it lands; others (handle_client threads) wait on `landed`
+ * under the shard lock. The last thread out (or the leader, if none
+ * waited) frees it.
+ */
+typedef struct Flight
+{
+  struct Flight *next;
+  FlightWaiter *parked;
+  pthread_cond_t landed_cond;
+  int landed;
+  int waiters;
+  CacheEntry *result; /* one reference; NULL: nothing to share */
+
+  uint64_t hash;
+  const char *key;
+  size_t key_len;
+} Flight;
+
+typedef struct
+{
+  pthread_mutex_t lock;
+  Flight *flights; /* in progress, few at a time */
+  CacheEntry *buckets[SHARD_BUCKETS];
+  CacheEntry *newest;
+  CacheEntry *oldest;
+  size_t bytes;
+  uint64_t entries;
+} Shard;
+
+static Shard shards[CACHE_SHARDS];
+static pthread_once_t shards_once = PTHREAD_ONCE_INIT;
+
+static _Atomic uint64_t stat_hits;
+static _Atomic uint64_t stat_not_modified;
+static _Atomic uint64_t stat_misses;
+static _Atomic uint64_t stat_stores;
+static _Atomic uint64_t stat_evictions;
+static _Atomic uint64_t stat_coalesced;
+
+static void shards_init(void)
+{
+  for (int i = 0; i < CACHE_SHARDS; i++)
+    pthread_mutex_init(&shards[i].lock, NULL);
+}
+
+static Shard *shard_of(uint64_t hash)
+{
+  pthread_once(&shards_once, shards_init);
+  return &shards[hash >> 60]; /* buckets use the low bits */
+}
+
+static void entry_release(CacheEntry *e)
+{
+  if (atomic_fetch_sub_explicit(&e->refs, 1, memory_order_acq_rel) == 1)
+    free(e);
+}
+
+/* Called with the shard locked; drops the shard's reference */
+static void shard_remove(Shard *s, CacheEntry *e)
+{
+  CacheEntry **link = &s->buckets[e->hash % SHARD_BUCKETS];
+  while (*link != e)
+    link = &(*link)->chain;
+  *link = e->chain;
+
+  if (e->newer)
+    e->newer->older = e->older;
+  else
+    s->newest = e->older;
+  if (e->older)
+    e->older->newer = e->newer;
+  else
+    s->oldest = e->newer;
+
+  s->bytes -= e->size;
+  s->entries--;
+  entry_release(e);
+}
+
+static void lru_push(Shard *s, CacheEntry *e)
+{
+  e->newer = NULL;
+  e->older = s->newest;
+  if (s->newest)
+    s->newest->newer = e;
+  else
+    s->oldest = e;
+  s->newest = e;
+}
+
+static CacheEntry *bucket_find(Shard *s, uint64_t hash,
+                               const char *key, size_t key_len)
+{
+  for (CacheEntry *e = s->buckets[hash % SHARD_BUCKETS]; e; e = e->chain)
+  {
+    if (e->hash == hash && e->key_len == key_len &&
+        memcmp(e->key, key, key_len) == 0)
+      return e;
+  }
+  return NULL;
+}
+
+/* A live entry with a reference taken, or NULL */
+static CacheEntry *cache_get(uint64_t hash, const char *key, size_t key_len,
+                             uint64_t now)
+{
+  Shard *s = shard_of(hash);
+  pthread_mutex_lock(&s->lock);
+
+  CacheEntry *e = bucket_find(s, hash, key, key_len);
+  if (e && now >= e->expires_ns)
+  {
+    shard_remove(s, e);
+    e = NULL;
+  }
+  else if (e)
+  {
+    if (s->newest != e)
+    {
+      e->newer->older = e->older;
+      if (e->older)
+        e->older->newer = e->newer;
+      else
+        s->oldest = e->newer;
+      lru_push(s, e);
+    }
+    atomic_fetch_add_explicit(&e->refs, 1, memory_order_relaxed);
+  }
+
+  pthread_mutex_unlock(&s->lock);
+  return e;
+}
+
+/* Takes over the caller's reference */
+static void cache_put(CacheEntry *e)
+{
+  Shard *s = shard_of(e->hash);
+  size_t budget = cache_budget / CACHE_SHARDS;
+
+  if (e->size > budget)
+  {
+    entry_release(e);
+    return;
+  }
+
+  pthread_mutex_lock(&s->lock);
+
+  CacheEntry *old = bucket_find(s, e->hash, e->key, e->key_len);
+  if (old)
+    shard_remove(s, old);
+
+  while (s->oldest && s->bytes + e->size > budget)
+  {
+    shard_remove(s, s->oldest);
+    atomic_fetch_add_explicit(&stat_evictions, 1, memory_order_relaxed);
+  }
+
+  CacheEntry **bucket = &s->buckets[e->hash % SHARD_BUCKETS];
+  e->chain = *bucket;
+  *bucket = e;
+  lru_push(s, e);
+  s->bytes += e->size;
+  s->entries++;
+
+  pthread_mutex_unlock(&s->lock);
+}
+
+void forge_cache_purge(void)
+{
+  pthread_once(&shards_once, shards_init);
+
+  for (int i = 0; i < CACHE_SHARDS; i++)
+  {
+    Shard *s = &shards[i];
+    pthread_mutex_lock(&s->lock);
+    while (s->oldest)
+      shard_remove(s, s->oldest);
+    pthread_mutex_unlock(&s->lock);
+  }
+}
+
+void forge_cache_stats(ForgeCacheStats *out)
+{
+  memset(out, 0, sizeof(*out));
+  out->hits = atomic_load_explicit(&stat_hits, memory_order_relaxed);
+  out->not_modified = atomic_load_explicit(&stat_not_modified, memory_order_relaxed);
+  out->misses = atomic_load_explicit(&stat_misses, memory_order_relaxed);
+  out->stores = atomic_load_explicit(&stat_stores, memory_order_relaxed);
+  out->evictions = atomic_load_explicit(&stat_evictions, memory_order_relaxed);
+  out->coalesced = atomic_load_explicit(&stat_coalesced, memory_order_relaxed);
+
+  pthread_once(&shards_once, shards_init);
+  for (int i = 0; i < CACHE_SHARDS; i++)
+  {
+    Shard *s = &shards[i];
+    pthread_mutex_lock(&s->lock);
+    out->entries += s->entries;
+    out->bytes += s->bytes;
+    pthread_mutex_unlock(&s->lock);
+  }
+}
+
+/* =========================================================
+   Coalescing
+   ========================================================= */
+
+static void flight_free(Flight *f)
+{
+  if (f->result)
+    entry_release(f->result);
+  pthread_cond_destroy(&f->landed_cond);
+  free(f);
+}
+
+/* Marks an exchange parked by flight_join(), not by the handler */
+static char flight_parked_tag;
+#define FLIGHT_PARKED_CAPTURE ((ForgeCapture *)&flight_parked_tag)
+
+/* Wakes for this core's own full inbox, retried by its sweep */
+static _Thread_local FlightWaiter *flight_retry;
+
+/* Hand a parked waiter its response (a reference, or NULL) */
+static void waiter_wake(FlightWaiter *w, CacheEntry *e)
+{
+  while (forge_conn_resume(w->conn, e) != 0)
+  {
+    /* Our own inbox only drains once this dispatch returns */
+    ForgeCore *core = forge_current_core();
+    if (core && forge_core_id(core) == w->core)
+    {
+      w->result = e;
+      w->next = flight_retry;
+      flight_retry = w;
+      return;
+    }
+    usleep(1000);
+  }
+  free(w);
+}
+
+/* Core timer: waiters on this core past their deadline run the handler */
+static void flights_expire(ForgeCore *core, void *arg)
+{
+  (void)arg;
+  int id = forge_core_id(core);
+  uint64_t now = forge_access_log_clock();
+  FlightWaiter *expired = NULL;
+
+  FlightWaiter *retry = flight_retry;
+  flight_retry = NULL;
+  while (retry)
+  {
+    FlightWaiter *w = retry;
+    retry = w->next;
+    waiter_wake(w, w->result);
+  }
+
+  for (int i = 0; i < CACHE_SHARDS; i++)
+  {
+    Shard *s = &shards[i];
+    pthread_mutex_lock(&s->lock);
+    for (Flight *f = s->flights; f; f = f->next)
+    {
+      for (FlightWaiter **link = &f->parked; *link;)
+      {
+        FlightWaiter *w = *link;
+        if (w->core != id || now < w->deadline_ns)
+        {
+          link = &w->next;
+          continue;
+        }
+        *link = w->next;
+        w->next = expired;
+        expired = w;
+      }
+    }
+    pthread_mutex_unlock(&s->lock);
+  }
+
+  while (expired)
+  {
+    FlightWaiter *w = expired;
+    expired = w->next;
+    waiter_wake(w, NULL);
+  }
+}
+
+#define FLIGHT_SWEEP_MS 50
+
+static _Thread_local int flight_sweeping;
+
+/* Park the request in `f`; under the shard lock. 0, or -1 to wait inline */
+static int flight_park(Flight *f, ForgeConn *c, uint64_t wait_ns)
+{
+  ForgeCore *core = forge_current_core();
+  if (!c || !core)
+    return -1;
+
+  if (!flight_sweeping)
+  {
+    if (forge_core_every(core, FLIGHT_SWEEP_MS, flights_expire, NULL) != 0)
+      return -1;
+    flight_sweeping = 1;
+  }
+
+  FlightWaiter *w = malloc(sizeof(*w));
+  if (!w)
+    return -1;
+
+  /* Parked with the marker, so the resumed dispatch knows it is ours */
+  ForgeCapture *capture = forge_exchange.capture;
+  forge_exchange.capture = FLIGHT_PARKED_CAPTURE;
+  int rc = forge_conn_park(c);
+  forge_exchange.capture = capture;
+  if (rc != 0)
+  {
+    free(w);
+    return -1;
+  }
+
+  w->conn = c;
+  w->core = forge_core_id(core);
+  w->deadline_ns = forge_access_log_clock() + wait_ns;
+  w->next = f->parked;
+  f->parked = w;
+  return 0;
+}
+
+#define FLIGHT_LEAD 0
+#define FLIGHT_SHARED 1 /* *shared holds the response */
+#define FLIGHT_RUN 2    /* timed out or nothing to share: run the handler */
+#define FLIGHT_PARKED 3 /* resumed with the response once it lands */
+
+/*
+ * Join the flight for a key, or start it (FLIGHT_LEAD, *lead set:
+ * land it when done). A follower on a core loop is parked; any
+ * other waits here for up to `wait_ns`.
+ */
+static int flight_join(uint64_t hash, const char *key, size_t key_len,
+                       uint64_t wait_ns, ForgeConn *c,
+                       Flight **lead, CacheEntry **shared)
+{
+  Shard *s = shard_of(hash);
+  *lead = NULL;
+  *shared = NULL;
+
+  pthread_mutex_lock(&s->lock);
+
+  Flight *f = s->flights;
+  while (f && !(f->hash == hash && f->key_len == key_len &&
+                memcmp(f->key, key, key_len) == 0))
+    f = f->next;
+
+  if (!f)
+  {
+    f = calloc(1, sizeof(*f) + key_len);
+    if (f)
+    {
+      pthread_cond_init(&f->landed_cond, NULL);
+      memcpy(f + 1, key, key_len);
+      f->key = (const char *)(f + 1);
+      f->key_len = key_len;
+      f->hash = hash;
+      f->next = s->flights;
+      s->flights = f;
+      *lead = f;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return *lead ? FLIGHT_LEAD : FLIGHT_RUN;
+  }
+
+  if (flight_park(f, c, wait_ns) == 0)
+  {
+    pthread_mutex_unlock(&s->lock);
+    return FLIGHT_PARKED;
+  }
+
+  /* Condition variables time out on the realtime clock */
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  uint64_t ns = (uint64_t)deadline.tv_nsec + wait_ns;
+  deadline.tv_sec += (time_t)(ns / 1000000000ULL);
+  deadline.tv_nsec = (long)(ns % 1000000000ULL);
+
+  f->waiters++;
+  while (!f->landed &&
+         pthread_cond_timedwait(&f->landed_cond, &s->lock, &deadline) != ETIMEDOUT)
+    ;
+
+  CacheEntry *e = f->landed ? f->result : NULL;
+  if (e)
+    atomic_fetch_add_explicit(&e->refs, 1, memory_order_relaxed);
+  if (--f->waiters == 0 && f->landed)
+    flight_free(f);
+
+  pthread_mutex_unlock(&s->lock);
+  *shared = e;
+  return e ? FLIGHT_SHARED : FLIGHT_RUN;
+}
+
+/* Hand the leader's response (its reference, or NULL) to the waiters */
+static void flight_land(Flight *f, CacheEntry *result)
+{
+  Shard *s = shard_of(f->hash);
+  pthread_mutex_lock(&s->lock);
+
+  Flight **link = &s->flights;
+  while (*link != f)
+    link = &(*link)->next;
+  *link = f->next;
+
+  f->result = result;
+  f->landed = 1;
+  FlightWaiter *parked = f->parked;
+  f->parked = NULL;
+  pthread_cond_broadcast(&f->landed_cond);
+
+  /* Each parked request gets a reference of its own */
+  for (FlightWaiter *w = parked; w && result; w = w->next)
+    atomic_fetch_add_explicit(&result->refs, 1, memory_order_relaxed);
+  if (f->waiters == 0)
+    flight_free(f);
+
+  pthread_mutex_unlock(&s->lock);
+
+  while (parked)
+  {
+    FlightWaiter *w = parked;
+    parked = w->next;
+    waiter_wake(w, result);
+  }
+}
+
+/* =========================================================
+   Capture
+   ========================================================= */
+
+/* The response of a missed request, recorded while it is sent */
+struct ForgeCapture
+{
+  const ForgeCachePolicy *policy;
+  size_t headers_from; /* exchange headers that middleware added */
+
+  char status[64];
+  char content_type[128];
+  char etag[ETAG_MAX];
+  int etag_sent; /* the ETag is among the exchange headers */
+
+  char *body;
+  size_t len;
+  size_t cap;
+
+  int started;
+  int chunked;
+  int complete;
+  int failed;
+};
+
+static uint64_t fnv1a(uint64_t h, const char *data, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    h ^= (unsigned char)data[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+#define FNV_OFFSET 14695981039346656037ULL
+
+static void make_etag(ForgeCapture *c)
+{
+  snprintf(c->etag, sizeof(c->etag), "\"%016llx-%zx\"",
+           (unsigned long long)fnv1a(FNV_OFFSET, c->body ? c->body : "", c->len),
+           c->len);
+}
+
+/* The handler's own ETag, if it set one */
+static int find_etag(const char *headers, size_t len, char *out, size_t cap)
+{
+  for (const char *p = headers; p < headers + len;)
+  {
+    const char *end = memchr(p, '\r', (size_t)(headers + len - p));
+    if (!end)
+      break;
+
+    if ((size_t)(end - p) > 5 && name_equals(p, 5, "etag:"))
+    {
+      const char *v = p + 5;
+      while (*v == ' ')
+        v++;
+      size_t v_len = (size_t)(end - v);
+      if (v_len == 0 || v_len >= cap)
+        return 0;
+      memcpy(out, v, v_len);
+      out[v_len] = '\0';
+      return 1;
+    }
+    p = end + 2;
+  }
+  return 0;
+}
+
+static int capture_append(ForgeCapture *c, const char *data, size_t len)
+{
+  if (c->len + len > FORGE_CACHE_MAX_ENTRY)
+    return -1;
+
+  if (c->len + len > c->cap)
+  {
+    size_t cap = c->cap ? c->cap : 4096;
+    while (cap < c->len + len)
+      cap *= 2;
+    char *grown = realloc(c->body, cap);
+    if (!grown)
+      return -1;
+    c->body = grown;
+    c->cap = cap;
+  }
+
+  memcpy(c->body + c->len, data, len);
+  c->len += len;
+  return 0;
+}
+
+void forge_cache_capture_head(const char *status,
+                              const char *content_type,
+                              const char *body,
+                              size_t body_len,
+                              int chunked)
+{
+  ForgeCapture *c = forge_exchange.capture;
+
+  /* A second response, or one the cache would not store */
+  if (c->started || atoi(status) != 200 ||
+      strlen(status) >= sizeof(c->status) ||
+      strlen(content_type) >= sizeof(c->content_type))
+  {
+    c->failed = 1;
+    return;
+  }
+
+  c->started = 1;
+  c->chunked = chunked;
+  strcpy(c->status, status);
+  strcpy(c->content_type, content_type);
+
+  if (c->policy->vary_count > 0)
+    forge_response_header(forge_exchange.fd, "Vary", c->policy->vary_value);
+
+  if (!chunked && capture_append(c, body, body_len) != 0)
+  {
+    c->failed = 1;
+    return;
+  }
+
+  const char *headers = forge_exchange.headers + c->headers_from;
+  size_t headers_len = forge_exchange.headers_len - c->headers_from;
+  if (find_etag(headers, headers_len, c->etag, sizeof(c->etag)))
+  {
+    c->etag_sent = 1;
+  }
+  else if (!chunked)
+  {
+    /* The body is known: this response gets the ETag as well */
+    make_etag(c);
+    c->etag_sent = forge_response_header(forge_exchange.fd, "ETag", c->etag) == 0;
+  }
+}
+
+void forge_cache_capture_body(const char *data, size_t len)
+{
+  ForgeCapture *c = forge_exchange.capture;
+  if (!c->started || !c->chunked || capture_append(c, data, len) != 0)
+    c->failed = 1;
+}
+
+void forge_cache_capture_end(void)
+{
+  ForgeCapture *c = forge_exchange.capture;
+  if (!c->started || c->failed)
+    return;
+
+  if (!c->etag[0])
+    make_etag(c);
+  c->complete = 1;
+}
+
+/* =========================================================
+   Serving
+   ========================================================= */
+
+/* Neither cookies nor Cache-Control: no-store / private */
+static int storable(const char *headers, size_t len)
+{
+  for (const char *p = headers; p < headers + len;)
+  {
+    const char *end = memchr(p, '\r', (size_t)(headers + len - p));
+    if (!end)
+      break;
+
+    size_t line_len = (size_t)(end - p);
+    if (line_len >= 11 && name_equals(p, 11, "set-cookie:"))
+      return 0;
+    if (line_len >= 14 && name_equals(p, 14, "cache-control:") &&
+        (contains_lower(p, line_len, "no-store") ||
+         contains_lower(p, line_len, "private")))
+      return 0;
+    p = end + 2;
+  }
+  return 1;
+}
+
+/* The captured response as an entry with one reference, or NULL */
+static CacheEntry *entry_build(const ForgeCapture *c, const char *key, size_t key_len,
+                               uint64_t hash, uint64_t now)
+{
+  const char *headers = forge_exchange.headers + c->headers_from;
+  size_t headers_len = forge_exchange.headers_len - c->headers_from;
+  if (!storable(headers, headers_len))
+    return NULL;
+
+  char prefix[512];
+  int prefix_len = snprintf(prefix, sizeof(prefix),
+                            "HTTP/1.1 %s\r\n"
+                            "Content-Type: %s\r\n"
+                            "Content-Length: %zu\r\n",
+                            c->status, c->content_type, c->len);
+  char etag_line[ETAG_MAX + 16];
+  int etag_len = c->etag_sent ? 0 : snprintf(etag_line, sizeof(etag_line),
+                                             "ETag: %s\r\n", c->etag);
+  if (prefix_len < 0 || (size_t)prefix_len >= sizeof(prefix) || etag_len < 0)
+    return NULL;
+
+  size_t head_len = (size_t)prefix_len + headers_len + (size_t)etag_len;
+  size_t size = sizeof(CacheEntry) + key_len + head_len + c->len;
+  CacheEntry *e = malloc(size);
+  if (!e)
+    return NULL;
+
+  memset(e, 0, sizeof(*e));
+  char *p = (char *)(e + 1);
+
+  memcpy(p, key, key_len);
+  e->key = p;
+  e->key_len = key_len;
+  p += key_len;
+
+  memcpy(p, prefix, (size_t)prefix_len);
+  memcpy(p + prefix_len, headers, headers_len);
+  memcpy(p + prefix_len + headers_len, etag_line, (size_t)etag_len);
+  e->head = p;
+  e->head_len = head_len;
+  e->headers = p + prefix_len;
+  e->headers_len = headers_len + (size_t)etag_len;
+  p += head_len;
+
+  if (c->len > 0)
+    memcpy(p, c->body, c->len);
+  e->body = p;
+  e->body_len = c->len;
+
+  strcpy(e->etag, c->etag);
+  strcpy(e->status, c->status);
+  strcpy(e->content_type, c->content_type);
+  e->hash = hash;
+  e->expires_ns = now + c->policy->ttl_ns;
+  e->size = size;
+  atomic_init(&e->refs, 1);
+  return e;
+}
+
+/* Method, path, query and each Vary header value, NUL-separated */
+static size_t build_key(const ForgeCachePolicy *policy,
+                        const ForgeHttpRequest *req,
+                        char *key, size_t cap)
+{
+  size_t method_len = strlen(req->method);
+  size_t path_len = strlen(req->path);
+  size_t query_len = strlen(req->query);
+  if (method_len + path_len + query_len + 3 > cap)
+    return 0;
+
+  memcpy(key, req->method, method_len + 1);
+  memcpy(key + method_len + 1, req->path, path_len + 1);
+  memcpy(key + method_len + path_len + 2, req->query, query_len + 1);
+  size_t len = method_len + path_len + query_len + 3;
+
+  for (int i = 0; i < policy->vary_count; i++)
+  {
+    const ForgeHttpHeader *h = forge_http_header(req, policy->vary[i]);
+    size_t v_len = h ? h->value_len : 0;
+    if (len + v_len + 2 > cap)
+      return 0;
+
+    key[len++] = h ? 'v' : '-'; /* absent differs from empty */
+    if (v_len)
+      memcpy(key + len, h->value, v_len);
+    len += v_len;
+    key[len++] = '\0';
+  }
+  return len;
+}
+
+/* If-None-Match: "*" or a list of (weak or strong) entity tags */
+static int etag_matches(const ForgeHttpHeader *inm, const char *etag)
+{
+  size_t etag_len = strlen(etag);
+  const char *p = inm->value;
+  const char *end = inm->value + inm->value_len;
+
+  while (p < end)
+  {
+    while (p < end && (*p == ' ' || *p == ','))
+      p++;
+    const char *tag = p;
+    while (p < end && *p != ',')
+      p++;
+
+    const char *tag_end = p;
+    while (tag_end > tag && tag_end[-1] == ' ')
+      tag_end--;
+    if (tag_end - tag >= 2 && tag[0] == 'W' && tag[1] == '/')
+      tag += 2;
+
+    size_t len = (size_t)(tag_end - tag);
+    if ((len == 1 && tag[0] == '*') ||
+        (len == etag_len && memcmp(tag, etag, len) == 0))
+      return 1;
+  }
+  return 0;
+}
+
+/* Extra headers for an HTTP/2 hit; they go through HPACK there */
+static void add_headers(const char *headers, size_t len)
+{
+  if (forge_exchange.headers_len + len <= sizeof(forge_exchange.headers))
+  {
+    memcpy(forge_exchange.headers + forge_exchange.headers_len, headers, len);
+    forge_exchange.headers_len += len;
+  }
+}
+
+static void serve_entry(const ForgeCachePolicy *policy, const CacheEntry *e,
+                        const ForgeHttpRequest *req, int client_socket)
+{
+  const ForgeHttpHeader *inm = forge_header_get(req, FORGE_HDR_IF_NONE_MATCH);
+
+  if (inm && etag_matches(inm, e->etag))
+  {
+    atomic_fetch_add_explicit(&stat_not_modified, 1, memory_order_relaxed);
+
+    char head[256 + sizeof(policy->vary_value)];
+    int len = snprintf(head, sizeof(head), "%sETag: %s\r\n%s%s%s",
+                       forge_exchange.h2 ? "" : "HTTP/1.1 304 Not Modified\r\n",
+                       e->etag,
+                       policy->vary_count ? "Vary: " : "",
+                       policy->vary_value,
+                       policy->vary_count ? "\r\n" : "");
+
+    if (forge_exchange.h2)
+    {
+      add_headers(head, (size_t)len);
+      forge_http_respond(client_socket, "304 Not Modified",
+                         e->content_type, "", 0);
+    }
+    else
+    {
+      forge_http_respond_raw(client_socket, 304, head, (size_t)len, NULL, 0);
+    }
+    return;
+  }
+
+  if (forge_exchange.h2)
+  {
+    add_headers(e->headers, e->headers_len);
+    forge_http_respond(client_socket, e->status, e->content_type,
+                       e->body, e->body_len);
+  }
+  else
+  {
+    forge_http_respond_raw(client_socket, 200, e->head, e->head_len,
+                           e->body, e->body_len);
+  }
+}
+
+void forge_cache_serve(const ForgeCachePolicy *policy,
+                       ForgeRouteHandler handler,
+                       const ForgeHttpRequest *req,
+                       int client_socket)
+{
+  char key[FORGE_MAX_PATH + 4096];
+  size_t key_len = 0;
+
+  /* Only the exchange's own socket is recorded; shared credentials bypass */
+  if (client_socket == forge_exchange.fd &&
+      (policy->vary_auth || !forge_header_get(req, FORGE_HDR_AUTHORIZATION)))
+    key_len = build_key(policy, req, key, sizeof(key));
+
+  if (key_len == 0)
+  {
+    handler(req, client_socket);
+    return;
+  }
+
+  uint64_t hash = fnv1a(FNV_OFFSET, key, key_len);
+  uint64_t now = forge_access_log_clock();
+  CacheEntry *e = NULL;
+  Flight *lead = NULL;
+
+  void *landed;
+  if (forge_exchange.capture == FLIGHT_PARKED_CAPTURE &&
+      forge_conn_resumed(req->conn, &landed))
+  {
+    /* Parked behind a flight: its response, or run the handler */
+    forge_exchange.capture = NULL;
+    e = landed;
+  }
+  else
+  {
+    e = policy->ttl_ns ? cache_get(hash, key, key_len, now) : NULL;
+    if (e)
+    {
+      atomic_fetch_add_explicit(&stat_hits, 1, memory_order_relaxed);
+      serve_entry(policy, e, req, client_socket);
+      entry_release(e);
+      return;
+    }
+
+    /* A miss already being filled: wait for that response */
+    if (policy->wait_ns &&
+        flight_join(hash, key, key_len, policy->wait_ns, req->conn,
+                    &lead, &e) == FLIGHT_PARKED)
+      return;
+  }
+
+  if (e)
+  {
+    atomic_fetch_add_explicit(&stat_coalesced, 1, memory_order_relaxed);
+    serve_entry(policy, e, req, client_socket);
+    entry_release(e);
+    return;
+  }
+
+  atomic_fetch_add_explicit(&stat_misses, 1, memory_order_relaxed);
+
+  ForgeCapture capture;
+  memset(&capture, 0, sizeof(capture));
+  capture.policy = policy;
+  capture.headers_from = forge_exchange.headers_len;
+
+  forge_exchange.capture = &capture;
+  handler(req, client_socket);
+  forge_exchange.capture = NULL;
+
+  e = capture.complete ? entry_build(&capture, key, key_len, hash, now) : NULL;
+  free(capture.body);
+
+  if (e && policy->ttl_ns)
+  {
+    atomic_fetch_add_explicit(&stat_stores, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&e->refs, 1, memory_order_relaxed);
+    cache_put(e);
+  }
+
+  if (lead)
+    flight_land(lead, e);
+  else if (e)
+    entry_release(e);
+}
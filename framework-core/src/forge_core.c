@@ -0,0 +1,555 @@
+#define _GNU_SOURCE
+#include "forge_core.h"
+#include "forge_internal.h"
+#include "forge_log.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+/* =========================================================
+   Layout
+   ========================================================= */
+
+#define CACHE_LINE 64
+#define ARENA_CHUNK (64 * 1024)
+#define MAX_START_HOOKS 16
+#define MAX_CORE_TIMERS 16
+
+typedef char forge_core_queue_pow2[
+    (FORGE_CORE_QUEUE & (FORGE_CORE_QUEUE - 1)) == 0 ? 1 : -1];
+
+/*
+ * Bounded MPSC queue (Vyukov): producers claim a slot with one CAS
+ * on `tail`; each slot's sequence number says whether it is free,
+ * published, or consumed, so the owner pops without atomics RMW.
+ */
+typedef struct
+{
+  _Atomic size_t seq;
+  ForgeCoreFn fn;
+  void *arg;
+} InboxSlot;
+
+typedef struct
+{
+  uint64_t due_ns;
+  uint64_t interval_ns;
+  ForgeCoreFn fn;
+  void *arg;
+} CoreTimer;
+
+typedef struct ArenaChunk
+{
+  struct ArenaChunk *next; /* older chunk */
+  size_t used;
+  size_t cap;
+  _Alignas(16) char data[];
+} ArenaChunk;
+
+struct ForgeCore
+{
+  /* owner-only, read-mostly */
+  int id;
+  void *data;
+  ArenaChunk *arena;
+  CoreTimer timers[MAX_CORE_TIMERS];
+  int timer_count;
+#ifndef _WIN32
+  int wake[2]; /* self-pipe: posters write, the loop polls */
+#endif
+
+  /* written by the owner only; other cores just read */
+  _Alignas(CACHE_LINE) struct
+  {
+    _Atomic uint64_t accepted;
+    _Atomic uint64_t active;
+    _Atomic uint64_t requests;
+    _Atomic uint64_t bytes_out;
+    _Atomic uint64_t messages;
+    _Atomic uint64_t shed;
+    _Atomic uint64_t queue_delay_ns;
+    _Atomic uint64_t queue_delay_max_ns;
+    _Atomic uint64_t overloaded;
+    _Atomic uint64_t accepted_off_cpu;
+  } stats;
+
+  /* producers */
+  _Alignas(CACHE_LINE) _Atomic size_t tail;
+
+  /* consumer (owner) */
+  _Alignas(CACHE_LINE) size_t head;
+  InboxSlot slots[FORGE_CORE_QUEUE];
+};
+
+/* =========================================================
+   Registry
+   ========================================================= */
+
+/* Filled before core threads start, read-only afterwards */
+static ForgeCore *cores[FORGE_MAX_CORES];
+static int core_total;
+
+static struct
+{
+  ForgeCoreFn fn;
+  void *arg;
+} start_hooks[MAX_START_HOOKS];
+static int start_hook_count;
+
+static _Thread_local ForgeCore *current_core;
+
+static pthread_once_t main_core_once = PTHREAD_ONCE_INIT;
+
+static ForgeCore *core_create(int id)
+{
+  size_t size = (sizeof(ForgeCore) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+
+#ifdef _WIN32
+  ForgeCore *core = _aligned_malloc(size, CACHE_LINE);
+#else
+  ForgeCore *core = NULL;
+  if (posix_memalign((void **)&core, CACHE_LINE, size) != 0)
+    core = NULL;
+#endif
+  if (!core)
+    return NULL;
+
+  memset(core, 0, sizeof(*core));
+  core->id = id;
+
+  for (size_t i = 0; i < FORGE_CORE_QUEUE; i++)
+    atomic_init(&core->slots[i].seq, i);
+
+#ifndef _WIN32
+  if (pipe(core->wake) != 0)
+  {
+    core->wake[0] = core->wake[1] = -1;
+  }
+  else
+  {
+    fcntl(core->wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(core->wake[1], F_SETFL, O_NONBLOCK);
+  }
+#endif
+
+  return core;
+}
+
+static void main_core_init(void)
+{
+  cores[0] = core_create(0);
+  core_total = cores[0] ? 1 : 0;
+}
+
+ForgeCore *forge_current_core(void)
+{
+  if (current_core)
+    return current_core;
+
+  /* Threads outside the runtime share core 0 */
+  pthread_once(&main_core_once, main_core_init);
+  return cores[0];
+}
+
+ForgeCore *forge_core_attach_aside(void)
+{
+  if (current_core)
+    return current_core;
+
+  /* Not registered: no posts, not in forge_core_count() or the stats */
+  current_core = core_create(-1);
+  return current_core;
+}
+
+int forge_core_id(const ForgeCore *core)
+{
+  return core ? core->id : -1;
+}
+
+int forge_core_count(void)
+{
+  pthread_once(&main_core_once, main_core_init);
+  return core_total;
+}
+
+void forge_core_set_data(ForgeCore *core, void *data)
+{
+  core->data = data;
+}
+
+void *forge_core_data(const ForgeCore *core)
+{
+  return core->data;
+}
+
+int forge_core_on_start(ForgeCoreFn fn, void *arg)
+{
+  if (!fn || start_hook_count == MAX_START_HOOKS)
+    return -1;
+
+  start_hooks[start_hook_count].fn = fn;
+  start_hooks[start_hook_count].arg = arg;
+  start_hook_count++;
+  return 0;
+}
+
+/* =========================================================
+   Request Arena
+   ========================================================= */
+
+void *forge_core_alloc(ForgeCore *core, size_t size)
+{
+  size = (size + 15) & ~(size_t)15;
+
+  ArenaChunk *c = core->arena;
+  if (!c || c->cap - c->used < size)
+  {
+    size_t cap = size > ARENA_CHUNK ? size : ARENA_CHUNK;
+    ArenaChunk *grown = malloc(sizeof(*grown) + cap);
+    if (!grown)
+      return NULL;
+
+    grown->next = c;
+    grown->used = 0;
+    grown->cap = cap;
+    core->arena = grown;
+    c = grown;
+  }
+
+  void *p = c->data + c->used;
+  c->used += size;
+  return p;
+}
+
+/* Keep the first regular chunk for the next request, free the rest */
+static void arena_reset(ForgeCore *core)
+{
+  ArenaChunk *c = core->arena;
+
+  while (c && (c->next || c->cap != ARENA_CHUNK))
+  {
+    ArenaChunk *older = c->next;
+    free(c);
+    c = older;
+  }
+
+  if (c)
+    c->used = 0;
+  core->arena = c;
+}
+
+/* =========================================================
+   Stats
+   ========================================================= */
+
+/* Single writer per counter: a plain load + store, no lock prefix */
+static void stat_add(_Atomic uint64_t *counter, int64_t delta)
+{
+  uint64_t v = atomic_load_explicit(counter, memory_order_relaxed);
+  atomic_store_explicit(counter, v + (uint64_t)delta, memory_order_relaxed);
+}
+
+void forge_core_conn_opened(ForgeCore *core)
+{
+  stat_add(&core->stats.accepted, 1);
+  stat_add(&core->stats.active, 1);
+}
+
+void forge_core_conn_off_cpu(ForgeCore *core)
+{
+  stat_add(&core->stats.accepted_off_cpu, 1);
+}
+
+void forge_core_conn_closed(ForgeCore *core)
+{
+  stat_add(&core->stats.active, -1);
+}
+
+void forge_core_request_done(ForgeCore *core, size_t bytes_out)
+{
+  stat_add(&core->stats.requests, 1);
+  stat_add(&core->stats.bytes_out, (int64_t)bytes_out);
+  arena_reset(core);
+}
+
+void forge_core_admission(ForgeCore *core, uint64_t delay_ns,
+                          int shed, int overloaded)
+{
+  if (shed)
+    stat_add(&core->stats.shed, 1);
+  else
+    stat_add(&core->stats.queue_delay_ns, (int64_t)delay_ns);
+
+  if (delay_ns > atomic_load_explicit(&core->stats.queue_delay_max_ns,
+                                      memory_order_relaxed))
+    atomic_store_explicit(&core->stats.queue_delay_max_ns, delay_ns,
+                          memory_order_relaxed);
+
+  atomic_store_explicit(&core->stats.overloaded, overloaded != 0,
+                        memory_order_relaxed);
+}
+
+static void stats_read(const ForgeCore *core, ForgeCoreStats *out)
+{
+  out->accepted += atomic_load_explicit(&core->stats.accepted, memory_order_relaxed);
+  out->active += atomic_load_explicit(&core->stats.active, memory_order_relaxed);
+  out->requests += atomic_load_explicit(&core->stats.requests, memory_order_relaxed);
+  out->bytes_out += atomic_load_explicit(&core->stats.bytes_out, memory_order_relaxed);
+  out->messages += atomic_load_explicit(&core->stats.messages, memory_order_relaxed);
+  out->shed += atomic_load_explicit(&core->stats.shed, memory_order_relaxed);
+  out->queue_delay_ns += atomic_load_explicit(&core->stats.queue_delay_ns, memory_order_relaxed);
+  out->overloaded += atomic_load_explicit(&core->stats.overloaded, memory_order_relaxed);
+  out->accepted_off_cpu += atomic_load_explicit(&core->stats.accepted_off_cpu, memory_order_relaxed);
+
+  uint64_t max = atomic_load_explicit(&core->stats.queue_delay_max_ns, memory_order_relaxed);
+  if (max > out->queue_delay_max_ns)
+    out->queue_delay_max_ns = max;
+}
+
+void forge_core_stats(int core_id, ForgeCoreStats *out)
+{
+  memset(out, 0, sizeof(*out));
+  int total = forge_core_count();
+
+  for (int i = 0; i < total; i++)
+  {
+    if (cores[i] && (core_id < 0 || core_id == i))
+      stats_read(cores[i], out);
+  }
+}
+
+/* =========================================================
+   Cross-Core Messages
+   ========================================================= */
+
+int forge_core_post(int core_id, ForgeCoreFn fn, void *arg)
+{
+  if (!fn || core_id < 0 || core_id >= forge_core_count() || !cores[core_id])
+    return -1;
+
+  ForgeCore *core = cores[core_id];
+  size_t pos = atomic_load_explicit(&core->tail, memory_order_relaxed);
+  InboxSlot *slot;
+
+  while (1)
+  {
+    slot = &core->slots[pos & (FORGE_CORE_QUEUE - 1)];
+    size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+    if (diff == 0)
+    {
+      if (atomic_compare_exchange_weak_explicit(&core->tail, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0)
+    {
+      return -1; /* full */
+    }
+    else
+    {
+      pos = atomic_load_explicit(&core->tail, memory_order_relaxed);
+    }
+  }
+
+  slot->fn = fn;
+  slot->arg = arg;
+  atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+#ifndef _WIN32
+  /* A full pipe already guarantees a wake-up */
+  if (core->wake[1] >= 0)
+  {
+    ssize_t rc = write(core->wake[1], "", 1);
+    (void)rc;
+  }
+#endif
+  return 0;
+}
+
+int forge_core_broadcast(ForgeCoreFn fn, void *arg)
+{
+  int missed = 0;
+  int total = forge_core_count();
+
+  for (int i = 0; i < total; i++)
+    missed += forge_core_post(i, fn, arg) != 0;
+  return missed;
+}
+
+int forge_core_drain(ForgeCore *core)
+{
+  int ran = 0;
+
+  while (1)
+  {
+    InboxSlot *slot = &core->slots[core->head & (FORGE_CORE_QUEUE - 1)];
+    size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (seq != core->head + 1)
+      break;
+
+    ForgeCoreFn fn = slot->fn;
+    void *arg = slot->arg;
+
+    /* Hand the slot back to producers one lap later */
+    atomic_store_explicit(&slot->seq, core->head + FORGE_CORE_QUEUE,
+                          memory_order_release);
+    core->head++;
+
+    fn(core, arg);
+    ran++;
+  }
+
+  if (ran > 0)
+    stat_add(&core->stats.messages, ran);
+  return ran;
+}
+
+int forge_core_wake_fd(const ForgeCore *core)
+{
+#ifdef _WIN32
+  (void)core;
+  return -1;
+#else
+  return core->wake[0];
+#endif
+}
+
+void forge_core_clear_wake(ForgeCore *core)
+{
+#ifdef _WIN32
+  (void)core;
+#else
+  char sink[64];
+  while (read(core->wake[0], sink, sizeof(sink)) > 0)
+    ;
+#endif
+}
+
+/* =========================================================
+   Timers
+   ========================================================= */
+
+int forge_core_every(ForgeCore *core, unsigned interval_ms,
+                     ForgeCoreFn fn, void *arg)
+{
+  if (!fn || interval_ms == 0 || core->timer_count == MAX_CORE_TIMERS)
+    return -1;
+
+  CoreTimer *t = &core->timers[core->timer_count++];
+  t->interval_ns = (uint64_t)interval_ms * 1000000ULL;
+  t->due_ns = forge_access_log_clock() + t->interval_ns;
+  t->fn = fn;
+  t->arg = arg;
+  return 0;
+}
+
+int forge_core_run_timers(ForgeCore *core, uint64_t now_ns)
+{
+  uint64_t next = UINT64_MAX;
+
+  for (int i = 0; i < core->timer_count; i++)
+  {
+    CoreTimer *t = &core->timers[i];
+    if (now_ns >= t->due_ns)
+    {
+      /* Skip missed periods rather than running them back to back */
+      t->due_ns += t->interval_ns;
+      if (t->due_ns <= now_ns)
+        t->due_ns = now_ns + t->interval_ns;
+      t->fn(core, t->arg);
+    }
+    if (t->due_ns < next)
+      next = t->due_ns;
+  }
+
+  if (next == UINT64_MAX)
+    return -1;
+  uint64_t wait_ms = (next - now_ns + 999999) / 1000000;
+  return wait_ms > INT32_MAX ? INT32_MAX : (int)wait_ms;
+}
+
+/* =========================================================
+   Runtime
+   ========================================================= */
+
+typedef struct
+{
+  ForgeCore *core;
+  ForgeCoreLoop loop;
+  void *arg;
+} CoreStart;
+
+static void *core_thread(void *p)
+{
+  CoreStart *start = p;
+  current_core = start->core;
+
+  for (int i = 0; i < start_hook_count; i++)
+    start_hooks[i].fn(start->core, start_hooks[i].arg);
+
+  start->loop(start->core, start->arg);
+  return NULL;
+}
+
+int forge_core_run(int count, ForgeCoreLoop loop, void *arg)
+{
+  pthread_once(&main_core_once, main_core_init);
+  if (!cores[0])
+    return -1;
+
+  if (count < 1)
+    count = 1;
+  if (count > FORGE_MAX_CORES)
+    count = FORGE_MAX_CORES;
+
+  for (int i = 1; i < count; i++)
+  {
+    if (!cores[i])
+      cores[i] = core_create(i);
+    if (!cores[i])
+    {
+      count = i;
+      break;
+    }
+  }
+  core_total = count;
+
+  static CoreStart starts[FORGE_MAX_CORES];
+  pthread_t threads[FORGE_MAX_CORES];
+
+  for (int i = 0; i < count; i++)
+  {
+    starts[i].core = cores[i];
+    starts[i].loop = loop;
+    starts[i].arg = arg;
+  }
+
+  for (int i = 1; i < count; i++)
+  {
+    if (pthread_create(&threads[i], NULL, core_thread, &starts[i]) != 0)
+    {
+      fprintf(stderr, "core %d: thread creation failed\n", i);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  /* Core 0 runs on the calling thread */
+  core_thread(&starts[0]);
+
+  for (int i = 1; i < count; i++)
+    pthread_join(threads[i], NULL);
+  return 0;
+}
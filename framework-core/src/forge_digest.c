@@ -0,0 +1,279 @@
+#include "forge_internal.h"
+
+#include <string.h>
+
+/* =========================================================
+   SHA-1 (RFC 3174)
+   ========================================================= */
+
+/* Only for protocol handshakes (WebSocket accept keys), not security */
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void sha1_block(uint32_t h[5], const unsigned char *p)
+{
+  uint32_t w[80];
+  for (int i = 0; i < 16; i++)
+    w[i] = (uint32_t)p[i * 4] << 24 | (uint32_t)p[i * 4 + 1] << 16 |
+           (uint32_t)p[i * 4 + 2] << 8 | (uint32_t)p[i * 4 + 3];
+  for (int i = 16; i < 80; i++)
+    w[i] = ROTL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+  uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+  for (int i = 0; i < 80; i++)
+  {
+    uint32_t f, k;
+    if (i < 20)
+    {
+      f = (b & c) | (~b & d);
+      k = 0x5a827999;
+    }
+    else if (i < 40)
+    {
+      f = b ^ c ^ d;
+      k = 0x6ed9eba1;
+    }
+    else if (i < 60)
+    {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8f1bbcdc;
+    }
+    else
+    {
+      f = b ^ c ^ d;
+      k = 0xca62c1d6;
+    }
+
+    uint32_t t = ROTL(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = ROTL(b, 30);
+    b = a;
+    a = t;
+  }
+
+  h[0] += a;
+  h[1] += b;
+  h[2] += c;
+  h[3] += d;
+  h[4] += e;
+}
+
+void forge_sha1(const void *data, size_t len, unsigned char out[20])
+{
+  uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+  const unsigned char *p = data;
+  size_t left = len;
+
+  for (; left >= 64; left -= 64, p += 64)
+    sha1_block(h, p);
+
+  /* Tail, 0x80, zeros, then the bit length: one or two blocks */
+  unsigned char tail[128];
+  memset(tail, 0, sizeof(tail));
+  memcpy(tail, p, left);
+  tail[left] = 0x80;
+
+  size_t tail_len = left + 9 <= 64 ? 64 : 128;
+  uint64_t bits = (uint64_t)len * 8;
+  for (int i = 0; i < 8; i++)
+    tail[tail_len - 1 - i] = (unsigned char)(bits >> (8 * i));
+
+  sha1_block(h, tail);
+  if (tail_len == 128)
+    sha1_block(h, tail + 64);
+
+  for (int i = 0; i < 5; i++)
+  {
+    out[i * 4] = (unsigned char)(h[i] >> 24);
+    out[i * 4 + 1] = (unsigned char)(h[i] >> 16);
+    out[i * 4 + 2] = (unsigned char)(h[i] >> 8);
+    out[i * 4 + 3] = (unsigned char)h[i];
+  }
+}
+
+/* =========================================================
+   SHA-256 (FIPS 180-4)
+   ========================================================= */
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static void sha256_block(uint32_t h[8], const unsigned char *p)
+{
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++)
+    w[i] = (uint32_t)p[i * 4] << 24 | (uint32_t)p[i * 4 + 1] << 16 |
+           (uint32_t)p[i * 4 + 2] << 8 | (uint32_t)p[i * 4 + 3];
+  for (int i = 16; i < 64; i++)
+  {
+    uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+  uint32_t e = h[4], f = h[5], g = h[6], k = h[7];
+
+  for (int i = 0; i < 64; i++)
+  {
+    uint32_t s1 = ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25);
+    uint32_t t1 = k + s1 + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+    uint32_t s0 = ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22);
+    uint32_t t2 = s0 + ((a & b) ^ (a & c) ^ (b & c));
+
+    k = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+
+  h[0] += a;
+  h[1] += b;
+  h[2] += c;
+  h[3] += d;
+  h[4] += e;
+  h[5] += f;
+  h[6] += g;
+  h[7] += k;
+}
+
+void forge_sha256_init(ForgeSha256 *ctx)
+{
+  static const uint32_t iv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  memcpy(ctx->h, iv, sizeof(iv));
+  ctx->len = 0;
+  ctx->used = 0;
+}
+
+void forge_sha256_update(ForgeSha256 *ctx, const void *data, size_t len)
+{
+  const unsigned char *p = data;
+  ctx->len += len;
+
+  if (ctx->used > 0)
+  {
+    size_t take = 64 - ctx->used < len ? 64 - ctx->used : len;
+    memcpy(ctx->block + ctx->used, p, take);
+    ctx->used += take;
+    p += take;
+    len -= take;
+    if (ctx->used < 64)
+      return;
+    sha256_block(ctx->h, ctx->block);
+    ctx->used = 0;
+  }
+
+  /* Whole blocks straight from the caller's buffer */
+  for (; len >= 64; len -= 64, p += 64)
+    sha256_block(ctx->h, p);
+
+  memcpy(ctx->block, p, len);
+  ctx->used = len;
+}
+
+void forge_sha256_final(ForgeSha256 *ctx, unsigned char out[32])
+{
+  uint64_t bits = ctx->len * 8;
+
+  ctx->block[ctx->used++] = 0x80;
+  if (ctx->used > 56)
+  {
+    memset(ctx->block + ctx->used, 0, 64 - ctx->used);
+    sha256_block(ctx->h, ctx->block);
+    ctx->used = 0;
+  }
+  memset(ctx->block + ctx->used, 0, 56 - ctx->used);
+  for (int i = 0; i < 8; i++)
+    ctx->block[63 - i] = (unsigned char)(bits >> (8 * i));
+  sha256_block(ctx->h, ctx->block);
+
+  for (int i = 0; i < 8; i++)
+  {
+    out[i * 4] = (unsigned char)(ctx->h[i] >> 24);
+    out[i * 4 + 1] = (unsigned char)(ctx->h[i] >> 16);
+    out[i * 4 + 2] = (unsigned char)(ctx->h[i] >> 8);
+    out[i * 4 + 3] = (unsigned char)ctx->h[i];
+  }
+}
+
+/* =========================================================
+   Base64 (RFC 4648)
+   ========================================================= */
+
+size_t forge_base64_encode(const unsigned char *in, size_t len, char *out)
+{
+  static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t n = 0;
+
+  for (size_t i = 0; i < len; i += 3)
+  {
+    uint32_t v = (uint32_t)in[i] << 16;
+    if (i + 1 < len)
+      v |= (uint32_t)in[i + 1] << 8;
+    if (i + 2 < len)
+      v |= in[i + 2];
+
+    out[n++] = alphabet[(v >> 18) & 63];
+    out[n++] = alphabet[(v >> 12) & 63];
+    out[n++] = i + 1 < len ? alphabet[(v >> 6) & 63] : '=';
+    out[n++] = i + 2 < len ? alphabet[v & 63] : '=';
+  }
+
+  out[n] = '\0';
+  return n;
+}
+
+/* Decoded length, or -1 on a character outside the alphabet */
+long forge_base64_decode(const char *in, size_t len, unsigned char *out)
+{
+  uint32_t v = 0;
+  int bits = 0;
+  long n = 0;
+
+  for (size_t i = 0; i < len && in[i] != '='; i++)
+  {
+    char ch = in[i];
+    int d;
+    if (ch >= 'A' && ch <= 'Z')
+      d = ch - 'A';
+    else if (ch >= 'a' && ch <= 'z')
+      d = ch - 'a' + 26;
+    else if (ch >= '0' && ch <= '9')
+      d = ch - '0' + 52;
+    else if (ch == '+')
+      d = 62;
+    else if (ch == '/')
+      d = 63;
+    else
+      return -1;
+
+    v = (v << 6) | (uint32_t)d;
+    bits += 6;
+    if (bits >= 8)
+    {
+      bits -= 8;
+      out[n++] = (unsigned char)(v >> bits);
+    }
+  }
+  return n;
+}
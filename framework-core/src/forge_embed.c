@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+#include "forge_embed.h"
+#include "forge_http.h"
+#include "forge_router.h"
+#include "forge_internal.h"
+
+#include <string.h>
+
+/* =========================================================
+   Lookup
+   ========================================================= */
+
+uint32_t forge_embed_hash(const char *s, size_t len, uint32_t seed)
+{
+  /* FNV-1a, then a murmur3 finalizer so the low bits spread too */
+  uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+  for (size_t i = 0; i < len; i++)
+  {
+    h ^= (unsigned char)s[i];
+    h *= 16777619u;
+  }
+
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+const ForgeEmbedAsset *forge_embed_find(const ForgeEmbedTable *table,
+                                        const char *path,
+                                        size_t len)
+{
+  if (!table || table->count == 0 || table->buckets == 0)
+    return NULL;
+
+  uint32_t seed = table->seeds[forge_embed_hash(path, len, 0) % table->buckets];
+  const ForgeEmbedAsset *a =
+      &table->assets[forge_embed_hash(path, len, seed) % table->count];
+
+  /* Every key hits its own slot; one compare rejects the rest */
+  if (strncmp(a->path, path, len) != 0 || a->path[len] != '\0')
+    return NULL;
+  return a;
+}
+
+/* =========================================================
+   Serving
+   ========================================================= */
+
+/* Accept-Encoding lists gzip (or *) without q=0 */
+static int accepts_gzip(const ForgeHttpHeader *h)
+{
+  if (!h)
+    return 0;
+
+  const char *p = h->value;
+  const char *end = h->value + h->value_len;
+
+  while (p < end)
+  {
+    while (p < end && (*p == ' ' || *p == ','))
+      p++;
+    const char *coding = p;
+    while (p < end && *p != ',' && *p != ';' && *p != ' ')
+      p++;
+    size_t len = (size_t)(p - coding);
+
+    /* Parameters: only a zero quality matters */
+    int refused = 0;
+    while (p < end && *p != ',')
+    {
+      if (*p == 'q' && p + 1 < end && p[1] == '=')
+      {
+        const char *q = p + 2;
+        refused = q < end && *q == '0';
+        for (q++; refused && q < end && *q != ',' && *q != ' '; q++)
+          refused = *q == '.' || *q == '0';
+      }
+      p++;
+    }
+
+    int gzip = len == 4 && (coding[0] | 0x20) == 'g' && (coding[1] | 0x20) == 'z' &&
+               (coding[2] | 0x20) == 'i' && (coding[3] | 0x20) == 'p';
+    if ((gzip || (len == 1 && coding[0] == '*')) && !refused)
+      return 1;
+  }
+  return 0;
+}
+
+static int etag_listed(const ForgeHttpHeader *inm, const char *etag)
+{
+  size_t etag_len = strlen(etag);
+  const char *p = inm->value;
+  const char *end = inm->value + inm->value_len;
+
+  while (p < end)
+  {
+    while (p < end && (*p == ' ' || *p == ','))
+      p++;
+    const char *tag = p;
+    while (p < end && *p != ',')
+      p++;
+
+    const char *tag_end = p;
+    while (tag_end > tag && tag_end[-1] == ' ')
+      tag_end--;
+    if (tag_end - tag >= 2 && tag[0] == 'W' && tag[1] == '/')
+      tag += 2;
+
+    size_t len = (size_t)(tag_end - tag);
+    if ((len == 1 && tag[0] == '*') ||
+        (len == etag_len && memcmp(tag, etag, len) == 0))
+      return 1;
+  }
+  return 0;
+}
+
+/* HTTP/2 answers carry the variant's headers through HPACK */
+static void add_headers(const char *headers, size_t len)
+{
+  if (forge_exchange.headers_len + len <= sizeof(forge_exchange.headers))
+  {
+    memcpy(forge_exchange.headers + forge_exchange.headers_len, headers, len);
+    forge_exchange.headers_len += len;
+  }
+}
+
+static void embed_handler(const ForgeHttpRequest *req, int client_socket)
+{
+  const ForgeEmbedAsset *a = forge_route_arg();
+  if (!a)
+  {
+    forge_send_text(client_socket, "404 Not Found", "Not Found\n");
+    return;
+  }
+
+  const ForgeEmbedVariant *v = &a->identity;
+  if (a->gzip.body && accepts_gzip(forge_header_get(req, FORGE_HDR_ACCEPT_ENCODING)))
+    v = &a->gzip;
+
+  int h2 = forge_exchange.h2 && client_socket == forge_exchange.fd;
+  const ForgeHttpHeader *inm = forge_header_get(req, FORGE_HDR_IF_NONE_MATCH);
+
+  if (inm && v->headers_len <= 256 && etag_listed(inm, v->etag))
+  {
+    static const char status[] = "HTTP/1.1 304 Not Modified\r\n";
+    char head[sizeof(status) + 256];
+
+    if (h2)
+    {
+      add_headers(v->headers, v->headers_len);
+      forge_http_respond(client_socket, "304 Not Modified", a->content_type, "", 0);
+    }
+    else
+    {
+      memcpy(head, status, sizeof(status) - 1);
+      memcpy(head + sizeof(status) - 1, v->headers, v->headers_len);
+      forge_http_respond_raw(client_socket, 304, head,
+                             sizeof(status) - 1 + v->headers_len, NULL, 0);
+    }
+    return;
+  }
+
+  if (h2)
+  {
+    add_headers(v->headers, v->headers_len);
+    forge_http_respond(client_socket, "200 OK", a->content_type,
+                       (const char *)v->body, v->body_len);
+  }
+  else
+  {
+    forge_http_respond_raw(client_socket, 200, v->head, v->head_len,
+                           (const char *)v->body, v->body_len);
+  }
+}
+
+int forge_embed_register(const ForgeEmbedTable *table)
+{
+  if (!table)
+    return -1;
+
+  /* Each route carries its asset: no lookup per request */
+  for (size_t i = 0; i < table->count; i++)
+  {
+    ForgeRoute route = {"GET", table->assets[i].path, embed_handler, 0,
+                        (void *)&table->assets[i]};
+    if (forge_router_add_route(&route) != 0)
+      return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,1353 @@
+#define _GNU_SOURCE
+#include "forge_h2.h"
+#include "forge_hpack.h"
+#include "forge_log.h"
+#include "forge_internal.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+/* =========================================================
+   Limits
+   ========================================================= */
+
+#define H2_HEADER_BLOCK_MAX (64 * 1024) /* HEADERS + CONTINUATION */
+#define H2_FIELD_ARENA 8192             /* decoded fields per stream */
+#define H2_SCRATCH 8192                 /* Huffman output per field */
+#define H2_OUT_CAP (64 * 1024)          /* frames batched per write */
+#define H2_BODY_MEMORY (64 * 1024)      /* body bytes a stream keeps in memory */
+#define H2_CONN_BODY_MEMORY (256 * 1024) /* ... all streams of a connection */
+
+/* =========================================================
+   Connection / Stream State
+   ========================================================= */
+
+struct ForgeH2Stream
+{
+  ForgeH2Conn *h2;
+  uint32_t id;
+
+  /* request side */
+  uint8_t *block; /* header block fragments until END_HEADERS */
+  size_t block_len;
+  char *arena; /* decoded header names / values */
+  size_t arena_len;
+  ForgeHttpRequest req;
+  int headers_done;
+  int end_stream;         /* peer sent END_STREAM */
+  int end_stream_pending; /* END_STREAM seen, header block incomplete */
+  int trailers;
+  int refused;
+  int bad_request;
+  int malformed;    /* reset with PROTOCOL_ERROR (RFC 9113 8.1.1) */
+  int regular_seen; /* a non-pseudo field was decoded */
+  const char *authority; /* :authority, copied into the arena */
+  size_t authority_len;
+
+  size_t max_body;
+  int too_large;
+  int spool_failed;
+  char *body; /* the first H2_BODY_MEMORY bytes */
+  size_t body_len;
+  size_t body_cap;
+  int spool_fd; /* the rest, like HTTP/1 staging; -1: none */
+  size_t spooled;
+  uint64_t received; /* DATA payload, kept or not, against content-length */
+  ForgeConn body_conn; /* memory- and spool-backed body source for handlers */
+
+  /* response side */
+  int dispatched;
+  int responded;
+  int reset; /* closed while parked: freed once it resumes, unanswered */
+  int64_t send_window;
+  char *pending; /* DATA waiting for flow-control credit */
+  size_t pending_len;
+  size_t pending_off;
+
+  uint64_t start_ns;
+};
+
+struct ForgeH2Conn
+{
+  ForgeConn *conn;
+  ForgeHpackTable decoder;
+  ForgeHpackTable encoder;
+
+  ForgeH2Stream *streams[FORGE_H2_MAX_STREAMS + 1];
+  int nstreams;
+
+  uint32_t last_stream_id;
+  uint32_t continuation_id; /* stream owed a CONTINUATION */
+  int preface_ok;
+  int goaway;
+
+  int64_t send_window;
+  uint32_t peer_initial_window;
+  uint32_t peer_max_frame;
+  uint32_t recv_consumed; /* connection credit to hand back */
+  size_t body_memory;     /* body_cap summed over the streams */
+  int parked;             /* streams whose handler parked them */
+
+  size_t out_len;
+  uint8_t out[H2_OUT_CAP];
+  char scratch[H2_SCRATCH];
+};
+
+/* =========================================================
+   Frame Codec
+   ========================================================= */
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+void forge_h2_pack_frame(uint8_t out[FORGE_H2_FRAME_HEADER],
+                         const ForgeH2Frame *frame)
+{
+  out[0] = (uint8_t)(frame->length >> 16);
+  out[1] = (uint8_t)(frame->length >> 8);
+  out[2] = (uint8_t)frame->length;
+  out[3] = frame->type;
+  out[4] = frame->flags;
+  put_be32(out + 5, frame->stream_id & 0x7fffffff);
+}
+
+void forge_h2_unpack_frame(const uint8_t in[FORGE_H2_FRAME_HEADER],
+                           ForgeH2Frame *frame)
+{
+  frame->length = ((uint32_t)in[0] << 16) | ((uint32_t)in[1] << 8) | in[2];
+  frame->type = in[3];
+  frame->flags = in[4];
+  frame->stream_id = get_be32(in + 5) & 0x7fffffff;
+}
+
+/* =========================================================
+   Output
+   ========================================================= */
+
+static int out_flush(ForgeH2Conn *h)
+{
+  if (h->out_len == 0)
+    return 0;
+
+  int rc = forge_conn_write_all(h->conn->fd, h->out, h->out_len);
+  h->out_len = 0;
+  return rc;
+}
+
+static void out_frame(ForgeH2Conn *h, uint8_t type, uint8_t flags,
+                      uint32_t stream_id, const void *payload, size_t len)
+{
+  if (h->out_len + FORGE_H2_FRAME_HEADER + len > sizeof(h->out))
+    out_flush(h);
+
+  ForgeH2Frame f = {(uint32_t)len, type, flags, stream_id};
+  forge_h2_pack_frame(h->out + h->out_len, &f);
+  h->out_len += FORGE_H2_FRAME_HEADER;
+
+  if (len > 0)
+  {
+    memcpy(h->out + h->out_len, payload, len);
+    h->out_len += len;
+  }
+}
+
+static void send_rst(ForgeH2Conn *h, uint32_t id, uint32_t code)
+{
+  uint8_t p[4];
+  put_be32(p, code);
+  out_frame(h, FORGE_H2_RST_STREAM, 0, id, p, 4);
+}
+
+static void send_window_update(ForgeH2Conn *h, uint32_t id, uint32_t inc)
+{
+  uint8_t p[4];
+  put_be32(p, inc);
+  out_frame(h, FORGE_H2_WINDOW_UPDATE, 0, id, p, 4);
+}
+
+/* Queue GOAWAY and report the connection as dead */
+static int conn_error(ForgeH2Conn *h, uint32_t code)
+{
+  uint8_t p[8];
+  put_be32(p, h->last_stream_id);
+  put_be32(p + 4, code);
+  out_frame(h, FORGE_H2_GOAWAY, 0, 0, p, 8);
+  h->goaway = 1;
+  return -1;
+}
+
+/* =========================================================
+   Streams
+   ========================================================= */
+
+static ForgeH2Stream *stream_find(ForgeH2Conn *h, uint32_t id)
+{
+  for (int i = 0; i < h->nstreams; i++)
+  {
+    if (h->streams[i]->id == id)
+      return h->streams[i];
+  }
+  return NULL;
+}
+
+static ForgeH2Stream *stream_new(ForgeH2Conn *h, uint32_t id)
+{
+  ForgeH2Stream *s = calloc(1, sizeof(*s));
+  if (!s)
+    return NULL;
+
+  s->arena = malloc(H2_FIELD_ARENA);
+  if (!s->arena)
+  {
+    free(s);
+    return NULL;
+  }
+
+  s->h2 = h;
+  s->id = id;
+  s->spool_fd = -1;
+  forge_conn_init(&s->body_conn, -1, NULL, 0);
+  s->send_window = h->peer_initial_window;
+  s->req.content_length = -1;
+  s->start_ns = forge_access_log_clock();
+
+  /* One slot beyond the advertised limit so excess streams can be refused */
+  s->refused = h->nstreams >= FORGE_H2_MAX_STREAMS;
+  h->streams[h->nstreams++] = s;
+  return s;
+}
+
+static void stream_close(ForgeH2Conn *h, ForgeH2Stream *s)
+{
+  /* Parked work still reads the request: wait for it to come back */
+  if (s->body_conn.parked)
+  {
+    s->reset = 1;
+    return;
+  }
+
+  for (int i = 0; i < h->nstreams; i++)
+  {
+    if (h->streams[i] == s)
+    {
+      h->streams[i] = h->streams[--h->nstreams];
+      break;
+    }
+  }
+
+  h->body_memory -= s->body_cap;
+  forge_conn_spool_close(&s->body_conn);
+  free(s->body_conn.park_exchange);
+#ifndef _WIN32
+  if (s->spool_fd >= 0)
+  {
+    close(s->spool_fd);
+    forge_spool_release(s->spooled);
+  }
+#endif
+
+  free(s->block);
+  free(s->arena);
+  free(s->body);
+  free(s->pending);
+  free(s);
+}
+
+/* =========================================================
+   Response Path
+   ========================================================= */
+
+/* Send as much DATA as both windows allow; returns bytes sent */
+static size_t stream_write_data(ForgeH2Conn *h, ForgeH2Stream *s,
+                                const char *data, size_t len,
+                                int end_stream)
+{
+  size_t off = 0;
+
+  while (off < len)
+  {
+    int64_t chunk = (int64_t)(len - off);
+    uint32_t max_frame = h->peer_max_frame < FORGE_H2_DEFAULT_FRAME
+                             ? h->peer_max_frame
+                             : FORGE_H2_DEFAULT_FRAME;
+
+    if (chunk > max_frame)
+      chunk = max_frame;
+    if (chunk > h->send_window)
+      chunk = h->send_window;
+    if (chunk > s->send_window)
+      chunk = s->send_window;
+    if (chunk <= 0)
+      break;
+
+    int last = end_stream && off + (size_t)chunk == len;
+    out_frame(h, FORGE_H2_DATA, last ? FORGE_H2_FLAG_END_STREAM : 0,
+              s->id, data + off, (size_t)chunk);
+
+    h->send_window -= chunk;
+    s->send_window -= chunk;
+    off += (size_t)chunk;
+  }
+
+  return off;
+}
+
+/* Resume responses that were waiting on WINDOW_UPDATE */
+static void flush_pending(ForgeH2Conn *h)
+{
+  for (int i = 0; i < h->nstreams;)
+  {
+    ForgeH2Stream *s = h->streams[i];
+
+    if (s->pending && h->send_window > 0)
+    {
+      s->pending_off += stream_write_data(h, s,
+                                          s->pending + s->pending_off,
+                                          s->pending_len - s->pending_off, 1);
+      if (s->pending_off == s->pending_len)
+      {
+        stream_close(h, s);
+        continue; /* slot now holds another stream */
+      }
+    }
+    i++;
+  }
+}
+
+/* Headers added with forge_response_header(), lowercased for HTTP/2 */
+static int encode_extra_headers(ForgeH2Conn *h, uint8_t *block,
+                                size_t cap, size_t *n)
+{
+  const char *p = forge_exchange.headers;
+  const char *end = p + forge_exchange.headers_len;
+
+  while (p < end)
+  {
+    const char *colon = memchr(p, ':', (size_t)(end - p));
+    const char *eol = colon ? memchr(colon, '\r', (size_t)(end - colon)) : NULL;
+    if (!eol)
+      return -1;
+
+    char name[128];
+    size_t name_len = (size_t)(colon - p);
+    if (name_len >= sizeof(name))
+      return -1;
+    for (size_t i = 0; i < name_len; i++)
+      name[i] = (char)tolower((unsigned char)p[i]);
+    name[name_len] = '\0';
+
+    /* Connection-specific fields are illegal in HTTP/2 */
+    if (strcmp(name, "connection") != 0 && strcmp(name, "keep-alive") != 0 &&
+        strcmp(name, "transfer-encoding") != 0 && strcmp(name, "upgrade") != 0)
+    {
+      long used = forge_hpack_encode(&h->encoder, block + *n, cap - *n, name,
+                                     colon + 2, (size_t)(eol - colon - 2),
+                                     FORGE_HPACK_INDEX);
+      if (used < 0)
+        return -1;
+      *n += (size_t)used;
+    }
+
+    p = eol + 2;
+  }
+  return 0;
+}
+
+int forge_h2_respond(ForgeH2Stream *s,
+                     const char *status,
+                     const char *content_type,
+                     const char *body,
+                     size_t body_len)
+{
+  ForgeH2Conn *h = s->h2;
+  if (s->responded)
+    return -1;
+  s->responded = 1;
+
+  /* The peer reset it while it was parked: nobody is listening */
+  if (s->reset)
+    return 0;
+
+  char code[4] = {0};
+  memcpy(code, status, 3);
+
+  char length[24];
+  int length_len = snprintf(length, sizeof(length), "%zu", body_len);
+
+  uint8_t block[512 + FORGE_RESPONSE_HEADERS_MAX];
+  size_t n = 0;
+  long used;
+
+  used = forge_hpack_encode(&h->encoder, block, sizeof(block), ":status",
+                            code, strlen(code), FORGE_HPACK_INDEX);
+  if (used < 0)
+    goto fail;
+  n += (size_t)used;
+
+  used = forge_hpack_encode(&h->encoder, block + n, sizeof(block) - n,
+                            "content-type", content_type,
+                            strlen(content_type), FORGE_HPACK_INDEX);
+  if (used < 0)
+    goto fail;
+  n += (size_t)used;
+
+  used = forge_hpack_encode(&h->encoder, block + n, sizeof(block) - n,
+                            "content-length", length, (size_t)length_len,
+                            FORGE_HPACK_NO_INDEX);
+  if (used < 0)
+    goto fail;
+  n += (size_t)used;
+
+  used = forge_hpack_encode(&h->encoder, block + n, sizeof(block) - n,
+                            "server", "Forge", 5, FORGE_HPACK_INDEX);
+  if (used < 0)
+    goto fail;
+  n += (size_t)used;
+
+  /* Changes every second: not worth a dynamic table entry */
+  size_t date_len;
+  const char *date = forge_http_date(&date_len);
+  used = forge_hpack_encode(&h->encoder, block + n, sizeof(block) - n,
+                            "date", date, date_len, FORGE_HPACK_NO_INDEX);
+  if (used < 0)
+    goto fail;
+  n += (size_t)used;
+
+  if (encode_extra_headers(h, block, sizeof(block), &n) != 0)
+    goto fail;
+
+  out_frame(h, FORGE_H2_HEADERS,
+            FORGE_H2_FLAG_END_HEADERS | (body_len ? 0 : FORGE_H2_FLAG_END_STREAM),
+            s->id, block, n);
+  forge_exchange.bytes += FORGE_H2_FRAME_HEADER + n;
+
+  size_t sent = stream_write_data(h, s, body, body_len, 1);
+  forge_exchange.bytes += sent;
+
+  if (sent < body_len)
+  {
+    /* The handler's buffer dies on return: keep the remainder */
+    s->pending_len = body_len - sent;
+    s->pending = malloc(s->pending_len);
+    if (!s->pending)
+    {
+      send_rst(h, s->id, FORGE_H2_INTERNAL_ERROR);
+      s->pending_len = 0;
+      return -1;
+    }
+    memcpy(s->pending, body + sent, s->pending_len);
+  }
+
+  return 0;
+
+fail:
+  send_rst(h, s->id, FORGE_H2_INTERNAL_ERROR);
+  return -1;
+}
+
+/* =========================================================
+   Header Decoding
+   ========================================================= */
+
+static char *arena_copy(ForgeH2Stream *s, const char *src, size_t len)
+{
+  if (s->arena_len + len + 1 > H2_FIELD_ARENA)
+    return NULL;
+
+  char *dst = s->arena + s->arena_len;
+  memcpy(dst, src, len);
+  dst[len] = '\0';
+  s->arena_len += len + 1;
+  return dst;
+}
+
+static int add_header(ForgeH2Stream *s,
+                      const char *name, size_t name_len,
+                      const char *value, size_t value_len)
+{
+  ForgeHttpRequest *req = &s->req;
+  if (req->header_count == FORGE_MAX_HEADERS)
+    return -1;
+
+  char *n = arena_copy(s, name, name_len);
+  char *v = arena_copy(s, value, value_len);
+  if (!n || !v)
+    return -1;
+
+  ForgeHttpHeader *h = &req->headers[req->header_count++];
+  h->name = n;
+  h->name_len = name_len;
+  h->value = v;
+  h->value_len = value_len;
+  forge_http_index_header(req, req->header_count - 1);
+  return 0;
+}
+
+static int copy_pseudo(char *dst, size_t cap, const char *v, size_t len)
+{
+  if (len == 0 || len >= cap)
+    return -1;
+  memcpy(dst, v, len);
+  dst[len] = '\0';
+  return 0;
+}
+
+static int on_field(const char *name, size_t name_len,
+                    const char *value, size_t value_len,
+                    void *user)
+{
+  ForgeH2Stream *s = user;
+  ForgeHttpRequest *req = &s->req;
+
+  /* Keep decoding (HPACK state must stay in sync), just don't store */
+  if (s->trailers || s->refused || s->bad_request)
+    return 0;
+
+  if (name_len > 0 && name[0] == ':')
+  {
+    int rc = 0;
+
+    if (s->regular_seen)
+      rc = -1; /* pseudo-headers must come first */
+    else if (name_len == 7 && memcmp(name, ":method", 7) == 0)
+      rc = copy_pseudo(req->method, sizeof(req->method), value, value_len);
+    else if (name_len == 5 && memcmp(name, ":path", 5) == 0)
+      rc = forge_http_set_target(req, value, value_len);
+    else if (name_len == 10 && memcmp(name, ":authority", 10) == 0)
+    {
+      /* Surfaced as Host once the whole block is decoded */
+      s->authority = arena_copy(s, value, value_len);
+      s->authority_len = value_len;
+      rc = s->authority ? 0 : -1;
+    }
+    else if (name_len != 7 || memcmp(name, ":scheme", 7) != 0)
+      rc = -1;
+
+    if (rc != 0)
+      s->bad_request = 1;
+    return 0;
+  }
+
+  s->regular_seen = 1;
+  if (name_len == 14 && memcmp(name, "content-length", 14) == 0)
+  {
+    /* One well-formed value, or the stream is malformed */
+    long long n = forge_http_parse_length(value, value_len);
+    if (n < 0 || req->content_length >= 0)
+    {
+      s->malformed = 1;
+      return 0;
+    }
+    req->content_length = n;
+  }
+
+  if (add_header(s, name, name_len, value, value_len) != 0)
+    s->bad_request = 1;
+  return 0;
+}
+
+/* The request ended with other than its declared content-length */
+static int length_mismatch(const ForgeH2Stream *s)
+{
+  return s->end_stream && s->req.content_length >= 0 &&
+         s->received != (uint64_t)s->req.content_length;
+}
+
+static int headers_complete(ForgeH2Conn *h, ForgeH2Stream *s)
+{
+  int rc = forge_hpack_decode(&h->decoder, s->block, s->block_len,
+                              h->scratch, sizeof(h->scratch),
+                              on_field, s);
+  free(s->block);
+  s->block = NULL;
+  s->block_len = 0;
+
+  if (rc != 0)
+    return conn_error(h, FORGE_H2_COMPRESSION_ERROR);
+
+  if (s->end_stream_pending)
+    s->end_stream = 1;
+
+  if (s->refused)
+  {
+    send_rst(h, s->id, FORGE_H2_REFUSED_STREAM);
+    stream_close(h, s);
+    return 0;
+  }
+
+  if (s->malformed || length_mismatch(s))
+  {
+    send_rst(h, s->id, FORGE_H2_PROTOCOL_ERROR);
+    stream_close(h, s);
+    return 0;
+  }
+
+  if (s->trailers)
+    return 0;
+
+  if (!s->req.method[0] || !s->req.path[0])
+    s->bad_request = 1;
+
+  if (s->authority && !forge_header_get(&s->req, FORGE_HDR_HOST) &&
+      add_header(s, "host", 4, s->authority, s->authority_len) != 0)
+    s->bad_request = 1;
+
+  memcpy(s->req.version, "HTTP/2.0", 9);
+  s->headers_done = 1;
+
+  if (!s->bad_request)
+  {
+    /* Resolved again at dispatch: registrations may rebuild the table */
+    forge_router_enter();
+    size_t max_body = forge_server_route(&s->req)->route.max_body;
+    forge_router_exit();
+    s->max_body = max_body ? max_body : FORGE_DEFAULT_MAX_BODY;
+  }
+
+  return 0;
+}
+
+/* =========================================================
+   Frame Handlers
+   ========================================================= */
+
+/* Strip PADDED (and PRIORITY) fields; returns payload bounds */
+static int frame_payload(const ForgeH2Frame *f, const uint8_t *p,
+                         int has_priority,
+                         const uint8_t **data, size_t *len)
+{
+  size_t off = 0;
+  size_t pad = 0;
+
+  if (f->flags & FORGE_H2_FLAG_PADDED)
+  {
+    if (f->length < 1)
+      return -1;
+    pad = p[0];
+    off = 1;
+  }
+
+  if (has_priority && (f->flags & FORGE_H2_FLAG_PRIORITY))
+    off += 5;
+
+  if (off + pad > f->length)
+    return -1;
+
+  *data = p + off;
+  *len = f->length - off - pad;
+  return 0;
+}
+
+static int append_block(ForgeH2Stream *s, const uint8_t *data, size_t len)
+{
+  if (s->block_len + len > H2_HEADER_BLOCK_MAX)
+    return -1;
+
+  uint8_t *grown = realloc(s->block, s->block_len + len);
+  if (!grown && s->block_len + len > 0)
+    return -1;
+
+  s->block = grown;
+  if (len > 0)
+    memcpy(s->block + s->block_len, data, len);
+  s->block_len += len;
+  return 0;
+}
+
+static int on_headers(ForgeH2Conn *h, const ForgeH2Frame *f, const uint8_t *p)
+{
+  const uint8_t *frag;
+  size_t frag_len;
+
+  if (f->stream_id == 0 || (f->stream_id & 1) == 0)
+    return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+  if (frame_payload(f, p, 1, &frag, &frag_len) != 0)
+    return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+
+  ForgeH2Stream *s = stream_find(h, f->stream_id);
+  if (!s)
+  {
+    if (f->stream_id <= h->last_stream_id)
+      return conn_error(h, FORGE_H2_STREAM_CLOSED);
+
+    h->last_stream_id = f->stream_id;
+    s = stream_new(h, f->stream_id);
+    if (!s)
+      return conn_error(h, FORGE_H2_INTERNAL_ERROR);
+  }
+  else
+  {
+    /* Second HEADERS on a stream: trailers, which must end it */
+    if (!s->headers_done || s->end_stream ||
+        !(f->flags & FORGE_H2_FLAG_END_STREAM))
+      return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+    s->trailers = 1;
+  }
+
+  if (append_block(s, frag, frag_len) != 0)
+    return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+
+  if (f->flags & FORGE_H2_FLAG_END_STREAM)
+    s->end_stream_pending = 1;
+
+  if (f->flags & FORGE_H2_FLAG_END_HEADERS)
+    return headers_complete(h, s);
+
+  h->continuation_id = f->stream_id;
+  return 0;
+}
+
+static int on_continuation(ForgeH2Conn *h, const ForgeH2Frame *f, const uint8_t *p)
+{
+  if (h->continuation_id == 0 || f->stream_id != h->continuation_id)
+    return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+
+  ForgeH2Stream *s = stream_find(h, f->stream_id);
+  if (!s || append_block(s, p, f->length) != 0)
+    return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+
+  if (!(f->flags & FORGE_H2_FLAG_END_HEADERS))
+    return 0;
+
+  h->continuation_id = 0;
+  return headers_complete(h, s);
+}
+
+/*
+ * Keep the start of a request body in memory and spool the rest,
+ * so windows can be credited on arrival without memory growing
+ * with the body: a stream holds at most H2_BODY_MEMORY, and all
+ * of a connection's streams H2_CONN_BODY_MEMORY.
+ */
+static int body_append(ForgeH2Conn *h, ForgeH2Stream *s,
+                       const uint8_t *data, size_t len)
+{
+  if (s->spool_fd < 0 && s->body_len + len > s->body_cap)
+  {
+    size_t cap = s->body_cap ? s->body_cap : 16 * 1024;
+    while (cap < s->body_len + len)
+      cap *= 2;
+
+    if (cap <= H2_BODY_MEMORY &&
+        h->body_memory - s->body_cap + cap <= H2_CONN_BODY_MEMORY)
+    {
+      char *grown = realloc(s->body, cap);
+      if (!grown)
+        return -1;
+      h->body_memory += cap - s->body_cap;
+      s->body = grown;
+      s->body_cap = cap;
+    }
+    else if ((s->spool_fd = forge_spool_open()) < 0)
+    {
+      return -1;
+    }
+  }
+
+  /* Once spooling, every later byte follows the spool to keep order */
+  if (s->spool_fd >= 0)
+  {
+    if (forge_spool_claim(len) != 0)
+      return -1;
+    s->spooled += len;
+    if (forge_conn_write_all(s->spool_fd, data, len) != 0)
+      return -1;
+    return 0;
+  }
+
+  memcpy(s->body + s->body_len, data, len);
+  s->body_len += len;
+  return 0;
+}
+
+static int on_data(ForgeH2Conn *h, const ForgeH2Frame *f, const uint8_t *p)
+{
+  const uint8_t *data;
+  size_t len;
+
+  if (f->stream_id == 0)
+    return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+  if (frame_payload(f, p, 0, &data, &len) != 0)
+    return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+
+  /* The whole frame, padding included, counts against the window */
+  h->recv_consumed += f->length;
+
+  ForgeH2Stream *s = stream_find(h, f->stream_id);
+  if (!s || !s->headers_done || s->end_stream)
+  {
+    if (f->stream_id > h->last_stream_id)
+      return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+    send_rst(h, f->stream_id, FORGE_H2_STREAM_CLOSED);
+    return 0;
+  }
+
+  /* Never more than declared, and all of it by END_STREAM */
+  s->received += len;
+  if (f->flags & FORGE_H2_FLAG_END_STREAM)
+    s->end_stream = 1;
+  if ((s->req.content_length >= 0 &&
+       s->received > (uint64_t)s->req.content_length) ||
+      length_mismatch(s))
+  {
+    send_rst(h, s->id, FORGE_H2_PROTOCOL_ERROR);
+    stream_close(h, s);
+    return 0;
+  }
+
+  if (!s->too_large && !s->spool_failed && len > 0)
+  {
+    if (s->body_len + s->spooled + len > s->max_body)
+    {
+      s->too_large = 1;
+      h->body_memory -= s->body_cap;
+      free(s->body);
+      s->body = NULL;
+      s->body_len = 0;
+      s->body_cap = 0;
+    }
+    else if (body_append(h, s, data, len) != 0)
+    {
+      s->spool_failed = 1;
+    }
+  }
+
+  if (!s->end_stream && f->length > 0)
+    send_window_update(h, s->id, f->length);
+
+  return 0;
+}
+
+static int apply_settings(ForgeH2Conn *h, const uint8_t *p, size_t len)
+{
+  for (size_t i = 0; i + 6 <= len; i += 6)
+  {
+    uint16_t id = (uint16_t)((p[i] << 8) | p[i + 1]);
+    uint32_t v = get_be32(p + i + 2);
+
+    switch (id)
+    {
+    case FORGE_H2_SETTINGS_HEADER_TABLE_SIZE:
+      forge_hpack_set_limit(&h->encoder, v);
+      break;
+
+    case FORGE_H2_SETTINGS_ENABLE_PUSH:
+      if (v > 1)
+        return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+      break;
+
+    case FORGE_H2_SETTINGS_INITIAL_WINDOW_SIZE:
+    {
+      if (v > FORGE_H2_MAX_WINDOW)
+        return conn_error(h, FORGE_H2_FLOW_CONTROL_ERROR);
+
+      /* Applies retroactively to every open stream */
+      int64_t delta = (int64_t)v - (int64_t)h->peer_initial_window;
+      for (int j = 0; j < h->nstreams; j++)
+      {
+        h->streams[j]->send_window += delta;
+        if (h->streams[j]->send_window > FORGE_H2_MAX_WINDOW)
+          return conn_error(h, FORGE_H2_FLOW_CONTROL_ERROR);
+      }
+      h->peer_initial_window = v;
+      break;
+    }
+
+    case FORGE_H2_SETTINGS_MAX_FRAME_SIZE:
+      if (v < FORGE_H2_DEFAULT_FRAME || v > 0xffffff)
+        return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+      h->peer_max_frame = v;
+      break;
+
+    default:
+      break; /* unknown settings are ignored */
+    }
+  }
+
+  return 0;
+}
+
+static int on_settings(ForgeH2Conn *h, const ForgeH2Frame *f, const uint8_t *p)
+{
+  if (f->stream_id != 0)
+    return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+
+  if (f->flags & FORGE_H2_FLAG_ACK)
+    return f->length == 0 ? 0 : conn_error(h, FORGE_H2_FRAME_SIZE_ERROR);
+
+  if (f->length % 6 != 0)
+    return conn_error(h, FORGE_H2_FRAME_SIZE_ERROR);
+
+  if (apply_settings(h, p, f->length) != 0)
+    return -1;
+
+  out_frame(h, FORGE_H2_SETTINGS, FORGE_H2_FLAG_ACK, 0, NULL, 0);
+  flush_pending(h);
+  return 0;
+}
+
+static int on_window_update(ForgeH2Conn *h, const ForgeH2Frame *f, const uint8_t *p)
+{
+  if (f->length != 4)
+    return conn_error(h, FORGE_H2_FRAME_SIZE_ERROR);
+
+  uint32_t inc = get_be32(p) & 0x7fffffff;
+
+  if (f->stream_id == 0)
+  {
+    if (inc == 0)
+      return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+    h->send_window += inc;
+    if (h->send_window > FORGE_H2_MAX_WINDOW)
+      return conn_error(h, FORGE_H2_FLOW_CONTROL_ERROR);
+  }
+  else
+  {
+    ForgeH2Stream *s = stream_find(h, f->stream_id);
+    if (!s)
+      return 0; /* already closed on our side */
+
+    s->send_window += inc;
+    if (inc == 0 || s->send_window > FORGE_H2_MAX_WINDOW)
+    {
+      send_rst(h, s->id, inc == 0 ? FORGE_H2_PROTOCOL_ERROR
+                                  : FORGE_H2_FLOW_CONTROL_ERROR);
+      stream_close(h, s);
+      return 0;
+    }
+  }
+
+  flush_pending(h);
+  return 0;
+}
+
+static int on_frame(ForgeH2Conn *h, const ForgeH2Frame *f, const uint8_t *p)
+{
+  /* A header block must not be interleaved with anything else */
+  if (h->continuation_id && f->type != FORGE_H2_CONTINUATION)
+    return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+
+  switch (f->type)
+  {
+  case FORGE_H2_DATA:
+    return on_data(h, f, p);
+
+  case FORGE_H2_HEADERS:
+    return on_headers(h, f, p);
+
+  case FORGE_H2_CONTINUATION:
+    return on_continuation(h, f, p);
+
+  case FORGE_H2_SETTINGS:
+    return on_settings(h, f, p);
+
+  case FORGE_H2_WINDOW_UPDATE:
+    return on_window_update(h, f, p);
+
+  case FORGE_H2_PRIORITY:
+    if (f->stream_id == 0)
+      return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+    return f->length == 5 ? 0 : conn_error(h, FORGE_H2_FRAME_SIZE_ERROR);
+
+  case FORGE_H2_RST_STREAM:
+  {
+    if (f->stream_id == 0)
+      return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+    if (f->length != 4)
+      return conn_error(h, FORGE_H2_FRAME_SIZE_ERROR);
+
+    ForgeH2Stream *s = stream_find(h, f->stream_id);
+    if (s)
+      stream_close(h, s);
+    return 0;
+  }
+
+  case FORGE_H2_PING:
+    if (f->stream_id != 0)
+      return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+    if (f->length != 8)
+      return conn_error(h, FORGE_H2_FRAME_SIZE_ERROR);
+    if (!(f->flags & FORGE_H2_FLAG_ACK))
+      out_frame(h, FORGE_H2_PING, FORGE_H2_FLAG_ACK, 0, p, 8);
+    return 0;
+
+  case FORGE_H2_GOAWAY:
+    if (f->stream_id != 0)
+      return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+    h->goaway = 1;
+    return 0;
+
+  case FORGE_H2_PUSH_PROMISE:
+    return conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+
+  default:
+    return 0; /* extension frames are ignored */
+  }
+}
+
+/* =========================================================
+   Stream Dispatch
+   ========================================================= */
+
+static void stream_dispatch(ForgeH2Conn *h, ForgeH2Stream *s)
+{
+  int fd = h->conn->fd;
+  s->dispatched = 1;
+
+  forge_exchange_begin(fd, 0, s);
+
+  if (s->body_conn.parked == FORGE_RESUMED)
+  {
+    /* Handed back: the dispatch restores the parked exchange */
+    h->parked--;
+    forge_router_enter();
+    forge_server_dispatch(forge_server_route(&s->req), &s->req, fd);
+    forge_router_exit();
+  }
+  else if (s->bad_request)
+  {
+    forge_send_text(fd, "400 Bad Request", "Bad Request\n");
+  }
+  else if (s->too_large)
+  {
+    forge_send_text(fd, "413 Payload Too Large", "Payload Too Large\n");
+  }
+  else if (s->spool_failed)
+  {
+    forge_send_text(fd, "503 Service Unavailable", "Service Unavailable\n");
+  }
+  else
+  {
+    /* Body is fully received: serve forge_body_read() from memory, then the spool */
+    forge_conn_init(&s->body_conn, -1, s->body, s->body_len);
+    s->body_conn.len = s->body_len;
+    s->body_conn.tier = -1; /* never pooled, even when empty */
+    s->body_conn.ready_ns = h->conn->ready_ns;
+    s->body_conn.peer_ipv4 = h->conn->peer_ipv4;
+#ifndef _WIN32
+    if (s->spool_fd >= 0 && lseek(s->spool_fd, 0, SEEK_SET) == 0)
+    {
+      s->body_conn.spool_fd = s->spool_fd;
+      s->body_conn.spool_claimed = s->spooled;
+      s->spool_fd = -1;
+    }
+#endif
+    s->body_conn.owner = h->conn;
+    s->req.content_length = (long long)(s->body_len + s->spooled);
+    s->req.chunked = 0;
+    s->req.expect_continue = 0;
+    s->req.conn = &s->body_conn;
+
+    forge_router_enter();
+    forge_server_dispatch(forge_server_route(&s->req), &s->req, fd);
+    forge_router_exit();
+  }
+
+  /* Parked: answered, logged and closed once it resumes */
+  if (s->body_conn.parked == FORGE_PARKED)
+  {
+    h->parked++;
+    forge_exchange_begin(fd, 0, NULL);
+    return;
+  }
+
+  if (!s->responded)
+  {
+    send_rst(h, s->id, FORGE_H2_INTERNAL_ERROR);
+    s->responded = 1;
+  }
+
+  forge_access_log_record(s->bad_request ? NULL : &s->req,
+                          forge_exchange.status,
+                          forge_exchange.bytes,
+                          h->conn->peer_ipv4,
+                          s->start_ns);
+  forge_exchange_begin(fd, 0, NULL);
+
+  if (!s->pending)
+    stream_close(h, s);
+}
+
+static void dispatch_ready(ForgeH2Conn *h)
+{
+  for (int i = 0; i < h->nstreams;)
+  {
+    ForgeH2Stream *s = h->streams[i];
+    if ((s->headers_done && s->end_stream && !s->dispatched) ||
+        s->body_conn.parked == FORGE_RESUMED)
+    {
+      int before = h->nstreams;
+      stream_dispatch(h, s);
+      if (h->nstreams < before)
+        continue; /* closed: slot now holds another stream */
+    }
+    i++;
+  }
+}
+
+/* =========================================================
+   Input Processing
+   ========================================================= */
+
+static int h2_process(ForgeH2Conn *h)
+{
+  ForgeConn *c = h->conn;
+  int rc = 0;
+
+  if (!h->preface_ok)
+  {
+    size_t avail = c->len - c->pos;
+    size_t cmp = avail < FORGE_H2_PREFACE_LEN ? avail : FORGE_H2_PREFACE_LEN;
+
+    if (memcmp(c->buf + c->pos, FORGE_H2_PREFACE, cmp) != 0)
+    {
+      conn_error(h, FORGE_H2_PROTOCOL_ERROR);
+      out_flush(h);
+      return -1;
+    }
+    if (avail < FORGE_H2_PREFACE_LEN)
+      goto done;
+
+    c->pos += FORGE_H2_PREFACE_LEN;
+    h->preface_ok = 1;
+  }
+
+  while (c->len - c->pos >= FORGE_H2_FRAME_HEADER)
+  {
+    ForgeH2Frame f;
+    forge_h2_unpack_frame((const uint8_t *)c->buf + c->pos, &f);
+
+    /* We never raise SETTINGS_MAX_FRAME_SIZE above the default */
+    if (f.length > FORGE_H2_DEFAULT_FRAME)
+    {
+      rc = conn_error(h, FORGE_H2_FRAME_SIZE_ERROR);
+      break;
+    }
+    if (c->len - c->pos < FORGE_H2_FRAME_HEADER + f.length)
+      break;
+
+    const uint8_t *payload = (const uint8_t *)c->buf + c->pos + FORGE_H2_FRAME_HEADER;
+    c->pos += FORGE_H2_FRAME_HEADER + f.length;
+
+    if (on_frame(h, &f, payload) != 0)
+    {
+      rc = -1;
+      break;
+    }
+  }
+
+done:
+  forge_conn_next_request(c);
+
+  if (rc == 0)
+    dispatch_ready(h);
+
+  if (h->recv_consumed > 0)
+  {
+    send_window_update(h, 0, h->recv_consumed);
+    h->recv_consumed = 0;
+  }
+
+  if (out_flush(h) != 0)
+    return -1;
+
+  if (rc != 0 || (h->goaway && h->nstreams == 0))
+    return -1;
+  return 0;
+}
+
+/* =========================================================
+   Upgrade (RFC 7540 3.2)
+   ========================================================= */
+
+int forge_h2_wants_upgrade(const ForgeHttpRequest *req)
+{
+  return strcmp(req->version, "HTTP/1.1") == 0 &&
+         req->content_length <= 0 && !req->chunked &&
+         forge_http_has_token(forge_header_get(req, FORGE_HDR_UPGRADE), "h2c") &&
+         forge_header_get(req, FORGE_HDR_HTTP2_SETTINGS) != NULL;
+}
+
+/* base64url without padding (the HTTP2-Settings encoding) */
+static long base64url_decode(const char *in, size_t len, uint8_t *out, size_t cap)
+{
+  uint32_t acc = 0;
+  int bits = 0;
+  size_t o = 0;
+
+  for (size_t i = 0; i < len && in[i] != '='; i++)
+  {
+    char ch = in[i];
+    int v;
+    if (ch >= 'A' && ch <= 'Z')
+      v = ch - 'A';
+    else if (ch >= 'a' && ch <= 'z')
+      v = ch - 'a' + 26;
+    else if (ch >= '0' && ch <= '9')
+      v = ch - '0' + 52;
+    else if (ch == '-' || ch == '+')
+      v = 62;
+    else if (ch == '_' || ch == '/')
+      v = 63;
+    else
+      return -1;
+
+    acc = (acc << 6) | (uint32_t)v;
+    bits += 6;
+    if (bits >= 8)
+    {
+      if (o == cap)
+        return -1;
+      bits -= 8;
+      out[o++] = (uint8_t)(acc >> bits);
+    }
+  }
+  return (long)o;
+}
+
+/* Turn the upgrading HTTP/1.1 request into stream 1 */
+static int adopt_upgrade(ForgeH2Conn *h, const ForgeHttpRequest *upgrade)
+{
+  ForgeH2Stream *s = stream_new(h, 1);
+  if (!s)
+    return -1;
+
+  h->last_stream_id = 1;
+  memcpy(s->req.method, upgrade->method, sizeof(s->req.method));
+  memcpy(s->req.path, upgrade->path, sizeof(s->req.path));
+  memcpy(s->req.query, upgrade->query, sizeof(s->req.query));
+
+  /* Copy fields out of the connection buffer before it is compacted */
+  for (int i = 0; i < upgrade->header_count; i++)
+  {
+    const ForgeHttpHeader *f = &upgrade->headers[i];
+    if (add_header(s, f->name, f->name_len, f->value, f->value_len) != 0)
+    {
+      s->bad_request = 1;
+      break;
+    }
+  }
+
+  /* Stream 1 is half-closed (remote) from the start */
+  s->end_stream_pending = 1;
+  return headers_complete(h, s);
+}
+
+/* =========================================================
+   Lifecycle
+   ========================================================= */
+
+int forge_h2_start(ForgeConn *c, const ForgeHttpRequest *upgrade)
+{
+  ForgeH2Conn *h = calloc(1, sizeof(*h));
+  if (!h)
+    return -1;
+
+  h->conn = c;
+  h->send_window = FORGE_H2_DEFAULT_WINDOW;
+  h->peer_initial_window = FORGE_H2_DEFAULT_WINDOW;
+  h->peer_max_frame = FORGE_H2_DEFAULT_FRAME;
+  forge_hpack_init(&h->decoder, FORGE_HPACK_DEFAULT_TABLE);
+  forge_hpack_init(&h->encoder, FORGE_HPACK_DEFAULT_TABLE);
+
+  c->h2 = h;
+  c->proto = FORGE_PROTO_H2;
+
+  if (upgrade)
+  {
+    static const char switching[] =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Connection: Upgrade\r\n"
+        "Upgrade: h2c\r\n"
+        "\r\n";
+
+    const ForgeHttpHeader *hs = forge_header_get(upgrade, FORGE_HDR_HTTP2_SETTINGS);
+    uint8_t settings[256];
+    long n = base64url_decode(hs->value, hs->value_len, settings, sizeof(settings));
+    if (n < 0 || n % 6 != 0 ||
+        forge_conn_write_all(c->fd, switching, sizeof(switching) - 1) != 0)
+      return -1;
+
+    /* Implicitly acknowledged: no SETTINGS ACK for these */
+    if (apply_settings(h, settings, (size_t)n) != 0)
+      return -1;
+  }
+
+  /* The server connection preface is a SETTINGS frame */
+  uint8_t mine[6];
+  mine[0] = 0;
+  mine[1] = FORGE_H2_SETTINGS_MAX_CONCURRENT_STREAMS;
+  put_be32(mine + 2, FORGE_H2_MAX_STREAMS);
+  out_frame(h, FORGE_H2_SETTINGS, 0, 0, mine, sizeof(mine));
+
+  if (upgrade && adopt_upgrade(h, upgrade) != 0)
+  {
+    out_flush(h);
+    return -1;
+  }
+
+  return h2_process(h);
+}
+
+int forge_h2_serve(ForgeConn *c)
+{
+  long n = forge_conn_fill(c);
+  if (n == FORGE_CONN_AGAIN)
+    return 0;
+  if (n <= 0)
+    return -1;
+  return h2_process(c->h2);
+}
+
+int forge_h2_resume(ForgeConn *c)
+{
+  ForgeH2Conn *h = c->h2;
+
+  dispatch_ready(h);
+  if (out_flush(h) != 0)
+    return -1;
+  return h->goaway && h->nstreams == 0 ? -1 : 0;
+}
+
+int forge_h2_parked(const ForgeConn *c)
+{
+  return c->h2 ? c->h2->parked : 0;
+}
+
+void forge_h2_free(ForgeConn *c)
+{
+  ForgeH2Conn *h = c->h2;
+  if (!h)
+    return;
+
+  /* Normally none is parked by now: the loop waits for them */
+  for (int i = 0; i < h->nstreams; i++)
+    h->streams[i]->body_conn.parked = 0;
+
+  while (h->nstreams > 0)
+    stream_close(h, h->streams[0]);
+
+  forge_hpack_free(&h->decoder);
+  forge_hpack_free(&h->encoder);
+  free(h);
+
+  c->h2 = NULL;
+  c->proto = FORGE_PROTO_HTTP1;
+}
@@ -0,0 +1,682 @@
+#include "forge_hpack.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* =========================================================
+   Static Table (RFC 7541 Appendix A)
+   ========================================================= */
+
+typedef struct
+{
+  const char *name;
+  const char *value;
+} StaticEntry;
+
+#define STATIC_COUNT 61
+
+static const StaticEntry static_table[STATIC_COUNT] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+/* =========================================================
+   Huffman Code (RFC 7541 Appendix B, canonical)
+   ========================================================= */
+
+static const uint32_t huff_codes[257] = {
+    0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+    0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+    0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+    0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+    0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+    0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+    0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+    0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+    0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+    0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+    0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+    0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+    0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+    0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+    0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+    0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+    0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+    0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+    0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+    0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+    0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+    0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+    0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+    0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+    0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+    0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+    0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+    0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+    0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+    0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+    0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+    0x3fffffff,
+};
+
+static const uint8_t huff_lens[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+/* Symbols ordered by (code length, symbol): canonical decode order */
+static const uint16_t huff_sorted[257] = {
+    48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37, 45, 46, 47, 51,
+    52, 53, 54, 55, 56, 57, 61, 65, 95, 98, 100, 102, 103, 104, 108, 109,
+    110, 112, 114, 117, 58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+    77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89, 106, 107, 113, 118,
+    119, 120, 121, 122, 38, 42, 44, 59, 88, 90, 33, 34, 40, 41, 63, 39,
+    43, 124, 35, 62, 0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+    195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+    179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160,
+    163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+    233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157,
+    158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239, 9, 142,
+    144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+    200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211,
+    212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+    2, 3, 4, 5, 6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+    21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220, 249, 10, 13, 22,
+    256,
+};
+
+/* Per code length: first code, symbols with that length, index into huff_sorted */
+static const uint32_t huff_first[31] = {
+    0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x14, 0x5c,
+    0xf8, 0x0, 0x3f8, 0x7fa, 0xffa, 0x1ff8, 0x3ffc, 0x7ffc,
+    0x0, 0x0, 0x0, 0x7fff0, 0xfffe6, 0x1fffdc, 0x3fffd2, 0x7fffd8,
+    0xffffea, 0x1ffffec, 0x3ffffe0, 0x7ffffde, 0xfffffe2, 0x0, 0x3ffffffc,
+};
+
+static const uint16_t huff_count[31] = {
+    0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+    0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4,
+};
+
+static const uint16_t huff_offset[31] = {
+    0, 0, 0, 0, 0, 0, 10, 36, 68, 0, 74, 79, 82, 84, 90, 92,
+    0, 0, 0, 95, 98, 106, 119, 145, 174, 186, 190, 205, 224, 0, 253,
+};
+
+size_t forge_hpack_huffman_len(const uint8_t *in, size_t len)
+{
+  size_t bits = 0;
+  for (size_t i = 0; i < len; i++)
+    bits += huff_lens[in[i]];
+  return (bits + 7) / 8;
+}
+
+long forge_hpack_huffman_encode(const uint8_t *in, size_t len,
+                                uint8_t *out, size_t cap)
+{
+  uint64_t acc = 0;
+  int bits = 0;
+  size_t o = 0;
+
+  for (size_t i = 0; i < len; i++)
+  {
+    acc = (acc << huff_lens[in[i]]) | huff_codes[in[i]];
+    bits += huff_lens[in[i]];
+
+    while (bits >= 8)
+    {
+      if (o == cap)
+        return -1;
+      bits -= 8;
+      out[o++] = (uint8_t)(acc >> bits);
+    }
+  }
+
+  /* Pad with the most significant bits of EOS (all ones) */
+  if (bits > 0)
+  {
+    if (o == cap)
+      return -1;
+    out[o++] = (uint8_t)((acc << (8 - bits)) | (0xffu >> bits));
+  }
+
+  return (long)o;
+}
+
+long forge_hpack_huffman_decode(const uint8_t *in, size_t len,
+                                char *out, size_t cap)
+{
+  uint32_t code = 0;
+  int bits = 0;
+  size_t o = 0;
+
+  for (size_t i = 0; i < len; i++)
+  {
+    for (int b = 7; b >= 0; b--)
+    {
+      code = (code << 1) | ((in[i] >> b) & 1u);
+      bits++;
+
+      if (bits < 5)
+        continue;
+      if (bits > 30)
+        return -1;
+
+      uint32_t d = code - huff_first[bits];
+      if (code >= huff_first[bits] && d < huff_count[bits])
+      {
+        uint16_t sym = huff_sorted[huff_offset[bits] + d];
+        if (sym == 256 || o == cap)
+          return -1; /* EOS inside a string is an error */
+        out[o++] = (char)sym;
+        code = 0;
+        bits = 0;
+      }
+    }
+  }
+
+  /* Padding: at most 7 bits, all ones */
+  if (bits > 7 || code != (1u << bits) - 1)
+    return -1;
+
+  return (long)o;
+}
+
+/* =========================================================
+   Integers (RFC 7541 5.1)
+   ========================================================= */
+
+long forge_hpack_encode_int(uint8_t *out, size_t cap,
+                            uint8_t first, int prefix_bits,
+                            uint64_t value)
+{
+  uint64_t max = (1u << prefix_bits) - 1;
+  size_t o = 0;
+
+  if (cap == 0)
+    return -1;
+
+  if (value < max)
+  {
+    out[o++] = (uint8_t)(first | value);
+    return (long)o;
+  }
+
+  out[o++] = (uint8_t)(first | max);
+  value -= max;
+
+  while (value >= 128)
+  {
+    if (o == cap)
+      return -1;
+    out[o++] = (uint8_t)(0x80 | (value & 0x7f));
+    value >>= 7;
+  }
+
+  if (o == cap)
+    return -1;
+  out[o++] = (uint8_t)value;
+  return (long)o;
+}
+
+long forge_hpack_decode_int(const uint8_t *in, size_t len,
+                            int prefix_bits, uint64_t *value)
+{
+  uint64_t max = (1u << prefix_bits) - 1;
+
+  if (len == 0)
+    return -1;
+
+  uint64_t v = in[0] & max;
+  if (v < max)
+  {
+    *value = v;
+    return 1;
+  }
+
+  for (size_t i = 1, shift = 0; i < len && shift <= 56; i++, shift += 7)
+  {
+    v += (uint64_t)(in[i] & 0x7f) << shift;
+    if (!(in[i] & 0x80))
+    {
+      *value = v;
+      return (long)(i + 1);
+    }
+  }
+
+  return -1;
+}
+
+/* =========================================================
+   Dynamic Table
+   ========================================================= */
+
+void forge_hpack_init(ForgeHpackTable *t, size_t limit)
+{
+  memset(t, 0, sizeof(*t));
+  if (limit > FORGE_HPACK_DEFAULT_TABLE)
+    limit = FORGE_HPACK_DEFAULT_TABLE;
+  t->limit = limit;
+  t->max_size = limit;
+}
+
+static ForgeHpackEntry *table_at(ForgeHpackTable *t, size_t i)
+{
+  /* i = 0 is the newest entry */
+  return &t->entries[(t->head + FORGE_HPACK_MAX_ENTRIES - i) % FORGE_HPACK_MAX_ENTRIES];
+}
+
+static void table_evict(ForgeHpackTable *t)
+{
+  ForgeHpackEntry *e = table_at(t, t->count - 1);
+  t->size -= e->name_len + e->value_len + 32;
+  free(e->name);
+  memset(e, 0, sizeof(*e));
+  t->count--;
+}
+
+static void table_resize(ForgeHpackTable *t, size_t max_size)
+{
+  t->max_size = max_size;
+  while (t->count > 0 && t->size > t->max_size)
+    table_evict(t);
+}
+
+void forge_hpack_free(ForgeHpackTable *t)
+{
+  while (t->count > 0)
+    table_evict(t);
+}
+
+void forge_hpack_set_limit(ForgeHpackTable *t, size_t limit)
+{
+  if (limit > FORGE_HPACK_DEFAULT_TABLE)
+    limit = FORGE_HPACK_DEFAULT_TABLE;
+  if (limit == t->limit)
+    return;
+
+  t->limit = limit;
+  table_resize(t, limit);
+  t->pending_update = 1;
+}
+
+static int table_add(ForgeHpackTable *t,
+                     const char *name, size_t name_len,
+                     const char *value, size_t value_len)
+{
+  size_t esize = name_len + value_len + 32;
+
+  /* Copy first: name/value may live in an entry about to be evicted */
+  char *mem = NULL;
+  if (esize <= t->max_size)
+  {
+    mem = malloc(name_len + value_len + 1);
+    if (!mem)
+      return -1;
+    memcpy(mem, name, name_len);
+    memcpy(mem + name_len, value, value_len);
+  }
+
+  while (t->count > 0 &&
+         (t->size + esize > t->max_size || t->count == FORGE_HPACK_MAX_ENTRIES))
+    table_evict(t);
+
+  /* Too large for the table: it just ends up empty */
+  if (!mem)
+    return 0;
+
+  t->head = (t->head + 1) % FORGE_HPACK_MAX_ENTRIES;
+  ForgeHpackEntry *e = &t->entries[t->head];
+  e->name = mem;
+  e->name_len = name_len;
+  e->value = mem + name_len;
+  e->value_len = value_len;
+  t->count++;
+  t->size += esize;
+  return 0;
+}
+
+/* 1-based HPACK index into static + dynamic table */
+static int table_lookup(ForgeHpackTable *t, uint64_t index,
+                        const char **name, size_t *name_len,
+                        const char **value, size_t *value_len)
+{
+  if (index == 0)
+    return -1;
+
+  if (index <= STATIC_COUNT)
+  {
+    const StaticEntry *s = &static_table[index - 1];
+    *name = s->name;
+    *name_len = strlen(s->name);
+    *value = s->value;
+    *value_len = strlen(s->value);
+    return 0;
+  }
+
+  index -= STATIC_COUNT + 1;
+  if (index >= t->count)
+    return -1;
+
+  ForgeHpackEntry *e = table_at(t, (size_t)index);
+  *name = e->name;
+  *name_len = e->name_len;
+  *value = e->value;
+  *value_len = e->value_len;
+  return 0;
+}
+
+/* =========================================================
+   Decoder
+   ========================================================= */
+
+/* String literal (RFC 7541 5.2); may point into `in` or `*scratch` */
+static long read_string(const uint8_t *in, size_t len,
+                        char **scratch, size_t *scratch_left,
+                        const char **str, size_t *str_len)
+{
+  uint64_t n;
+  long used = forge_hpack_decode_int(in, len, 7, &n);
+  if (used < 0 || n > len - (size_t)used)
+    return -1;
+
+  const uint8_t *data = in + used;
+
+  if (in[0] & 0x80)
+  {
+    long out = forge_hpack_huffman_decode(data, (size_t)n, *scratch, *scratch_left);
+    if (out < 0)
+      return -1;
+    *str = *scratch;
+    *str_len = (size_t)out;
+    *scratch += out;
+    *scratch_left -= (size_t)out;
+  }
+  else
+  {
+    *str = (const char *)data;
+    *str_len = (size_t)n;
+  }
+
+  return used + (long)n;
+}
+
+int forge_hpack_decode(ForgeHpackTable *t,
+                       const uint8_t *in, size_t len,
+                       char *scratch, size_t scratch_cap,
+                       ForgeHpackEmit emit, void *user)
+{
+  size_t p = 0;
+
+  while (p < len)
+  {
+    uint8_t b = in[p];
+    uint64_t index;
+    long used;
+    const char *name, *value;
+    size_t name_len, value_len;
+
+    if (b & 0x80)
+    {
+      /* Indexed header field */
+      used = forge_hpack_decode_int(in + p, len - p, 7, &index);
+      if (used < 0 ||
+          table_lookup(t, index, &name, &name_len, &value, &value_len) != 0)
+        return -1;
+      p += (size_t)used;
+
+      if (emit && emit(name, name_len, value, value_len, user) != 0)
+        return -1;
+      continue;
+    }
+
+    if ((b & 0xe0) == 0x20)
+    {
+      /* Dynamic table size update */
+      used = forge_hpack_decode_int(in + p, len - p, 5, &index);
+      if (used < 0 || index > t->limit)
+        return -1;
+      p += (size_t)used;
+      table_resize(t, (size_t)index);
+      continue;
+    }
+
+    /* Literal: with indexing (01), without (0000) or never (0001) */
+    int indexing = (b & 0x40) != 0;
+    used = forge_hpack_decode_int(in + p, len - p, indexing ? 6 : 4, &index);
+    if (used < 0)
+      return -1;
+    p += (size_t)used;
+
+    char *sp = scratch;
+    size_t sleft = scratch_cap;
+
+    if (index)
+    {
+      const char *unused_value;
+      size_t unused_len;
+      if (table_lookup(t, index, &name, &name_len, &unused_value, &unused_len) != 0)
+        return -1;
+    }
+    else
+    {
+      used = read_string(in + p, len - p, &sp, &sleft, &name, &name_len);
+      if (used < 0)
+        return -1;
+      p += (size_t)used;
+    }
+
+    used = read_string(in + p, len - p, &sp, &sleft, &value, &value_len);
+    if (used < 0)
+      return -1;
+    p += (size_t)used;
+
+    if (emit && emit(name, name_len, value, value_len, user) != 0)
+      return -1;
+
+    if (indexing && table_add(t, name, name_len, value, value_len) != 0)
+      return -1;
+  }
+
+  return 0;
+}
+
+/* =========================================================
+   Encoder
+   ========================================================= */
+
+static long write_string(uint8_t *out, size_t cap,
+                         const char *s, size_t len)
+{
+  size_t hlen = forge_hpack_huffman_len((const uint8_t *)s, len);
+  int huffman = hlen < len;
+  size_t body = huffman ? hlen : len;
+
+  long used = forge_hpack_encode_int(out, cap, huffman ? 0x80 : 0x00, 7, body);
+  if (used < 0 || body > cap - (size_t)used)
+    return -1;
+
+  if (huffman)
+    forge_hpack_huffman_encode((const uint8_t *)s, len, out + used, body);
+  else
+    memcpy(out + used, s, len);
+
+  return used + (long)body;
+}
+
+/* Best match: exact (returns index, *exact = 1) or name-only */
+static size_t find_field(ForgeHpackTable *t,
+                         const char *name, size_t name_len,
+                         const char *value, size_t value_len,
+                         int *exact)
+{
+  size_t name_match = 0;
+  *exact = 0;
+
+  for (size_t i = 0; i < STATIC_COUNT; i++)
+  {
+    const StaticEntry *s = &static_table[i];
+    if (strncmp(s->name, name, name_len) != 0 || s->name[name_len] != '\0')
+      continue;
+    if (value && strlen(s->value) == value_len &&
+        memcmp(s->value, value, value_len) == 0)
+    {
+      *exact = 1;
+      return i + 1;
+    }
+    if (!name_match)
+      name_match = i + 1;
+  }
+
+  for (size_t i = 0; i < t->count; i++)
+  {
+    ForgeHpackEntry *e = table_at(t, i);
+    if (e->name_len != name_len || memcmp(e->name, name, name_len) != 0)
+      continue;
+    if (value && e->value_len == value_len &&
+        memcmp(e->value, value, value_len) == 0)
+    {
+      *exact = 1;
+      return STATIC_COUNT + 1 + i;
+    }
+    if (!name_match)
+      name_match = STATIC_COUNT + 1 + i;
+  }
+
+  return name_match;
+}
+
+long forge_hpack_encode(ForgeHpackTable *t,
+                        uint8_t *out, size_t cap,
+                        const char *name,
+                        const char *value, size_t value_len,
+                        int mode)
+{
+  size_t name_len = strlen(name);
+  size_t o = 0;
+  long used;
+
+  if (t->pending_update)
+  {
+    used = forge_hpack_encode_int(out, cap, 0x20, 5, t->max_size);
+    if (used < 0)
+      return -1;
+    o += (size_t)used;
+    t->pending_update = 0;
+  }
+
+  int exact;
+  size_t index = find_field(t, name, name_len,
+                            mode == FORGE_HPACK_NEVER ? NULL : value,
+                            value_len, &exact);
+
+  if (exact)
+  {
+    used = forge_hpack_encode_int(out + o, cap - o, 0x80, 7, index);
+    return used < 0 ? -1 : (long)o + used;
+  }
+
+  if (mode == FORGE_HPACK_INDEX)
+    used = forge_hpack_encode_int(out + o, cap - o, 0x40, 6, index);
+  else
+    used = forge_hpack_encode_int(out + o, cap - o,
+                                  mode == FORGE_HPACK_NEVER ? 0x10 : 0x00,
+                                  4, index);
+  if (used < 0)
+    return -1;
+  o += (size_t)used;
+
+  if (!index)
+  {
+    used = write_string(out + o, cap - o, name, name_len);
+    if (used < 0)
+      return -1;
+    o += (size_t)used;
+  }
+
+  used = write_string(out + o, cap - o, value, value_len);
+  if (used < 0)
+    return -1;
+  o += (size_t)used;
+
+  if (mode == FORGE_HPACK_INDEX &&
+      table_add(t, name, name_len, value, value_len) != 0)
+    return -1;
+
+  return (long)o;
+}
@@ -1,15 +1,601 @@
+#define _GNU_SOURCE
 #include "forge_http.h"
+#include "forge_internal.h"
+#include "forge_pool.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #ifdef _WIN32
 #include <winsock2.h>
 #else
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+/* =========================================================
+   Header Helpers
+   ========================================================= */
+
+static int name_equals(const char *a, size_t a_len, const char *b)
+{
+  size_t i = 0;
+  for (; i < a_len && b[i]; i++)
+  {
+    if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i]))
+      return 0;
+  }
+  return i == a_len && b[i] == '\0';
+}
+
+/* =========================================================
+   Known Headers
+   ========================================================= */
+
+static const char *const header_names[FORGE_HDR_COUNT] = {
+    [FORGE_HDR_ACCEPT] = "accept",
+    [FORGE_HDR_ACCEPT_CHARSET] = "accept-charset",
+    [FORGE_HDR_ACCEPT_ENCODING] = "accept-encoding",
+    [FORGE_HDR_ACCEPT_LANGUAGE] = "accept-language",
+    [FORGE_HDR_ACCESS_CONTROL_REQUEST_HEADERS] = "access-control-request-headers",
+    [FORGE_HDR_ACCESS_CONTROL_REQUEST_METHOD] = "access-control-request-method",
+    [FORGE_HDR_AUTHORIZATION] = "authorization",
+    [FORGE_HDR_CACHE_CONTROL] = "cache-control",
+    [FORGE_HDR_CONNECTION] = "connection",
+    [FORGE_HDR_CONTENT_ENCODING] = "content-encoding",
+    [FORGE_HDR_CONTENT_LENGTH] = "content-length",
+    [FORGE_HDR_CONTENT_TYPE] = "content-type",
+    [FORGE_HDR_COOKIE] = "cookie",
+    [FORGE_HDR_DATE] = "date",
+    [FORGE_HDR_EXPECT] = "expect",
+    [FORGE_HDR_FORWARDED] = "forwarded",
+    [FORGE_HDR_FROM] = "from",
+    [FORGE_HDR_HOST] = "host",
+    [FORGE_HDR_HTTP2_SETTINGS] = "http2-settings",
+    [FORGE_HDR_IF_MATCH] = "if-match",
+    [FORGE_HDR_IF_MODIFIED_SINCE] = "if-modified-since",
+    [FORGE_HDR_IF_NONE_MATCH] = "if-none-match",
+    [FORGE_HDR_IF_RANGE] = "if-range",
+    [FORGE_HDR_IF_UNMODIFIED_SINCE] = "if-unmodified-since",
+    [FORGE_HDR_KEEP_ALIVE] = "keep-alive",
+    [FORGE_HDR_ORIGIN] = "origin",
+    [FORGE_HDR_PRAGMA] = "pragma",
+    [FORGE_HDR_PROXY_AUTHORIZATION] = "proxy-authorization",
+    [FORGE_HDR_RANGE] = "range",
+    [FORGE_HDR_REFERER] = "referer",
+    [FORGE_HDR_SEC_WEBSOCKET_EXTENSIONS] = "sec-websocket-extensions",
+    [FORGE_HDR_SEC_WEBSOCKET_KEY] = "sec-websocket-key",
+    [FORGE_HDR_SEC_WEBSOCKET_PROTOCOL] = "sec-websocket-protocol",
+    [FORGE_HDR_SEC_WEBSOCKET_VERSION] = "sec-websocket-version",
+    [FORGE_HDR_TE] = "te",
+    [FORGE_HDR_TRAILER] = "trailer",
+    [FORGE_HDR_TRANSFER_ENCODING] = "transfer-encoding",
+    [FORGE_HDR_UPGRADE] = "upgrade",
+    [FORGE_HDR_USER_AGENT] = "user-agent",
+    [FORGE_HDR_VIA] = "via",
+    [FORGE_HDR_X_FORWARDED_FOR] = "x-forwarded-for",
+    [FORGE_HDR_X_FORWARDED_HOST] = "x-forwarded-host",
+    [FORGE_HDR_X_FORWARDED_PROTO] = "x-forwarded-proto",
+    [FORGE_HDR_X_REQUEST_ID] = "x-request-id",
+};
+
+/*
+ * Perfect hash of the names above: length, first, middle and last
+ * character (lowercased) put each one in a slot of its own, so a
+ * name is classified with one table load and one compare. Slots hold
+ * id + 1. The multipliers were searched for; a name added to the
+ * list needs a slot here, and the known_header_ids test fails until
+ * it has one that is not taken.
+ */
+#define HEADER_SLOTS 128
+
+static const unsigned char header_slots[HEADER_SLOTS] = {
+    [1] = FORGE_HDR_FROM + 1,
+    [6] = FORGE_HDR_TRAILER + 1,
+    [8] = FORGE_HDR_IF_MATCH + 1,
+    [9] = FORGE_HDR_SEC_WEBSOCKET_VERSION + 1,
+    [13] = FORGE_HDR_PRAGMA + 1,
+    [17] = FORGE_HDR_ACCESS_CONTROL_REQUEST_METHOD + 1,
+    [23] = FORGE_HDR_TE + 1,
+    [28] = FORGE_HDR_CONTENT_LENGTH + 1,
+    [29] = FORGE_HDR_ACCEPT_ENCODING + 1,
+    [30] = FORGE_HDR_VIA + 1,
+    [31] = FORGE_HDR_X_REQUEST_ID + 1,
+    [32] = FORGE_HDR_CONTENT_ENCODING + 1,
+    [36] = FORGE_HDR_IF_UNMODIFIED_SINCE + 1,
+    [41] = FORGE_HDR_IF_NONE_MATCH + 1,
+    [42] = FORGE_HDR_TRANSFER_ENCODING + 1,
+    [45] = FORGE_HDR_CACHE_CONTROL + 1,
+    [52] = FORGE_HDR_COOKIE + 1,
+    [54] = FORGE_HDR_CONNECTION + 1,
+    [55] = FORGE_HDR_IF_MODIFIED_SINCE + 1,
+    [66] = FORGE_HDR_ACCEPT_LANGUAGE + 1,
+    [73] = FORGE_HDR_HOST + 1,
+    [79] = FORGE_HDR_ACCESS_CONTROL_REQUEST_HEADERS + 1,
+    [81] = FORGE_HDR_X_FORWARDED_FOR + 1,
+    [84] = FORGE_HDR_SEC_WEBSOCKET_PROTOCOL + 1,
+    [87] = FORGE_HDR_RANGE + 1,
+    [90] = FORGE_HDR_ORIGIN + 1,
+    [92] = FORGE_HDR_ACCEPT_CHARSET + 1,
+    [94] = FORGE_HDR_USER_AGENT + 1,
+    [95] = FORGE_HDR_X_FORWARDED_PROTO + 1,
+    [97] = FORGE_HDR_AUTHORIZATION + 1,
+    [98] = FORGE_HDR_ACCEPT + 1,
+    [99] = FORGE_HDR_SEC_WEBSOCKET_KEY + 1,
+    [102] = FORGE_HDR_EXPECT + 1,
+    [104] = FORGE_HDR_REFERER + 1,
+    [105] = FORGE_HDR_SEC_WEBSOCKET_EXTENSIONS + 1,
+    [107] = FORGE_HDR_HTTP2_SETTINGS + 1,
+    [110] = FORGE_HDR_FORWARDED + 1,
+    [111] = FORGE_HDR_PROXY_AUTHORIZATION + 1,
+    [114] = FORGE_HDR_DATE + 1,
+    [118] = FORGE_HDR_IF_RANGE + 1,
+    [120] = FORGE_HDR_UPGRADE + 1,
+    [121] = FORGE_HDR_CONTENT_TYPE + 1,
+    [122] = FORGE_HDR_KEEP_ALIVE + 1,
+    [124] = FORGE_HDR_X_FORWARDED_HOST + 1,
+};
+
+static unsigned header_fold(char c)
+{
+  return (unsigned char)(c >= 'A' && c <= 'Z' ? c + 32 : c);
+}
+
+int forge_header_id(const char *name, size_t len)
+{
+  if (!name || len == 0)
+    return -1;
+
+  unsigned slot = ((unsigned)len + header_fold(name[0]) + 6 * header_fold(name[len - 1]) +
+                   7 * header_fold(name[len / 2])) &
+                  (HEADER_SLOTS - 1);
+  int id = header_slots[slot] - 1;
+  if (id < 0 || !name_equals(name, len, header_names[id]))
+    return -1;
+  return id;
+}
+
+const char *forge_header_name(ForgeHeaderId id)
+{
+  return (unsigned)id < FORGE_HDR_COUNT ? header_names[id] : NULL;
+}
+
+const ForgeHttpHeader *forge_header_get(const ForgeHttpRequest *req,
+                                        ForgeHeaderId id)
+{
+  if (!req || (unsigned)id >= FORGE_HDR_COUNT || !req->header_index[id])
+    return NULL;
+  return &req->headers[req->header_index[id] - 1];
+}
+
+int forge_http_index_header(ForgeHttpRequest *req, int i)
+{
+  const ForgeHttpHeader *h = &req->headers[i];
+  int id = forge_header_id(h->name, h->name_len);
+
+  /* Repeated headers: the first one is indexed */
+  if (id >= 0 && !req->header_index[id])
+    req->header_index[id] = (unsigned char)(i + 1);
+  return id;
+}
+
+/* =========================================================
+   Header Fields
+   ========================================================= */
+
+long long forge_http_parse_length(const char *v, size_t len)
+{
+  if (len == 0 || len > 18)
+    return -1;
+
+  long long n = 0;
+  for (size_t i = 0; i < len; i++)
+  {
+    if (v[i] < '0' || v[i] > '9')
+      return -1;
+    n = n * 10 + (v[i] - '0');
+  }
+  return n;
+}
+
+/*
+ * Transfer-Encoding: the comma-separated codings must be exactly
+ * one "chunked". 0, -1 (malformed), or FORGE_PARSE_UNSUPPORTED.
+ */
+static int parse_transfer_coding(const char *v, size_t len, ForgeHttpRequest *req)
+{
+  const char *end = v + len;
+
+  while (v < end)
+  {
+    const char *comma = memchr(v, ',', (size_t)(end - v));
+    const char *tok_end = comma ? comma : end;
+    while (v < tok_end && (*v == ' ' || *v == '\t'))
+      v++;
+    const char *t = tok_end;
+    while (t > v && (t[-1] == ' ' || t[-1] == '\t'))
+      t--;
+
+    /* Empty list elements are allowed and skipped */
+    if (t > v)
+    {
+      if (!name_equals(v, (size_t)(t - v), "chunked"))
+        return FORGE_PARSE_UNSUPPORTED;
+      if (req->chunked)
+        return -1;
+      req->chunked = 1;
+    }
+    v = comma ? comma + 1 : end;
+  }
+
+  return req->chunked ? 0 : -1;
+}
+
+/* Parse header lines starting at `p` up to the blank line */
+static int parse_headers(const char *p, ForgeHttpRequest *req)
+{
+  while (*p && !(p[0] == '\r' && p[1] == '\n'))
+  {
+    const char *eol = strstr(p, "\r\n");
+    if (!eol)
+      return -1;
+
+    const char *colon = memchr(p, ':', (size_t)(eol - p));
+    if (!colon || colon == p)
+      return -1;
+
+    /* No whitespace inside names (also rejects obs-fold) */
+    for (const char *q = p; q < colon; q++)
+    {
+      if (*q == ' ' || *q == '\t')
+        return -1;
+    }
+
+    const char *v = colon + 1;
+    const char *v_end = eol;
+    while (v < v_end && (*v == ' ' || *v == '\t'))
+      v++;
+    while (v_end > v && (v_end[-1] == ' ' || v_end[-1] == '\t'))
+      v_end--;
+
+    if (req->header_count == FORGE_MAX_HEADERS)
+      return -1;
+
+    ForgeHttpHeader *h = &req->headers[req->header_count++];
+    h->name = p;
+    h->name_len = (size_t)(colon - p);
+    h->value = v;
+    h->value_len = (size_t)(v_end - v);
+
+    int id = forge_http_index_header(req, req->header_count - 1);
+    if (id == FORGE_HDR_CONTENT_LENGTH)
+    {
+      long long n = forge_http_parse_length(h->value, h->value_len);
+      if (n < 0 || (req->content_length >= 0 && req->content_length != n))
+        return -1;
+      req->content_length = n;
+    }
+    else if (id == FORGE_HDR_TRANSFER_ENCODING)
+    {
+      /* No gzip, deflate, ...: the body could not be decoded */
+      int rc = parse_transfer_coding(h->value, h->value_len, req);
+      if (rc != 0)
+        return rc;
+    }
+    else if (id == FORGE_HDR_EXPECT)
+    {
+      req->expect_continue =
+          name_equals(h->value, h->value_len, "100-continue");
+    }
+
+    p = eol + 2;
+  }
+
+  /* Both framings at once is a smuggling vector */
+  if (req->chunked && req->content_length >= 0)
+    return -1;
+
+  return 0;
+}
+
+const ForgeHttpHeader *forge_http_header(const ForgeHttpRequest *req,
+                                         const char *name)
+{
+  if (!req || !name)
+    return NULL;
+
+  int id = forge_header_id(name, strlen(name));
+  if (id >= 0)
+    return forge_header_get(req, (ForgeHeaderId)id);
+
+  for (int i = 0; i < req->header_count; i++)
+  {
+    const ForgeHttpHeader *h = &req->headers[i];
+    if (name_equals(h->name, h->name_len, name))
+      return h;
+  }
+  return NULL;
+}
+
+int forge_http_has_token(const ForgeHttpHeader *h, const char *token)
+{
+  size_t tlen = strlen(token);
+
+  /* Comma-separated list, tokens compared case-insensitively */
+  for (size_t i = 0; h && i + tlen <= h->value_len; i++)
+  {
+    int start = i == 0 || h->value[i - 1] == ',' || h->value[i - 1] == ' ';
+    int end = i + tlen == h->value_len || h->value[i + tlen] == ',' ||
+              h->value[i + tlen] == ' ';
+    if (start && end && name_equals(h->value + i, tlen, token))
+      return 1;
+  }
+  return 0;
+}
+
+/* =========================================================
+   Request Target
+   ========================================================= */
+
+static int hex_value(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+/*
+ * Length of the prefix of `s` that is already canonical: no '%',
+ * and no '/' followed by '/' or '.'. Most paths are canonical in
+ * full, so this is usually the only pass over them.
+ */
+static size_t plain_run(const char *s, size_t len)
+{
+  size_t i = 0;
+
+#if defined(__AVX2__)
+  const __m256i pct = _mm256_set1_epi8('%');
+  const __m256i slash = _mm256_set1_epi8('/');
+  const __m256i dot = _mm256_set1_epi8('.');
+
+  for (; i + 33 <= len; i += 32)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+    __m256i next = _mm256_loadu_si256((const __m256i *)(s + i + 1));
+    __m256i after = _mm256_or_si256(_mm256_cmpeq_epi8(next, slash),
+                                    _mm256_cmpeq_epi8(next, dot));
+    __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, pct),
+                                  _mm256_and_si256(_mm256_cmpeq_epi8(v, slash), after));
+    unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+    if (mask)
+      return i + (size_t)__builtin_ctz(mask);
+  }
+#elif defined(__SSE2__)
+  const __m128i pct = _mm_set1_epi8('%');
+  const __m128i slash = _mm_set1_epi8('/');
+  const __m128i dot = _mm_set1_epi8('.');
+
+  for (; i + 17 <= len; i += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    __m128i next = _mm_loadu_si128((const __m128i *)(s + i + 1));
+    __m128i after = _mm_or_si128(_mm_cmpeq_epi8(next, slash),
+                                 _mm_cmpeq_epi8(next, dot));
+    __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, pct),
+                               _mm_and_si128(_mm_cmpeq_epi8(v, slash), after));
+    unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+    if (mask)
+      return i + (size_t)__builtin_ctz(mask);
+  }
 #endif
 
+  for (; i < len; i++)
+  {
+    if (s[i] == '%' ||
+        (s[i] == '/' && i + 1 < len && (s[i + 1] == '/' || s[i + 1] == '.')))
+      return i;
+  }
+  return len;
+}
+
+/*
+ * The segment ending at out[o] is complete: drop it if it is "."
+ * and drop it with its parent if it is "..". Returns the new end.
+ */
+static size_t close_segment(const char *out, size_t o)
+{
+  size_t seg = o;
+  while (seg > 0 && out[seg - 1] != '/')
+    seg--;
+
+  size_t n = o - seg;
+  if (n == 1 && out[seg] == '.')
+    return seg;
+  if (n == 2 && out[seg] == '.' && out[seg + 1] == '.')
+  {
+    if (seg <= 1)
+      return seg; /* "/.." stays at the root */
+    seg--;
+    while (seg > 0 && out[seg - 1] != '/')
+      seg--;
+    return seg;
+  }
+  return o;
+}
+
+/*
+ * Decode and normalize `in` (starting with '/') into `out`, which
+ * has room for `len` + 1 bytes. Canonical runs are copied whole; the
+ * byte loop only runs from an escape or a '/' that needs work up to
+ * the end of that segment. Returns the length, or -1 on a bad escape.
+ */
+static long normalize_path(const char *in, size_t len, char *out)
+{
+  size_t i = 0;
+  size_t o = 0;
+
+  while (i < len)
+  {
+    size_t n = plain_run(in + i, len - i);
+    memcpy(out + o, in + i, n);
+    i += n;
+    o += n;
+
+    while (i < len)
+    {
+      char c = in[i];
+      if (c == '%')
+      {
+        int hi = i + 2 < len ? hex_value(in[i + 1]) : -1;
+        int lo = i + 2 < len ? hex_value(in[i + 2]) : -1;
+        if (hi < 0 || lo < 0 || (hi == 0 && lo == 0))
+          return -1;
+        c = (char)(hi << 4 | lo);
+        i += 3;
+      }
+      else
+      {
+        i++;
+      }
+
+      if (c != '/')
+      {
+        out[o++] = c;
+        continue;
+      }
+
+      o = close_segment(out, o);
+      if (o == 0 || out[o - 1] != '/')
+        out[o++] = '/';
+
+      /* A segment starting with '.' or '/' is decided here too */
+      if (i < len && (in[i] == '.' || in[i] == '/'))
+        continue;
+      break; /* back to the fast scan */
+    }
+  }
+
+  o = close_segment(out, o);
+  out[o] = '\0';
+  return (long)o;
+}
+
+int forge_http_set_target(ForgeHttpRequest *req, const char *target, size_t len)
+{
+  if (len == 0 || len >= FORGE_MAX_PATH || target[0] != '/')
+    return -1;
+
+  const char *q = memchr(target, '?', len);
+  size_t path_len = q ? (size_t)(q - target) : len;
+  size_t query_len = q ? len - path_len - 1 : 0;
+
+  memcpy(req->query, q ? q + 1 : "", query_len);
+  req->query[query_len] = '\0';
+  req->query_indexed = 0;
+  req->query_count = 0;
+
+  return normalize_path(target, path_len, req->path) < 0 ? -1 : 0;
+}
+
+/* Decode one query component ('+' is a space; bad escapes stay) */
+static size_t decode_component(const char *in, size_t len, char *out)
+{
+  size_t o = 0;
+  for (size_t i = 0; i < len; i++)
+  {
+    int hi, lo;
+    if (in[i] == '+')
+      out[o++] = ' ';
+    else if (in[i] == '%' && i + 2 < len &&
+             (hi = hex_value(in[i + 1])) >= 0 &&
+             (lo = hex_value(in[i + 2])) >= 0)
+    {
+      out[o++] = (char)(hi << 4 | lo);
+      i += 2;
+    }
+    else
+      out[o++] = in[i];
+  }
+  out[o] = '\0';
+  return o;
+}
+
+/* Split the raw query into NUL-terminated decoded keys and values */
+static void index_query(ForgeHttpRequest *req)
+{
+  const char *p = req->query;
+  size_t o = 0;
+
+  req->query_indexed = 1;
+  req->query_count = 0;
+
+  while (*p && req->query_count < FORGE_MAX_QUERY)
+  {
+    const char *end = strchr(p, '&');
+    if (!end)
+      end = p + strlen(p);
+
+    if (end > p)
+    {
+      const char *eq = memchr(p, '=', (size_t)(end - p));
+      const char *key_end = eq ? eq : end;
+
+      ForgeQueryParam *param = &req->query_params[req->query_count++];
+      param->key = (unsigned short)o;
+      param->key_len = (unsigned short)decode_component(p, (size_t)(key_end - p),
+                                                        req->query_buf + o);
+      o += param->key_len + 1;
+
+      param->value = 0;
+      if (eq)
+      {
+        param->value = (unsigned short)o;
+        o += decode_component(eq + 1, (size_t)(end - eq - 1), req->query_buf + o) + 1;
+      }
+    }
+
+    p = *end ? end + 1 : end;
+  }
+}
+
+const char *forge_query_get(const ForgeHttpRequest *req, const char *key)
+{
+  if (!req || !key)
+    return NULL;
+
+  /* The index is a cache; requests are only const towards handlers */
+  ForgeHttpRequest *r = (ForgeHttpRequest *)req;
+  if (!r->query_indexed)
+    index_query(r);
+
+  size_t key_len = strlen(key);
+  for (int i = 0; i < r->query_count; i++)
+  {
+    const ForgeQueryParam *param = &r->query_params[i];
+    if (param->key_len == key_len &&
+        memcmp(r->query_buf + param->key, key, key_len) == 0)
+      return param->value ? r->query_buf + param->value : "";
+  }
+  return NULL;
+}
+
 /* =========================================================
    HTTP Request Parser
    ========================================================= */
@@ -46,9 +632,6 @@ int forge_parse_http_request(const char *raw, ForgeHttpRequest *req)
   memcpy(req->method, raw, method_len);
   req->method[method_len] = '\0';
 
-  memcpy(req->path, sp1 + 1, path_len);
-  req->path[path_len] = '\0';
-
   memcpy(req->version, sp2 + 1, ver_len);
   req->version[ver_len] = '\0';
 
@@ -60,7 +643,7 @@ int forge_parse_http_request(const char *raw, ForgeHttpRequest *req)
   }
 
   /* Origin-form only */
-  if (req->path[0] != '/')
+  if (forge_http_set_target(req, sp1 + 1, path_len) != 0)
     return -1;
 
   /* HTTP version */
@@ -68,57 +651,1173 @@ int forge_parse_http_request(const char *raw, ForgeHttpRequest *req)
       strcmp(req->version, "HTTP/1.0") != 0)
     return -1;
 
-  return 0;
+  req->header_count = 0;
+  memset(req->header_index, 0, sizeof(req->header_index));
+  req->content_length = -1;
+  req->chunked = 0;
+  req->expect_continue = 0;
+
+  return parse_headers(line_end + 2, req);
 }
 
 /* =========================================================
-   HTTP Response Helpers
+   Connection Input
    ========================================================= */
 
-void forge_send_text(int client_socket,
-                     const char *status,
-                     const char *body)
+static const size_t conn_tiers[] = {512, 4096, 65536};
+
+#define CONN_TIERS ((int)(sizeof(conn_tiers) / sizeof(conn_tiers[0])))
+
+/*
+ * Room a parsed head should leave for chunk-size and trailer lines,
+ * which are read behind it once the buffer can no longer move
+ */
+#define CONN_BODY_SLACK 128
+
+void forge_conn_init(ForgeConn *c, int fd, char *buf, size_t cap)
+{
+  memset(c, 0, sizeof(*c));
+  c->fd = fd;
+  c->buf = buf;
+  c->cap = cap;
+  c->tier = buf ? -1 : 0;
+  c->spool_fd = -1;
+}
+
+/* A tiered connection coming out of idle gets its smallest buffer */
+static int conn_reserve(ForgeConn *c)
+{
+  if (c->buf)
+    return 0;
+  if (c->tier < 0)
+    return -1;
+
+  c->buf = forge_pool_alloc(conn_tiers[0]);
+  if (!c->buf)
+    return -1;
+  c->cap = conn_tiers[0];
+  c->tier = 0;
+  return 0;
+}
+
+/* Move up to tier `tier`; nothing may point into the buffer */
+static int conn_promote_to(ForgeConn *c, int tier)
+{
+  if (c->tier < 0 || tier >= CONN_TIERS || tier <= c->tier)
+    return -1;
+
+  char *grown = forge_pool_alloc(conn_tiers[tier]);
+  if (!grown)
+    return -1;
+
+  memcpy(grown, c->buf, c->len);
+  forge_pool_free(c->buf);
+  c->buf = grown;
+  c->tier = tier;
+  c->cap = conn_tiers[tier];
+  return 0;
+}
+
+/* Move to the next tier before a head is parsed */
+static int conn_promote(ForgeConn *c)
+{
+  if (c->body_base > 0)
+    return -1;
+  return conn_promote_to(c, c->tier + 1);
+}
+
+void forge_conn_release(ForgeConn *c)
+{
+  if (c->tier < 0 || !c->buf || c->pos != c->len || c->body_base > 0)
+    return;
+
+  /* The smallest tier is kept for the next keep-alive request */
+  c->len = 0;
+  c->pos = 0;
+  if (c->tier == 0)
+    return;
+
+  forge_pool_free(c->buf);
+  c->buf = NULL;
+  c->cap = 0;
+  c->len = 0;
+  c->pos = 0;
+  c->tier = 0;
+}
+
+void forge_conn_free(ForgeConn *c)
 {
-  char resp[512];
+  forge_conn_spool_close(c);
+  if (c->tier < 0)
+    return;
 
-  snprintf(resp, sizeof(resp),
-           "HTTP/1.1 %s\r\n"
-           "Content-Type: text/plain; charset=utf-8\r\n"
-           "Content-Length: %zu\r\n"
-           "Connection: close\r\n"
-           "\r\n"
-           "%s",
-           status,
-           strlen(body),
-           body);
+  forge_pool_free(c->buf);
+  c->buf = NULL;
+  c->cap = 0;
+}
 
+/* Socket read; FORGE_CONN_AGAIN when a nonblocking one is drained */
+static long sock_recv(ForgeConn *c, void *dst, size_t cap, int flags)
+{
 #ifdef _WIN32
-  send(client_socket, resp, (int)strlen(resp), 0);
+  return recv(c->fd, dst, (int)cap, flags);
 #else
-  write(client_socket, resp, strlen(resp));
+  ssize_t n;
+  if (c->nonblocking)
+    flags |= MSG_DONTWAIT;
+  do
+  {
+    n = recv(c->fd, dst, cap, flags);
+  } while (n < 0 && errno == EINTR);
+
+  if (n < 0 && c->nonblocking && (errno == EAGAIN || errno == EWOULDBLOCK))
+    return FORGE_CONN_AGAIN;
+  return (long)n;
 #endif
 }
 
-void forge_send_json(int client_socket,
-                     const char *status,
-                     const char *body)
+/* Next body or head bytes: the spool first, then the socket */
+static long conn_recv(ForgeConn *c, void *dst, size_t cap)
+{
+#ifndef _WIN32
+  while (c->spool_fd >= 0)
+  {
+    ssize_t n = read(c->spool_fd, dst, cap);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n != 0)
+      return (long)n;
+    forge_conn_spool_close(c);
+  }
+#endif
+  return sock_recv(c, dst, cap, 0);
+}
+
+long forge_conn_fill(ForgeConn *c)
 {
-  char resp[512];
+  if (conn_reserve(c) != 0)
+    return -1;
+  if (c->len + 1 >= c->cap && conn_promote(c) != 0)
+    return -1;
+
+  long n = conn_recv(c, c->buf + c->len, c->cap - 1 - c->len);
+  if (n > 0)
+    c->len += (size_t)n;
+  return n;
+}
 
-  snprintf(resp, sizeof(resp),
-           "HTTP/1.1 %s\r\n"
-           "Content-Type: application/json; charset=utf-8\r\n"
-           "Content-Length: %zu\r\n"
-           "Connection: close\r\n"
-           "\r\n"
-           "%s",
-           status,
-           strlen(body),
-           body);
+int forge_conn_write_all(int fd, const void *data, size_t len)
+{
+  const char *p = data;
 
+  while (len > 0)
+  {
 #ifdef _WIN32
-  send(client_socket, resp, (int)strlen(resp), 0);
+    int n = send(fd, p, (int)len, 0);
 #else
-  write(client_socket, resp, strlen(resp));
+    ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == ENOTSOCK)
+      n = write(fd, p, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+#endif
+    if (n <= 0)
+      return -1;
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+#ifndef _WIN32
+long forge_conn_writev(int fd, const struct iovec *iov, int n)
+{
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = (struct iovec *)iov;
+  msg.msg_iovlen = (size_t)n;
+
+  for (;;)
+  {
+    ssize_t sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if (sent < 0 && errno == ENOTSOCK)
+      sent = writev(fd, iov, n);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    return (long)sent;
+  }
+}
 #endif
+
+long forge_conn_read_head(ForgeConn *c)
+{
+  size_t scanned = 0;
+
+  if (conn_reserve(c) != 0)
+    return -1;
+
+  while (1)
+  {
+    if (c->len > 0)
+    {
+      c->buf[c->len] = '\0';
+      char *end = strstr(c->buf + scanned, "\r\n\r\n");
+      if (end)
+      {
+        long head_len = (long)(end + 4 - c->buf);
+
+        /* Last chance to move: the head is parsed in place next */
+        if (c->cap - (size_t)head_len < CONN_BODY_SLACK)
+          conn_promote(c);
+        return head_len;
+      }
+      scanned = c->len > 3 ? c->len - 3 : 0;
+    }
+
+    /* Head must fit, leaving room for the terminator */
+    if (c->len + 1 >= c->cap && conn_promote(c) != 0)
+      return -1;
+
+    long n = conn_recv(c, c->buf + c->len, c->cap - 1 - c->len);
+    if (n == FORGE_CONN_AGAIN)
+      return n;
+    if (n <= 0)
+      return (n == 0 && c->len == 0) ? 0 : -1;
+    c->len += (size_t)n;
+  }
+}
+
+void forge_conn_begin_body(ForgeConn *c,
+                           const ForgeHttpRequest *req,
+                           size_t max_body)
+{
+  c->max_body = max_body ? max_body : FORGE_DEFAULT_MAX_BODY;
+  c->body_base = c->pos;
+  c->body_read = 0;
+  c->remaining = 0;
+  c->chunk_crlf = 0;
+  c->expect_continue = req->expect_continue;
+  c->continue_sent = 0;
+  c->body_error = 0;
+  c->body_armed = 1;
+  c->staged = 0;
+
+  if (req->chunked)
+  {
+    c->body_mode = FORGE_BODY_CHUNKED;
+  }
+  else if (req->content_length > 0)
+  {
+    c->body_mode = FORGE_BODY_LENGTH;
+    c->remaining = (unsigned long long)req->content_length;
+    if (c->remaining > c->max_body)
+      c->body_error = FORGE_BODY_TOO_LARGE;
+  }
+  else
+  {
+    c->body_mode = FORGE_BODY_NONE;
+  }
+}
+
+/* Unread body bytes worth draining to keep a connection alive */
+#define DRAIN_LIMIT (64 * 1024)
+
+int forge_conn_finish_body(ForgeConn *c)
+{
+  int pending = c->body_mode == FORGE_BODY_LENGTH ||
+                c->body_mode == FORGE_BODY_CHUNKED;
+
+  /* A body nobody asked for (no 100 Continue sent) is never coming */
+  if (c->body_error || (pending && c->expect_continue && !c->continue_sent))
+    return -1;
+
+  size_t drained = 0;
+  while (c->body_mode == FORGE_BODY_LENGTH || c->body_mode == FORGE_BODY_CHUNKED)
+  {
+    char sink[4096];
+    ForgeHttpRequest req;
+    req.conn = c;
+
+    /* A staged body is local: skipping it costs no network wait */
+    long n = forge_body_read(&req, sink, sizeof(sink));
+    if (n < 0 || (!c->staged && (drained += (size_t)n) > DRAIN_LIMIT))
+      return -1;
+    if (n == 0)
+      break;
+  }
+  return 0;
+}
+
+void forge_conn_next_request(ForgeConn *c)
+{
+  size_t left = c->len - c->pos;
+  if (left > 0)
+    memmove(c->buf, c->buf + c->pos, left);
+
+  c->len = left;
+  c->pos = 0;
+  c->body_base = 0;
+  c->body_mode = FORGE_BODY_NONE;
+  c->body_armed = 0;
+  c->staging = 0;
+  c->staged = 0;
+  forge_conn_spool_close(c);
+}
+
+/* =========================================================
+   Body Staging
+   ========================================================= */
+
+enum
+{
+  SCAN_SIZE = 0, /* chunk-size line, extensions included */
+  SCAN_DATA,
+  SCAN_DATA_CR,  /* line ending owed after chunk data */
+  SCAN_DATA_LF,
+  SCAN_TRAILER,  /* trailer section line */
+  SCAN_DONE
+};
+
+/* Longest chunk-size or trailer line accepted while staging */
+#define SCAN_LINE_MAX 1024
+
+/* Bytes staged from the socket per read */
+#define STAGE_CHUNK (16 * 1024)
+
+/* Staging step results: the chunked framing is broken, the spool budget spent */
+#define STAGE_BAD_FRAMING (-3)
+#define STAGE_NO_SPOOL (-4)
+
+int forge_spool_open(void)
+{
+#ifdef _WIN32
+  return -1;
+#else
+  const char *dir = getenv("TMPDIR");
+  if (!dir || !*dir)
+    dir = "/tmp";
+
+  int fd = -1;
+#ifdef O_TMPFILE
+  fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+#endif
+  if (fd < 0)
+  {
+    char path[256];
+    if (snprintf(path, sizeof(path), "%s/forge-body-XXXXXX", dir) >= (int)sizeof(path))
+      return -1;
+    fd = mkstemp(path);
+    if (fd >= 0)
+      unlink(path);
+  }
+  return fd;
+#endif
+}
+
+/* Spooled bytes of every connection; forge_spool_budget is in forge_server.c */
+static _Atomic unsigned long long spool_used;
+
+int forge_spool_claim(size_t n)
+{
+  unsigned long long used = atomic_fetch_add_explicit(&spool_used, n,
+                                                      memory_order_relaxed);
+  if (forge_spool_budget && used + n > forge_spool_budget)
+  {
+    atomic_fetch_sub_explicit(&spool_used, n, memory_order_relaxed);
+    return -1;
+  }
+  return 0;
+}
+
+void forge_spool_release(unsigned long long n)
+{
+  atomic_fetch_sub_explicit(&spool_used, n, memory_order_relaxed);
+}
+
+void forge_conn_spool_close(ForgeConn *c)
+{
+#ifndef _WIN32
+  if (c->spool_fd >= 0)
+    close(c->spool_fd);
+#endif
+  c->spool_fd = -1;
+  forge_spool_release(c->spool_claimed);
+  c->spool_claimed = 0;
+}
+
+/*
+ * Advance the chunked-body scanner over wire bytes. Returns how
+ * many of the `n` bytes belong to the body (all of them until the
+ * last trailer line ends), or -1 on a framing error.
+ */
+static long chunk_scan(ForgeConn *c, const char *p, size_t n)
+{
+  size_t i = 0;
+
+  while (i < n && c->scan_state != SCAN_DONE)
+  {
+    char ch = p[i];
+
+    switch (c->scan_state)
+    {
+    case SCAN_SIZE:
+      i++;
+      if (ch == '\n')
+      {
+        if (c->scan_lines == 0)
+          return -1;
+        c->scan_line = 0;
+        c->scan_lines = 0;
+        if (c->scan_size == 0)
+        {
+          c->scan_state = SCAN_TRAILER;
+          break;
+        }
+        if (c->scan_total + c->scan_size > c->max_body)
+        {
+          c->body_error = FORGE_BODY_TOO_LARGE;
+          return -1;
+        }
+        c->scan_total += c->scan_size;
+        c->scan_state = SCAN_DATA;
+        break;
+      }
+
+      /* Leading hex digits (scan_lines counts them); chunk_next() checks the rest */
+      if (c->scan_line == (size_t)c->scan_lines && isxdigit((unsigned char)ch))
+      {
+        if (c->scan_lines++ == 15)
+          return -1;
+        int d = isdigit((unsigned char)ch) ? ch - '0' : tolower((unsigned char)ch) - 'a' + 10;
+        c->scan_size = (c->scan_size << 4) | (unsigned)d;
+      }
+      if (++c->scan_line > SCAN_LINE_MAX)
+        return -1;
+      break;
+
+    case SCAN_DATA:
+    {
+      size_t take = n - i;
+      if (take > c->scan_size)
+        take = (size_t)c->scan_size;
+      i += take;
+      c->scan_size -= take;
+      if (c->scan_size == 0)
+        c->scan_state = SCAN_DATA_CR;
+      break;
+    }
+
+    case SCAN_DATA_CR:
+    case SCAN_DATA_LF:
+      i++;
+      if (ch == '\r' && c->scan_state == SCAN_DATA_CR)
+        c->scan_state = SCAN_DATA_LF;
+      else if (ch == '\n')
+        c->scan_state = SCAN_SIZE;
+      else
+        return -1;
+      break;
+
+    case SCAN_TRAILER:
+      i++;
+      if (ch == '\n')
+      {
+        if (c->scan_line == 0)
+        {
+          c->scan_state = SCAN_DONE;
+          break;
+        }
+        c->scan_line = 0;
+        if (++c->scan_lines > FORGE_MAX_HEADERS)
+          return -1;
+      }
+      else if (ch != '\r' || c->scan_line > 0)
+      {
+        if (++c->scan_line > SCAN_LINE_MAX)
+          return -1;
+      }
+      break;
+    }
+  }
+  return (long)i;
+}
+
+static int stage_complete(const ForgeConn *c)
+{
+  return c->body_mode == FORGE_BODY_LENGTH ? c->stage_left == 0
+                                           : c->scan_state == SCAN_DONE;
+}
+
+/* A body the handler cannot use: it gets body_error instead */
+static int stage_fail(ForgeConn *c, int error)
+{
+  if (!c->body_error)
+    c->body_error = error;
+  c->staging = 0;
+  forge_conn_spool_close(c);
+  return 0;
+}
+
+#ifndef _WIN32
+/*
+ * One read into the buffer, growing it or switching to the spool
+ * (returning 0) when it is full. EOF mid-body is -1.
+ */
+static long stage_to_buffer(ForgeConn *c)
+{
+  if (c->len + 1 >= c->cap && conn_promote_to(c, c->tier + 1) != 0)
+  {
+    if ((c->spool_fd = forge_spool_open()) < 0)
+      return -1;
+    return 0;
+  }
+
+  size_t old_len = c->len;
+  long n = sock_recv(c, c->buf + c->len, c->cap - 1 - c->len, 0);
+  if (n <= 0)
+    return n == 0 ? -1 : n;
+  c->len += (size_t)n;
+
+  if (c->body_mode == FORGE_BODY_LENGTH)
+  {
+    c->stage_left -= (size_t)n < c->stage_left ? (unsigned long long)n : c->stage_left;
+    return n;
+  }
+  /* Bytes past the last chunk stay buffered as the next request */
+  return chunk_scan(c, c->buf + old_len, (size_t)n) < 0 ? STAGE_BAD_FRAMING : n;
+}
+
+/* One read straight into the spool, never past the body's end */
+static long stage_to_spool(ForgeConn *c)
+{
+  char scratch[STAGE_CHUNK];
+  long n;
+
+  if (c->body_mode == FORGE_BODY_LENGTH)
+  {
+    size_t want = c->stage_left < sizeof(scratch) ? (size_t)c->stage_left : sizeof(scratch);
+    n = sock_recv(c, scratch, want, 0);
+    if (n <= 0)
+      return n == 0 ? -1 : n;
+    c->stage_left -= (unsigned long long)n;
+  }
+  else
+  {
+    /* Peek, then take only what the scanner claims for the body */
+    n = sock_recv(c, scratch, sizeof(scratch), MSG_PEEK);
+    if (n <= 0)
+      return n == 0 ? -1 : n;
+    long used = chunk_scan(c, scratch, (size_t)n);
+    if (used < 0)
+      return STAGE_BAD_FRAMING;
+    if (sock_recv(c, scratch, (size_t)used, 0) != used)
+      return -1;
+    n = used;
+  }
+
+  /* Read, not yet written: the bytes are gone either way */
+  if (forge_spool_claim((size_t)n) != 0)
+    return STAGE_NO_SPOOL;
+  c->spool_claimed += (unsigned long long)n;
+
+  if (forge_conn_write_all(c->spool_fd, scratch, (size_t)n) != 0)
+    return -1;
+  return n;
+}
+#endif
+
+int forge_conn_stage_body(ForgeConn *c)
+{
+#ifdef _WIN32
+  /* No spool here: handlers stream the body from the socket */
+  (void)stage_complete;
+  (void)stage_fail;
+  (void)chunk_scan;
+  return 0;
+#else
+  if (c->body_error || c->body_mode == FORGE_BODY_NONE ||
+      c->body_mode == FORGE_BODY_DONE)
+    return 0;
+
+  if (!c->staging)
+  {
+    size_t buffered = c->len - c->pos;
+
+    c->staging = 1;
+    c->scan_state = SCAN_SIZE;
+    c->scan_size = 0;
+    c->scan_total = 0;
+    c->scan_line = 0;
+    c->scan_lines = 0;
+
+    if (c->body_mode == FORGE_BODY_LENGTH)
+      c->stage_left = c->remaining > buffered ? c->remaining - buffered : 0;
+    else if (chunk_scan(c, c->buf + c->pos, buffered) < 0)
+      return stage_fail(c, FORGE_BODY_ERROR);
+
+    if (!stage_complete(c) && c->expect_continue && !c->continue_sent)
+    {
+      static const char cont[] = "HTTP/1.1 100 Continue\r\n\r\n";
+      if (forge_conn_write_all(c->fd, cont, sizeof(cont) - 1) != 0)
+        return -1;
+      c->continue_sent = 1;
+    }
+  }
+
+  while (!stage_complete(c))
+  {
+    long n = c->spool_fd >= 0 ? stage_to_spool(c) : stage_to_buffer(c);
+    if (n == STAGE_BAD_FRAMING)
+      return stage_fail(c, FORGE_BODY_ERROR);
+    if (n == STAGE_NO_SPOOL)
+      return stage_fail(c, FORGE_BODY_UNAVAILABLE);
+    if (n < 0)
+      return n == FORGE_CONN_AGAIN ? FORGE_CONN_AGAIN : -1;
+  }
+
+  if (c->spool_fd >= 0 && lseek(c->spool_fd, 0, SEEK_SET) != 0)
+    return -1;
+
+  c->staging = 0;
+  c->staged = 1;
+  c->continue_sent = 1; /* the body is here; nothing left to invite */
+  return 0;
+#endif
+}
+
+/* =========================================================
+   Streaming Request Body
+   ========================================================= */
+
+static long body_fail(ForgeConn *c, int code)
+{
+  c->body_error = code;
+  return code;
+}
+
+/* Buffered bytes first, then straight from the socket into dst */
+static long body_take(ForgeConn *c, char *dst, size_t want)
+{
+  size_t avail = c->len - c->pos;
+  if (avail > 0)
+  {
+    size_t n = avail < want ? avail : want;
+    memcpy(dst, c->buf + c->pos, n);
+    c->pos += n;
+    return (long)n;
+  }
+  return conn_recv(c, dst, want);
+}
+
+/*
+ * Consume one LF-terminated line (CR optional) from the body
+ * area. Returns its length without the line ending, or -1.
+ */
+static long body_line(ForgeConn *c, const char **line)
+{
+  while (1)
+  {
+    char *start = c->buf + c->pos;
+    size_t avail = c->len - c->pos;
+    char *lf = memchr(start, '\n', avail);
+
+    if (lf)
+    {
+      size_t n = (size_t)(lf - start);
+      c->pos += n + 1;
+      if (n > 0 && start[n - 1] == '\r')
+        n--;
+      *line = start;
+      return (long)n;
+    }
+
+    /* Compact behind the request head, which must stay put */
+    if (c->pos > c->body_base)
+    {
+      memmove(c->buf + c->body_base, start, avail);
+      c->pos = c->body_base;
+      c->len = c->body_base + avail;
+    }
+
+    if (c->len + 1 >= c->cap)
+      return -1;
+
+    long n = conn_recv(c, c->buf + c->len, c->cap - 1 - c->len);
+    if (n <= 0)
+      return -1;
+    c->len += (size_t)n;
+  }
+}
+
+/* Advance to the next chunk; switches to DONE after the last one */
+static int chunk_next(ForgeConn *c)
+{
+  const char *line;
+  long n;
+
+  if (c->chunk_crlf)
+  {
+    if (body_line(c, &line) != 0)
+      return body_fail(c, FORGE_BODY_ERROR);
+    c->chunk_crlf = 0;
+  }
+
+  n = body_line(c, &line);
+  if (n <= 0)
+    return body_fail(c, FORGE_BODY_ERROR);
+
+  unsigned long long size = 0;
+  long i = 0;
+  for (; i < n; i++)
+  {
+    int d = line[i];
+    if (d >= '0' && d <= '9')
+      d -= '0';
+    else if (d >= 'a' && d <= 'f')
+      d -= 'a' - 10;
+    else if (d >= 'A' && d <= 'F')
+      d -= 'A' - 10;
+    else
+      break;
+
+    if (i >= 15)
+      return body_fail(c, FORGE_BODY_ERROR);
+    size = (size << 4) | (unsigned)d;
+  }
+
+  /* Digits, then nothing or a chunk extension */
+  if (i == 0 || (i < n && line[i] != ';' && line[i] != ' ' && line[i] != '\t'))
+    return body_fail(c, FORGE_BODY_ERROR);
+
+  if (size == 0)
+  {
+    /* Trailer section, discarded */
+    for (int lines = 0; (n = body_line(c, &line)) != 0; lines++)
+    {
+      if (n < 0 || lines == FORGE_MAX_HEADERS)
+        return body_fail(c, FORGE_BODY_ERROR);
+    }
+    c->body_mode = FORGE_BODY_DONE;
+    return 0;
+  }
+
+  if (c->body_read + size > c->max_body)
+    return body_fail(c, FORGE_BODY_TOO_LARGE);
+
+  c->remaining = size;
+  return 0;
+}
+
+long forge_body_read(const ForgeHttpRequest *req, void *buf, size_t cap)
+{
+  ForgeConn *c = req ? req->conn : NULL;
+  if (!c || !buf)
+    return FORGE_BODY_ERROR;
+  if (c->body_error)
+    return c->body_error;
+  if (c->body_mode == FORGE_BODY_NONE || c->body_mode == FORGE_BODY_DONE)
+    return 0;
+  if (cap == 0)
+    return 0;
+
+  if (c->expect_continue && !c->continue_sent)
+  {
+    static const char cont[] = "HTTP/1.1 100 Continue\r\n\r\n";
+    c->continue_sent = 1;
+#ifdef _WIN32
+    send(c->fd, cont, (int)sizeof(cont) - 1, 0);
+#else
+    if (forge_conn_write_all(c->fd, cont, sizeof(cont) - 1) != 0)
+      return body_fail(c, FORGE_BODY_ERROR);
+#endif
+  }
+
+  if (c->body_mode == FORGE_BODY_CHUNKED && c->remaining == 0)
+  {
+    if (chunk_next(c) != 0)
+      return c->body_error;
+    if (c->body_mode == FORGE_BODY_DONE)
+      return 0;
+  }
+
+  size_t want = cap;
+  if (want > c->remaining)
+    want = (size_t)c->remaining;
+
+  long n = body_take(c, buf, want);
+  if (n <= 0)
+    return body_fail(c, FORGE_BODY_ERROR);
+
+  c->remaining -= (unsigned long long)n;
+  c->body_read += (unsigned long long)n;
+
+  if (c->remaining == 0)
+  {
+    if (c->body_mode == FORGE_BODY_LENGTH)
+      c->body_mode = FORGE_BODY_DONE;
+    else
+      c->chunk_crlf = 1;
+  }
+
+  return n;
+}
+
+long long forge_body_stream(const ForgeHttpRequest *req,
+                            ForgeBodyCallback on_chunk,
+                            void *user)
+{
+  char chunk[16 * 1024];
+  long long total = 0;
+  long n;
+
+  while ((n = forge_body_read(req, chunk, sizeof(chunk))) > 0)
+  {
+    int rc = on_chunk ? on_chunk(chunk, (size_t)n, user) : 0;
+    if (rc < 0)
+      return rc;
+    total += n;
+  }
+
+  return n < 0 ? n : total;
+}
+
+/* =========================================================
+   Common Response Headers
+   ========================================================= */
+
+/*
+ * Server and Date, pre-formatted once per second per thread, with
+ * both Connection variants so a response just copies one block.
+ */
+static _Thread_local struct
+{
+  time_t second;
+  char date[32];
+  size_t date_len;
+  char block[2][96]; /* [0] close, [1] keep-alive */
+  size_t block_len[2];
+} common;
+
+/* IMF-fixdate (RFC 9110): "Sun, 06 Nov 1994 08:49:37 GMT" */
+static size_t format_http_date(char *out, time_t t)
+{
+  static const char days[] = "ThuFriSatSunMonTueWed"; /* 1970-01-01 was a Thursday */
+  static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+  long long secs = (long long)t;
+  long long z = secs >= 0 ? secs / 86400 : (secs - 86399) / 86400;
+  long tod = (long)(secs - z * 86400);
+  int wday = (int)(((z % 7) + 7) % 7);
+
+  /* Civil date from days since the epoch (proleptic Gregorian) */
+  z += 719468;
+  long long era = (z >= 0 ? z : z - 146096) / 146097;
+  long doe = (long)(z - era * 146097);
+  long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  long mp = (5 * doy + 2) / 153;
+  int day = (int)(doy - (153 * mp + 2) / 5 + 1);
+  int month = (int)(mp < 10 ? mp + 3 : mp - 9);
+  long long year = yoe + era * 400 + (month <= 2);
+
+  int n = snprintf(out, 32, "%.3s, %02d %.3s %04lld %02ld:%02ld:%02ld GMT",
+                   days + wday * 3, day, months + (month - 1) * 3, year,
+                   tod / 3600, tod / 60 % 60, tod % 60);
+  return n > 0 ? (size_t)n : 0;
+}
+
+void forge_http_tick(void)
+{
+  time_t now = time(NULL);
+  if (now == common.second)
+    return;
+
+  common.second = now;
+  common.date_len = format_http_date(common.date, now);
+
+  for (int keep_alive = 0; keep_alive < 2; keep_alive++)
+  {
+    int n = snprintf(common.block[keep_alive], sizeof(common.block[0]),
+                     "Server: Forge\r\n"
+                     "Date: %s\r\n"
+                     "Connection: %s\r\n",
+                     common.date,
+                     keep_alive ? "keep-alive" : "close");
+    common.block_len[keep_alive] = n > 0 ? (size_t)n : 0;
+  }
+}
+
+const char *forge_http_date(size_t *len)
+{
+  /* Threads without an event loop refresh on first use */
+  if (common.second == 0)
+    forge_http_tick();
+
+  *len = common.date_len;
+  return common.date;
+}
+
+/* =========================================================
+   HTTP Response Helpers
+   ========================================================= */
+
+_Thread_local ForgeExchange forge_exchange;
+
+void forge_exchange_begin(int fd, int keep_alive, ForgeH2Stream *h2)
+{
+  forge_exchange.fd = fd;
+  forge_exchange.keep_alive = keep_alive;
+  forge_exchange.h2 = h2;
+  forge_exchange.capture = NULL;
+  forge_exchange.conn = NULL;
+  forge_exchange.route_arg = NULL;
+  forge_exchange.headers_len = 0;
+  forge_exchange.chunked_ok = 0;
+  forge_exchange.status = 0;
+  forge_exchange.bytes = 0;
+}
+
+int forge_http_build_head(char *head, size_t cap,
+                          const char *status,
+                          const char *content_type,
+                          long long content_length)
+{
+  if (common.second == 0)
+    forge_http_tick();
+
+  int len = content_length < 0
+                ? snprintf(head, 256,
+                           "HTTP/1.1 %s\r\n"
+                           "Content-Type: %s\r\n"
+                           "Transfer-Encoding: chunked\r\n",
+                           status, content_type)
+                : snprintf(head, 256,
+                           "HTTP/1.1 %s\r\n"
+                           "Content-Type: %s\r\n"
+                           "Content-Length: %lld\r\n",
+                           status, content_type, content_length);
+
+  int keep_alive = forge_exchange.keep_alive != 0;
+  if (len < 0 || len >= 256 ||
+      (size_t)len + common.block_len[keep_alive] +
+              forge_exchange.headers_len + 2 > cap)
+    return -1;
+
+  /* Server, Date, Connection: one copy of the per-second block */
+  memcpy(head + len, common.block[keep_alive], common.block_len[keep_alive]);
+  len += (int)common.block_len[keep_alive];
+
+  memcpy(head + len, forge_exchange.headers, forge_exchange.headers_len);
+  len += (int)forge_exchange.headers_len;
+  memcpy(head + len, "\r\n", 2);
+  return len + 2;
+}
+
+/*
+ * Write `n` buffers in one syscall where possible, never copying
+ * them; a rare short write on a full socket buffer finishes
+ * blocking. Returns the bytes written.
+ */
+static size_t send_parts(int fd, const void *const *parts,
+                         const size_t *lens, int n)
+{
+  size_t done = 0;
+
+#ifdef _WIN32
+  for (int i = 0; i < n; i++)
+  {
+    if (forge_conn_write_all(fd, parts[i], lens[i]) != 0)
+      break;
+    done += lens[i];
+  }
+#else
+  struct iovec iov[8];
+  size_t total = 0;
+  for (int i = 0; i < n; i++)
+  {
+    iov[i].iov_base = (void *)parts[i];
+    iov[i].iov_len = lens[i];
+    total += lens[i];
+  }
+
+  long sent = forge_conn_writev(fd, iov, n);
+  if (sent < 0)
+    return 0;
+  done = (size_t)sent;
+
+  size_t offset = 0;
+  for (int i = 0; i < n && done < total; i++)
+  {
+    if (done < offset + lens[i])
+    {
+      size_t skip = done - offset;
+      if (forge_conn_write_all(fd, (const char *)parts[i] + skip,
+                               lens[i] - skip) != 0)
+        break;
+      done = offset + lens[i];
+    }
+    offset += lens[i];
+  }
+#endif
+
+  return done;
+}
+
+void forge_http_respond(int client_socket,
+                        const char *status,
+                        const char *content_type,
+                        const char *body,
+                        size_t body_len)
+{
+  forge_exchange.status = atoi(status);
+
+  if (forge_exchange.capture && client_socket == forge_exchange.fd)
+  {
+    forge_cache_capture_head(status, content_type, body, body_len, 0);
+    forge_cache_capture_end();
+  }
+
+  if (forge_exchange.h2 && client_socket == forge_exchange.fd)
+  {
+    forge_h2_respond(forge_exchange.h2, status, content_type, body, body_len);
+    return;
+  }
+
+  char head[512 + FORGE_RESPONSE_HEADERS_MAX];
+  int len = forge_http_build_head(head, sizeof(head), status, content_type,
+                                  (long long)body_len);
+  if (len < 0)
+    return;
+
+  const void *parts[2] = {head, body};
+  size_t lens[2] = {(size_t)len, body_len};
+  forge_exchange.bytes += send_parts(client_socket, parts, lens, 2);
+}
+
+void forge_http_respond_raw(int client_socket,
+                            int status,
+                            const char *head,
+                            size_t head_len,
+                            const char *body,
+                            size_t body_len)
+{
+  if (common.second == 0)
+    forge_http_tick();
+
+  forge_exchange.status = status;
+
+  int keep_alive = forge_exchange.keep_alive != 0;
+  const void *parts[5] = {head, common.block[keep_alive],
+                          forge_exchange.headers, "\r\n", body};
+  size_t lens[5] = {head_len, common.block_len[keep_alive],
+                    forge_exchange.headers_len, 2, body_len};
+  forge_exchange.bytes += send_parts(client_socket, parts, lens,
+                                     body_len ? 5 : 4);
+}
+
+int forge_http_can_chunk(int client_socket)
+{
+  return forge_exchange.chunked_ok && !forge_exchange.h2 &&
+         client_socket == forge_exchange.fd;
+}
+
+int forge_http_chunked_begin(int client_socket,
+                             const char *status,
+                             const char *content_type)
+{
+  forge_exchange.status = atoi(status);
+
+  if (forge_exchange.capture && client_socket == forge_exchange.fd)
+    forge_cache_capture_head(status, content_type, NULL, 0, 1);
+
+  char head[512 + FORGE_RESPONSE_HEADERS_MAX];
+  int len = forge_http_build_head(head, sizeof(head), status, content_type, -1);
+  if (len < 0)
+    return -1;
+
+  const void *parts[1] = {head};
+  size_t lens[1] = {(size_t)len};
+  size_t sent = send_parts(client_socket, parts, lens, 1);
+  forge_exchange.bytes += sent;
+  return sent == (size_t)len ? 0 : -1;
+}
+
+int forge_http_chunk(int client_socket, const char *data, size_t len)
+{
+  if (forge_exchange.capture && client_socket == forge_exchange.fd)
+  {
+    if (len == 0)
+      forge_cache_capture_end();
+    else
+      forge_cache_capture_body(data, len);
+  }
+
+  if (len == 0)
+  {
+    static const char last[] = "0\r\n\r\n";
+    const void *parts[1] = {last};
+    size_t lens[1] = {sizeof(last) - 1};
+    size_t sent = send_parts(client_socket, parts, lens, 1);
+    forge_exchange.bytes += sent;
+    return sent == lens[0] ? 0 : -1;
+  }
+
+  char size_line[24];
+  int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", len);
+
+  const void *parts[3] = {size_line, data, "\r\n"};
+  size_t lens[3] = {(size_t)n, len, 2};
+  size_t sent = send_parts(client_socket, parts, lens, 3);
+  forge_exchange.bytes += sent;
+  return sent == (size_t)n + len + 2 ? 0 : -1;
+}
+
+static void send_response(int client_socket,
+                          const char *status,
+                          const char *content_type,
+                          const char *body)
+{
+  forge_http_respond(client_socket, status, content_type, body, strlen(body));
+}
+
+void forge_send_text(int client_socket,
+                     const char *status,
+                     const char *body)
+{
+  send_response(client_socket, status,
+                "text/plain; charset=utf-8", body);
+}
+
+void forge_send_json(int client_socket,
+                     const char *status,
+                     const char *body)
+{
+  send_response(client_socket, status,
+                "application/json; charset=utf-8", body);
+}
+
+int forge_response_header(int client_socket,
+                          const char *name,
+                          const char *value)
+{
+  (void)client_socket;
+
+  size_t name_len = strlen(name);
+  size_t value_len = strlen(value);
+
+  /* Header injection: no line breaks, no empty or odd names */
+  if (name_len == 0 || strpbrk(name, " :\r\n") || strpbrk(value, "\r\n"))
+    return -1;
+
+  size_t need = name_len + 2 + value_len + 2;
+  if (forge_exchange.headers_len + need > sizeof(forge_exchange.headers))
+    return -1;
+
+  char *p = forge_exchange.headers + forge_exchange.headers_len;
+  memcpy(p, name, name_len);
+  memcpy(p + name_len, ": ", 2);
+  memcpy(p + name_len + 2, value, value_len);
+  memcpy(p + name_len + 2 + value_len, "\r\n", 2);
+  forge_exchange.headers_len += need;
+  return 0;
 }
@@ -0,0 +1,570 @@
+#ifndef FORGE_INTERNAL_H
+#define FORGE_INTERNAL_H
+
+/*
+ * Library-private declarations shared between framework-core
+ * translation units. Not installed with the public headers.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#ifndef _WIN32
+#include <sys/socket.h>
+#endif
+
+#include "forge_http.h"
+#include "forge_router.h"
+#include "forge_core.h"
+#include "forge_digest.h"
+
+typedef struct ForgeH2Conn ForgeH2Conn;
+typedef struct ForgeH2Stream ForgeH2Stream;
+typedef struct ForgeCapture ForgeCapture;
+typedef struct ForgeCachePolicy ForgeCachePolicy;
+
+/* =========================================================
+   Request Exchange
+   ========================================================= */
+
+#define FORGE_RESPONSE_HEADERS_MAX 1024
+
+/*
+ * Per-thread state of the request being answered. The server
+ * sets the inputs before calling a handler; the response
+ * helpers fill in the accounting.
+ */
+typedef struct
+{
+  /* inputs */
+  int fd;            /* socket the handler was given */
+  int keep_alive;    /* HTTP/1.x: answer with keep-alive, not close */
+  int chunked_ok;    /* HTTP/1.1 peer: chunked framing allowed */
+  ForgeH2Stream *h2; /* set while an HTTP/2 stream's handler runs */
+  ForgeCapture *capture; /* set while a cached route's handler runs */
+  ForgeConn *conn;   /* HTTP/1 connection behind fd, NULL for h2 */
+  void *route_arg;   /* ForgeRoute.arg of the dispatched route */
+
+  /* extra response headers, "Name: value\r\n" each */
+  char headers[FORGE_RESPONSE_HEADERS_MAX];
+  size_t headers_len;
+
+  /* accounting */
+  int status;
+  size_t bytes;
+} ForgeExchange;
+
+extern _Thread_local ForgeExchange forge_exchange;
+
+/* Reset the per-request fields before running a handler */
+void forge_exchange_begin(int fd, int keep_alive, ForgeH2Stream *h2);
+
+/*
+ * Set req->path (decoded, normalized) and req->query (raw) from a
+ * request target. Returns -1 unless it is origin-form and decodes.
+ */
+int forge_http_set_target(ForgeHttpRequest *req, const char *target, size_t len);
+
+/* Classify req->headers[i] and index it if it is the first of its id */
+int forge_http_index_header(ForgeHttpRequest *req, int i);
+
+/* True when the comma-separated header `h` lists `token` */
+int forge_http_has_token(const ForgeHttpHeader *h, const char *token);
+
+/* Strict decimal Content-Length (no sign, no whitespace); -1 if not */
+long long forge_http_parse_length(const char *v, size_t len);
+
+/*
+ * Refresh this thread's Server/Date header block when the wall
+ * clock moved to a new second. Event loops call it once per
+ * iteration; responses only copy the cached block.
+ */
+void forge_http_tick(void);
+
+/* This thread's cached IMF-fixdate (29 bytes, not refreshed here) */
+const char *forge_http_date(size_t *len);
+
+/*
+ * HTTP/1.1 head: status line, framing (Content-Length, or chunked
+ * when content_length < 0), the common block and the exchange's
+ * extra headers. Returns its length, or -1 if it does not fit.
+ */
+int forge_http_build_head(char *head, size_t cap,
+                          const char *status,
+                          const char *content_type,
+                          long long content_length);
+
+/* Complete response with a known body length (HTTP/1 or h2) */
+void forge_http_respond(int client_socket,
+                        const char *status,
+                        const char *content_type,
+                        const char *body,
+                        size_t body_len);
+
+/* True when the current exchange on `client_socket` may be chunked */
+int forge_http_can_chunk(int client_socket);
+
+/*
+ * Chunked HTTP/1.1 response: the head, then one chunk per call;
+ * a zero-length chunk ends the body. 0 / -1.
+ */
+int forge_http_chunked_begin(int client_socket,
+                             const char *status,
+                             const char *content_type);
+int forge_http_chunk(int client_socket, const char *data, size_t len);
+
+/*
+ * HTTP/1 response from a pre-serialized `head` (status line and
+ * entity headers, framing included): completed with the common
+ * block and the exchange's extra headers, sent in one writev().
+ */
+void forge_http_respond_raw(int client_socket,
+                            int status,
+                            const char *head,
+                            size_t head_len,
+                            const char *body,
+                            size_t body_len);
+
+/* =========================================================
+   Connections
+   ========================================================= */
+
+typedef enum
+{
+  FORGE_BODY_NONE = 0,
+  FORGE_BODY_LENGTH,
+  FORGE_BODY_CHUNKED,
+  FORGE_BODY_DONE
+} ForgeBodyMode;
+
+typedef enum
+{
+  FORGE_PROTO_HTTP1 = 0,
+  FORGE_PROTO_H2,
+  FORGE_PROTO_WS,
+  FORGE_PROTO_SSE
+} ForgeProto;
+
+/*
+ * Per-connection read state. buf[pos, len) holds received bytes
+ * not consumed yet; buf[0, body_base) is the request head that
+ * ForgeHttpRequest headers point into and is never moved.
+ *
+ * Server connections draw buf from pooled tiers (512 B, 4 KB,
+ * 64 KB): it starts on the smallest, is promoted when a head or
+ * frame outgrows it, and a promoted buffer goes back to the pool
+ * once the connection is idle; the smallest is kept for the next
+ * keep-alive request. Promotion moves the buffer, so it only
+ * happens before a head is parsed.
+ */
+struct ForgeConn
+{
+  int fd;
+  ForgeProto proto;
+  ForgeH2Conn *h2;
+  struct ForgeWs *ws;
+  struct ForgeSseSub *sse;
+  struct ForgeZeroCopy *zc; /* zero-copy bodies awaiting completion */
+  uint32_t peer_ipv4;
+  uint64_t last_active_ns;
+  uint64_t ready_ns; /* became readable; admission control measures from here */
+  int polled;        /* owned by a core loop, not handle_client() */
+  int want_write;    /* queued output: poll for POLLOUT too */
+  int nonblocking;   /* reads never wait: FORGE_CONN_AGAIN instead */
+  uint64_t request_ns;  /* first byte of the request being received */
+  uint64_t deadline_ns; /* close unless the request progresses by then */
+
+  char *buf;  /* NULL: no tier held */
+  size_t cap;
+  int tier;   /* -1: caller-owned buffer */
+  size_t len;
+  size_t pos;
+  size_t body_base;
+
+  ForgeBodyMode body_mode;
+  unsigned long long remaining; /* body (LENGTH) or chunk (CHUNKED) */
+  unsigned long long body_read;
+  size_t max_body;
+  int chunk_crlf;    /* CRLF still owed after chunk data */
+  int expect_continue; /* client waits for 100 Continue */
+  int continue_sent;   /* 100 Continue already written */
+  int body_error;    /* sticky FORGE_BODY_* code */
+  int body_armed;    /* begin_body ran for the current request */
+
+  /*
+   * Staging: the body is received ahead of dispatch so handlers
+   * never wait on the network. It stays in buf while it fits the
+   * largest tier; the rest goes to spool_fd, an unlinked file that
+   * reads continue from once buf[pos, len) is used up.
+   */
+  int staging;       /* body still arriving; head parsed */
+  int staged;        /* the whole body is local (buf + spool) */
+  int spool_fd;      /* -1: none */
+  unsigned long long stage_left; /* LENGTH: bytes still to receive */
+  int scan_state;    /* CHUNKED: wire scanner position */
+  unsigned long long scan_size;  /* chunk data still to skip */
+  unsigned long long scan_total; /* chunk data seen so far */
+  size_t scan_line;  /* bytes in the current size or trailer line */
+  int scan_lines;    /* size digits, then trailer lines */
+  unsigned long long spool_claimed; /* of the spool budget, for spool_fd */
+  int screen;        /* FORGE_SCREEN_*: admitted ahead of staging */
+
+  /* Parking: see forge_conn_park() */
+  int parked;        /* FORGE_PARKED, FORGE_RESUMED, or 0 */
+  int park_core;     /* core the resume is posted to */
+  void *park_result; /* handed over by forge_conn_resume() */
+  ForgeExchange *park_exchange; /* the exchange as the handler left it */
+  uint64_t park_ns;  /* request start, logged once resumed */
+  ForgeConn *owner;  /* HTTP/2 stream body: the connection it came on */
+  int woken;         /* a parked exchange on it was resumed */
+  int closing;       /* closed by the peer, kept until nothing is parked */
+  int lingering;     /* shut down, polled until zero-copy bodies complete */
+};
+
+/* forge_conn_read_head()/forge_conn_fill(): nothing to read yet */
+#define FORGE_CONN_AGAIN (-2)
+
+/* Fixed `buf`, or NULL to draw tiered buffers from the pool */
+void forge_conn_init(ForgeConn *c, int fd, char *buf, size_t cap);
+
+/* Drop a promoted buffer holding no unread bytes back to the pool */
+void forge_conn_release(ForgeConn *c);
+
+/* Drop the tiered buffer whatever it holds, at close */
+void forge_conn_free(ForgeConn *c);
+
+/*
+ * Receive until the buffer holds a complete request head,
+ * promoting a tiered buffer as needed. Returns the head length
+ * (through the blank line), 0 on orderly EOF before any byte,
+ * -1 on error or overflow of the largest tier. A nonblocking
+ * connection returns FORGE_CONN_AGAIN once the socket is drained.
+ */
+long forge_conn_read_head(ForgeConn *c);
+
+/* Arm body decoding for `req` once its head was parsed */
+void forge_conn_begin_body(ForgeConn *c,
+                           const ForgeHttpRequest *req,
+                           size_t max_body);
+
+/*
+ * Receive the armed body ahead of dispatch, sending 100 Continue
+ * first if the client waits for it. Returns 0 once it is all local
+ * (or unreadable: body_error is set), FORGE_CONN_AGAIN when more
+ * has to arrive, -1 on EOF or a socket error. May move buf.
+ */
+int forge_conn_stage_body(ForgeConn *c);
+
+/* Unlinked temporary file for spooled bodies; -1 on failure */
+int forge_spool_open(void);
+
+/*
+ * Spooled bytes are claimed from a budget shared by every connection
+ * of the process (forge_server_set_spool_budget()). Claim before
+ * writing: -1 when the budget is spent. Released on close.
+ */
+extern unsigned long long forge_spool_budget;
+int forge_spool_claim(size_t n);
+void forge_spool_release(unsigned long long n);
+
+/* Close the spool, dropping whatever was not read from it */
+void forge_conn_spool_close(ForgeConn *c);
+
+/*
+ * After a response: discard a small unread body remainder so the
+ * connection can carry the next request. Returns 0 when the body
+ * is fully consumed, -1 when the connection has to close.
+ */
+int forge_conn_finish_body(ForgeConn *c);
+
+/* Move pipelined bytes behind the finished request to the front */
+void forge_conn_next_request(ForgeConn *c);
+
+/*
+ * One recv() into the free tail of the buffer, promoting a full
+ * tiered one first; returns bytes, FORGE_CONN_AGAIN, or <= 0
+ */
+long forge_conn_fill(ForgeConn *c);
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 /* launch_server*() ignores SIGPIPE instead */
+#endif
+
+/*
+ * Write all of `data`, retrying short writes; returns 0 / -1. A
+ * peer that went away fails the write instead of raising SIGPIPE;
+ * `fd` may also be a spool file.
+ */
+int forge_conn_write_all(int fd, const void *data, size_t len);
+
+#ifndef _WIN32
+struct iovec;
+
+/* One writev() with forge_conn_write_all()'s rules; bytes or -1 */
+long forge_conn_writev(int fd, const struct iovec *iov, int n);
+#endif
+
+/*
+ * Read zero-copy completions from the error queue and release the
+ * finished bodies, waiting up to `wait_ms` while any are pending.
+ * Returns the notifications read, or -1 when c never sent one.
+ */
+int forge_zerocopy_reap(ForgeConn *c, int wait_ms);
+
+/* Bodies the kernel may still read from */
+int forge_zerocopy_pending(const ForgeConn *c);
+
+/* Outstanding bodies are waited for this long before a close */
+#define FORGE_ZEROCOPY_CLOSE_WAIT_MS 2000
+
+/*
+ * Before close: drop the state. A connection on a core loop has
+ * lingered for its bodies already; any other waits for them here.
+ */
+void forge_zerocopy_free(ForgeConn *c);
+
+/* =========================================================
+   Routing (forge_router.c)
+   ========================================================= */
+
+typedef struct
+{
+  ForgeMiddlewareFn before;
+  ForgeMiddlewareDoneFn after;
+} ForgeMiddlewareStep;
+
+/* A route with its middleware chain flattened into one array */
+typedef struct
+{
+  ForgeRoute route; /* handler NULL: the 404 entry */
+  ForgeCachePolicy *cache; /* the table's copy of the policy, or NULL */
+  int priority; /* forge_route_priority(), -1 when never set */
+  const ForgeMiddlewareStep *chain;
+  int chain_len;
+} ForgeCompiledRoute;
+
+/* Route metadata changed: recompile and publish the table now */
+void forge_router_invalidate(void);
+
+/* Set the built-in routes and publish anything not published yet */
+void forge_router_commit(const ForgeRoute *builtin, int builtin_count);
+
+/*
+ * Read-side section around resolving and dispatching: a table that
+ * a reload swaps out is not freed while a section that may have
+ * seen it is open. Never blocks; sections nest.
+ */
+void forge_router_enter(void);
+void forge_router_exit(void);
+
+/*
+ * Free swapped-out tables nobody reads any more, and retry a publish
+ * that had to wait for that (event-loop tick)
+ */
+void forge_router_reclaim(void);
+
+/*
+ * Match `req` against the published table (application routes, then
+ * the built-ins). Registrations publish a new table themselves, so
+ * this only loads the pointer and never compiles or locks. Never
+ * NULL: unmatched requests get the 404 entry. Call inside a
+ * forge_router_enter() section; the result is valid until its exit.
+ */
+const ForgeCompiledRoute *forge_router_resolve(const ForgeHttpRequest *req);
+
+/* =========================================================
+   WebSocket (forge_ws.c)
+   ========================================================= */
+
+/* Read once and handle every complete frame; 0 keep, -1 close */
+int forge_ws_serve(ForgeConn *c);
+
+/* Frames already buffered (sent right behind the handshake) */
+int forge_ws_process(ForgeConn *c);
+
+/* Idle: ping the peer; -1 when the last ping got no answer */
+int forge_ws_keepalive(ForgeConn *c);
+
+/* Reports the close to the handler and releases the state */
+void forge_ws_free(ForgeConn *c);
+
+/* =========================================================
+   Server-Sent Events (forge_sse.c)
+   ========================================================= */
+
+/* Readable or writable: discard input, write queued events; 0 / -1 */
+int forge_sse_serve(ForgeConn *c);
+
+/* Unsubscribes and drops the queued events */
+void forge_sse_free(ForgeConn *c);
+
+/* =========================================================
+   Access Log (forge_log.c)
+   ========================================================= */
+
+/* In a forked child: restart the writer thread for the open log */
+void forge_access_log_after_fork(void);
+
+/* =========================================================
+   Digests (forge_digest.c)
+   ========================================================= */
+
+void forge_sha1(const void *data, size_t len, unsigned char out[20]);
+
+/* Padded base64; `out` needs 4 * ((len + 2) / 3) + 1 bytes */
+size_t forge_base64_encode(const unsigned char *in, size_t len, char *out);
+
+/* Decoded length, or -1 on a byte outside the alphabet */
+long forge_base64_decode(const char *in, size_t len, unsigned char *out);
+
+/* =========================================================
+   Response Cache (forge_cache.c)
+   ========================================================= */
+
+/*
+ * A copy of the route's policy for a compiled table to own (free()
+ * it with the table), or *out NULL when it has none. -1 on OOM.
+ */
+int forge_cache_policy_copy(const char *method, const char *path,
+                            ForgeCachePolicy **out);
+
+/* Answer from the cache, or run `handler` and store its response */
+void forge_cache_serve(const ForgeCachePolicy *policy,
+                       ForgeRouteHandler handler,
+                       const ForgeHttpRequest *req,
+                       int client_socket);
+
+/*
+ * Recording hooks of the response helpers, called while
+ * forge_exchange.capture is set and the response goes to the
+ * exchange's socket. capture_head may add ETag/Vary headers.
+ */
+void forge_cache_capture_head(const char *status,
+                              const char *content_type,
+                              const char *body,
+                              size_t body_len,
+                              int chunked);
+void forge_cache_capture_body(const char *data, size_t len);
+void forge_cache_capture_end(void);
+
+/* =========================================================
+   Cores (forge_core.c)
+   ========================================================= */
+
+typedef void (*ForgeCoreLoop)(ForgeCore *core, void *arg);
+
+/*
+ * Start `count` cores, each running `loop` on its own thread after
+ * the forge_core_on_start() hooks. Core 0 runs on the caller; returns
+ * once every loop has returned.
+ */
+int forge_core_run(int count, ForgeCoreLoop loop, void *arg);
+
+/*
+ * Give the calling thread, which is outside the runtime, a private
+ * core (id -1) instead of sharing core 0: own arena and counters,
+ * unreachable by posts and left out of forge_core_stats(). NULL on OOM.
+ */
+ForgeCore *forge_core_attach_aside(void);
+
+/* Run the due timers; ms until the next one, -1 when none */
+int forge_core_run_timers(ForgeCore *core, uint64_t now_ns);
+
+/* Readable when messages were posted; -1 where unsupported */
+int forge_core_wake_fd(const ForgeCore *core);
+void forge_core_clear_wake(ForgeCore *core);
+
+/* Owner-side accounting; request_done also resets the arena */
+void forge_core_conn_opened(ForgeCore *core);
+void forge_core_conn_off_cpu(ForgeCore *core);
+void forge_core_conn_closed(ForgeCore *core);
+void forge_core_request_done(ForgeCore *core, size_t bytes_out);
+
+/* One admission decision: time the request queued, shed or not */
+void forge_core_admission(ForgeCore *core, uint64_t delay_ns,
+                          int shed, int overloaded);
+
+/* =========================================================
+   Dispatch (forge_server.c)
+   ========================================================= */
+
+/* Route lookup including the built-in routes; never NULL */
+const ForgeCompiledRoute *forge_server_route(const ForgeHttpRequest *req);
+
+#define FORGE_PARKED 1
+#define FORGE_RESUMED 2
+
+/*
+ * ForgeConn.screen: a body still to be staged is first screened by
+ * admission and the route's before middleware, dispatched with
+ * FORGE_SCREENING. Passing leaves FORGE_SCREENED and the exchange in
+ * park_exchange; the dispatch after staging resumes from there.
+ */
+#define FORGE_SCREENING 1
+#define FORGE_SCREENED 2
+
+/*
+ * Parking. A handler that would wait (on a backend, on a concurrent
+ * request) calls forge_conn_park(req->conn) and returns without
+ * answering. Its core then leaves the exchange alone: no reads, no
+ * timeouts, no stream reset. forge_conn_resume(), from any thread,
+ * hands it `result` and posts it back to that core, where the
+ * request is dispatched again without admission or the before
+ * middleware; the handler takes `result` with forge_conn_resumed().
+ *
+ * forge_conn_park() returns -1 outside a core loop (handle_client(),
+ * the control lane): the handler answers inline. forge_conn_resume()
+ * returns -1 when the core's inbox is full; try again.
+ */
+int forge_conn_park(ForgeConn *c);
+int forge_conn_resume(ForgeConn *c, void *result);
+
+/* 1 with *result set when `c`'s exchange was resumed, else 0 */
+int forge_conn_resumed(const ForgeConn *c, void **result);
+
+/*
+ * Requests routed to `handler` are dispatched as soon as their head
+ * is in: the body is neither screened nor staged, the handler parks
+ * and reads it with forge_body_read() off the core (the proxy
+ * forwards it as it arrives). Idempotent; -1 when the table is full.
+ */
+int forge_server_stream_body(ForgeRouteHandler handler);
+
+/* Run `route`'s middleware and handler, or answer 404 / 413 */
+void forge_server_dispatch(const ForgeCompiledRoute *route,
+                           const ForgeHttpRequest *req,
+                           int client_socket);
+
+/* =========================================================
+   HTTP/2 (forge_h2.c)
+   ========================================================= */
+
+/*
+ * Switch `c` to HTTP/2. With `upgrade` NULL the client used prior
+ * knowledge and its preface is at c->buf[c->pos]; otherwise
+ * `upgrade` is the HTTP/1.1 request carrying "Upgrade: h2c", which
+ * becomes stream 1. Returns 0 to keep the connection, -1 to close.
+ */
+int forge_h2_start(ForgeConn *c, const ForgeHttpRequest *upgrade);
+
+/* Read once and process every complete frame; 0 keep, -1 close */
+int forge_h2_serve(ForgeConn *c);
+
+/* Dispatch the streams forge_conn_resume() handed back; 0 / -1 */
+int forge_h2_resume(ForgeConn *c);
+
+/* Streams of `c` that are parked */
+int forge_h2_parked(const ForgeConn *c);
+
+void forge_h2_free(ForgeConn *c);
+
+/* Response path used by the send helpers for HTTP/2 streams */
+int forge_h2_respond(ForgeH2Stream *s,
+                     const char *status,
+                     const char *content_type,
+                     const char *body,
+                     size_t body_len);
+
+/* True when `req` asks for "Upgrade: h2c" and can be upgraded */
+int forge_h2_wants_upgrade(const ForgeHttpRequest *req);
+
+#endif /* FORGE_INTERNAL_H */
@@ -0,0 +1,557 @@
+#define _GNU_SOURCE
+#include "forge_json.h"
+#include "forge_http.h"
+#include "forge_internal.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define JSON_CONTENT_TYPE "application/json; charset=utf-8"
+
+/* =========================================================
+   Output Buffer
+   ========================================================= */
+
+static void fail(ForgeJsonWriter *w)
+{
+  w->error = 1;
+}
+
+/* Chunking starts once the buffer fills, if the exchange allows it */
+static int can_flush(const ForgeJsonWriter *w)
+{
+  return w->chunked || forge_http_can_chunk(w->client_socket);
+}
+
+static int flush_chunk(ForgeJsonWriter *w)
+{
+  if (!w->chunked)
+  {
+    if (forge_http_chunked_begin(w->client_socket, w->status,
+                                 JSON_CONTENT_TYPE) != 0)
+      return -1;
+    w->chunked = 1;
+  }
+
+  if (w->len > 0 && forge_http_chunk(w->client_socket, w->buf, w->len) != 0)
+    return -1;
+
+  w->len = 0;
+  return 0;
+}
+
+/* Free space for `want` more bytes: flush a chunk, or grow */
+static int make_room(ForgeJsonWriter *w, size_t want)
+{
+  if (can_flush(w))
+  {
+    if (flush_chunk(w) != 0)
+    {
+      fail(w);
+      return -1;
+    }
+    if (w->cap >= want)
+      return 0;
+  }
+
+  size_t cap = w->cap * 2;
+  if (cap < w->len + want)
+    cap = w->len + want;
+
+  char *grown;
+  if (w->buf == w->inline_buf)
+  {
+    grown = malloc(cap);
+    if (grown)
+      memcpy(grown, w->buf, w->len);
+  }
+  else
+  {
+    grown = realloc(w->buf, cap);
+  }
+
+  if (!grown)
+  {
+    fail(w);
+    return -1;
+  }
+
+  w->buf = grown;
+  w->cap = cap;
+  return 0;
+}
+
+/* Room for a small token (number, escape, punctuation) */
+static int reserve(ForgeJsonWriter *w, size_t n)
+{
+  if (w->cap - w->len >= n)
+    return 0;
+  return make_room(w, n);
+}
+
+static void put_char(ForgeJsonWriter *w, char c)
+{
+  if (reserve(w, 1) == 0)
+    w->buf[w->len++] = c;
+}
+
+/* Copy `n` bytes, flushing as often as needed for large runs */
+static void put_raw(ForgeJsonWriter *w, const char *data, size_t n)
+{
+  while (n > 0 && !w->error)
+  {
+    size_t room = w->cap - w->len;
+    if (room == 0)
+    {
+      make_room(w, n);
+      continue;
+    }
+
+    size_t take = n < room ? n : room;
+    memcpy(w->buf + w->len, data, take);
+    w->len += take;
+    data += take;
+    n -= take;
+  }
+}
+
+/* =========================================================
+   Structure
+   ========================================================= */
+
+static int in_object(const ForgeJsonWriter *w)
+{
+  return w->depth > 0 && ((w->objects >> (w->depth - 1)) & 1);
+}
+
+/* Separator before a value; -1 when a value is not allowed here */
+static int value_begin(ForgeJsonWriter *w)
+{
+  if (w->error || w->complete || (in_object(w) && !w->after_key))
+  {
+    fail(w);
+    return -1;
+  }
+
+  if (w->after_key)
+    w->after_key = 0;
+  else if (w->need_comma)
+    put_char(w, ',');
+
+  return w->error ? -1 : 0;
+}
+
+static void value_end(ForgeJsonWriter *w)
+{
+  w->need_comma = 1;
+  if (w->depth == 0)
+    w->complete = 1;
+}
+
+static void container_begin(ForgeJsonWriter *w, int object)
+{
+  if (value_begin(w) != 0)
+    return;
+
+  if (w->depth == FORGE_JSON_MAX_DEPTH)
+  {
+    fail(w);
+    return;
+  }
+
+  if (object)
+    w->objects |= (uint64_t)1 << w->depth;
+  else
+    w->objects &= ~((uint64_t)1 << w->depth);
+  w->depth++;
+
+  put_char(w, object ? '{' : '[');
+  w->need_comma = 0;
+}
+
+static void container_end(ForgeJsonWriter *w, int object)
+{
+  if (w->error || w->depth == 0 || in_object(w) != object || w->after_key)
+  {
+    fail(w);
+    return;
+  }
+
+  w->depth--;
+  put_char(w, object ? '}' : ']');
+  value_end(w);
+}
+
+void forge_json_begin(ForgeJsonWriter *w,
+                      int client_socket,
+                      const char *status)
+{
+  memset(w, 0, offsetof(ForgeJsonWriter, inline_buf));
+  w->client_socket = client_socket;
+  w->status = status;
+  w->buf = w->inline_buf;
+  w->cap = sizeof(w->inline_buf);
+}
+
+void forge_json_object_begin(ForgeJsonWriter *w)
+{
+  container_begin(w, 1);
+}
+
+void forge_json_object_end(ForgeJsonWriter *w)
+{
+  container_end(w, 1);
+}
+
+void forge_json_array_begin(ForgeJsonWriter *w)
+{
+  container_begin(w, 0);
+}
+
+void forge_json_array_end(ForgeJsonWriter *w)
+{
+  container_end(w, 0);
+}
+
+/* =========================================================
+   Strings
+   ========================================================= */
+
+/*
+ * 0: copied as is. Otherwise the character after the backslash;
+ * 'u' means \u00XX. Everything >= 0x20 but '"' and '\' is safe.
+ */
+static const unsigned char escapes[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    ['"'] = '"',
+    ['\\'] = '\\',
+};
+
+/* Length of the leading run of characters that need no escaping */
+static size_t safe_run(const char *s, size_t len)
+{
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  /* 16 bytes per step: '"', '\' or <= 0x1F (unsigned) ends the run */
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1F);
+
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    __m128i stop = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+        _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+
+    int mask = _mm_movemask_epi8(stop);
+    if (mask)
+      return i + (size_t)__builtin_ctz((unsigned)mask);
+  }
+#endif
+
+  while (i < len && !escapes[(unsigned char)s[i]])
+    i++;
+  return i;
+}
+
+static void put_string(ForgeJsonWriter *w, const char *s, size_t len)
+{
+  static const char hex[] = "0123456789abcdef";
+
+  put_char(w, '"');
+
+  while (len > 0 && !w->error)
+  {
+    size_t run = safe_run(s, len);
+    put_raw(w, s, run);
+    s += run;
+    len -= run;
+
+    if (len == 0 || reserve(w, 6) != 0)
+      break;
+
+    unsigned char c = (unsigned char)*s++;
+    len--;
+
+    char *out = w->buf + w->len;
+    out[0] = '\\';
+    out[1] = (char)escapes[c];
+    if (escapes[c] == 'u')
+    {
+      memcpy(out + 2, "00", 2);
+      out[4] = hex[c >> 4];
+      out[5] = hex[c & 15];
+      w->len += 6;
+    }
+    else
+    {
+      w->len += 2;
+    }
+  }
+
+  put_char(w, '"');
+}
+
+void forge_json_key(ForgeJsonWriter *w, const char *key)
+{
+  if (w->error || !in_object(w) || w->after_key)
+  {
+    fail(w);
+    return;
+  }
+
+  if (w->need_comma)
+    put_char(w, ',');
+
+  put_string(w, key, strlen(key));
+  put_char(w, ':');
+  w->after_key = 1;
+  w->need_comma = 0;
+}
+
+void forge_json_string_n(ForgeJsonWriter *w, const char *s, size_t len)
+{
+  if (value_begin(w) != 0)
+    return;
+
+  put_string(w, s, len);
+  value_end(w);
+}
+
+void forge_json_string(ForgeJsonWriter *w, const char *s)
+{
+  forge_json_string_n(w, s, strlen(s));
+}
+
+/* =========================================================
+   Numbers
+   ========================================================= */
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/* Decimal digits of `v` ending at `end`; returns the first digit */
+static char *format_u64(char *end, uint64_t v)
+{
+  while (v >= 100)
+  {
+    unsigned pair = (unsigned)(v % 100);
+    v /= 100;
+    end -= 2;
+    memcpy(end, digit_pairs + pair * 2, 2);
+  }
+
+  if (v >= 10)
+  {
+    end -= 2;
+    memcpy(end, digit_pairs + v * 2, 2);
+  }
+  else
+  {
+    *--end = (char)('0' + v);
+  }
+  return end;
+}
+
+void forge_json_int(ForgeJsonWriter *w, long long v)
+{
+  if (value_begin(w) != 0)
+    return;
+
+  char tmp[24];
+  char *end = tmp + sizeof(tmp);
+  uint64_t mag = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+
+  char *p = format_u64(end, mag);
+  if (v < 0)
+    *--p = '-';
+
+  put_raw(w, p, (size_t)(end - p));
+  value_end(w);
+}
+
+static const double pow10_exact[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+#define EXACT_INT_LIMIT 9007199254740992.0 /* 2^53 */
+
+/*
+ * Fixed notation with the fewest decimals d such that m / 10^d
+ * rounds back to `a`. With m < 2^53 and 10^d <= 10^22 both exact,
+ * the division is correctly rounded, just like strtod() of the same
+ * digits, so the output parses back to exactly `a`. Returns 0 when
+ * no such m exists (very large, tiny, or 17-digit values).
+ */
+static size_t format_fixed(char *out, double a)
+{
+  for (int d = 0; d < (int)(sizeof(pow10_exact) / sizeof(pow10_exact[0])); d++)
+  {
+    double scaled = a * pow10_exact[d];
+    if (scaled >= EXACT_INT_LIMIT)
+      return 0;
+
+    uint64_t m = (uint64_t)(scaled + 0.5);
+    if (m == 0 || (double)m / pow10_exact[d] != a)
+      continue;
+
+    char tmp[24];
+    char *end = tmp + sizeof(tmp);
+    char *p = format_u64(end, m);
+    size_t digits = (size_t)(end - p);
+    size_t n = 0;
+
+    if ((size_t)d >= digits)
+    {
+      /* 0.00ddd */
+      out[n++] = '0';
+      out[n++] = '.';
+      for (size_t z = digits; z < (size_t)d; z++)
+        out[n++] = '0';
+      memcpy(out + n, p, digits);
+      return n + digits;
+    }
+
+    memcpy(out, p, digits - (size_t)d);
+    n = digits - (size_t)d;
+    if (d > 0)
+    {
+      out[n++] = '.';
+      memcpy(out + n, p + digits - (size_t)d, (size_t)d);
+      n += (size_t)d;
+    }
+    return n;
+  }
+  return 0;
+}
+
+/* Shortest of %.15g .. %.17g that reads back exactly */
+static size_t format_general(char *out, size_t cap, double a)
+{
+  int n = 0;
+  for (int precision = 15; precision <= 17; precision++)
+  {
+    n = snprintf(out, cap, "%.*g", precision, a);
+    if (strtod(out, NULL) == a)
+      break;
+  }
+
+  /* A non-C numeric locale must not leak into JSON */
+  for (int i = 0; i < n; i++)
+  {
+    if (out[i] == ',')
+      out[i] = '.';
+  }
+  return n > 0 ? (size_t)n : 0;
+}
+
+void forge_json_double(ForgeJsonWriter *w, double v)
+{
+  if (!isfinite(v))
+  {
+    forge_json_null(w);
+    return;
+  }
+
+  if (value_begin(w) != 0)
+    return;
+
+  char tmp[64];
+  size_t n = 0;
+
+  if (signbit(v))
+  {
+    tmp[n++] = '-';
+    v = -v;
+  }
+
+  if (v == 0)
+  {
+    tmp[n++] = '0';
+  }
+  else
+  {
+    size_t fixed = format_fixed(tmp + n, v);
+    n += fixed ? fixed : format_general(tmp + n, sizeof(tmp) - n, v);
+  }
+
+  put_raw(w, tmp, n);
+  value_end(w);
+}
+
+void forge_json_bool(ForgeJsonWriter *w, int v)
+{
+  if (value_begin(w) != 0)
+    return;
+
+  if (v)
+    put_raw(w, "true", 4);
+  else
+    put_raw(w, "false", 5);
+  value_end(w);
+}
+
+void forge_json_null(ForgeJsonWriter *w)
+{
+  if (value_begin(w) != 0)
+    return;
+
+  put_raw(w, "null", 4);
+  value_end(w);
+}
+
+/* =========================================================
+   Completion
+   ========================================================= */
+
+int forge_json_end(ForgeJsonWriter *w)
+{
+  int rc = 0;
+
+  if (w->error || !w->complete)
+  {
+    rc = -1;
+
+    if (!w->chunked)
+      forge_send_text(w->client_socket, "500 Internal Server Error",
+                      "Internal Server Error\n");
+    else
+      forge_exchange.keep_alive = 0; /* truncated body: close */
+  }
+  else if (w->chunked)
+  {
+    if (flush_chunk(w) != 0 || forge_http_chunk(w->client_socket, NULL, 0) != 0)
+      rc = -1;
+  }
+  else
+  {
+    forge_http_respond(w->client_socket, w->status, JSON_CONTENT_TYPE,
+                       w->buf, w->len);
+  }
+
+  if (w->buf != w->inline_buf)
+    free(w->buf);
+  w->buf = w->inline_buf;
+  w->len = 0;
+  return rc;
+}
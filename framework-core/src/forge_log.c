@@ -0,0 +1,512 @@
+#define _GNU_SOURCE
+#include "forge_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+/* =========================================================
+   Ring Entries
+   ========================================================= */
+
+#define LOG_PATH_MAX 96
+#define LOG_BATCH_SIZE (64 * 1024)
+#define LOG_LINE_MAX 768 /* a text line, the path escaped */
+#define LOG_IDLE_MS 10
+
+/* Fixed 128-byte slot; the producer never formats anything */
+typedef struct
+{
+  uint64_t ts_ns;
+  uint32_t duration_us;
+  uint32_t bytes;
+  uint32_t peer;
+  uint16_t status;
+  uint8_t http_version; /* 10, 11 or 20 */
+  uint8_t path_len;
+  char method[FORGE_MAX_METHOD];
+  char path[LOG_PATH_MAX];
+} ForgeLogEntry;
+
+typedef char forge_log_entry_size[(sizeof(ForgeLogEntry) == 128) ? 1 : -1];
+
+/*
+ * Single-producer / single-consumer ring owned by one request
+ * thread. head and tail live on separate cache lines so the
+ * producer and the writer thread never share a dirty line.
+ */
+typedef struct ForgeLogRing
+{
+  atomic_size_t head;
+  char pad_head[64 - sizeof(atomic_size_t)];
+  atomic_size_t tail;
+  char pad_tail[64 - sizeof(atomic_size_t)];
+  atomic_ullong dropped;
+  struct ForgeLogRing *next;
+  ForgeLogEntry entries[FORGE_LOG_RING_SIZE];
+} ForgeLogRing;
+
+typedef char forge_log_ring_pow2[
+    (FORGE_LOG_RING_SIZE & (FORGE_LOG_RING_SIZE - 1)) == 0 ? 1 : -1];
+
+/* =========================================================
+   Global State
+   ========================================================= */
+
+static _Atomic(ForgeLogRing *) rings = NULL;
+static atomic_int log_enabled = 0;
+static atomic_int writer_stop = 0;
+
+static FILE *log_file = NULL;
+static ForgeLogFormat log_format = FORGE_LOG_TEXT;
+static pthread_t writer_thread;
+
+static _Thread_local ForgeLogRing *local_ring = NULL;
+
+/* =========================================================
+   Clocks
+   ========================================================= */
+
+uint64_t forge_access_log_clock(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t wall_clock_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_ms(int ms)
+{
+#ifdef _WIN32
+  Sleep(ms);
+#else
+  struct timespec ts = {0, (long)ms * 1000000L};
+  nanosleep(&ts, NULL);
+#endif
+}
+
+/* =========================================================
+   Producer (request threads)
+   ========================================================= */
+
+/* First record on a thread: allocate its ring and publish it */
+static ForgeLogRing *ring_attach(void)
+{
+  ForgeLogRing *ring = calloc(1, sizeof(*ring));
+  if (!ring)
+    return NULL;
+
+  ForgeLogRing *head = atomic_load(&rings);
+  do
+  {
+    ring->next = head;
+  } while (!atomic_compare_exchange_weak(&rings, &head, ring));
+
+  local_ring = ring;
+  return ring;
+}
+
+void forge_access_log_record(const ForgeHttpRequest *req,
+                             int status,
+                             size_t bytes,
+                             uint32_t peer_ipv4,
+                             uint64_t start_ns)
+{
+  if (!atomic_load_explicit(&log_enabled, memory_order_relaxed))
+    return;
+
+  ForgeLogRing *ring = local_ring ? local_ring : ring_attach();
+  if (!ring)
+    return;
+
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+  if (head - tail >= FORGE_LOG_RING_SIZE)
+  {
+    atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+    return;
+  }
+
+  ForgeLogEntry *e = &ring->entries[head & (FORGE_LOG_RING_SIZE - 1)];
+  uint64_t now = forge_access_log_clock();
+
+  e->ts_ns = wall_clock_ns();
+  e->duration_us = (uint32_t)((now - start_ns) / 1000);
+  e->bytes = bytes > UINT32_MAX ? UINT32_MAX : (uint32_t)bytes;
+  e->peer = peer_ipv4;
+  e->status = (uint16_t)status;
+
+  if (req)
+  {
+    size_t path_len = strnlen(req->path, FORGE_MAX_PATH);
+    if (path_len > LOG_PATH_MAX)
+      path_len = LOG_PATH_MAX;
+
+    memcpy(e->method, req->method, FORGE_MAX_METHOD);
+    memcpy(e->path, req->path, path_len);
+
+    /* The query as far as it fits */
+    if (req->query[0] && path_len < LOG_PATH_MAX)
+    {
+      size_t query_len = strnlen(req->query, FORGE_MAX_PATH);
+      e->path[path_len++] = '?';
+      if (query_len > LOG_PATH_MAX - path_len)
+        query_len = LOG_PATH_MAX - path_len;
+      memcpy(e->path + path_len, req->query, query_len);
+      path_len += query_len;
+    }
+    e->path_len = (uint8_t)path_len;
+    e->http_version = (uint8_t)((req->version[5] - '0') * 10 +
+                                (req->version[7] - '0'));
+  }
+  else
+  {
+    memcpy(e->method, "-", 2);
+    e->path[0] = '-';
+    e->path_len = 1;
+    e->http_version = 11;
+  }
+
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+unsigned long long forge_access_log_dropped(void)
+{
+  unsigned long long total = 0;
+  for (ForgeLogRing *r = atomic_load(&rings); r; r = r->next)
+    total += atomic_load_explicit(&r->dropped, memory_order_relaxed);
+  return total;
+}
+
+/* =========================================================
+   Encoders (writer thread / offline decoder)
+   ========================================================= */
+
+/*
+ * The path is decoded, so it can hold any byte: quotes, backslashes,
+ * controls and non-ASCII are written as \xHH to keep one request per
+ * line. `out` holds 4 bytes per input byte.
+ */
+static size_t escape_path(const char *path, size_t len, char *out)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  size_t n = 0;
+
+  for (size_t i = 0; i < len; i++)
+  {
+    unsigned char ch = (unsigned char)path[i];
+    if (ch < 0x20 || ch >= 0x7f || ch == '"' || ch == '\\')
+    {
+      out[n++] = '\\';
+      out[n++] = 'x';
+      out[n++] = hex[ch >> 4];
+      out[n++] = hex[ch & 15];
+    }
+    else
+      out[n++] = (char)ch;
+  }
+  return n;
+}
+
+static size_t format_text(const ForgeLogEntry *e, char *out, size_t cap)
+{
+  char peer[16] = "-";
+  if (e->peer)
+  {
+    const unsigned char *b = (const unsigned char *)&e->peer;
+    snprintf(peer, sizeof(peer), "%u.%u.%u.%u", b[0], b[1], b[2], b[3]);
+  }
+
+  time_t secs = (time_t)(e->ts_ns / 1000000000ull);
+  struct tm tm;
+#ifdef _WIN32
+  gmtime_s(&tm, &secs);
+#else
+  gmtime_r(&secs, &tm);
+#endif
+
+  char when[32];
+  strftime(when, sizeof(when), "%d/%b/%Y:%H:%M:%S +0000", &tm);
+
+  char path[LOG_PATH_MAX * 4];
+  size_t path_len = escape_path(e->path, e->path_len, path);
+
+  int n = snprintf(out, cap,
+                   "%s - - [%s] \"%.*s %.*s HTTP/%u.%u\" %u %u %uus\n",
+                   peer,
+                   when,
+                   (int)strnlen(e->method, FORGE_MAX_METHOD), e->method,
+                   (int)path_len, path,
+                   (unsigned)e->http_version / 10,
+                   (unsigned)e->http_version % 10,
+                   (unsigned)e->status,
+                   (unsigned)e->bytes,
+                   (unsigned)e->duration_us);
+
+  if (n < 0)
+    return 0;
+  return (size_t)n < cap ? (size_t)n : cap - 1;
+}
+
+static void put_le(unsigned char *p, uint64_t v, int n)
+{
+  for (int i = 0; i < n; i++)
+    p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static uint64_t get_le(const unsigned char *p, int n)
+{
+  uint64_t v = 0;
+  for (int i = 0; i < n; i++)
+    v |= (uint64_t)p[i] << (8 * i);
+  return v;
+}
+
+/*
+ * Binary record:
+ *   u8 len | u64 ts_ns | u32 dur_us | u32 bytes | u32 peer |
+ *   u16 status | u8 http_version | u8 mlen | method | u8 plen | path
+ * Integers are little-endian; `len` covers the whole record.
+ */
+#define BIN_FIXED 25
+
+static size_t encode_binary(const ForgeLogEntry *e, unsigned char *out)
+{
+  size_t mlen = strnlen(e->method, FORGE_MAX_METHOD - 1);
+  unsigned char *p = out + 1;
+
+  put_le(p, e->ts_ns, 8), p += 8;
+  put_le(p, e->duration_us, 4), p += 4;
+  put_le(p, e->bytes, 4), p += 4;
+  memcpy(p, &e->peer, 4), p += 4;
+  put_le(p, e->status, 2), p += 2;
+  *p++ = e->http_version;
+  *p++ = (unsigned char)mlen;
+  memcpy(p, e->method, mlen), p += mlen;
+  *p++ = e->path_len;
+  memcpy(p, e->path, e->path_len), p += e->path_len;
+
+  out[0] = (unsigned char)(p - out);
+  return (size_t)(p - out);
+}
+
+static int decode_binary(const unsigned char *rec, size_t len, ForgeLogEntry *e)
+{
+  if (len < BIN_FIXED + 1)
+    return -1;
+
+  const unsigned char *p = rec + 1;
+  const unsigned char *end = rec + len;
+
+  memset(e, 0, sizeof(*e));
+  e->ts_ns = get_le(p, 8), p += 8;
+  e->duration_us = (uint32_t)get_le(p, 4), p += 4;
+  e->bytes = (uint32_t)get_le(p, 4), p += 4;
+  memcpy(&e->peer, p, 4), p += 4;
+  e->status = (uint16_t)get_le(p, 2), p += 2;
+  e->http_version = *p++;
+
+  size_t mlen = *p++;
+  if (mlen >= FORGE_MAX_METHOD || p + mlen + 1 > end)
+    return -1;
+  memcpy(e->method, p, mlen), p += mlen;
+
+  size_t plen = *p++;
+  if (plen > LOG_PATH_MAX || p + plen != end)
+    return -1;
+  memcpy(e->path, p, plen);
+  e->path_len = (uint8_t)plen;
+  return 0;
+}
+
+/* =========================================================
+   Writer Thread
+   ========================================================= */
+
+typedef struct
+{
+  char data[LOG_BATCH_SIZE];
+  size_t len;
+} LogBatch;
+
+static void batch_flush(LogBatch *b)
+{
+  if (b->len == 0)
+    return;
+  fwrite(b->data, 1, b->len, log_file);
+  fflush(log_file);
+  b->len = 0;
+}
+
+static size_t drain_rings(LogBatch *b)
+{
+  size_t drained = 0;
+
+  for (ForgeLogRing *r = atomic_load(&rings); r; r = r->next)
+  {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+
+    while (tail != head)
+    {
+      if (LOG_BATCH_SIZE - b->len < LOG_LINE_MAX)
+        batch_flush(b);
+
+      const ForgeLogEntry *e = &r->entries[tail & (FORGE_LOG_RING_SIZE - 1)];
+      if (log_format == FORGE_LOG_BINARY)
+        b->len += encode_binary(e, (unsigned char *)b->data + b->len);
+      else
+        b->len += format_text(e, b->data + b->len, LOG_BATCH_SIZE - b->len);
+
+      tail++;
+      drained++;
+    }
+
+    atomic_store_explicit(&r->tail, tail, memory_order_release);
+  }
+
+  return drained;
+}
+
+static void *writer_main(void *arg)
+{
+  LogBatch *batch = arg;
+
+  while (!atomic_load(&writer_stop))
+  {
+    if (drain_rings(batch) == 0)
+      sleep_ms(LOG_IDLE_MS);
+    batch_flush(batch);
+  }
+
+  drain_rings(batch);
+  batch_flush(batch);
+  free(batch);
+  return NULL;
+}
+
+/* =========================================================
+   Lifecycle
+   ========================================================= */
+
+int forge_access_log_open(const char *path, ForgeLogFormat format)
+{
+  if (!path || log_file)
+    return -1;
+
+  LogBatch *batch = malloc(sizeof(*batch));
+  if (!batch)
+    return -1;
+  batch->len = 0;
+
+  log_file = fopen(path, format == FORGE_LOG_BINARY ? "ab" : "a");
+  if (!log_file)
+  {
+    perror("access log open failed");
+    free(batch);
+    return -1;
+  }
+
+  log_format = format;
+  if (format == FORGE_LOG_BINARY)
+  {
+    fseek(log_file, 0, SEEK_END);
+    if (ftell(log_file) == 0)
+      fwrite(FORGE_LOG_MAGIC, 1, strlen(FORGE_LOG_MAGIC), log_file);
+  }
+
+  atomic_store(&writer_stop, 0);
+  if (pthread_create(&writer_thread, NULL, writer_main, batch) != 0)
+  {
+    fclose(log_file);
+    log_file = NULL;
+    free(batch);
+    return -1;
+  }
+
+  atomic_store(&log_enabled, 1);
+  return 0;
+}
+
+/* The writer thread did not survive fork(): start the child's own */
+void forge_access_log_after_fork(void)
+{
+  if (!log_file || !atomic_load(&log_enabled))
+    return;
+
+  /* The parent's rings belong to threads this process does not have */
+  atomic_store(&rings, NULL);
+  local_ring = NULL;
+
+  LogBatch *batch = malloc(sizeof(*batch));
+  if (batch)
+    batch->len = 0;
+  if (!batch || pthread_create(&writer_thread, NULL, writer_main, batch) != 0)
+  {
+    free(batch);
+    atomic_store(&log_enabled, 0);
+  }
+}
+
+void forge_access_log_close(void)
+{
+  if (!log_file)
+    return;
+
+  atomic_store(&log_enabled, 0);
+  atomic_store(&writer_stop, 1);
+  pthread_join(writer_thread, NULL);
+
+  fclose(log_file);
+  log_file = NULL;
+}
+
+/* =========================================================
+   Offline Decoder
+   ========================================================= */
+
+long forge_access_log_decode(FILE *in, FILE *out)
+{
+  char magic[sizeof(FORGE_LOG_MAGIC) - 1];
+  if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) ||
+      memcmp(magic, FORGE_LOG_MAGIC, sizeof(magic)) != 0)
+    return -1;
+
+  long count = 0;
+  int len;
+
+  while ((len = fgetc(in)) != EOF)
+  {
+    unsigned char rec[256];
+    rec[0] = (unsigned char)len;
+
+    if (len < BIN_FIXED + 1 ||
+        fread(rec + 1, 1, (size_t)len - 1, in) != (size_t)len - 1)
+      return -1;
+
+    ForgeLogEntry e;
+    if (decode_binary(rec, (size_t)len, &e) != 0)
+      return -1;
+
+    char line[LOG_LINE_MAX];
+    fwrite(line, 1, format_text(&e, line, sizeof(line)), out);
+    count++;
+  }
+
+  return count;
+}
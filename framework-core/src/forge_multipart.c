@@ -0,0 +1,543 @@
+#define _GNU_SOURCE
+#include "forge_multipart.h"
+#include "forge_http.h"
+#include "forge_internal.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+/* =========================================================
+   Parser State
+   ========================================================= */
+
+#define DELIM_MAX (4 + FORGE_MULTIPART_MAX_BOUNDARY)
+
+typedef enum
+{
+  MP_PREAMBLE = 0, /* before the first boundary */
+  MP_AFTER_DELIM,  /* boundary seen: "--" ends the form, CRLF a part */
+  MP_DASH,
+  MP_CR,
+  MP_HEADERS,
+  MP_BODY,
+  MP_EPILOGUE
+} MpState;
+
+struct ForgeMultipart
+{
+  const ForgeMultipartHandler *handler;
+  void *user;
+  MpState state;
+  int error; /* sticky negative code */
+  int parts;
+
+  /* "\r\n--boundary" and its Horspool shift table */
+  char delim[DELIM_MAX];
+  size_t delim_len;
+  unsigned char shift[256];
+
+  /* Tail of the last piece that may start a delimiter */
+  char carry[DELIM_MAX];
+  size_t carry_len;
+
+  char headers[FORGE_MULTIPART_MAX_HEADERS];
+  size_t headers_len;
+
+  /* Part in progress */
+  ForgeMultipartPart part;
+  ForgeSha256 sha;
+  int spool_fd;
+  char name[256];
+  char filename[256];
+  char content_type[128];
+  char spool_path[512];
+};
+
+static int ieq_prefix(const char *s, size_t len, const char *prefix)
+{
+  size_t n = strlen(prefix);
+  if (len < n)
+    return 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    if (tolower((unsigned char)s[i]) != prefix[i])
+      return 0;
+  }
+  return 1;
+}
+
+/* memmem() is not portable */
+static const char *find_bytes(const char *hay, size_t n, const char *needle, size_t m)
+{
+  while (n >= m)
+  {
+    const char *p = memchr(hay, needle[0], n - m + 1);
+    if (!p)
+      return NULL;
+    if (memcmp(p, needle, m) == 0)
+      return p;
+    n -= (size_t)(p + 1 - hay);
+    hay = p + 1;
+  }
+  return NULL;
+}
+
+/*
+ * Value of parameter `key` in "type; a=b; key="v"" into `out`.
+ * Returns its length, -1 when absent, -2 when it does not fit.
+ */
+static int header_param(const char *v, size_t len, const char *key,
+                        char *out, size_t cap)
+{
+  size_t key_len = strlen(key);
+  size_t i = 0;
+
+  while (i < len)
+  {
+    /* Next parameter starts after ';' */
+    while (i < len && v[i] != ';')
+    {
+      if (v[i] == '"')
+        for (i++; i < len && v[i] != '"'; i++)
+          i += v[i] == '\\';
+      i++;
+    }
+    i++;
+    while (i < len && (v[i] == ' ' || v[i] == '\t'))
+      i++;
+
+    if (!(i + key_len < len && ieq_prefix(v + i, len - i, key) && v[i + key_len] == '='))
+      continue;
+
+    i += key_len + 1;
+    size_t n = 0;
+    if (i < len && v[i] == '"')
+    {
+      for (i++; i < len && v[i] != '"'; i++)
+      {
+        if (v[i] == '\\' && i + 1 < len)
+          i++;
+        if (n + 1 >= cap)
+          return -2;
+        out[n++] = v[i];
+      }
+    }
+    else
+    {
+      for (; i < len && v[i] != ';' && v[i] != ' ' && v[i] != '\t'; i++)
+      {
+        if (n + 1 >= cap)
+          return -2;
+        out[n++] = v[i];
+      }
+    }
+    out[n] = '\0';
+    return (int)n;
+  }
+  return -1;
+}
+
+ForgeMultipart *forge_multipart_new(const char *content_type, size_t len,
+                                    const ForgeMultipartHandler *handler,
+                                    void *user)
+{
+  if (!content_type || !handler || !ieq_prefix(content_type, len, "multipart/"))
+    return NULL;
+
+  char boundary[FORGE_MULTIPART_MAX_BOUNDARY + 2];
+  int blen = header_param(content_type, len, "boundary", boundary, sizeof(boundary));
+  if (blen <= 0 || blen > FORGE_MULTIPART_MAX_BOUNDARY)
+    return NULL;
+
+  /* CR only ever starts the delimiter, which the carry logic relies on */
+  for (int i = 0; i < blen; i++)
+  {
+    if (boundary[i] == '\r' || boundary[i] == '\n')
+      return NULL;
+  }
+
+  ForgeMultipart *mp = calloc(1, sizeof(*mp));
+  if (!mp)
+    return NULL;
+
+  mp->handler = handler;
+  mp->user = user;
+  mp->spool_fd = -1;
+
+  memcpy(mp->delim, "\r\n--", 4);
+  memcpy(mp->delim + 4, boundary, (size_t)blen);
+  mp->delim_len = 4 + (size_t)blen;
+
+  memset(mp->shift, (int)mp->delim_len, sizeof(mp->shift));
+  for (size_t i = 0; i + 1 < mp->delim_len; i++)
+    mp->shift[(unsigned char)mp->delim[i]] = (unsigned char)(mp->delim_len - 1 - i);
+
+  /* The body may open with the boundary: pretend a CRLF came first */
+  memcpy(mp->carry, "\r\n", 2);
+  mp->carry_len = 2;
+  return mp;
+}
+
+/* =========================================================
+   Parts
+   ========================================================= */
+
+static int parse_part_headers(ForgeMultipart *mp)
+{
+  mp->name[0] = '\0';
+  mp->filename[0] = '\0';
+  mp->content_type[0] = '\0';
+  int has_filename = 0;
+
+  const char *p = mp->headers;
+  const char *end = mp->headers + mp->headers_len - 2; /* final CRLF */
+
+  while (p < end)
+  {
+    const char *eol = find_bytes(p, (size_t)(end - p + 2), "\r\n", 2);
+    const char *colon = memchr(p, ':', (size_t)(eol - p));
+    if (!colon)
+      return FORGE_MULTIPART_MALFORMED;
+
+    const char *v = colon + 1;
+    while (v < eol && (*v == ' ' || *v == '\t'))
+      v++;
+    size_t v_len = (size_t)(eol - v);
+    size_t name_len = (size_t)(colon - p);
+
+    if (name_len == 19 && ieq_prefix(p, name_len, "content-disposition"))
+    {
+      int name = header_param(v, v_len, "name", mp->name, sizeof(mp->name));
+      int file = header_param(v, v_len, "filename", mp->filename, sizeof(mp->filename));
+      if (name == -2 || file == -2)
+        return FORGE_MULTIPART_MALFORMED;
+      has_filename = file >= 0;
+    }
+    else if (name_len == 12 && ieq_prefix(p, name_len, "content-type"))
+    {
+      while (v_len > 0 && (v[v_len - 1] == ' ' || v[v_len - 1] == '\t'))
+        v_len--;
+      if (v_len >= sizeof(mp->content_type))
+        return FORGE_MULTIPART_MALFORMED;
+      memcpy(mp->content_type, v, v_len);
+      mp->content_type[v_len] = '\0';
+    }
+
+    p = eol + 2;
+  }
+
+  memset(&mp->part, 0, sizeof(mp->part));
+  mp->part.name = mp->name;
+  mp->part.filename = has_filename ? mp->filename : NULL;
+  mp->part.content_type = mp->content_type;
+  return 0;
+}
+
+static int part_begin(ForgeMultipart *mp)
+{
+  int rc = parse_part_headers(mp);
+  if (rc < 0)
+    return rc;
+
+  forge_sha256_init(&mp->sha);
+
+  if (mp->part.filename && mp->handler->spool_dir)
+  {
+#ifdef _WIN32
+    return FORGE_MULTIPART_IO;
+#else
+    int n = snprintf(mp->spool_path, sizeof(mp->spool_path),
+                     "%s/forge-upload-XXXXXX", mp->handler->spool_dir);
+    if (n < 0 || (size_t)n >= sizeof(mp->spool_path))
+      return FORGE_MULTIPART_IO;
+
+    mp->spool_fd = mkstemp(mp->spool_path);
+    if (mp->spool_fd < 0)
+      return FORGE_MULTIPART_IO;
+    mp->part.spool_path = mp->spool_path;
+#endif
+  }
+
+  if (mp->handler->on_part_begin)
+    return mp->handler->on_part_begin(&mp->part, mp->user);
+  return 0;
+}
+
+static int part_data(ForgeMultipart *mp, const char *data, size_t len)
+{
+  if (mp->state != MP_BODY || len == 0)
+    return 0; /* preamble is ignored */
+
+  mp->part.size += len;
+  forge_sha256_update(&mp->sha, data, len);
+
+  if (mp->spool_fd >= 0)
+    return forge_conn_write_all(mp->spool_fd, data, len) == 0 ? 0 : FORGE_MULTIPART_IO;
+  if (mp->handler->on_part_data)
+    return mp->handler->on_part_data(&mp->part, data, len, mp->user);
+  return 0;
+}
+
+static int part_end(ForgeMultipart *mp)
+{
+  forge_sha256_final(&mp->sha, mp->part.sha256);
+
+#ifndef _WIN32
+  if (mp->spool_fd >= 0)
+  {
+    int rc = close(mp->spool_fd);
+    mp->spool_fd = -1;
+    if (rc != 0)
+    {
+      unlink(mp->spool_path);
+      return FORGE_MULTIPART_IO;
+    }
+  }
+#endif
+
+  /* From here on the spool file is the caller's */
+  mp->parts++;
+  if (mp->handler->on_part_end)
+    return mp->handler->on_part_end(&mp->part, mp->user);
+  return 0;
+}
+
+/* =========================================================
+   Boundary Search
+   ========================================================= */
+
+/* First full delimiter in `d` (Horspool), or -1 */
+static long find_delim(const ForgeMultipart *mp, const char *d, size_t n)
+{
+  const unsigned char *p = (const unsigned char *)d;
+  size_t dl = mp->delim_len;
+  unsigned char last = (unsigned char)mp->delim[dl - 1];
+
+  for (size_t i = 0; i + dl <= n; i += mp->shift[p[i + dl - 1]])
+  {
+    if (p[i + dl - 1] == last && memcmp(p + i, mp->delim, dl - 1) == 0)
+      return (long)i;
+  }
+  return -1;
+}
+
+static int delimiter_seen(ForgeMultipart *mp)
+{
+  int rc = mp->state == MP_BODY ? part_end(mp) : 0;
+  mp->state = MP_AFTER_DELIM;
+  return rc;
+}
+
+/*
+ * Preamble or part data: pass on everything up to the next
+ * delimiter. A tail that could be the start of one is held in
+ * `carry` until the next piece decides. Returns bytes consumed.
+ */
+static long scan_data(ForgeMultipart *mp, const char *d, size_t n)
+{
+  size_t dl = mp->delim_len;
+  int rc;
+
+  if (mp->carry_len > 0)
+  {
+    size_t k = mp->carry_len;
+    size_t m = n < dl - k ? n : dl - k;
+
+    if (memcmp(d, mp->delim + k, m) == 0)
+    {
+      if (k + m < dl)
+      {
+        memcpy(mp->carry + k, d, m);
+        mp->carry_len += m;
+        return (long)m;
+      }
+      mp->carry_len = 0;
+      rc = delimiter_seen(mp);
+      return rc < 0 ? rc : (long)m;
+    }
+
+    /* Not a delimiter after all, and CR only starts one at carry[0] */
+    mp->carry_len = 0;
+    rc = part_data(mp, mp->carry, k);
+    return rc < 0 ? rc : 0;
+  }
+
+  long pos = find_delim(mp, d, n);
+  if (pos >= 0)
+  {
+    rc = part_data(mp, d, (size_t)pos);
+    if (rc == 0)
+      rc = delimiter_seen(mp);
+    return rc < 0 ? rc : pos + (long)dl;
+  }
+
+  size_t keep = n;
+  for (size_t i = n > dl - 1 ? n - (dl - 1) : 0; i < n; i++)
+  {
+    if (d[i] == '\r' && memcmp(d + i, mp->delim, n - i) == 0)
+    {
+      keep = i;
+      break;
+    }
+  }
+
+  rc = part_data(mp, d, keep);
+  if (rc < 0)
+    return rc;
+  memcpy(mp->carry, d + keep, n - keep);
+  mp->carry_len = n - keep;
+  return (long)n;
+}
+
+/* Collect a part's header block; returns bytes consumed */
+static long scan_headers(ForgeMultipart *mp, const char *d, size_t n)
+{
+  size_t old = mp->headers_len;
+  size_t room = sizeof(mp->headers) - old;
+  size_t take = n < room ? n : room;
+
+  memcpy(mp->headers + old, d, take);
+  mp->headers_len += take;
+
+  /* No headers at all, or the blank line ending them */
+  size_t end = 0;
+  if (mp->headers_len >= 2 && memcmp(mp->headers, "\r\n", 2) == 0)
+    end = 2;
+  else
+  {
+    size_t from = old > 3 ? old - 3 : 0;
+    const char *blank = find_bytes(mp->headers + from, mp->headers_len - from,
+                                   "\r\n\r\n", 4);
+    if (blank)
+      end = (size_t)(blank - mp->headers) + 4;
+  }
+
+  if (end == 0)
+  {
+    if (mp->headers_len == sizeof(mp->headers))
+      return FORGE_MULTIPART_MALFORMED;
+    return (long)take;
+  }
+
+  mp->headers_len = end;
+  mp->state = MP_BODY;
+  int rc = part_begin(mp);
+  return rc < 0 ? rc : (long)(end - old);
+}
+
+/* =========================================================
+   Feeding
+   ========================================================= */
+
+int forge_multipart_feed(ForgeMultipart *mp, const char *data, size_t len)
+{
+  while (len > 0 && mp->error == 0)
+  {
+    long used = 1;
+
+    switch (mp->state)
+    {
+    case MP_PREAMBLE:
+    case MP_BODY:
+      used = scan_data(mp, data, len);
+      break;
+
+    case MP_AFTER_DELIM:
+      if (*data == '-')
+        mp->state = MP_DASH;
+      else if (*data == '\r')
+        mp->state = MP_CR;
+      else if (*data != ' ' && *data != '\t') /* transport padding */
+        used = FORGE_MULTIPART_MALFORMED;
+      break;
+
+    case MP_DASH:
+      if (*data == '-')
+        mp->state = MP_EPILOGUE;
+      else
+        used = FORGE_MULTIPART_MALFORMED;
+      break;
+
+    case MP_CR:
+      if (*data == '\n')
+      {
+        mp->state = MP_HEADERS;
+        mp->headers_len = 0;
+      }
+      else
+        used = FORGE_MULTIPART_MALFORMED;
+      break;
+
+    case MP_HEADERS:
+      used = scan_headers(mp, data, len);
+      break;
+
+    case MP_EPILOGUE:
+      used = (long)len;
+      break;
+    }
+
+    if (used < 0)
+      mp->error = (int)used;
+    else
+    {
+      data += used;
+      len -= (size_t)used;
+    }
+  }
+  return mp->error;
+}
+
+int forge_multipart_finish(ForgeMultipart *mp)
+{
+  if (mp->error)
+    return mp->error;
+  return mp->state == MP_EPILOGUE ? mp->parts : FORGE_MULTIPART_MALFORMED;
+}
+
+void forge_multipart_free(ForgeMultipart *mp)
+{
+  if (!mp)
+    return;
+
+#ifndef _WIN32
+  if (mp->spool_fd >= 0)
+  {
+    close(mp->spool_fd);
+    unlink(mp->spool_path);
+  }
+#endif
+  free(mp);
+}
+
+static int feed_body(const char *data, size_t len, void *user)
+{
+  return forge_multipart_feed(user, data, len);
+}
+
+int forge_multipart_read(const ForgeHttpRequest *req,
+                         const ForgeMultipartHandler *handler,
+                         void *user)
+{
+  const ForgeHttpHeader *type = forge_header_get(req, FORGE_HDR_CONTENT_TYPE);
+  if (!type)
+    return FORGE_MULTIPART_MALFORMED;
+
+  ForgeMultipart *mp = forge_multipart_new(type->value, type->value_len,
+                                           handler, user);
+  if (!mp)
+    return FORGE_MULTIPART_MALFORMED;
+
+  long long rc = forge_body_stream(req, feed_body, mp);
+  int parts = rc < 0 ? (int)rc : forge_multipart_finish(mp);
+
+  forge_multipart_free(mp);
+  return parts;
+}
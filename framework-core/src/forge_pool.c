@@ -0,0 +1,448 @@
+#define _GNU_SOURCE
+#include "forge_pool.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+/* =========================================================
+   Size Classes
+   ========================================================= */
+
+/*
+ * 512 B holds a connection's state, or the receive buffer of a
+ * typical request; 4 KB and 64 KB are the buffer's larger tiers.
+ */
+static const size_t class_sizes[FORGE_POOL_CLASSES] = {512, 4096, 16384, 32768, 65536};
+
+#define POOL_CLASSES FORGE_POOL_CLASSES
+
+static int class_of(size_t size)
+{
+  for (int i = 0; i < POOL_CLASSES; i++)
+  {
+    if (size <= class_sizes[i])
+      return i;
+  }
+  return -1;
+}
+
+#ifdef _WIN32
+
+void *forge_pool_alloc(size_t size)
+{
+  return class_of(size) < 0 ? NULL : malloc(size);
+}
+
+void forge_pool_free(void *buf)
+{
+  free(buf);
+}
+
+int forge_pool_stats(ForgePoolStats *out, int max)
+{
+  (void)out;
+  (void)max;
+  return 0;
+}
+
+#else
+
+/* =========================================================
+   Pools
+   ========================================================= */
+
+typedef struct PoolSlot
+{
+  struct PoolSlot *next;
+} PoolSlot;
+
+typedef struct
+{
+  pthread_mutex_t lock;
+  int node;
+  size_t slot_size;
+
+  PoolSlot *free_list;
+  char *fresh;     /* never handed out yet: carved lazily, untouched */
+  char *fresh_end;
+
+  uint64_t slots_used;
+  uint64_t slots_total;
+  uint64_t regions;
+  uint64_t hugetlb_regions;
+} Pool;
+
+/* Lives in the first slot(s) of every region */
+typedef struct
+{
+  Pool *pool;
+} RegionHeader;
+
+static Pool pools[FORGE_POOL_MAX_NODES][POOL_CLASSES];
+static int node_count = 1;
+static pthread_once_t pools_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Slots a thread freed, reused by that thread without the pool
+ * lock: a core's connection churn never touches the mutex. At most
+ * CACHE_BYTES per class; a full cache hands half back in one lock.
+ * Only the owner writes `count`; stats read it to count the slots
+ * as free. A thread's cache goes back to the pools when it exits
+ * and is then claimed by the next new thread on that node.
+ */
+#define CACHE_BYTES (64 * 1024)
+
+typedef struct ThreadCache
+{
+  struct ThreadCache *next; /* every cache ever made; never unlinked */
+  atomic_int claimed;
+  int node;
+  PoolSlot *slots[POOL_CLASSES];
+  _Atomic uint64_t count[POOL_CLASSES];
+} ThreadCache;
+
+static _Atomic(ThreadCache *) caches = NULL;
+static pthread_key_t cache_key;
+static _Thread_local ThreadCache *local_cache = NULL;
+
+static void cache_release(void *arg);
+
+/* Node this thread allocates from; -1 until its first allocation */
+static _Thread_local int local_node = -1;
+
+/* "0-1" or "0,2-3" from sysfs: the highest node id + 1 */
+static int detect_nodes(void)
+{
+  FILE *f = fopen("/sys/devices/system/node/online", "r");
+  if (!f)
+    return 1;
+
+  char line[128];
+  int max = 0;
+  if (fgets(line, sizeof(line), f))
+  {
+    for (char *p = line; *p;)
+    {
+      char *end;
+      long v = strtol(p, &end, 10);
+      if (end == p)
+      {
+        p++;
+        continue;
+      }
+      if (v > max)
+        max = (int)v;
+      p = end;
+    }
+  }
+  fclose(f);
+
+  return max + 1 > FORGE_POOL_MAX_NODES ? FORGE_POOL_MAX_NODES : max + 1;
+}
+
+static void pools_init(void)
+{
+  node_count = detect_nodes();
+  pthread_key_create(&cache_key, cache_release);
+
+  for (int n = 0; n < FORGE_POOL_MAX_NODES; n++)
+  {
+    for (int c = 0; c < POOL_CLASSES; c++)
+    {
+      pthread_mutex_init(&pools[n][c].lock, NULL);
+      pools[n][c].node = n;
+      pools[n][c].slot_size = class_sizes[c];
+    }
+  }
+}
+
+static int current_node(void)
+{
+  if (local_node >= 0)
+    return local_node;
+
+  unsigned cpu = 0, node = 0;
+#ifdef SYS_getcpu
+  if (node_count > 1 && syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+    node = 0;
+#endif
+  (void)cpu;
+
+  local_node = (int)node < node_count ? (int)node : 0;
+  return local_node;
+}
+
+/* =========================================================
+   Regions
+   ========================================================= */
+
+#define MPOL_PREFERRED_MODE 1
+
+/* Prefer `node` for the region's pages; they are not touched yet */
+static void region_bind(void *base, int node)
+{
+#ifdef SYS_mbind
+  if (node_count < 2)
+    return;
+
+  unsigned long mask = 1UL << node;
+  if (syscall(SYS_mbind, base, FORGE_POOL_REGION, MPOL_PREFERRED_MODE,
+              &mask, (unsigned long)(sizeof(mask) * 8), 0) != 0)
+    perror("mbind");
+#else
+  (void)base;
+  (void)node;
+#endif
+}
+
+/* One 2 MB-aligned region; *hugetlb says whether it is hugetlbfs */
+static void *region_map(int *hugetlb)
+{
+#ifdef MAP_HUGETLB
+  void *huge = mmap(NULL, FORGE_POOL_REGION, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (huge != MAP_FAILED)
+  {
+    *hugetlb = 1;
+    return huge;
+  }
+#endif
+
+  /* No reserved huge pages: map twice the size, keep an aligned 2 MB */
+  char *raw = mmap(NULL, FORGE_POOL_REGION * 2, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED)
+    return NULL;
+
+  char *base = (char *)(((uintptr_t)raw + FORGE_POOL_REGION - 1) &
+                        ~(uintptr_t)(FORGE_POOL_REGION - 1));
+  if (base > raw)
+    munmap(raw, (size_t)(base - raw));
+  char *tail = base + FORGE_POOL_REGION;
+  if (tail < raw + FORGE_POOL_REGION * 2)
+    munmap(tail, (size_t)(raw + FORGE_POOL_REGION * 2 - tail));
+
+#ifdef MADV_HUGEPAGE
+  madvise(base, FORGE_POOL_REGION, MADV_HUGEPAGE);
+#endif
+
+  *hugetlb = 0;
+  return base;
+}
+
+/* Called with the pool locked */
+static int pool_grow(Pool *pool)
+{
+  int hugetlb = 0;
+  char *base = region_map(&hugetlb);
+  if (!base)
+    return -1;
+
+  region_bind(base, pool->node);
+
+  RegionHeader *header = (RegionHeader *)base;
+  header->pool = pool;
+
+  /* The header takes the first slot(s) */
+  size_t skip = (sizeof(RegionHeader) + pool->slot_size - 1) / pool->slot_size;
+
+  pool->fresh = base + skip * pool->slot_size;
+  pool->fresh_end = base + FORGE_POOL_REGION;
+  pool->slots_total += FORGE_POOL_REGION / pool->slot_size - skip;
+  pool->regions++;
+  pool->hugetlb_regions += (uint64_t)hugetlb;
+  return 0;
+}
+
+/* =========================================================
+   Thread Caches
+   ========================================================= */
+
+/* Return `n` slots from `tc`'s class `cls` list to its pool */
+static void cache_spill(ThreadCache *tc, int cls, uint64_t n)
+{
+  Pool *pool = &pools[tc->node][cls];
+
+  pthread_mutex_lock(&pool->lock);
+  for (; n > 0 && tc->slots[cls]; n--)
+  {
+    PoolSlot *slot = tc->slots[cls];
+    tc->slots[cls] = slot->next;
+    atomic_fetch_sub_explicit(&tc->count[cls], 1, memory_order_relaxed);
+
+    slot->next = pool->free_list;
+    pool->free_list = slot;
+    pool->slots_used--;
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/* Thread exit: empty the cache and let another thread claim it */
+static void cache_release(void *arg)
+{
+  ThreadCache *tc = arg;
+
+  for (int c = 0; c < POOL_CLASSES; c++)
+    cache_spill(tc, c, UINT64_MAX);
+  local_cache = NULL;
+  atomic_store(&tc->claimed, 0);
+}
+
+/* This thread's cache, claimed or made on first use; NULL on OOM */
+static ThreadCache *cache_get(void)
+{
+  if (local_cache)
+    return local_cache;
+
+  int node = current_node();
+  ThreadCache *tc;
+  for (tc = atomic_load(&caches); tc; tc = tc->next)
+  {
+    int idle = 0;
+    if (tc->node == node && atomic_compare_exchange_strong(&tc->claimed, &idle, 1))
+      break;
+  }
+
+  if (!tc)
+  {
+    tc = calloc(1, sizeof(*tc));
+    if (!tc)
+      return NULL;
+    tc->node = node;
+    atomic_init(&tc->claimed, 1);
+
+    ThreadCache *head = atomic_load(&caches);
+    do
+    {
+      tc->next = head;
+    } while (!atomic_compare_exchange_weak(&caches, &head, tc));
+  }
+
+  pthread_setspecific(cache_key, tc);
+  local_cache = tc;
+  return tc;
+}
+
+/* =========================================================
+   API
+   ========================================================= */
+
+void *forge_pool_alloc(size_t size)
+{
+  int cls = class_of(size);
+  if (cls < 0)
+    return NULL;
+
+  pthread_once(&pools_once, pools_init);
+
+  ThreadCache *tc = cache_get();
+  if (tc && tc->slots[cls])
+  {
+    PoolSlot *slot = tc->slots[cls];
+    tc->slots[cls] = slot->next;
+    atomic_fetch_sub_explicit(&tc->count[cls], 1, memory_order_relaxed);
+    return slot;
+  }
+
+  Pool *pool = &pools[current_node()][cls];
+
+  pthread_mutex_lock(&pool->lock);
+
+  void *buf = NULL;
+  if (pool->free_list)
+  {
+    buf = pool->free_list;
+    pool->free_list = pool->free_list->next;
+  }
+  else if (pool->fresh < pool->fresh_end || pool_grow(pool) == 0)
+  {
+    buf = pool->fresh;
+    pool->fresh += pool->slot_size;
+  }
+
+  if (buf)
+    pool->slots_used++;
+
+  pthread_mutex_unlock(&pool->lock);
+  return buf;
+}
+
+void forge_pool_free(void *buf)
+{
+  if (!buf)
+    return;
+
+  RegionHeader *header = (RegionHeader *)((uintptr_t)buf &
+                                          ~(uintptr_t)(FORGE_POOL_REGION - 1));
+  Pool *pool = header->pool;
+  PoolSlot *slot = buf;
+
+  /* Kept by this thread if it came from its node */
+  ThreadCache *tc = cache_get();
+  if (tc && pool->node == tc->node)
+  {
+    int cls = (int)(pool - pools[pool->node]);
+    uint64_t limit = CACHE_BYTES / pool->slot_size;
+    uint64_t count = atomic_load_explicit(&tc->count[cls], memory_order_relaxed);
+
+    if (count >= limit)
+      cache_spill(tc, cls, (count + 1) / 2);
+    slot->next = tc->slots[cls];
+    tc->slots[cls] = slot;
+    atomic_fetch_add_explicit(&tc->count[cls], 1, memory_order_relaxed);
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  slot->next = pool->free_list;
+  pool->free_list = slot;
+  pool->slots_used--;
+  pthread_mutex_unlock(&pool->lock);
+}
+
+int forge_pool_stats(ForgePoolStats *out, int max)
+{
+  pthread_once(&pools_once, pools_init);
+
+  int n = 0;
+  for (int node = 0; node < node_count; node++)
+  {
+    for (int c = 0; c < POOL_CLASSES && n < max; c++)
+    {
+      Pool *pool = &pools[node][c];
+
+      /* Slots sitting in thread caches are free, not used */
+      uint64_t cached = 0;
+      for (ThreadCache *tc = atomic_load(&caches); tc; tc = tc->next)
+      {
+        if (tc->node == node)
+          cached += atomic_load_explicit(&tc->count[c], memory_order_relaxed);
+      }
+
+      pthread_mutex_lock(&pool->lock);
+      if (pool->regions > 0)
+      {
+        out[n].node = node;
+        out[n].slot_size = pool->slot_size;
+        out[n].slots_used = pool->slots_used > cached ? pool->slots_used - cached : 0;
+        out[n].slots_total = pool->slots_total;
+        out[n].regions = pool->regions;
+        out[n].hugetlb_regions = pool->hugetlb_regions;
+        n++;
+      }
+      pthread_mutex_unlock(&pool->lock);
+    }
+  }
+  return n;
+}
+
+#endif
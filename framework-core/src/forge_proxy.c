@@ -0,0 +1,1246 @@
+#define _GNU_SOURCE
+#include "forge_proxy.h"
+#include "forge_http.h"
+#include "forge_log.h"
+#include "forge_router.h"
+#include "forge_pool.h"
+#include "forge_internal.h"
+
+#include <ctype.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#endif
+
+#ifdef _WIN32
+
+ForgeProxy *forge_proxy_create(const char *const *upstreams, int count)
+{
+  (void)upstreams;
+  (void)count;
+  printf("the reverse proxy is not supported on Windows\n");
+  return NULL;
+}
+
+int forge_proxy_route(ForgeProxy *proxy,
+                      const char *method,
+                      const char *path,
+                      const char *upstream_path,
+                      size_t max_body)
+{
+  (void)proxy;
+  (void)method;
+  (void)path;
+  (void)upstream_path;
+  (void)max_body;
+  return -1;
+}
+
+int forge_proxy_stats(const ForgeProxy *proxy, int index,
+                      ForgeUpstreamStats *out)
+{
+  (void)proxy;
+  (void)index;
+  (void)out;
+  return -1;
+}
+
+void forge_proxy_set_threads(unsigned threads)
+{
+  (void)threads;
+}
+
+#else
+
+/* =========================================================
+   Configuration
+   ========================================================= */
+
+#define MAX_PROXIES 16
+#define IDLE_PER_UPSTREAM 8
+
+/* Pool slot holding an upstream ForgeConn and its response buffer */
+#define UPSTREAM_SLOT 16384
+
+#define CONNECT_TIMEOUT_MS 1000
+#define UPSTREAM_RECV_TIMEOUT_SEC 30
+#define UPSTREAM_DOWN_NS (1000ULL * 1000000ULL)
+#define RELAY_CHUNK (16 * 1024)
+
+typedef struct
+{
+  int id; /* index into the per-thread idle pools */
+  struct sockaddr_storage addr;
+  socklen_t addr_len;
+  char host[128]; /* Host header when the client sent none */
+
+  _Atomic uint64_t outstanding;
+  _Atomic uint64_t requests;
+  _Atomic uint64_t connect_failures;
+  _Atomic uint64_t reused;
+  _Atomic uint64_t down_until_ns;
+} Upstream;
+
+struct ForgeProxy
+{
+  Upstream upstreams[FORGE_PROXY_MAX_UPSTREAMS];
+  int count;
+  _Atomic unsigned next; /* rotates the tie-break among equals */
+};
+
+/*
+ * What a proxied route forwards to; the route table carries a pointer
+ * to it. Immutable once published and never freed: an old table may
+ * still be dispatching through it. Interned, so reload builds that
+ * register the same route again do not grow the list.
+ */
+typedef struct ProxyRoute
+{
+  struct ProxyRoute *next;
+  ForgeProxy *proxy;
+  const char *upstream_path;
+} ProxyRoute;
+
+/* Filled before launch, read-only while serving */
+static ForgeProxy proxies[MAX_PROXIES];
+static int proxy_count;
+
+static pthread_mutex_t routes_lock = PTHREAD_MUTEX_INITIALIZER;
+static ProxyRoute *proxy_routes;
+
+/* Idle keep-alive upstream connections of this thread */
+static _Thread_local struct
+{
+  ForgeConn *conns[MAX_PROXIES * FORGE_PROXY_MAX_UPSTREAMS][IDLE_PER_UPSTREAM];
+  int count[MAX_PROXIES * FORGE_PROXY_MAX_UPSTREAMS];
+} idle;
+
+/*
+ * A parked request handed to a proxy thread. For HTTP/1 the thread
+ * answers on the client socket itself; for HTTP/2 it fills in the
+ * response for the stream's core to send once resumed.
+ */
+typedef struct ProxyJob
+{
+  struct ProxyJob *next;
+  const ProxyRoute *route;
+  ForgeHttpRequest req;   /* points into the parked connection */
+  ForgeExchange exchange; /* the parked exchange; the outcome after */
+
+  char status[64]; /* HTTP/2 */
+  char content_type[256];
+  char *body;
+  size_t body_len;
+} ProxyJob;
+
+/* The HTTP/2 job this thread collects a response for, or NULL */
+static _Thread_local ProxyJob *collecting;
+
+static int parse_upstream(Upstream *u, const char *spec)
+{
+  memset(&u->addr, 0, sizeof(u->addr));
+
+  if (strncmp(spec, "unix:", 5) == 0)
+  {
+    struct sockaddr_un *un = (struct sockaddr_un *)&u->addr;
+    size_t len = strlen(spec + 5);
+    if (len == 0 || len >= sizeof(un->sun_path))
+      return -1;
+
+    un->sun_family = AF_UNIX;
+    memcpy(un->sun_path, spec + 5, len + 1);
+    u->addr_len = (socklen_t)sizeof(*un);
+    snprintf(u->host, sizeof(u->host), "localhost");
+    return 0;
+  }
+
+  const char *colon = strrchr(spec, ':');
+  if (!colon || colon == spec || (size_t)(colon - spec) >= sizeof(u->host))
+    return -1;
+
+  char ip[64];
+  size_t ip_len = (size_t)(colon - spec);
+  if (ip_len >= sizeof(ip))
+    return -1;
+  memcpy(ip, spec, ip_len);
+  ip[ip_len] = '\0';
+
+  char *end;
+  long port = strtol(colon + 1, &end, 10);
+  if (*end != '\0' || port < 1 || port > 65535)
+    return -1;
+
+  struct sockaddr_in *in = (struct sockaddr_in *)&u->addr;
+  in->sin_family = AF_INET;
+  in->sin_port = htons((uint16_t)port);
+  if (inet_pton(AF_INET, ip, &in->sin_addr) != 1)
+    return -1;
+
+  u->addr_len = (socklen_t)sizeof(*in);
+  snprintf(u->host, sizeof(u->host), "%s", spec);
+  return 0;
+}
+
+ForgeProxy *forge_proxy_create(const char *const *upstreams, int count)
+{
+  if (!upstreams || count < 1 || count > FORGE_PROXY_MAX_UPSTREAMS ||
+      proxy_count == MAX_PROXIES)
+    return NULL;
+
+  ForgeProxy *p = &proxies[proxy_count];
+  memset(p, 0, sizeof(*p));
+
+  for (int i = 0; i < count; i++)
+  {
+    if (parse_upstream(&p->upstreams[i], upstreams[i]) != 0)
+    {
+      fprintf(stderr, "proxy: bad upstream \"%s\"\n", upstreams[i]);
+      return NULL;
+    }
+    p->upstreams[i].id = proxy_count * FORGE_PROXY_MAX_UPSTREAMS + i;
+  }
+
+  p->count = count;
+  proxy_count++;
+  return p;
+}
+
+static void proxy_handler(const ForgeHttpRequest *req, int client_socket);
+
+static int same_path(const char *a, const char *b)
+{
+  return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+static ProxyRoute *intern_route(ForgeProxy *proxy, const char *upstream_path)
+{
+  pthread_mutex_lock(&routes_lock);
+
+  ProxyRoute *r = proxy_routes;
+  while (r && !(r->proxy == proxy && same_path(r->upstream_path, upstream_path)))
+    r = r->next;
+
+  if (!r && (r = malloc(sizeof(*r))))
+  {
+    r->proxy = proxy;
+    r->upstream_path = upstream_path;
+    r->next = proxy_routes;
+    proxy_routes = r;
+  }
+
+  pthread_mutex_unlock(&routes_lock);
+  return r;
+}
+
+int forge_proxy_route(ForgeProxy *proxy,
+                      const char *method,
+                      const char *path,
+                      const char *upstream_path,
+                      size_t max_body)
+{
+  if (!proxy || (upstream_path && upstream_path[0] != '/'))
+    return -1;
+
+  ProxyRoute *r = intern_route(proxy, upstream_path);
+  if (!r)
+    return -1;
+
+  /* Bodies are forwarded as they arrive, not staged first */
+  if (forge_server_stream_body(proxy_handler) != 0)
+    return -1;
+
+  ForgeRoute route = {method, path, proxy_handler, max_body, r};
+  return forge_router_add_route(&route);
+}
+
+int forge_proxy_stats(const ForgeProxy *proxy, int index,
+                      ForgeUpstreamStats *out)
+{
+  if (!proxy || index < 0 || index >= proxy->count)
+    return -1;
+
+  const Upstream *u = &proxy->upstreams[index];
+  out->requests = atomic_load_explicit(&u->requests, memory_order_relaxed);
+  out->connect_failures = atomic_load_explicit(&u->connect_failures, memory_order_relaxed);
+  out->outstanding = atomic_load_explicit(&u->outstanding, memory_order_relaxed);
+  out->reused = atomic_load_explicit(&u->reused, memory_order_relaxed);
+  return 0;
+}
+
+/* =========================================================
+   Upstream Connections
+   ========================================================= */
+
+static int connect_fd(const Upstream *u)
+{
+  int fd = socket(u->addr.ss_family, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+
+  int flags = fcntl(fd, F_GETFL);
+  fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+  int rc = connect(fd, (const struct sockaddr *)&u->addr, u->addr_len);
+  if (rc < 0 && errno == EINPROGRESS)
+  {
+    struct pollfd pfd = {fd, POLLOUT, 0};
+    int err = 0;
+    socklen_t err_len = sizeof(err);
+
+    if (poll(&pfd, 1, CONNECT_TIMEOUT_MS) == 1 &&
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) == 0 && err == 0)
+      rc = 0;
+  }
+
+  if (rc < 0)
+  {
+    close(fd);
+    return -1;
+  }
+
+  fcntl(fd, F_SETFL, flags);
+
+  if (u->addr.ss_family == AF_INET)
+  {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  struct timeval timeout = {UPSTREAM_RECV_TIMEOUT_SEC, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  return fd;
+}
+
+static ForgeConn *upstream_open(const Upstream *u)
+{
+  int fd = connect_fd(u);
+  if (fd < 0)
+    return NULL;
+
+  ForgeConn *c = forge_pool_alloc(UPSTREAM_SLOT);
+  if (!c)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  forge_conn_init(c, fd, (char *)(c + 1), UPSTREAM_SLOT - sizeof(*c));
+  return c;
+}
+
+static void upstream_close(ForgeConn *c)
+{
+  close(c->fd);
+  forge_pool_free(c);
+}
+
+/* A pooled connection the backend has not closed meanwhile */
+static ForgeConn *idle_pop(const Upstream *u)
+{
+  while (idle.count[u->id] > 0)
+  {
+    ForgeConn *c = idle.conns[u->id][--idle.count[u->id]];
+
+    char probe;
+    ssize_t n = recv(c->fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return c;
+
+    upstream_close(c); /* EOF, error, or stray bytes */
+  }
+  return NULL;
+}
+
+static void idle_push(const Upstream *u, ForgeConn *c)
+{
+  if (idle.count[u->id] == IDLE_PER_UPSTREAM)
+  {
+    upstream_close(c);
+    return;
+  }
+  idle.conns[u->id][idle.count[u->id]++] = c;
+}
+
+/* Least outstanding among those not tried yet; healthy ones first */
+static Upstream *pick_upstream(ForgeProxy *p, unsigned tried)
+{
+  uint64_t now = forge_access_log_clock();
+  unsigned start = atomic_fetch_add_explicit(&p->next, 1, memory_order_relaxed);
+
+  Upstream *best = NULL;
+  uint64_t best_load = 0;
+  int best_down = 0;
+
+  for (int k = 0; k < p->count; k++)
+  {
+    int i = (int)((start + (unsigned)k) % (unsigned)p->count);
+    if (tried & (1u << i))
+      continue;
+
+    Upstream *u = &p->upstreams[i];
+    int down = now < atomic_load_explicit(&u->down_until_ns, memory_order_relaxed);
+    uint64_t load = atomic_load_explicit(&u->outstanding, memory_order_relaxed);
+
+    if (!best || down < best_down || (down == best_down && load < best_load))
+    {
+      best = u;
+      best_load = load;
+      best_down = down;
+    }
+  }
+  return best;
+}
+
+/* =========================================================
+   Header Filtering
+   ========================================================= */
+
+static int name_is(const char *name, size_t len, const char *want)
+{
+  return strlen(want) == len && strncasecmp(name, want, len) == 0;
+}
+
+/* Hop-by-hop headers and framing, which the proxy rewrites */
+static int hop_by_hop(const char *name, size_t len)
+{
+  static const char *const hop[] = {
+      "connection", "keep-alive", "proxy-connection", "te", "trailer",
+      "transfer-encoding", "upgrade", "content-length", "http2-settings"};
+
+  for (size_t i = 0; i < sizeof(hop) / sizeof(hop[0]); i++)
+  {
+    if (name_is(name, len, hop[i]))
+      return 1;
+  }
+  return 0;
+}
+
+typedef struct
+{
+  char *data;
+  size_t len;
+  size_t cap;
+  int overflow; /* a put did not fit; later ones fail too */
+} HeadBuf;
+
+static int put(HeadBuf *b, const char *data, size_t n)
+{
+  if (b->overflow || b->len + n > b->cap)
+  {
+    b->overflow = 1;
+    return -1;
+  }
+  memcpy(b->data + b->len, data, n);
+  b->len += n;
+  return 0;
+}
+
+static int put_str(HeadBuf *b, const char *s)
+{
+  return put(b, s, strlen(s));
+}
+
+/* forge_send_text(), or the collected response of an HTTP/2 job */
+static void reply_text(int client_socket, const char *status, const char *text)
+{
+  if (!collecting)
+  {
+    forge_send_text(client_socket, status, text);
+    return;
+  }
+
+  snprintf(collecting->status, sizeof(collecting->status), "%s", status);
+  snprintf(collecting->content_type, sizeof(collecting->content_type),
+           "text/plain; charset=utf-8");
+  collecting->body = strdup(text);
+  collecting->body_len = collecting->body ? strlen(text) : 0;
+}
+
+/* =========================================================
+   Request Forwarding
+   ========================================================= */
+
+#define SEND_UPSTREAM_ERROR -1
+#define SEND_CLIENT_ERROR -2
+#define SEND_HEAD_TOO_LARGE -3
+
+static int write_chunked(int fd, const char *data, size_t len)
+{
+  char size_line[24];
+  int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", len);
+
+  return forge_conn_write_all(fd, size_line, (size_t)n) == 0 &&
+                 forge_conn_write_all(fd, data, len) == 0 &&
+                 forge_conn_write_all(fd, "\r\n", 2) == 0
+             ? 0
+             : -1;
+}
+
+/* Head, then the body streamed from the client as it arrives */
+static int send_request(ForgeConn *up,
+                        const Upstream *u,
+                        const ProxyRoute *route,
+                        const ForgeHttpRequest *req,
+                        int *body_started)
+{
+  char head_data[FORGE_MAX_PATH + 8192];
+  HeadBuf head = {head_data, 0, sizeof(head_data), 0};
+  int has_host = 0;
+  const ForgeHttpHeader *forwarded = NULL;
+
+  put_str(&head, req->method);
+  put(&head, " ", 1);
+  put_str(&head, route->upstream_path ? route->upstream_path : req->path);
+  if (req->query[0])
+  {
+    put(&head, "?", 1);
+    put_str(&head, req->query);
+  }
+  put_str(&head, " HTTP/1.1\r\n");
+
+  for (int i = 0; i < req->header_count; i++)
+  {
+    const ForgeHttpHeader *h = &req->headers[i];
+    if (hop_by_hop(h->name, h->name_len))
+      continue;
+    if (name_is(h->name, h->name_len, "x-forwarded-for"))
+    {
+      forwarded = h;
+      continue;
+    }
+    has_host |= name_is(h->name, h->name_len, "host");
+
+    put(&head, h->name, h->name_len);
+    put(&head, ": ", 2);
+    put(&head, h->value, h->value_len);
+    put(&head, "\r\n", 2);
+  }
+
+  if (!has_host)
+  {
+    put_str(&head, "Host: ");
+    put_str(&head, u->host);
+    put(&head, "\r\n", 2);
+  }
+
+  uint32_t peer = req->conn ? req->conn->peer_ipv4 : 0;
+  if (peer || forwarded)
+  {
+    char ip[INET_ADDRSTRLEN] = "";
+    if (peer)
+      inet_ntop(AF_INET, &peer, ip, sizeof(ip));
+
+    put_str(&head, "X-Forwarded-For: ");
+    if (forwarded)
+    {
+      put(&head, forwarded->value, forwarded->value_len);
+      if (peer)
+        put(&head, ", ", 2);
+    }
+    put_str(&head, ip);
+    put(&head, "\r\n", 2);
+  }
+
+  int has_body = req->chunked || req->content_length > 0;
+  char framing[64];
+  if (req->chunked)
+    snprintf(framing, sizeof(framing), "Transfer-Encoding: chunked\r\n");
+  else if (req->content_length > 0)
+    snprintf(framing, sizeof(framing), "Content-Length: %lld\r\n",
+             req->content_length);
+  else
+    framing[0] = '\0';
+  put_str(&head, framing);
+  put_str(&head, "Connection: keep-alive\r\n\r\n");
+
+  /* Any put that did not fit left the head incomplete */
+  if (head.overflow)
+    return SEND_HEAD_TOO_LARGE;
+
+  if (forge_conn_write_all(up->fd, head.data, head.len) != 0)
+    return SEND_UPSTREAM_ERROR;
+
+  if (!has_body)
+    return 0;
+
+  char buf[RELAY_CHUNK];
+  long n;
+  while ((n = forge_body_read(req, buf, sizeof(buf))) > 0)
+  {
+    *body_started = 1;
+    int rc = req->chunked ? write_chunked(up->fd, buf, (size_t)n)
+                          : forge_conn_write_all(up->fd, buf, (size_t)n);
+    if (rc != 0)
+      return SEND_UPSTREAM_ERROR;
+  }
+
+  if (n < 0)
+    return SEND_CLIENT_ERROR;
+
+  if (req->chunked && forge_conn_write_all(up->fd, "0\r\n\r\n", 5) != 0)
+    return SEND_UPSTREAM_ERROR;
+  return 0;
+}
+
+/* =========================================================
+   Response Relay
+   ========================================================= */
+
+/* Relay failed before anything reached the client: answer 502 */
+#define RELAY_UNSENT -2
+
+typedef struct
+{
+  int status;
+  const char *status_text; /* "200 OK" without CRLF */
+  size_t status_text_len;
+  const char *headers;     /* header lines, through the blank line */
+  const char *head_end;
+  size_t head_len;
+  long long length;        /* -1: not given */
+  int chunked;
+  int close;               /* the backend will not keep the connection */
+  int no_body;
+} UpstreamResponse;
+
+/*
+ * Read the next final response head (1xx are skipped). Returns 1,
+ * 0 when the backend closed before sending anything, -1 on error.
+ */
+static int read_response(ForgeConn *up, const ForgeHttpRequest *req,
+                         UpstreamResponse *r)
+{
+  while (1)
+  {
+    long head_len = forge_conn_read_head(up);
+    if (head_len <= 0)
+      return (int)head_len;
+
+    char *buf = up->buf;
+    if (head_len < 12 || strncmp(buf, "HTTP/1.", 7) != 0 || buf[8] != ' ')
+      return -1;
+
+    /* Three digits, then the reason phrase or the line end */
+    if (!isdigit((unsigned char)buf[9]) || !isdigit((unsigned char)buf[10]) ||
+        !isdigit((unsigned char)buf[11]) || (buf[12] != ' ' && buf[12] != '\r'))
+      return -1;
+
+    int status = (buf[9] - '0') * 100 + (buf[10] - '0') * 10 + (buf[11] - '0');
+    if (status < 100 || status == 101)
+      return -1;
+
+    if (status < 200)
+    {
+      up->pos = (size_t)head_len;
+      forge_conn_next_request(up);
+      continue;
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->status = status;
+    r->length = -1;
+    r->close = buf[7] == '0'; /* HTTP/1.0 closes unless told otherwise */
+    r->no_body = strcmp(req->method, "HEAD") == 0 || status == 204 || status == 304;
+
+    char *line_end = strstr(buf, "\r\n");
+    r->status_text = buf + 9;
+    r->status_text_len = (size_t)(line_end - r->status_text);
+    r->headers = line_end + 2;
+    r->head_end = buf + head_len;
+    r->head_len = (size_t)head_len;
+
+    for (char *line = line_end + 2; line < buf + head_len - 2;)
+    {
+      char *end = strstr(line, "\r\n");
+      char *colon = memchr(line, ':', (size_t)(end - line));
+      if (colon)
+      {
+        size_t name_len = (size_t)(colon - line);
+        char *value = colon + 1;
+        while (*value == ' ' || *value == '\t')
+          value++;
+
+        const char *value_end = end;
+        while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t'))
+          value_end--;
+
+        ForgeHttpHeader h = {line, name_len, value, (size_t)(value_end - value)};
+        if (name_is(line, name_len, "content-length"))
+        {
+          /* A misread length would desync the pooled connection */
+          long long n = forge_http_parse_length(h.value, h.value_len);
+          if (n < 0 || (r->length >= 0 && r->length != n))
+            return -1;
+          r->length = n;
+        }
+        else if (name_is(line, name_len, "transfer-encoding"))
+          r->chunked = forge_http_has_token(&h, "chunked");
+        else if (name_is(line, name_len, "connection"))
+        {
+          if (forge_http_has_token(&h, "close"))
+            r->close = 1;
+          else if (forge_http_has_token(&h, "keep-alive"))
+            r->close = 0;
+        }
+      }
+      line = end + 2;
+    }
+
+    if (r->chunked)
+      r->length = -1;
+    up->pos = (size_t)head_len;
+    return 1;
+  }
+}
+
+/* Decoded body bytes from the backend: 0 at the end, < 0 on error */
+static long read_body(ForgeConn *up, const UpstreamResponse *r,
+                      const ForgeHttpRequest *framing, char *buf, size_t cap)
+{
+  if (r->no_body)
+    return 0;
+
+  if (r->chunked || r->length >= 0)
+    return forge_body_read(framing, buf, cap);
+
+  /* Delimited by the backend closing the connection */
+  size_t avail = up->len - up->pos;
+  if (avail > 0)
+  {
+    size_t n = avail < cap ? avail : cap;
+    memcpy(buf, up->buf + up->pos, n);
+    up->pos += n;
+    return (long)n;
+  }
+  return (long)recv(up->fd, buf, cap, 0);
+}
+
+/* Filtered backend headers; `for_h2` also drops what h2 sets itself */
+static int copy_headers(HeadBuf *out, const UpstreamResponse *r, int for_h2,
+                        const char **content_type, size_t *content_type_len)
+{
+  const char *p = r->headers;
+  while (p < r->head_end - 2)
+  {
+    const char *end = strstr(p, "\r\n");
+    const char *colon = memchr(p, ':', (size_t)(end - p));
+    size_t name_len = colon ? (size_t)(colon - p) : 0;
+
+    int keep = colon && !(hop_by_hop(p, name_len) && !(r->no_body && name_is(p, name_len, "content-length")));
+    if (keep && for_h2)
+    {
+      const char *value = colon + 1;
+      while (*value == ' ' || *value == '\t')
+        value++;
+
+      if (name_is(p, name_len, "content-type"))
+      {
+        *content_type = value;
+        *content_type_len = (size_t)(end - value);
+        keep = 0;
+      }
+      else if (name_is(p, name_len, "date") || name_is(p, name_len, "server") ||
+               name_is(p, name_len, "content-length"))
+      {
+        keep = 0;
+      }
+    }
+
+    if (keep && put(out, p, (size_t)(end - p) + 2) != 0)
+      return -1;
+    p = end + 2;
+  }
+  return 0;
+}
+
+/*
+ * Stream the backend's response to an HTTP/1 client; 0 when
+ * complete, RELAY_UNSENT when its head does not fit, -1 when cut
+ * short
+ */
+static int relay_http1(int client_socket, ForgeConn *up,
+                       const UpstreamResponse *r,
+                       const ForgeHttpRequest *framing)
+{
+  char head_data[UPSTREAM_SLOT + FORGE_RESPONSE_HEADERS_MAX];
+  HeadBuf head = {head_data, 0, sizeof(head_data), 0};
+
+  int chunk_out = 0;
+  char line[64];
+
+  put_str(&head, "HTTP/1.1 ");
+  put(&head, r->status_text, r->status_text_len);
+  put(&head, "\r\n", 2);
+  copy_headers(&head, r, 0, NULL, NULL);
+
+  if (!r->no_body)
+  {
+    if (r->length >= 0)
+    {
+      snprintf(line, sizeof(line), "Content-Length: %lld\r\n", r->length);
+      put_str(&head, line);
+    }
+    else if (forge_http_can_chunk(client_socket))
+    {
+      put_str(&head, "Transfer-Encoding: chunked\r\n");
+      chunk_out = 1;
+    }
+    else
+    {
+      forge_exchange.keep_alive = 0; /* the client reads until close */
+    }
+  }
+
+  put_str(&head, forge_exchange.keep_alive ? "Connection: keep-alive\r\n"
+                                           : "Connection: close\r\n");
+  put(&head, forge_exchange.headers, forge_exchange.headers_len);
+  put(&head, "\r\n", 2);
+  if (head.overflow)
+    return RELAY_UNSENT;
+
+  forge_exchange.status = r->status;
+  if (forge_conn_write_all(client_socket, head.data, head.len) != 0)
+    return -1;
+  forge_exchange.bytes += head.len;
+
+  char buf[RELAY_CHUNK];
+  long n;
+  while ((n = read_body(up, r, framing, buf, sizeof(buf))) > 0)
+  {
+    if (chunk_out)
+    {
+      if (forge_http_chunk(client_socket, buf, (size_t)n) != 0)
+        return -1;
+    }
+    else
+    {
+      if (forge_conn_write_all(client_socket, buf, (size_t)n) != 0)
+        return -1;
+      forge_exchange.bytes += (size_t)n;
+    }
+  }
+
+  if (n < 0 && (r->chunked || r->length >= 0))
+    return -1;
+
+  if (chunk_out && forge_http_chunk(client_socket, NULL, 0) != 0)
+    return -1;
+  return 0;
+}
+
+/* h2 responses are one call: collect the body first; 0 / RELAY_UNSENT */
+static int relay_h2(int client_socket, ForgeConn *up,
+                    const UpstreamResponse *r,
+                    const ForgeHttpRequest *framing)
+{
+  char extra[FORGE_RESPONSE_HEADERS_MAX];
+  HeadBuf headers = {extra, 0, sizeof(extra), 0};
+  const char *content_type = "application/octet-stream";
+  size_t content_type_len = strlen(content_type);
+
+  if (copy_headers(&headers, r, 1, &content_type, &content_type_len) != 0)
+    return RELAY_UNSENT;
+
+  char *body = NULL;
+  size_t len = 0, cap = 0;
+  long n;
+
+  while (1)
+  {
+    if (cap - len < RELAY_CHUNK)
+    {
+      if (cap >= FORGE_PROXY_H2_MAX_BODY)
+      {
+        free(body);
+        return RELAY_UNSENT;
+      }
+      cap = cap ? cap * 2 : 4 * RELAY_CHUNK;
+      char *grown = realloc(body, cap);
+      if (!grown)
+      {
+        free(body);
+        return RELAY_UNSENT;
+      }
+      body = grown;
+    }
+
+    n = read_body(up, r, framing, body + len, RELAY_CHUNK);
+    if (n <= 0)
+      break;
+    len += (size_t)n;
+  }
+
+  if (n < 0 && (r->chunked || r->length >= 0))
+  {
+    free(body);
+    return RELAY_UNSENT;
+  }
+
+  /* Backend headers become this response's extra headers */
+  for (const char *p = extra; p < extra + headers.len;)
+  {
+    const char *end = memchr(p, '\r', (size_t)(extra + headers.len - p));
+    const char *colon = memchr(p, ':', (size_t)(end - p));
+
+    char name[128], value[1024];
+    size_t name_len = (size_t)(colon - p);
+    const char *v = colon + 1;
+    while (*v == ' ')
+      v++;
+    size_t value_len = (size_t)(end - v);
+
+    if (name_len < sizeof(name) && value_len < sizeof(value))
+    {
+      memcpy(name, p, name_len);
+      name[name_len] = '\0';
+      memcpy(value, v, value_len);
+      value[value_len] = '\0';
+      forge_response_header(client_socket, name, value);
+    }
+    p = end + 2;
+  }
+
+  char status[64], type[256];
+  snprintf(status, sizeof(status), "%.*s",
+           (int)r->status_text_len, r->status_text);
+  snprintf(type, sizeof(type), "%.*s", (int)content_type_len, content_type);
+
+  /* On a proxy thread: the stream's core sends it */
+  if (collecting)
+  {
+    memcpy(collecting->status, status, sizeof(status));
+    memcpy(collecting->content_type, type, sizeof(type));
+    collecting->body = body;
+    collecting->body_len = len;
+    return 0;
+  }
+
+  forge_http_respond(client_socket, status, type, body ? body : "", len);
+  free(body);
+  return 0;
+}
+
+/* =========================================================
+   Handler
+   ========================================================= */
+
+/* Safe to send twice (RFC 9110 9.2.2) */
+static int idempotent(const char *method)
+{
+  static const char *const methods[] = {
+      "GET", "HEAD", "OPTIONS", "TRACE", "PUT", "DELETE"};
+
+  for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++)
+  {
+    if (strcmp(method, methods[i]) == 0)
+      return 1;
+  }
+  return 0;
+}
+
+/* Forward `req` and relay the answer; blocks on the upstream */
+static void forward_upstream(const ProxyRoute *route,
+                             const ForgeHttpRequest *req,
+                             int client_socket)
+{
+  ForgeProxy *p = route->proxy;
+  unsigned tried = 0;
+
+  /* Each upstream until one connects, plus a retry per stale pooled connection */
+  for (int attempt = 0; attempt < 2 * p->count; attempt++)
+  {
+    Upstream *u = pick_upstream(p, tried);
+    if (!u)
+      break;
+
+    unsigned bit = 1u << (u - p->upstreams);
+    int reused = 1;
+    ForgeConn *up = idle_pop(u);
+    if (!up)
+    {
+      reused = 0;
+      up = upstream_open(u);
+    }
+
+    if (!up)
+    {
+      atomic_fetch_add_explicit(&u->connect_failures, 1, memory_order_relaxed);
+      atomic_store_explicit(&u->down_until_ns,
+                            forge_access_log_clock() + UPSTREAM_DOWN_NS,
+                            memory_order_relaxed);
+      tried |= bit;
+      continue;
+    }
+
+    atomic_fetch_add_explicit(&u->outstanding, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&u->requests, 1, memory_order_relaxed);
+    if (reused)
+      atomic_fetch_add_explicit(&u->reused, 1, memory_order_relaxed);
+
+    up->len = up->pos = up->body_base = 0;
+
+    int body_started = 0;
+    UpstreamResponse resp;
+    int rc = send_request(up, u, route, req, &body_started);
+    if (rc == 0)
+      rc = read_response(up, req, &resp);
+
+    if (rc == SEND_HEAD_TOO_LARGE)
+    {
+      atomic_fetch_sub_explicit(&u->outstanding, 1, memory_order_relaxed);
+      idle_push(u, up); /* nothing was written */
+      reply_text(client_socket, "431 Request Header Fields Too Large",
+                 "Request Header Fields Too Large\n");
+      return;
+    }
+
+    if (rc == SEND_CLIENT_ERROR)
+    {
+      atomic_fetch_sub_explicit(&u->outstanding, 1, memory_order_relaxed);
+      upstream_close(up);
+      if (req->conn && req->conn->body_error == FORGE_BODY_TOO_LARGE)
+        reply_text(client_socket, "413 Payload Too Large", "Payload Too Large\n");
+      else
+        reply_text(client_socket, "400 Bad Request", "Bad Request\n");
+      return;
+    }
+
+    if (rc != 1)
+    {
+      atomic_fetch_sub_explicit(&u->outstanding, 1, memory_order_relaxed);
+
+      /*
+       * Only a pooled connection the backend dropped while idle is
+       * known not to have run the request: nothing came back, and
+       * resending is harmless for an idempotent method whose body
+       * was not consumed. Anything else may have had effects.
+       */
+      int stale = reused && up->len == 0 && !body_started &&
+                  idempotent(req->method);
+      upstream_close(up);
+      if (stale)
+        continue;
+      break;
+    }
+
+    ForgeHttpRequest framing;
+    memset(&framing, 0, sizeof(framing));
+    framing.content_length = resp.no_body ? -1 : resp.length;
+    framing.chunked = resp.no_body ? 0 : resp.chunked;
+    framing.conn = up;
+    forge_conn_begin_body(up, &framing, (size_t)-1);
+
+    rc = forge_exchange.h2 ? relay_h2(client_socket, up, &resp, &framing)
+                           : relay_http1(client_socket, up, &resp, &framing);
+    int ok = rc == 0;
+
+    atomic_fetch_sub_explicit(&u->outstanding, 1, memory_order_relaxed);
+
+    int body_done = resp.no_body || up->body_mode == FORGE_BODY_DONE ||
+                    up->body_mode == FORGE_BODY_NONE;
+    if (ok && !resp.close && body_done && (resp.chunked || resp.length >= 0 || resp.no_body) &&
+        up->pos == up->len)
+      idle_push(u, up);
+    else
+      upstream_close(up);
+
+    if (rc == RELAY_UNSENT)
+      break;
+    if (!ok)
+      forge_exchange.keep_alive = 0; /* response cut short */
+    return;
+  }
+
+  reply_text(client_socket, "502 Bad Gateway", "Bad Gateway\n");
+}
+
+/*
+ * The client body was not staged (forge_server_stream_body()): the
+ * reads behind it wait for each piece, bounded by the socket's
+ * receive timeout, on whichever thread forwards it.
+ */
+static void proxy_forward(const ProxyRoute *route,
+                          const ForgeHttpRequest *req,
+                          int client_socket)
+{
+  ForgeConn *c = req->conn;
+  int nonblocking = c ? c->nonblocking : 0;
+  if (c)
+    c->nonblocking = 0;
+
+  forward_upstream(route, req, client_socket);
+
+  if (c)
+    c->nonblocking = nonblocking;
+}
+
+/* =========================================================
+   Proxy Threads
+   ========================================================= */
+
+/*
+ * Upstream I/O waits (for a connect, then for the backend), so a
+ * request on a core loop is parked and forwarded by one of these
+ * threads while its core serves other connections. A backend that
+ * answers slowly holds its thread, so the count bounds how many
+ * such requests are in flight at once.
+ */
+static unsigned proxy_threads = FORGE_PROXY_DEFAULT_THREADS;
+
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_ready = PTHREAD_COND_INITIALIZER;
+static ProxyJob *jobs_head;
+static ProxyJob *jobs_tail;
+
+static pthread_once_t threads_once = PTHREAD_ONCE_INIT;
+static int threads_running;
+
+static void *proxy_main(void *arg)
+{
+  (void)arg;
+  forge_core_attach_aside(); /* own arena and counters; core 0's on OOM */
+
+  while (1)
+  {
+    pthread_mutex_lock(&jobs_lock);
+    while (!jobs_head)
+      pthread_cond_wait(&jobs_ready, &jobs_lock);
+    ProxyJob *job = jobs_head;
+    jobs_head = job->next;
+    if (!jobs_head)
+      jobs_tail = NULL;
+    pthread_mutex_unlock(&jobs_lock);
+
+    /* The parked core leaves the client socket and the request alone */
+    forge_http_tick();
+    forge_exchange = job->exchange;
+    collecting = job->exchange.h2 ? job : NULL;
+
+    proxy_forward(job->route, &job->req, job->exchange.fd);
+
+    collecting = NULL;
+    job->exchange = forge_exchange;
+
+    /* A full inbox drains quickly; the request must get back */
+    while (forge_conn_resume(job->req.conn, job) != 0)
+      usleep(1000);
+  }
+  return NULL;
+}
+
+void forge_proxy_set_threads(unsigned threads)
+{
+  proxy_threads = threads ? threads : FORGE_PROXY_DEFAULT_THREADS;
+}
+
+static void proxy_threads_start(void)
+{
+  for (unsigned i = 0; i < proxy_threads; i++)
+  {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, proxy_main, NULL) == 0)
+    {
+      pthread_detach(thread);
+      threads_running++;
+    }
+  }
+}
+
+/* Park `req` and queue it for a proxy thread; -1: forward inline */
+static int proxy_submit(const ProxyRoute *route, const ForgeHttpRequest *req)
+{
+  pthread_once(&threads_once, proxy_threads_start);
+  if (threads_running == 0)
+    return -1;
+
+  ProxyJob *job = calloc(1, sizeof(*job));
+  if (!job)
+    return -1;
+
+  if (forge_conn_park(req->conn) != 0)
+  {
+    free(job);
+    return -1;
+  }
+
+  job->route = route;
+  job->req = *req;
+  job->exchange = forge_exchange;
+
+  pthread_mutex_lock(&jobs_lock);
+  if (jobs_tail)
+    jobs_tail->next = job;
+  else
+    jobs_head = job;
+  jobs_tail = job;
+  pthread_cond_signal(&jobs_ready);
+  pthread_mutex_unlock(&jobs_lock);
+  return 0;
+}
+
+/* Back on the request's core: send or account for the thread's answer */
+static void proxy_finish(ProxyJob *job, int client_socket)
+{
+  if (job->exchange.h2)
+  {
+    memcpy(forge_exchange.headers, job->exchange.headers,
+           job->exchange.headers_len);
+    forge_exchange.headers_len = job->exchange.headers_len;
+
+    if (job->status[0])
+      forge_http_respond(client_socket, job->status, job->content_type,
+                         job->body ? job->body : "", job->body_len);
+    else
+      forge_send_text(client_socket, "502 Bad Gateway", "Bad Gateway\n");
+  }
+  else
+  {
+    /* Already on the wire: only the accounting is left */
+    forge_exchange.status = job->exchange.status;
+    forge_exchange.bytes = job->exchange.bytes;
+    forge_exchange.keep_alive = job->exchange.keep_alive;
+  }
+
+  free(job->body);
+  free(job);
+}
+
+static void proxy_handler(const ForgeHttpRequest *req, int client_socket)
+{
+  const ProxyRoute *route = forge_route_arg();
+  if (!route)
+  {
+    forge_send_text(client_socket, "404 Not Found", "Not Found\n");
+    return;
+  }
+
+  ProxyJob *job;
+  if (forge_conn_resumed(req->conn, (void **)&job))
+  {
+    proxy_finish(job, client_socket);
+    return;
+  }
+
+  /* On a core loop the wait happens on a proxy thread instead */
+  if (proxy_submit(route, req) == 0)
+    return;
+
+  proxy_forward(route, req, client_socket);
+}
+
+#endif
@@ -1,4 +1,10 @@
 #include "../include/forge_router.h"
+#include "forge_internal.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 const ForgeRoute *forge_match_route(
@@ -16,3 +22,646 @@ const ForgeRoute *forge_match_route(
     }
     return NULL;
 }
+
+/* =========================================================
+   Registration
+   ========================================================= */
+
+typedef struct
+{
+    const char *prefix; /* NULL: every route and the 404 entry */
+    ForgeMiddlewareStep step;
+} ForgeMiddlewareEntry;
+
+static ForgeRoute *app_routes;
+static int app_route_count;
+static int app_route_cap;
+
+static ForgeMiddlewareEntry *middleware;
+static int middleware_count;
+static int middleware_cap;
+
+typedef struct
+{
+    const char *method;
+    const char *path;
+    int priority;
+} ForgePriorityEntry;
+
+static ForgePriorityEntry *priorities;
+static int priority_count;
+static int priority_cap;
+
+/* Registrations not published yet */
+static _Atomic int router_dirty = 1;
+
+/* Serializes registration snapshots, compiles and publication */
+static pthread_mutex_t router_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Inside a reload build: its registrations are published together */
+static _Thread_local int router_building;
+
+static void router_changed(void);
+
+static int grow(void **items, int *cap, int count, size_t size)
+{
+    if (count < *cap)
+        return 0;
+
+    int new_cap = *cap ? *cap * 2 : 16;
+    void *grown = realloc(*items, (size_t)new_cap * size);
+    if (!grown)
+        return -1;
+
+    *items = grown;
+    *cap = new_cap;
+    return 0;
+}
+
+int forge_router_add_route(const ForgeRoute *route)
+{
+    if (!route || !route->method || !route->path || !route->handler ||
+        route->path[0] != '/')
+        return -1;
+
+    if (grow((void **)&app_routes, &app_route_cap, app_route_count,
+             sizeof(*app_routes)) != 0)
+        return -1;
+
+    app_routes[app_route_count++] = *route;
+    router_changed();
+    return 0;
+}
+
+int forge_router_add(const char *method,
+                     const char *path,
+                     ForgeRouteHandler handler)
+{
+    ForgeRoute route = {method, path, handler, 0, NULL};
+    return forge_router_add_route(&route);
+}
+
+void *forge_route_arg(void)
+{
+    return forge_exchange.route_arg;
+}
+
+int forge_route_priority(const char *method, const char *path, int priority)
+{
+    if (!method || !path ||
+        (priority != FORGE_PRIORITY_NORMAL && priority != FORGE_PRIORITY_HIGH))
+        return -1;
+
+    /* A later call re-tags the same route */
+    for (int i = 0; i < priority_count; i++)
+    {
+        if (strcmp(priorities[i].method, method) == 0 &&
+            strcmp(priorities[i].path, path) == 0)
+        {
+            priorities[i].priority = priority;
+            router_changed();
+            return 0;
+        }
+    }
+
+    if (grow((void **)&priorities, &priority_cap, priority_count,
+             sizeof(*priorities)) != 0)
+        return -1;
+
+    priorities[priority_count].method = method;
+    priorities[priority_count].path = path;
+    priorities[priority_count].priority = priority;
+    priority_count++;
+    router_changed();
+    return 0;
+}
+
+int forge_use(const char *prefix,
+              ForgeMiddlewareFn before,
+              ForgeMiddlewareDoneFn after)
+{
+    if ((!before && !after) || (prefix && prefix[0] != '/'))
+        return -1;
+
+    if (grow((void **)&middleware, &middleware_cap, middleware_count,
+             sizeof(*middleware)) != 0)
+        return -1;
+
+    ForgeMiddlewareEntry *e = &middleware[middleware_count++];
+    e->prefix = prefix;
+    e->step.before = before;
+    e->step.after = after;
+    router_changed();
+    return 0;
+}
+
+/* =========================================================
+   Compilation
+   ========================================================= */
+
+/*
+ * Flattened routing table. Every route owns a contiguous slice of
+ * `steps`, so dispatch is one loop over function pointers.
+ */
+typedef struct
+{
+    ForgeCompiledRoute *routes;
+    int count;
+    ForgeMiddlewareStep *steps;
+    ForgeCompiledRoute not_found;
+} ForgeRouteTable;
+
+/* Built-in routes, remembered for reloads */
+static const ForgeRoute *builtin_routes;
+static int builtin_route_count;
+
+/* "/api" covers "/api" and "/api/..." but not "/apix" */
+static int prefix_covers(const char *prefix, const char *path)
+{
+    if (!prefix)
+        return 1;
+
+    size_t len = strlen(prefix);
+    if (len > 0 && prefix[len - 1] == '/')
+        len--;
+
+    return strncmp(prefix, path, len) == 0 &&
+           (path[len] == '\0' || path[len] == '/');
+}
+
+static int route_listed(const ForgeCompiledRoute *routes, int count,
+                        const ForgeRoute *route)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (strcmp(routes[i].route.method, route->method) == 0 &&
+            strcmp(routes[i].route.path, route->path) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/* Append the chain for `path` (NULL: the 404 entry) to `steps` */
+static int compile_chain(ForgeMiddlewareStep *steps, int used, const char *path)
+{
+    int n = 0;
+
+    for (int i = 0; i < middleware_count; i++)
+    {
+        const ForgeMiddlewareEntry *e = &middleware[i];
+        int applies = path ? prefix_covers(e->prefix, path) : e->prefix == NULL;
+
+        if (applies)
+            steps[used + n++] = e->step;
+    }
+    return n;
+}
+
+static int route_priority(const ForgeRoute *route)
+{
+    for (int i = 0; i < priority_count; i++)
+    {
+        if (strcmp(priorities[i].method, route->method) == 0 &&
+            strcmp(priorities[i].path, route->path) == 0)
+            return priorities[i].priority;
+    }
+    return -1;
+}
+
+static void table_free(ForgeRouteTable *t)
+{
+    if (!t)
+        return;
+    for (int i = 0; i < t->count; i++)
+        free(t->routes[i].cache);
+    free(t->routes);
+    free(t->steps);
+    free(t);
+}
+
+static ForgeRouteTable *router_compile(void)
+{
+    const ForgeRoute *builtin = builtin_routes;
+    int builtin_count = builtin_route_count;
+    int total = app_route_count + builtin_count;
+
+    /* Worst case every middleware covers every route, plus the 404 */
+    size_t max_steps = (size_t)(total + 1) * (size_t)middleware_count;
+
+    ForgeRouteTable *t = calloc(1, sizeof(*t));
+    ForgeCompiledRoute *routes = calloc((size_t)total + 1, sizeof(*routes));
+    ForgeMiddlewareStep *steps = calloc(max_steps + 1, sizeof(*steps));
+    if (!t || !routes || !steps)
+    {
+        free(t);
+        free(routes);
+        free(steps);
+        return NULL;
+    }
+
+    int count = 0;
+    int used = 0;
+
+    for (int i = 0; i < total; i++)
+    {
+        const ForgeRoute *r = i < app_route_count ? &app_routes[i]
+                                                  : &builtin[i - app_route_count];
+
+        /* Earlier registrations shadow later ones (and the built-ins) */
+        if (route_listed(routes, count, r))
+            continue;
+
+        ForgeCompiledRoute *c = &routes[count++];
+        c->route = *r;
+        if (forge_cache_policy_copy(r->method, r->path, &c->cache) != 0)
+        {
+            t->routes = routes;
+            t->count = count - 1;
+            t->steps = steps;
+            table_free(t);
+            return NULL;
+        }
+        c->priority = route_priority(r);
+        c->chain = steps + used;
+        c->chain_len = compile_chain(steps, used, r->path);
+        used += c->chain_len;
+    }
+
+    ForgeCompiledRoute not_found;
+    memset(&not_found, 0, sizeof(not_found));
+    not_found.route.method = "";
+    not_found.route.path = "";
+    not_found.priority = FORGE_PRIORITY_NORMAL;
+    not_found.chain = steps + used;
+    not_found.chain_len = compile_chain(steps, used, NULL);
+
+    t->routes = routes;
+    t->count = count;
+    t->steps = steps;
+    t->not_found = not_found;
+    return t;
+}
+
+/* =========================================================
+   Publication
+   ========================================================= */
+
+/*
+ * The compiled table sits behind one atomic pointer. A reader
+ * brackets its use with forge_router_enter() / forge_router_exit(),
+ * which store the global epoch in a slot of its own; a swapped-out
+ * table is freed once no slot holds an epoch from before the swap.
+ * Readers never wait: entering is one store and one load. Threads
+ * beyond ROUTER_READERS share a counter that holds back every free.
+ */
+#define ROUTER_READERS 256
+#define ROUTER_RETIRED 16
+
+typedef struct
+{
+    _Alignas(64) _Atomic uint64_t epoch; /* 0: not reading */
+    _Atomic int claimed;
+} ReaderSlot;
+
+typedef struct
+{
+    ForgeRouteTable *table;
+    uint64_t epoch; /* readers from this epoch on cannot see it */
+} RetiredTable;
+
+static _Atomic(ForgeRouteTable *) route_table;
+static _Atomic uint64_t router_epoch = 1;
+
+static ReaderSlot readers[ROUTER_READERS];
+static _Atomic int overflow_readers;
+
+static _Thread_local ReaderSlot *reader;
+static _Thread_local int reader_depth;
+static _Thread_local int reader_overflow;
+
+static pthread_key_t reader_key;
+static pthread_once_t reader_once = PTHREAD_ONCE_INIT;
+
+/* Owned by router_lock; the count is read without it */
+static RetiredTable retired[ROUTER_RETIRED];
+static _Atomic int retired_count;
+
+/* Thread exit hands the slot back */
+static void reader_release(void *slot)
+{
+    ReaderSlot *r = slot;
+    atomic_store_explicit(&r->epoch, 0, memory_order_release);
+    atomic_store_explicit(&r->claimed, 0, memory_order_release);
+}
+
+static void reader_key_init(void)
+{
+    pthread_key_create(&reader_key, reader_release);
+}
+
+static ReaderSlot *reader_claim(void)
+{
+    pthread_once(&reader_once, reader_key_init);
+
+    for (int i = 0; i < ROUTER_READERS; i++)
+    {
+        int expected = 0;
+        if (atomic_load_explicit(&readers[i].claimed, memory_order_relaxed) == 0 &&
+            atomic_compare_exchange_strong(&readers[i].claimed, &expected, 1))
+        {
+            pthread_setspecific(reader_key, &readers[i]);
+            return &readers[i];
+        }
+    }
+    return NULL;
+}
+
+void forge_router_enter(void)
+{
+    if (reader_depth++ > 0)
+        return;
+
+    if (!reader)
+        reader = reader_claim();
+    if (!reader)
+    {
+        reader_overflow = 1;
+        atomic_fetch_add(&overflow_readers, 1);
+        return;
+    }
+
+    /* Sequentially consistent: ordered before the table load */
+    atomic_store(&reader->epoch, atomic_load(&router_epoch));
+}
+
+void forge_router_exit(void)
+{
+    if (--reader_depth > 0)
+        return;
+
+    if (reader_overflow)
+    {
+        reader_overflow = 0;
+        atomic_fetch_sub(&overflow_readers, 1);
+        return;
+    }
+    atomic_store_explicit(&reader->epoch, 0, memory_order_release);
+}
+
+/* Free retired tables no reader can still hold; under router_lock */
+static void reclaim(void)
+{
+    uint64_t oldest = UINT64_MAX;
+    if (atomic_load(&overflow_readers) > 0)
+        oldest = 0;
+
+    for (int i = 0; i < ROUTER_READERS && oldest > 0; i++)
+    {
+        uint64_t e = atomic_load(&readers[i].epoch);
+        if (e && e < oldest)
+            oldest = e;
+    }
+
+    int count = atomic_load_explicit(&retired_count, memory_order_relaxed);
+    int kept = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (retired[i].epoch <= oldest)
+            table_free(retired[i].table);
+        else
+            retired[kept++] = retired[i];
+    }
+    atomic_store_explicit(&retired_count, kept, memory_order_relaxed);
+}
+
+static int router_publish(void);
+
+void forge_router_reclaim(void)
+{
+    int dirty = atomic_load_explicit(&router_dirty, memory_order_relaxed);
+    if ((!dirty && atomic_load_explicit(&retired_count, memory_order_relaxed) == 0) ||
+        pthread_mutex_trylock(&router_lock) != 0)
+        return;
+
+    /* A publish that found every retired slot taken is retried here */
+    if (dirty)
+        router_publish();
+    else
+        reclaim();
+    pthread_mutex_unlock(&router_lock);
+}
+
+/* Compile the registrations and swap the result in; under router_lock */
+static int router_publish(void)
+{
+    reclaim();
+    if (atomic_load_explicit(&retired_count, memory_order_relaxed) == ROUTER_RETIRED)
+        return -1; /* old tables still read: a reader is stuck */
+
+    atomic_store(&router_dirty, 0);
+    ForgeRouteTable *t = router_compile();
+    if (!t)
+    {
+        atomic_store(&router_dirty, 1);
+        return -1;
+    }
+
+    ForgeRouteTable *old = atomic_exchange(&route_table, t);
+    uint64_t epoch = atomic_fetch_add(&router_epoch, 1) + 1;
+
+    if (old)
+    {
+        int n = atomic_load_explicit(&retired_count, memory_order_relaxed);
+        retired[n].table = old;
+        retired[n].epoch = epoch;
+        atomic_store_explicit(&retired_count, n + 1, memory_order_relaxed);
+    }
+    reclaim();
+    return 0;
+}
+
+/* =========================================================
+   Reload
+   ========================================================= */
+
+/* Registrations made before forge_router_on_reload() are kept */
+static ForgeRouterBuildFn reload_build;
+static void *reload_arg;
+static int base_routes;
+static int base_middleware;
+static int base_priorities;
+
+/* Entries the build function registered, kept for a rollback */
+typedef struct
+{
+    ForgeRoute *routes;
+    ForgeMiddlewareEntry *middleware;
+    ForgePriorityEntry *priorities;
+    int route_count;
+    int middleware_count;
+    int priority_count;
+} ReloadLayer;
+
+static void *layer_copy(const void *items, int from, int to, size_t size)
+{
+    if (to <= from)
+        return NULL;
+
+    void *copy = malloc((size_t)(to - from) * size);
+    if (copy)
+        memcpy(copy, (const char *)items + (size_t)from * size, (size_t)(to - from) * size);
+    return copy;
+}
+
+static int layer_save(ReloadLayer *l)
+{
+    l->route_count = app_route_count;
+    l->middleware_count = middleware_count;
+    l->priority_count = priority_count;
+    l->routes = layer_copy(app_routes, base_routes, app_route_count, sizeof(*app_routes));
+    l->middleware = layer_copy(middleware, base_middleware, middleware_count,
+                               sizeof(*middleware));
+    l->priorities = layer_copy(priorities, base_priorities, priority_count,
+                               sizeof(*priorities));
+
+    return (app_route_count > base_routes && !l->routes) ||
+                   (middleware_count > base_middleware && !l->middleware) ||
+                   (priority_count > base_priorities && !l->priorities)
+               ? -1
+               : 0;
+}
+
+/* Capacity never shrinks, so the saved entries fit where they were */
+static void layer_restore(const ReloadLayer *l)
+{
+    if (l->routes)
+        memcpy(app_routes + base_routes, l->routes,
+               (size_t)(l->route_count - base_routes) * sizeof(*app_routes));
+    if (l->middleware)
+        memcpy(middleware + base_middleware, l->middleware,
+               (size_t)(l->middleware_count - base_middleware) * sizeof(*middleware));
+    if (l->priorities)
+        memcpy(priorities + base_priorities, l->priorities,
+               (size_t)(l->priority_count - base_priorities) * sizeof(*priorities));
+
+    app_route_count = l->route_count;
+    middleware_count = l->middleware_count;
+    priority_count = l->priority_count;
+}
+
+static void layer_drop(ReloadLayer *l)
+{
+    free(l->routes);
+    free(l->middleware);
+    free(l->priorities);
+}
+
+static void layer_truncate(void)
+{
+    app_route_count = base_routes;
+    middleware_count = base_middleware;
+    priority_count = base_priorities;
+}
+
+int forge_router_on_reload(ForgeRouterBuildFn build, void *arg)
+{
+    if (!build)
+        return -1;
+
+    pthread_mutex_lock(&router_lock);
+    reload_build = build;
+    reload_arg = arg;
+    base_routes = app_route_count;
+    base_middleware = middleware_count;
+    base_priorities = priority_count;
+
+    router_building = 1;
+    int rc = build(arg);
+    router_building = 0;
+    if (rc != 0)
+        layer_truncate();
+    router_publish();
+    pthread_mutex_unlock(&router_lock);
+    return rc != 0 ? -1 : 0;
+}
+
+int forge_router_reload(void)
+{
+    pthread_mutex_lock(&router_lock);
+
+    ReloadLayer layer;
+    int rc = 0;
+    if (reload_build)
+    {
+        rc = layer_save(&layer);
+        if (rc == 0)
+        {
+            layer_truncate();
+            router_building = 1;
+            rc = reload_build(reload_arg) != 0 ? -1 : 0;
+            router_building = 0;
+            if (rc != 0)
+                layer_restore(&layer);
+        }
+        layer_drop(&layer);
+    }
+
+    /* A failed build keeps serving the table already published */
+    if (rc == 0)
+        rc = router_publish();
+    pthread_mutex_unlock(&router_lock);
+    return rc;
+}
+
+/* =========================================================
+   Resolution
+   ========================================================= */
+
+/* Registrations publish at once; not while a reload build collects them */
+static void router_changed(void)
+{
+    atomic_store(&router_dirty, 1);
+    if (router_building)
+        return;
+
+    pthread_mutex_lock(&router_lock);
+    if (atomic_load(&router_dirty))
+        router_publish();
+    pthread_mutex_unlock(&router_lock);
+}
+
+void forge_router_invalidate(void)
+{
+    router_changed();
+}
+
+void forge_router_commit(const ForgeRoute *builtin, int builtin_count)
+{
+    pthread_mutex_lock(&router_lock);
+    if (builtin != builtin_routes || builtin_count != builtin_route_count)
+        atomic_store(&router_dirty, 1);
+    builtin_routes = builtin;
+    builtin_route_count = builtin_count;
+    if (atomic_load(&router_dirty))
+        router_publish();
+    pthread_mutex_unlock(&router_lock);
+}
+
+const ForgeCompiledRoute *forge_router_resolve(const ForgeHttpRequest *req)
+{
+    static const ForgeCompiledRoute unrouted = {{"", "", NULL, 0, NULL}, NULL, FORGE_PRIORITY_NORMAL, NULL, 0};
+
+    /* Stays valid until this reader's forge_router_exit() */
+    const ForgeRouteTable *t = atomic_load(&route_table);
+    if (!t)
+        return &unrouted;
+
+    for (int i = 0; i < t->count; i++)
+    {
+        const ForgeCompiledRoute *c = &t->routes[i];
+        if (strcmp(c->route.method, req->method) == 0 &&
+            strcmp(c->route.path, req->path) == 0)
+            return c;
+    }
+    return &t->not_found;
+}
@@ -1,19 +1,45 @@
+#define _GNU_SOURCE
 #include "forge_server.h"
 #include "forge_abi.h"
 #include "forge_router.h"
 #include "forge_http.h"
+#include "forge_json.h"
+#include "forge_pool.h"
+#include "forge_cache.h"
+#include "forge_sse.h"
+#include "forge_multipart.h"
+#include "forge_log.h"
+#include "forge_internal.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #else
 #include <unistd.h>
+#include <errno.h>
+#include <poll.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <signal.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/prctl.h>
+#include <linux/filter.h>
+#endif
 #endif
 
 /* =========================================================
@@ -23,6 +49,70 @@
 /* Embed ABI version into the binary */
 const int forge_abi_version = FORGE_ABI_VERSION;
 
+/* =========================================================
+   Unix Socket State
+   ========================================================= */
+
+#ifndef _WIN32
+/* Bound AF_UNIX path, removed again by shutdown_server() */
+static char unix_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+#endif
+
+/* =========================================================
+   Control Listener State
+   ========================================================= */
+
+#ifndef _WIN32
+/* forge_server_listen_control() socket; each process serves it */
+static int control_fd = -1;
+#endif
+
+/* Set on the control thread: only high-priority routes are served */
+static _Thread_local int control_lane;
+
+/* =========================================================
+   Reload State
+   ========================================================= */
+
+#ifndef _WIN32
+/* SIGHUP: core 0 rebuilds the route table on its next wakeup */
+static volatile sig_atomic_t reload_requested;
+
+static void reload_signal(int sig)
+{
+    (void)sig;
+    reload_requested = 1;
+}
+#endif
+
+/* =========================================================
+   Pre-fork Worker State
+   ========================================================= */
+
+#ifndef _WIN32
+/* ForgeCoreStats is all uint64_t; workers publish it word by word */
+#define STAT_WORDS (sizeof(ForgeCoreStats) / sizeof(uint64_t))
+#define STAT_WORD(field) (offsetof(ForgeCoreStats, field) / sizeof(uint64_t))
+
+/* Last counters one worker published; written by that worker only */
+typedef struct
+{
+    _Alignas(64) _Atomic uint64_t words[STAT_WORDS];
+} WorkerSlot;
+
+/* MAP_SHARED segment, mapped by the master before the first fork */
+typedef struct
+{
+    int workers;
+    _Atomic uint64_t restarts;
+    WorkerSlot retired; /* folded in from workers that exited */
+    WorkerSlot slots[FORGE_MAX_WORKERS];
+} WorkerShared;
+
+static WorkerShared *worker_shared;
+static int worker_index = -1;
+#endif
+
 /* =========================================================
    Route Handlers (forward declarations)
    ========================================================= */
@@ -30,16 +120,24 @@ const int forge_abi_version = FORGE_ABI_VERSION;
 static void handle_root(const ForgeHttpRequest *req, int client_socket);
 static void handle_health(const ForgeHttpRequest *req, int client_socket);
 static void handle_version(const ForgeHttpRequest *req, int client_socket);
+static void handle_upload(const ForgeHttpRequest *req, int client_socket);
+static void handle_metrics(const ForgeHttpRequest *req, int client_socket);
 static void send_404(int client_socket);
+static int workers_stats(ForgeCoreStats *out, unsigned long long *restarts);
 
 /* =========================================================
    Route Table (FILE SCOPE)
    ========================================================= */
 
+/* Artifact uploads stream through a fixed buffer, so size is only policy */
+#define UPLOAD_MAX_BODY ((size_t)1024 * 1024 * 1024)
+
 static const ForgeRoute routes[] = {
-    {"GET", "/", handle_root},
-    {"GET", "/health", handle_health},
-    {"GET", "/api/version", handle_version},
+    {"GET", "/", handle_root, 0, NULL},
+    {"GET", "/health", handle_health, 0, NULL},
+    {"GET", "/api/version", handle_version, 0, NULL},
+    {"POST", "/api/upload", handle_upload, UPLOAD_MAX_BODY, NULL},
+    {"GET", "/metrics", handle_metrics, 0, NULL},
 };
 
 /* =========================================================
@@ -65,6 +163,236 @@ static void handle_version(const ForgeHttpRequest *req, int client_socket)
                     "{ \"name\": \"forge\", \"version\": \"1.0\" }\n");
 }
 
+static int count_body_bytes(const char *data, size_t len, void *user)
+{
+    (void)data;
+    *(unsigned long long *)user += len;
+    return 0;
+}
+
+/* Form uploads: each part's size and digest are reported back */
+#define UPLOAD_MAX_PARTS 16
+
+typedef struct
+{
+    char name[64];
+    unsigned long long size;
+    char sha256[65];
+} UploadPart;
+
+typedef struct
+{
+    int count;
+    UploadPart parts[UPLOAD_MAX_PARTS];
+} UploadSummary;
+
+static int record_part(const ForgeMultipartPart *part, void *user)
+{
+    UploadSummary *summary = user;
+    if (summary->count == UPLOAD_MAX_PARTS)
+        return 0;
+
+    UploadPart *out = &summary->parts[summary->count++];
+    snprintf(out->name, sizeof(out->name), "%s", part->name);
+    out->size = part->size;
+    for (int i = 0; i < 32; i++)
+        snprintf(out->sha256 + i * 2, 3, "%02x", part->sha256[i]);
+    return 0;
+}
+
+static int is_multipart(const ForgeHttpRequest *req)
+{
+    const ForgeHttpHeader *type = forge_header_get(req, FORGE_HDR_CONTENT_TYPE);
+    if (!type || type->value_len < 10)
+        return 0;
+
+    for (int i = 0; i < 10; i++)
+    {
+        if (tolower((unsigned char)type->value[i]) != "multipart/"[i])
+            return 0;
+    }
+    return 1;
+}
+
+static void handle_upload(const ForgeHttpRequest *req, int client_socket)
+{
+    static const ForgeMultipartHandler form = {NULL, NULL, record_part, NULL};
+    UploadSummary summary;
+    summary.count = 0;
+
+    unsigned long long received = 0;
+    long long rc = is_multipart(req)
+                       ? forge_multipart_read(req, &form, &summary)
+                       : forge_body_stream(req, count_body_bytes, &received);
+
+    if (rc == FORGE_BODY_TOO_LARGE)
+    {
+        forge_send_text(client_socket, "413 Payload Too Large",
+                        "Payload Too Large\n");
+        return;
+    }
+    if (rc < 0)
+    {
+        forge_send_text(client_socket, "400 Bad Request", "Bad Request\n");
+        return;
+    }
+
+    ForgeJsonWriter w;
+    forge_json_begin(&w, client_socket, "200 OK");
+    forge_json_object_begin(&w);
+    forge_json_key(&w, "received");
+    for (int i = 0; i < summary.count; i++)
+        received += summary.parts[i].size;
+    forge_json_int(&w, (long long)received);
+
+    if (is_multipart(req))
+    {
+        forge_json_key(&w, "parts");
+        forge_json_array_begin(&w);
+        for (int i = 0; i < summary.count; i++)
+        {
+            forge_json_object_begin(&w);
+            forge_json_key(&w, "name");
+            forge_json_string(&w, summary.parts[i].name);
+            forge_json_key(&w, "size");
+            forge_json_int(&w, (long long)summary.parts[i].size);
+            forge_json_key(&w, "sha256");
+            forge_json_string(&w, summary.parts[i].sha256);
+            forge_json_object_end(&w);
+        }
+        forge_json_array_end(&w);
+    }
+    forge_json_object_end(&w);
+    forge_json_end(&w);
+}
+
+#define METRICS_BASE 2048
+#define METRICS_PER_POOL 512
+
+/* Prometheus text format: counters summed over all cores, pools by node */
+static void handle_metrics(const ForgeHttpRequest *req, int client_socket)
+{
+    (void)req;
+
+    /* Pre-fork workers: every process's counters, not just this one's */
+    ForgeCoreStats st;
+    unsigned long long restarts = 0;
+    int workers = workers_stats(&st, &restarts);
+    if (workers < 0)
+        forge_core_stats(-1, &st);
+
+    ForgePoolStats pools[FORGE_POOL_MAX_NODES * FORGE_POOL_CLASSES];
+    int npools = forge_pool_stats(pools, (int)(sizeof(pools) / sizeof(pools[0])));
+
+    /* Fixed counters fit in METRICS_BASE; each pool adds four labelled
+       lines, so the body grows with node x class count */
+    size_t cap = METRICS_BASE + (size_t)(npools > 0 ? npools : 0) * METRICS_PER_POOL;
+    char *body = malloc(cap);
+    if (!body)
+    {
+        forge_send_text(client_socket, "500 Internal Server Error", "out of memory\n");
+        return;
+    }
+    int len = snprintf(body, cap,
+                       "forge_cores %d\n"
+                       "forge_connections_accepted_total %llu\n"
+                       "forge_connections_active %llu\n"
+                       "forge_requests_total %llu\n"
+                       "forge_response_bytes_total %llu\n"
+                       "forge_core_messages_total %llu\n"
+                       "forge_requests_shed_total %llu\n"
+                       "forge_queue_delay_seconds_sum %.6f\n"
+                       "forge_queue_delay_seconds_max %.6f\n"
+                       "forge_cores_overloaded %llu\n"
+                       "forge_connections_off_cpu_total %llu\n",
+                       forge_core_count(),
+                       (unsigned long long)st.accepted,
+                       (unsigned long long)st.active,
+                       (unsigned long long)st.requests,
+                       (unsigned long long)st.bytes_out,
+                       (unsigned long long)st.messages,
+                       (unsigned long long)st.shed,
+                       (double)st.queue_delay_ns / 1e9,
+                       (double)st.queue_delay_max_ns / 1e9,
+                       (unsigned long long)st.overloaded,
+                       (unsigned long long)st.accepted_off_cpu);
+
+    if (workers >= 0 && len > 0 && (size_t)len < cap)
+        len += snprintf(body + len, cap - (size_t)len,
+                        "forge_workers %d\n"
+                        "forge_worker_restarts_total %llu\n",
+                        workers, restarts);
+
+    for (int i = 0; i < npools && len > 0 && (size_t)len < cap; i++)
+    {
+        const ForgePoolStats *p = &pools[i];
+        len += snprintf(body + len, cap - (size_t)len,
+                        "forge_pool_slots_used{node=\"%d\",size=\"%zu\"} %llu\n"
+                        "forge_pool_slots_total{node=\"%d\",size=\"%zu\"} %llu\n"
+                        "forge_pool_regions{node=\"%d\",size=\"%zu\",pages=\"hugetlb\"} %llu\n"
+                        "forge_pool_regions{node=\"%d\",size=\"%zu\",pages=\"thp\"} %llu\n",
+                        p->node, p->slot_size, (unsigned long long)p->slots_used,
+                        p->node, p->slot_size, (unsigned long long)p->slots_total,
+                        p->node, p->slot_size, (unsigned long long)p->hugetlb_regions,
+                        p->node, p->slot_size,
+                        (unsigned long long)(p->regions - p->hugetlb_regions));
+    }
+
+    ForgeCacheStats cache;
+    forge_cache_stats(&cache);
+
+    if (len > 0 && (size_t)len < cap)
+        len += snprintf(body + len, cap - (size_t)len,
+                        "forge_cache_hits_total %llu\n"
+                        "forge_cache_not_modified_total %llu\n"
+                        "forge_cache_misses_total %llu\n"
+                        "forge_cache_evictions_total %llu\n"
+                        "forge_cache_entries %llu\n"
+                        "forge_cache_bytes %llu\n"
+                        "forge_cache_coalesced_total %llu\n",
+                        (unsigned long long)cache.hits,
+                        (unsigned long long)cache.not_modified,
+                        (unsigned long long)cache.misses,
+                        (unsigned long long)cache.evictions,
+                        (unsigned long long)cache.entries,
+                        (unsigned long long)cache.bytes,
+                        (unsigned long long)cache.coalesced);
+
+    ForgeSseStats sse;
+    forge_sse_stats(NULL, &sse);
+
+    if (len > 0 && (size_t)len < cap)
+        len += snprintf(body + len, cap - (size_t)len,
+                        "forge_sse_subscribers %llu\n"
+                        "forge_sse_events_total %llu\n"
+                        "forge_sse_dropped_total %llu\n"
+                        "forge_sse_coalesced_total %llu\n",
+                        (unsigned long long)sse.subscribers,
+                        (unsigned long long)sse.published,
+                        (unsigned long long)sse.dropped,
+                        (unsigned long long)sse.coalesced);
+
+    if (len < 0 || (size_t)len >= cap)
+    {
+        free(body);
+        forge_send_text(client_socket, "500 Internal Server Error", "metrics truncated\n");
+        return;
+    }
+
+    forge_send_text(client_socket, "200 OK", body);
+    free(body);
+}
+
+/* Admin reload route: rebuild the route table and report */
+void forge_handle_reload(const ForgeHttpRequest *req, int client_socket)
+{
+    (void)req;
+    if (forge_router_reload() == 0)
+        forge_send_text(client_socket, "200 OK", "reloaded\n");
+    else
+        forge_send_text(client_socket, "500 Internal Server Error", "reload failed\n");
+}
+
 /* =========================================================
    Server Creation
    ========================================================= */
@@ -76,6 +404,11 @@ ForgeServer create_forge_server(int port, int backlog)
 
     server.port = port;
     server.backlog = backlog;
+#ifdef _WIN32
+    server.unix_fd = INVALID_SOCKET;
+#else
+    server.unix_fd = -1;
+#endif
 
 #ifdef _WIN32
     WSADATA wsa;
@@ -157,124 +490,1916 @@ ForgeServer create_forge_server(int port, int backlog)
 }
 
 /* =========================================================
-   Server Loop
+   Unix Domain Socket Listener
    ========================================================= */
 
-void launch_server(ForgeServer *server)
+#ifndef _WIN32
+static int open_unix_listener(const char *path, int backlog)
 {
-    while (1)
+    struct sockaddr_un addr;
+    size_t path_len = path ? strlen(path) : 0;
+
+    if (path_len == 0 || path_len >= sizeof(addr.sun_path))
     {
-        printf("🔌 Client connected\n");
-        fflush(stdout);
+        fprintf(stderr, "unix socket path invalid or too long\n");
+        return -1;
+    }
 
-#ifdef _WIN32
-        SOCKET client_socket = accept(server->socket_fd, NULL, NULL);
-        if (client_socket == INVALID_SOCKET)
-        {
-            printf("accept failed: %d\n", WSAGetLastError());
-            continue;
-        }
-#else
-        struct sockaddr_in client_addr;
-        socklen_t addr_len = sizeof(client_addr);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        perror("unix socket failed");
+        return -1;
+    }
 
-        int client_socket = accept(
-            server->socket_fd,
-            (struct sockaddr *)&client_addr,
-            &addr_len);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, path_len + 1);
+
+    /* Replace a stale socket left behind by a previous run, but only
+       once a probe confirms nothing is listening on it any more */
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+    {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        int live = probe >= 0 &&
+                   connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        int refused = !live && errno == ECONNREFUSED;
+        if (probe >= 0)
+            close(probe);
 
-        if (client_socket < 0)
+        if (!refused)
         {
-            perror("accept failed");
-            continue;
+            fprintf(stderr, "unix socket %s is in use\n", path);
+            close(fd);
+            return -1;
         }
-#endif
+        unlink(path);
+    }
 
-        handle_client(client_socket);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("unix bind failed");
+        close(fd);
+        return -1;
     }
-}
 
-/* =========================================================
-   Client Handler
-   ========================================================= */
+    if (listen(fd, backlog) < 0)
+    {
+        perror("unix listen failed");
+        close(fd);
+        unlink(path);
+        return -1;
+    }
 
+    memcpy(unix_path, path, path_len + 1);
+    printf("🔒 Bound to unix:%s\n", path);
+    return fd;
+}
+#endif
+
+int forge_server_listen_unix(ForgeServer *server, const char *path)
+{
 #ifdef _WIN32
-void handle_client(SOCKET client_socket)
+    (void)server;
+    (void)path;
+    printf("unix sockets are not supported on Windows\n");
+    return -1;
 #else
-void handle_client(int client_socket)
+    if (!server || server->unix_fd >= 0)
+        return -1;
+
+    int fd = open_unix_listener(path, server->backlog);
+    if (fd < 0)
+        return -1;
+
+    server->unix_fd = fd;
+    return 0;
 #endif
+}
+
+ForgeServer create_forge_unix_server(const char *path, int backlog)
 {
-    char buffer[30000];
-    int bytes_read;
+    ForgeServer server;
+    memset(&server, 0, sizeof(server));
+
+    server.backlog = backlog;
 
 #ifdef _WIN32
-    bytes_read = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
+    server.socket_fd = INVALID_SOCKET;
+    server.unix_fd = INVALID_SOCKET;
+    (void)path;
+    printf("unix sockets are not supported on Windows\n");
+    exit(EXIT_FAILURE);
 #else
-    bytes_read = read(client_socket, buffer, sizeof(buffer) - 1);
+    server.socket_fd = -1;
+    server.unix_fd = open_unix_listener(path, backlog);
+    if (server.unix_fd < 0)
+        exit(EXIT_FAILURE);
+
+    printf("✅ Forge server running on unix:%s\n", path);
 #endif
+    return server;
+}
+
+/* =========================================================
+   Admission Control
+   ========================================================= */
+
+/*
+ * CoDel-style shedding on queue delay: the time from a connection
+ * becoming readable to its request reaching dispatch. While the
+ * smallest delay seen in an interval stays under `target`, requests
+ * may queue for up to one interval. Once even the best request of
+ * an interval waited longer than `target`, the queue is standing
+ * rather than bursting, and anything queued beyond `target` is
+ * answered 503 before any work is spent on it.
+ */
+static uint64_t admission_target_ns = 5ULL * 1000000ULL;
+static uint64_t admission_interval_ns = 100ULL * 1000000ULL;
+
+#define SHED_HEAD(retry_after)                    \
+    "HTTP/1.1 503 Service Unavailable\r\n"         \
+    "Content-Type: text/plain; charset=utf-8\r\n"  \
+    "Content-Length: 20\r\n"                       \
+    "Retry-After: " retry_after "\r\n"
+
+#define SHED_BODY "Service Unavailable\n"
+
+/*
+ * Pre-serialized 503 head; the common block (Server, Date,
+ * Connection) completes it. Rewritten only by
+ * forge_server_set_admission(), before launch.
+ */
+static char shed_head[160] = SHED_HEAD("1");
+static size_t shed_head_len = sizeof(SHED_HEAD("1")) - 1;
+static char shed_retry_after[16] = "1";
+
+/* Controller state of this core's loop */
+static _Thread_local struct
+{
+    uint64_t interval_end;
+    uint64_t min_delay;
+    int overloaded;
+} admission;
+
+void forge_server_set_admission(unsigned target_ms,
+                                unsigned interval_ms,
+                                unsigned retry_after_s)
+{
+    admission_target_ns = (uint64_t)target_ms * 1000000ULL;
+    admission_interval_ns = (uint64_t)(interval_ms ? interval_ms : 100) * 1000000ULL;
+
+    snprintf(shed_retry_after, sizeof(shed_retry_after), "%u", retry_after_s);
+
+    int len = snprintf(shed_head, sizeof(shed_head), SHED_HEAD("%s"),
+                       shed_retry_after);
+    shed_head_len = (size_t)len;
+}
 
-    if (bytes_read <= 0)
+unsigned long long forge_spool_budget = FORGE_SPOOL_DEFAULT_BUDGET;
+
+void forge_server_set_spool_budget(unsigned long long bytes)
+{
+    forge_spool_budget = bytes;
+}
+
+/* 1 to serve the request, 0 to shed it */
+static int admission_admit(const ForgeConn *c)
+{
+    if (c->ready_ns == 0)
+        return 1;
+
+    uint64_t now = forge_access_log_clock();
+    uint64_t delay = now > c->ready_ns ? now - c->ready_ns : 0;
+
+    if (now >= admission.interval_end)
     {
-#ifdef _WIN32
-        closesocket(client_socket);
-#else
-        close(client_socket);
-#endif
-        return;
+        admission.overloaded = admission.interval_end != 0 &&
+                               admission.min_delay > admission_target_ns;
+        admission.min_delay = delay;
+        admission.interval_end = now + admission_interval_ns;
+    }
+    else if (delay < admission.min_delay)
+    {
+        admission.min_delay = delay;
     }
 
-    buffer[bytes_read] = '\0';
+    /* Disabled: still measured, never shed */
+    int admit = 1;
+    if (admission_target_ns > 0)
+        admit = delay <= (admission.overloaded ? admission_target_ns
+                                               : admission_interval_ns);
 
-    ForgeHttpRequest req;
-    memset(&req, 0, sizeof(req));
+    forge_core_admission(forge_current_core(), delay, !admit,
+                         admission_target_ns > 0 && admission.overloaded);
+    return admit;
+}
 
-    if (forge_parse_http_request(buffer, &req) != 0)
+/*
+ * Fast 503 without touching the route. The connection survives
+ * when the request allowed it: a reconnect costs the overloaded
+ * server more than the next request does.
+ */
+static void send_shed(int client_socket)
+{
+    if (forge_exchange.h2)
     {
-        send_404(client_socket);
-        goto cleanup;
+        forge_response_header(client_socket, "Retry-After", shed_retry_after);
+        forge_send_text(client_socket, "503 Service Unavailable", SHED_BODY);
+        return;
     }
 
-    const ForgeHttpRequest *creq = &req;
+    forge_http_respond_raw(client_socket, 503, shed_head, shed_head_len,
+                           SHED_BODY, sizeof(SHED_BODY) - 1);
+}
+
+/* =========================================================
+   Dispatch
+   ========================================================= */
+
+static pthread_once_t builtin_once = PTHREAD_ONCE_INIT;
+
+static void builtin_commit(void)
+{
+    forge_router_commit(routes, (int)(sizeof(routes) / sizeof(routes[0])));
+}
+
+const ForgeCompiledRoute *forge_server_route(const ForgeHttpRequest *req)
+{
+    /* Launch publishes the built-ins; a bare handle_client() does it here once */
+    pthread_once(&builtin_once, builtin_commit);
+    return forge_router_resolve(req);
+}
+
+/* Tagged HIGH, or untagged and one of the built-in probe routes */
+static int route_is_high(const ForgeCompiledRoute *route)
+{
+    if (route->priority >= 0)
+        return route->priority == FORGE_PRIORITY_HIGH;
+
+    return route->route.handler == handle_health ||
+           route->route.handler == handle_metrics;
+}
 
-    const ForgeRoute *route =
-        forge_match_route(
-            routes,
-            (int)(sizeof(routes) / sizeof(routes[0])),
-            creq);
+void forge_server_dispatch(const ForgeCompiledRoute *route,
+                           const ForgeHttpRequest *req,
+                           int client_socket)
+{
+    ForgeConn *c = req->conn;
+    int resumed = c && (c->parked == FORGE_RESUMED || c->screen == FORGE_SCREENED);
 
-    if (route)
+    if (resumed)
     {
-        route->handler(creq, client_socket);
+        /* As the handler or the screening left it: middleware headers, keep-alive */
+        forge_exchange = *c->park_exchange;
+        free(c->park_exchange);
+        c->park_exchange = NULL;
+        c->screen = 0;
     }
     else
     {
-        send_404(client_socket);
+        /* Armed even for 404s and 503s so an unread body can be drained */
+        if (c)
+            forge_conn_begin_body(c, req, route->route.max_body);
+
+        int high = route_is_high(route);
+
+        if (control_lane && !high)
+        {
+            send_404(client_socket);
+            forge_core_request_done(forge_current_core(), forge_exchange.bytes);
+            return;
+        }
+
+        /* Probes must get through exactly when the server is overloaded */
+        if (c && !high && !admission_admit(c))
+        {
+            send_shed(client_socket);
+            return;
+        }
     }
 
-cleanup:
-#ifdef _WIN32
-    closesocket(client_socket);
-#else
-    close(client_socket);
-#endif
+    forge_exchange.route_arg = route->route.arg;
+
+    /* A resumed request already passed its before middleware */
+    int ran = resumed ? route->chain_len : 0;
+    int halted = 0;
+
+    while (ran < route->chain_len)
+    {
+        ForgeMiddlewareFn before = route->chain[ran++].before;
+        if (before && before(req, client_socket) != FORGE_NEXT)
+        {
+            halted = 1;
+            break;
+        }
+    }
+
+    /* Screened: the handler runs once the body is staged */
+    if (!halted && c && c->screen == FORGE_SCREENING)
+    {
+        ForgeExchange *saved = malloc(sizeof(*saved));
+        if (saved)
+        {
+            *saved = forge_exchange;
+            c->park_exchange = saved;
+            c->screen = FORGE_SCREENED;
+            return;
+        }
+        send_shed(client_socket);
+        halted = 1;
+    }
+
+    if (!halted)
+    {
+        if (!route->route.handler)
+            send_404(client_socket);
+        else if (req->conn && req->conn->body_error == FORGE_BODY_TOO_LARGE)
+            forge_send_text(client_socket, "413 Payload Too Large",
+                            "Payload Too Large\n");
+        else if (req->conn && req->conn->body_error == FORGE_BODY_UNAVAILABLE)
+            send_shed(client_socket);
+        else if (route->cache)
+            forge_cache_serve(route->cache, route->route.handler,
+                              req, client_socket);
+        else
+            route->route.handler(req, client_socket);
+    }
+
+    /* Answered, and accounted for, once it resumes */
+    if (c && c->parked == FORGE_PARKED)
+        return;
+    if (c)
+        c->parked = 0;
+
+    while (ran-- > 0)
+    {
+        ForgeMiddlewareDoneFn after = route->chain[ran].after;
+        if (after)
+            after(req, client_socket, forge_exchange.status);
+    }
+
+    forge_core_request_done(forge_current_core(), forge_exchange.bytes);
 }
 
 /* =========================================================
-   404 Helper
+   Parking
    ========================================================= */
 
-static void send_404(int client_socket)
+int forge_conn_park(ForgeConn *c)
 {
-    forge_send_text(client_socket, "404 Not Found", "Not Found\n");
+    /* Only a core loop can set an exchange aside and come back to it */
+    ForgeConn *owner = c && c->owner ? c->owner : c;
+    if (!owner || !owner->polled || control_lane)
+        return -1;
+
+    ForgeExchange *saved = malloc(sizeof(*saved));
+    if (!saved)
+        return -1;
+    *saved = forge_exchange;
+
+    c->park_exchange = saved;
+    c->park_result = NULL;
+    c->park_core = forge_core_id(forge_current_core());
+    c->parked = FORGE_PARKED;
+    return 0;
+}
+
+/* On the parked connection's core: its loop dispatches it again */
+static void conn_wake(ForgeCore *core, void *arg)
+{
+    (void)core;
+    ForgeConn *c = arg;
+
+    c->parked = FORGE_RESUMED;
+    (c->owner ? c->owner : c)->woken = 1;
+}
+
+int forge_conn_resume(ForgeConn *c, void *result)
+{
+    c->park_result = result;
+    return forge_core_post(c->park_core, conn_wake, c);
+}
+
+int forge_conn_resumed(const ForgeConn *c, void **result)
+{
+    if (!c || c->parked != FORGE_RESUMED)
+        return 0;
+
+    *result = c->park_result;
+    return 1;
 }
 
 /* =========================================================
-   Shutdown
+   Connections
    ========================================================= */
 
-void shutdown_server(void)
+#define FORGE_MAX_CONNS 1024
+
+/* Idle keep-alive connections are swept after this long */
+#define FORGE_IDLE_TIMEOUT_NS (60ULL * 1000000000ULL)
+
+/* A request head has this long to arrive once its first byte did */
+#define FORGE_HEAD_TIMEOUT_NS (10ULL * 1000000000ULL)
+
+/* A body still arriving is dropped after this long without input */
+#define FORGE_BODY_STALL_NS (10ULL * 1000000000ULL)
+
+#ifdef _WIN32
+/* Windows reads block: bounds how long one slow client can stall */
+#define FORGE_RECV_TIMEOUT_SEC 10
+#endif
+
+/*
+ * Responses are written blocking: a client that stops reading
+ * fails the write (and loses the connection) after this long
+ * without progress, instead of holding its core's loop
+ */
+#define FORGE_SEND_TIMEOUT_MS 1000
+
+static const char h2_preface_head[] = "PRI * HTTP/2.0\r\n\r\n";
+
+static ForgeConn *conn_open(int fd, uint32_t peer_ipv4)
 {
+    /*
+     * Node-local state in a small slot; the receive buffer is drawn
+     * from the pooled tiers on the first read
+     */
+    ForgeConn *c = forge_pool_alloc(sizeof(*c));
+    if (!c)
+        return NULL;
+
+    forge_conn_init(c, fd, NULL, 0);
+    c->peer_ipv4 = peer_ipv4;
+    forge_core_conn_opened(forge_current_core());
+    c->last_active_ns = forge_access_log_clock();
+
 #ifdef _WIN32
-    WSACleanup();
+    DWORD timeout = FORGE_RECV_TIMEOUT_SEC * 1000;
+    setsockopt((SOCKET)fd, SOL_SOCKET, SO_RCVTIMEO,
+               (const char *)&timeout, sizeof(timeout));
+    timeout = FORGE_SEND_TIMEOUT_MS;
+    setsockopt((SOCKET)fd, SOL_SOCKET, SO_SNDTIMEO,
+               (const char *)&timeout, sizeof(timeout));
+#else
+    /* Reads return what is there; the loop waits for the rest */
+    c->nonblocking = 1;
+
+    struct timeval tv = {FORGE_SEND_TIMEOUT_MS / 1000,
+                         (FORGE_SEND_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    /* A streamed body is read blocking off the core: bound its stalls */
+    tv.tv_sec = (time_t)(FORGE_BODY_STALL_NS / 1000000000ULL);
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+#endif
+
+    return c;
+}
+
+static void conn_close(ForgeConn *c)
+{
+    forge_h2_free(c);
+    forge_ws_free(c);
+    forge_sse_free(c);
+    forge_zerocopy_free(c);
+    forge_core_conn_closed(forge_current_core());
+    free(c->park_exchange); /* screened, its body never staged */
+
+#ifdef _WIN32
+    closesocket((SOCKET)c->fd);
+#else
+    close(c->fd);
+#endif
+
+    forge_conn_free(c);
+    forge_pool_free(c);
+}
+
+static int wants_keep_alive(const ForgeHttpRequest *req)
+{
+    const ForgeHttpHeader *connection = forge_header_get(req, FORGE_HDR_CONNECTION);
+
+    if (strcmp(req->version, "HTTP/1.1") == 0)
+        return !forge_http_has_token(connection, "close");
+
+    return forge_http_has_token(connection, "keep-alive");
+}
+
+/*
+ * Read what has arrived of a request head. Returns its length,
+ * FORGE_CONN_AGAIN until it is complete, 0 on EOF or once its
+ * deadline passed, -1 on overflow.
+ */
+static long receive_head(ForgeConn *c)
+{
+    long head_len = forge_conn_read_head(c);
+
+    /* The head's clock starts at its first byte, not at each read */
+    if (c->len > 0 && !c->request_ns)
+    {
+        c->request_ns = c->ready_ns;
+        c->deadline_ns = c->ready_ns + FORGE_HEAD_TIMEOUT_NS;
+    }
+
+    /* Trickling bytes in keeps it readable, not alive */
+    if (head_len == FORGE_CONN_AGAIN && c->deadline_ns &&
+        c->ready_ns >= c->deadline_ns)
+        return 0;
+    return head_len;
+}
+
+/* forge_server_stream_body(): a handful of handlers, never removed */
+#define MAX_STREAM_HANDLERS 4
+static _Atomic(ForgeRouteHandler) stream_handlers[MAX_STREAM_HANDLERS];
+
+int forge_server_stream_body(ForgeRouteHandler handler)
+{
+    for (int i = 0; i < MAX_STREAM_HANDLERS; i++)
+    {
+        ForgeRouteHandler expected = NULL;
+        if (atomic_compare_exchange_strong(&stream_handlers[i], &expected, handler) ||
+            expected == handler)
+            return 0;
+    }
+    return -1;
+}
+
+static int streams_body(const ForgeCompiledRoute *route)
+{
+    for (int i = 0; i < MAX_STREAM_HANDLERS; i++)
+    {
+        ForgeRouteHandler handler = atomic_load(&stream_handlers[i]);
+        if (!handler)
+            return 0;
+        if (handler == route->route.handler)
+            return 1;
+    }
+    return 0;
+}
+
+/* Body bytes of the armed request that have not arrived yet */
+static int body_arriving(const ForgeConn *c)
+{
+#ifdef _WIN32
+    (void)c;
+    return 0; /* not staged: handlers read it from the socket */
+#else
+    if (c->body_error)
+        return 0;
+    if (c->body_mode == FORGE_BODY_CHUNKED)
+        return 1;
+    return c->body_mode == FORGE_BODY_LENGTH && c->remaining > c->len - c->pos;
+#endif
+}
+
+/*
+ * Admission and the route's before middleware, run for a request
+ * whose body is still to come: a shed or refused upload is answered
+ * without staging (or spooling) any of it. Returns 1 when it may
+ * stage; 0 once it was answered and logged.
+ */
+static int screen_request(ForgeConn *c, ForgeHttpRequest *req,
+                          const ForgeCompiledRoute *route)
+{
+    forge_exchange_begin(c->fd, !control_lane && wants_keep_alive(req), NULL);
+    forge_exchange.conn = c;
+    forge_exchange.chunked_ok = strcmp(req->version, "HTTP/1.1") == 0;
+
+    c->screen = FORGE_SCREENING;
+    forge_server_dispatch(route, req, c->fd);
+    if (c->screen == FORGE_SCREENED)
+        return 1;
+
+    c->screen = 0;
+    forge_access_log_record(req,
+                            forge_exchange.status,
+                            forge_exchange.bytes,
+                            c->peer_ipv4,
+                            c->request_ns ? c->request_ns : c->ready_ns);
+    return 0;
+}
+
+/*
+ * Receive the body of the parsed `req` before dispatch, so handlers
+ * never wait on the socket. Returns 0 when `req` can be dispatched,
+ * FORGE_CONN_AGAIN while the body is still arriving, -1 to close
+ * (also once screening answered it: its body was never read).
+ */
+static int receive_body(ForgeConn *c, ForgeHttpRequest *req)
+{
+    if (!c->staging && !c->screen)
+    {
+        forge_router_enter();
+        const ForgeCompiledRoute *route = forge_server_route(req);
+        forge_conn_begin_body(c, req, route->route.max_body);
+        int streams = streams_body(route);
+        int admitted = streams || !body_arriving(c) || screen_request(c, req, route);
+        forge_router_exit();
+
+        if (!admitted)
+            return -1;
+        if (streams)
+            return 0; /* its handler reads the body as it arrives */
+    }
+
+    char *head = c->buf;
+    int rc = forge_conn_stage_body(c);
+    if (rc == FORGE_CONN_AGAIN)
+    {
+        c->deadline_ns = c->ready_ns + FORGE_BODY_STALL_NS;
+        return rc;
+    }
+    if (rc != 0)
+        return -1;
+
+    /* A buffer that grew for the body moved the head under `req` */
+    if (c->buf != head)
+    {
+        memset(req, 0, sizeof(*req));
+        if (forge_parse_http_request(c->buf, req) != 0)
+            return -1;
+        req->conn = c;
+    }
+    return 0;
+}
+
+/* serve_request(): the handler parked it, leave the connection be */
+#define CONN_PARKED 1
+
+/*
+ * Dispatch a parsed request and complete the exchange. Returns 0
+ * to keep the connection, CONN_PARKED, or -1 to close it.
+ */
+static int run_request(ForgeConn *c, ForgeHttpRequest *req, uint64_t start_ns)
+{
+    forge_exchange_begin(c->fd, !control_lane && wants_keep_alive(req), NULL);
+    forge_exchange.conn = c;
+    forge_exchange.chunked_ok = strcmp(req->version, "HTTP/1.1") == 0;
+
+    forge_router_enter();
+    forge_server_dispatch(forge_server_route(req), req, c->fd);
+    forge_router_exit();
+
+    if (c->parked == FORGE_PARKED)
+    {
+        c->park_ns = start_ns;
+        return CONN_PARKED;
+    }
+
+    forge_access_log_record(req,
+                            forge_exchange.status,
+                            forge_exchange.bytes,
+                            c->peer_ipv4,
+                            start_ns);
+
+    /* Handlers can revoke keep-alive (e.g. after a truncated body) */
+    if (forge_exchange.status == 0 || !forge_exchange.keep_alive ||
+        forge_conn_finish_body(c) != 0)
+        return -1;
+
+    forge_conn_next_request(c);
+    return 0;
+}
+
+/*
+ * Serve one HTTP/1.x request from `c` with what the socket has.
+ * Returns 0 when the connection stays open for another request,
+ * FORGE_CONN_AGAIN while the request is still arriving,
+ * CONN_PARKED, or -1 to close it.
+ */
+static int serve_request(ForgeConn *c)
+{
+    ForgeHttpRequest req;
+    memset(&req, 0, sizeof(req));
+
+    /* Resumed: its head and body are where the handler left them */
+    if (c->parked == FORGE_RESUMED)
+    {
+        if (forge_parse_http_request(c->buf, &req) != 0)
+            return -1;
+        req.conn = c;
+        return run_request(c, &req, c->park_ns);
+    }
+
+    /* Staging: the head was parsed when it came in and stays put */
+    long head_len = c->staging ? (long)c->body_base : receive_head(c);
+    if (head_len == FORGE_CONN_AGAIN && !c->staging)
+        return FORGE_CONN_AGAIN;
+    if (head_len == 0)
+        return -1;
+
+    /* HTTP/2 with prior knowledge: the preface parses as a head */
+    if (!control_lane && head_len == (long)sizeof(h2_preface_head) - 1 &&
+        memcmp(c->buf, h2_preface_head, (size_t)head_len) == 0)
+    {
+        c->request_ns = c->deadline_ns = 0;
+        return forge_h2_start(c, NULL);
+    }
+
+    int parse_rc = head_len > 0 ? forge_parse_http_request(c->buf, &req) : -1;
+    int parsed = parse_rc == 0;
+
+    if (parsed && !c->staging)
+    {
+        c->pos = (size_t)head_len;
+
+        /* Answered on stream 1 after the 101; logged by the h2 layer */
+        if (!control_lane && forge_h2_wants_upgrade(&req))
+        {
+            c->request_ns = c->deadline_ns = 0;
+            return forge_h2_start(c, &req);
+        }
+    }
+    req.conn = c;
+
+    if (parsed)
+    {
+        int rc = receive_body(c, &req);
+        if (rc != 0)
+            return rc;
+    }
+
+    uint64_t start_ns = c->request_ns ? c->request_ns : c->ready_ns;
+    c->request_ns = c->deadline_ns = 0;
+
+    if (!parsed)
+    {
+        forge_exchange_begin(c->fd, 0, NULL);
+        forge_exchange.conn = c;
+        if (parse_rc == FORGE_PARSE_UNSUPPORTED)
+            forge_send_text(c->fd, "501 Not Implemented", "Not Implemented\n");
+        else
+            send_404(c->fd);
+        forge_access_log_record(NULL, forge_exchange.status,
+                                forge_exchange.bytes, c->peer_ipv4, start_ns);
+        return -1;
+    }
+
+    return run_request(c, &req, start_ns);
+}
+
+/* True when a complete pipelined head is already buffered */
+static int head_buffered(ForgeConn *c)
+{
+    c->buf[c->len] = '\0';
+    return c->len > 0 && strstr(c->buf, "\r\n\r\n") != NULL;
+}
+
+static int conn_input(ForgeConn *c)
+{
+    if (c->proto == FORGE_PROTO_H2)
+        return forge_h2_serve(c);
+    if (c->proto == FORGE_PROTO_WS)
+        return forge_ws_serve(c);
+    if (c->proto == FORGE_PROTO_SSE)
+        return forge_sse_serve(c);
+
+    do
+    {
+        int rc = serve_request(c);
+        if (rc == FORGE_CONN_AGAIN || rc == CONN_PARKED)
+            return 0; /* the rest arrives with a later POLLIN */
+        if (rc != 0)
+            return -1;
+    } while (c->proto == FORGE_PROTO_HTTP1 && head_buffered(c));
+
+    /* Frames the client sent right behind the handshake */
+    if (c->proto == FORGE_PROTO_WS && c->len > 0)
+        return forge_ws_process(c);
+
+    return 0;
+}
+
+/* The connection is readable: 0 keeps it, -1 closes it */
+static int conn_serve(ForgeConn *c)
+{
+    if (conn_input(c) != 0)
+        return -1;
+
+    /* Nothing half-received: idle on the smallest buffer */
+    if (!c->parked)
+        forge_conn_release(c);
+    return 0;
+}
+
+/* Parked work handed back: dispatch it again; 0 keeps `c`, -1 closes it */
+static int conn_resume(ForgeConn *c)
+{
+    c->woken = 0;
+    if (c->proto == FORGE_PROTO_H2)
+        return forge_h2_resume(c);
+    return conn_serve(c);
+}
+
+/* Parked work still out: `c` cannot be freed yet */
+static int conn_busy(const ForgeConn *c)
+{
+    return c->parked || (c->proto == FORGE_PROTO_H2 && forge_h2_parked(c) > 0);
+}
+
+/*
+ * Closing with zero-copy bodies in flight: the kernel still reads
+ * their pages, and closing now would have to wait for it. Instead
+ * the socket is shut down and stays on the loop, polled only for
+ * the error queue, until they complete. 1 when it lingers.
+ */
+static int conn_linger(ForgeConn *c, uint64_t now)
+{
+#ifndef _WIN32
+    if (forge_zerocopy_pending(c) == 0)
+        return 0;
+
+    forge_h2_free(c);
+    forge_ws_free(c);
+    forge_sse_free(c);
+    shutdown(c->fd, SHUT_WR);
+
+    c->lingering = 1;
+    c->want_write = 0;
+    c->deadline_ns = now + (uint64_t)FORGE_ZEROCOPY_CLOSE_WAIT_MS * 1000000ULL;
+    return 1;
+#else
+    (void)c;
+    (void)now;
+    return 0;
+#endif
+}
+
+/* =========================================================
+   Control Listener
+   ========================================================= */
+
+#ifdef _WIN32
+int forge_server_listen_control(ForgeServer *server, int port)
+{
+    (void)server;
+    (void)port;
+    printf("the control listener is not supported on Windows\n");
+    return -1;
+}
+#else
+/*
+ * The control thread: one request per connection, with short socket
+ * timeouts so a stalled client cannot hold the lane. Mostly asleep,
+ * so the scheduler runs it promptly even when every core is busy.
+ */
+static void *control_main(void *arg)
+{
+    (void)arg;
+    control_lane = 1;
+    if (!forge_core_attach_aside())
+        return NULL;
+
+    while (1)
+    {
+        struct pollfd pfd = {control_fd, POLLIN, 0};
+        if (poll(&pfd, 1, -1) < 0)
+            continue;
+
+        struct sockaddr_storage client_addr;
+        socklen_t addr_len = sizeof(client_addr);
+        int fd = accept(control_fd, (struct sockaddr *)&client_addr, &addr_len);
+        if (fd < 0)
+            continue; /* another worker took it */
+
+        uint32_t peer_ipv4 = 0;
+        if (client_addr.ss_family == AF_INET)
+            peer_ipv4 = ((struct sockaddr_in *)&client_addr)->sin_addr.s_addr;
+
+        ForgeConn *c = conn_open(fd, peer_ipv4);
+        if (!c)
+        {
+            close(fd);
+            continue;
+        }
+        c->nonblocking = 0; /* a thread of its own: reads may wait */
+
+        /* Writes are bounded by conn_open(); reads tighter than its */
+        struct timeval tv = {1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        forge_http_tick();
+        c->ready_ns = forge_access_log_clock();
+        serve_request(c);
+        conn_close(c);
+    }
+    return NULL;
+}
+
+int forge_server_listen_control(ForgeServer *server, int port)
+{
+    if (!server || control_fd >= 0)
+        return -1;
+
+    struct sockaddr_in addr = server->address;
+    addr.sin_family = AF_INET;
+    if (server->socket_fd < 0)
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)port);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    socklen_t addr_len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, 64) < 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len) < 0)
+    {
+        perror("control listener failed");
+        close(fd);
+        return -1;
+    }
+
+    /* Pre-fork workers all accept from it */
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    control_fd = fd;
+    printf("🔒 Control listener on port %d\n", ntohs(addr.sin_port));
+    return ntohs(addr.sin_port);
+}
+
+/* At launch, in the process that serves */
+static void control_start(void)
+{
+    pthread_t thread;
+    if (control_fd < 0)
+        return;
+
+    if (pthread_create(&thread, NULL, control_main, NULL) != 0)
+    {
+        perror("control thread failed");
+        return;
+    }
+    pthread_detach(thread);
+}
+#endif
+
+/* =========================================================
+   CPU Placement
+   ========================================================= */
+
+/* Set before launch; read-only while serving */
+static int placement_cpus[FORGE_MAX_CORES];
+static int placement_count; /* 0: not pinned */
+static int placement_auto;  /* resolve from the allowed CPUs at launch */
+static int placement_steer;
+
+#ifdef __linux__
+/* CPU this core's thread is pinned to, -1 when it floats */
+static _Thread_local int pinned_cpu = -1;
+#endif
+
+/* SO_REUSEPORT group in join order: [0] is the server's socket */
+static int reuseport_fds[FORGE_MAX_CORES];
+static int reuseport_count;
+
+int forge_parse_cpu_list(const char *list, int *cpus, int max)
+{
+    int n = 0;
+    const char *p = list;
+
+    while (p && *p)
+    {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p || lo < 0)
+            return -1;
+
+        long hi = lo;
+        if (*end == '-')
+        {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+            if (end == p || hi < lo)
+                return -1;
+        }
+
+        for (long cpu = lo; cpu <= hi; cpu++)
+        {
+            if (n == max || cpu > 65535)
+                return -1;
+            cpus[n++] = (int)cpu;
+        }
+
+        if (*end == ',')
+            end++;
+        else if (*end != '\0')
+            return -1;
+        p = end;
+    }
+    return n > 0 ? n : -1;
+}
+
+#ifdef _WIN32
+int forge_server_pin_cpus(const int *cpus, int count)
+{
+    (void)cpus;
+    (void)count;
+    return -1;
+}
+
+int forge_server_steer_connections(int enable)
+{
+    (void)enable;
+    return -1;
+}
+#else
+int forge_server_pin_cpus(const int *cpus, int count)
+{
+#ifdef __linux__
+    if (!cpus)
+    {
+        placement_auto = 1;
+        placement_count = 0;
+        return 0;
+    }
+    if (count < 1 || count > FORGE_MAX_CORES)
+        return -1;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (cpus[i] < 0 || cpus[i] >= CPU_SETSIZE)
+            return -1;
+        placement_cpus[i] = cpus[i];
+    }
+    placement_auto = 0;
+    placement_count = count;
+    return 0;
+#else
+    (void)cpus;
+    (void)count;
+    return -1;
+#endif
+}
+
+int forge_server_steer_connections(int enable)
+{
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    placement_steer = enable != 0;
+    return 0;
+#else
+    (void)enable;
+    return -1;
+#endif
+}
+#endif
+
+#ifdef __linux__
+/* The CPUs this process may run on, in order */
+static void placement_resolve(void)
+{
+    if (!placement_auto)
+        return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+        return;
+
+    placement_count = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && placement_count < FORGE_MAX_CORES; cpu++)
+    {
+        if (CPU_ISSET(cpu, &set))
+            placement_cpus[placement_count++] = cpu;
+    }
+    placement_auto = 0;
+}
+
+/* CPU of core / worker `slot` */
+static int placement_cpu(int slot)
+{
+    return placement_count > 0 ? placement_cpus[slot % placement_count] : -1;
+}
+
+/* Start hook: pin the core thread before it allocates or accepts */
+static void placement_start(ForgeCore *core, void *arg)
+{
+    (void)arg;
+    int cpu = placement_cpu(worker_index >= 0 ? worker_index : forge_core_id(core));
+    if (cpu < 0)
+        return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0)
+    {
+        fprintf(stderr, "pinning to CPU %d failed: %s\n", cpu, strerror(rc));
+        return;
+    }
+    pinned_cpu = cpu;
+}
+
+/*
+ * Listener i of the SO_REUSEPORT group belongs to the core or worker
+ * pinned on placement_cpu(i). The program maps the CPU that received
+ * the SYN to that index; other CPUs return an invalid index, which
+ * makes the kernel fall back to its hash.
+ */
+static int steer_attach(int fd, int listeners)
+{
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+    struct sock_filter code[2 + 2 * FORGE_MAX_CORES];
+    int n = 0;
+
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                                             (uint32_t)(SKF_AD_OFF + SKF_AD_CPU));
+    for (int i = 0; i < listeners; i++)
+    {
+        code[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+                                                 (uint32_t)placement_cpu(i), 0, 1);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, (uint32_t)i);
+    }
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffffffffu);
+
+    struct sock_fprog prog = {(unsigned short)n, code};
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) != 0)
+    {
+        perror("SO_ATTACH_REUSEPORT_CBPF");
+        return -1;
+    }
+    return 0;
+#else
+    (void)fd;
+    (void)listeners;
+    return -1;
+#endif
+}
+
+/* Launch: pin core threads and steer the listener group if asked */
+static void placement_apply(void)
+{
+    placement_resolve();
+    if (placement_count > 0)
+        forge_core_on_start(placement_start, NULL);
+
+    if (!placement_steer)
+        return;
+    if (placement_count == 0)
+    {
+        fprintf(stderr, "connection steering needs pinned CPUs, not steering\n");
+        return;
+    }
+    for (int i = 0; i < reuseport_count; i++)
+    {
+        if (reuseport_fds[i] < 0)
+        {
+            fprintf(stderr, "connection steering needs SO_REUSEPORT, not steering\n");
+            return;
+        }
+    }
+    steer_attach(reuseport_fds[0], reuseport_count);
+}
+#endif
+
+/* =========================================================
+   Server Loop
+   ========================================================= */
+
+#ifdef _WIN32
+void launch_server(ForgeServer *server)
+{
+    /* No event loop on Windows: one connection at a time */
+    while (1)
+    {
+        SOCKET client_socket = accept(server->socket_fd, NULL, NULL);
+        if (client_socket == INVALID_SOCKET)
+        {
+            printf("accept failed: %d\n", WSAGetLastError());
+            continue;
+        }
+
+        handle_client(client_socket);
+    }
+}
+
+void launch_server_cores(ForgeServer *server, int cores)
+{
+    (void)cores;
+    launch_server(server);
+}
+#else
+static void accept_client(int listen_fd, ForgeConn **conns, int *nconns)
+{
+    struct sockaddr_storage client_addr;
+    socklen_t addr_len = sizeof(client_addr);
+
+    int client_socket = accept(
+        listen_fd,
+        (struct sockaddr *)&client_addr,
+        &addr_len);
+
+    if (client_socket < 0)
+    {
+        /* Shared listener: another core won the race */
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            perror("accept failed");
+        return;
+    }
+
+    uint32_t peer_ipv4 = 0;
+    if (client_addr.ss_family == AF_INET)
+        peer_ipv4 = ((struct sockaddr_in *)&client_addr)->sin_addr.s_addr;
+
+    ForgeConn *c = conn_open(client_socket, peer_ipv4);
+    if (!c)
+    {
+        close(client_socket);
+        return;
+    }
+
+#if defined(__linux__) && defined(SO_INCOMING_CPU)
+    /* Its packets land on another core's CPU: cross-core cache traffic */
+    int cpu = -1;
+    socklen_t cpu_len = sizeof(cpu);
+    if (pinned_cpu >= 0 &&
+        getsockopt(client_socket, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &cpu_len) == 0 &&
+        cpu >= 0 && cpu != pinned_cpu)
+        forge_core_conn_off_cpu(forge_current_core());
+#endif
+
+    c->polled = 1;
+    conns[(*nconns)++] = c;
+}
+
+/*
+ * A TCP listener of this core's own, bound to the server's address
+ * through SO_REUSEPORT so the kernel spreads connections across
+ * cores. -1 when the platform cannot do that.
+ */
+static int open_core_listener(const ForgeServer *server)
+{
+#ifdef SO_REUSEPORT
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0 ||
+        bind(fd, (const struct sockaddr *)&server->address,
+             sizeof(server->address)) < 0 ||
+        listen(fd, server->backlog) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    (void)server;
+    return -1;
+#endif
+}
+
+/*
+ * One core's poll() loop over its listeners, its own connections
+ * and its message inbox. Keep-alive and HTTP/2 connections stay
+ * registered between requests; a one second tick sweeps idle ones.
+ */
+static void core_loop(ForgeCore *core, void *arg)
+{
+    ForgeServer *server = arg;
+
+    /* Core 0 keeps the server's socket; the others got their own at launch */
+    int tcp_fd = server->socket_fd;
+    int id = forge_core_id(core);
+    if (id > 0 && id < reuseport_count && reuseport_fds[id] >= 0)
+        tcp_fd = reuseport_fds[id];
+
+    int wake_fd = forge_core_wake_fd(core);
+
+    struct pollfd *fds = calloc(3 + FORGE_MAX_CONNS, sizeof(*fds));
+    ForgeConn **conns = calloc(FORGE_MAX_CONNS, sizeof(*conns));
+    if (!fds || !conns)
+    {
+        perror("core allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    int nconns = 0;
+    int timeout_ms = 1000;
+
+    while (1)
+    {
+        int nfds = 0;
+
+        if (wake_fd >= 0)
+            fds[nfds++] = (struct pollfd){wake_fd, POLLIN, 0};
+        int nwake = nfds;
+
+        /* At capacity new connections wait in the listen backlog */
+        if (nconns < FORGE_MAX_CONNS)
+        {
+            if (tcp_fd >= 0)
+                fds[nfds++] = (struct pollfd){tcp_fd, POLLIN, 0};
+            if (server->unix_fd >= 0)
+                fds[nfds++] = (struct pollfd){server->unix_fd, POLLIN, 0};
+        }
+        int nlisten = nfds;
+
+        /*
+         * Connections with queued output (event streams) also wait to
+         * write; parked ones are left out until their work comes back
+         */
+        for (int i = 0; i < nconns; i++)
+        {
+            ForgeConn *c = conns[i];
+            if (c->parked || c->closing)
+                fds[nfds++] = (struct pollfd){-1, 0, 0};
+            else if (c->lingering)
+                fds[nfds++] = (struct pollfd){c->fd, 0, 0}; /* POLLERR only */
+            else
+                fds[nfds++] = (struct pollfd){c->fd,
+                                              (short)(POLLIN | (c->want_write ? POLLOUT : 0)),
+                                              0};
+        }
+
+        if (poll(fds, (nfds_t)nfds, timeout_ms) < 0)
+        {
+            if (errno != EINTR)
+                perror("poll failed");
+            continue;
+        }
+
+        /* Queue delay of everything readable now counts from here */
+        uint64_t now = forge_access_log_clock();
+        forge_http_tick();
+
+        if (nwake && fds[0].revents)
+            forge_core_clear_wake(core);
+        forge_core_drain(core);
+
+        /* Reloads run here, off the request path; readers never wait */
+        if (id == 0 && reload_requested)
+        {
+            reload_requested = 0;
+            if (forge_router_reload() != 0)
+                fprintf(stderr, "route reload failed, serving the previous table\n");
+        }
+        if (id == 0)
+            forge_router_reclaim();
+
+        int next_timer = forge_core_run_timers(core, now);
+        timeout_ms = next_timer >= 0 && next_timer < 1000 ? next_timer : 1000;
+
+        /* Backwards, so swap-removal only moves visited entries */
+        for (int i = nconns - 1; i >= 0; i--)
+        {
+            ForgeConn *c = conns[i];
+
+            short revents = fds[nlisten + i].revents;
+
+            /* Zero-copy completions raise POLLERR; alone they need no read */
+            if ((revents & POLLERR) && c->zc && forge_zerocopy_reap(c, 0) > 0)
+                revents &= ~POLLERR;
+
+            if (c->lingering)
+            {
+                /* Closed for good once its bodies are done, or at the deadline */
+                forge_zerocopy_reap(c, 0);
+                if (forge_zerocopy_pending(c) > 0 && now < c->deadline_ns &&
+                    !(revents & (POLLERR | POLLHUP | POLLNVAL)))
+                    continue;
+            }
+            else if (c->woken)
+            {
+                /* Parked work handed back by forge_conn_resume() */
+                c->ready_ns = now;
+                if (conn_resume(c) == 0 && !c->closing)
+                {
+                    c->last_active_ns = now;
+                    continue;
+                }
+            }
+            else if (c->parked || c->closing)
+            {
+                /* Neither read nor timed out while its work is out */
+                continue;
+            }
+            else if (revents)
+            {
+                c->ready_ns = now;
+                if (conn_serve(c) == 0)
+                {
+                    c->last_active_ns = now;
+                    continue;
+                }
+            }
+            else if (c->deadline_ns)
+            {
+                /* A request still arriving has until its deadline */
+                if (now < c->deadline_ns)
+                    continue;
+            }
+            else if (c->proto == FORGE_PROTO_SSE ||
+                     now - c->last_active_ns < FORGE_IDLE_TIMEOUT_NS)
+            {
+                /* Event streams are checked by their heartbeats */
+                continue;
+            }
+            else if (c->proto == FORGE_PROTO_WS && forge_ws_keepalive(c) == 0)
+            {
+                /* Pinged; closed next time unless it answers */
+                c->last_active_ns = now;
+                continue;
+            }
+
+            /* Parked streams still point at it: closed once they are back */
+            if (conn_busy(c))
+            {
+                c->closing = 1;
+                continue;
+            }
+            if (!c->lingering && conn_linger(c, now))
+                continue;
+
+            conn_close(c);
+            conns[i] = conns[--nconns];
+        }
+
+        for (int i = nwake; i < nlisten; i++)
+        {
+            if ((fds[i].revents & POLLIN) && nconns < FORGE_MAX_CONNS)
+                accept_client(fds[i].fd, conns, &nconns);
+        }
+    }
+}
+
+void launch_server(ForgeServer *server)
+{
+    launch_server_cores(server, 1);
+}
+
+static void listeners_nonblocking(const ForgeServer *server)
+{
+    if (server->socket_fd >= 0)
+        fcntl(server->socket_fd, F_SETFL,
+              fcntl(server->socket_fd, F_GETFL) | O_NONBLOCK);
+    if (server->unix_fd >= 0)
+        fcntl(server->unix_fd, F_SETFL,
+              fcntl(server->unix_fd, F_GETFL) | O_NONBLOCK);
+}
+
+/*
+ * Open the SO_REUSEPORT group up front, in order, so group index i
+ * is core (or worker) i whatever order the threads start in.
+ */
+static void reuseport_open(const ForgeServer *server, int count)
+{
+    if (count > FORGE_MAX_CORES)
+        count = FORGE_MAX_CORES;
+
+    reuseport_fds[0] = server->socket_fd;
+    reuseport_count = 1;
+    if (server->socket_fd < 0 || count < 2)
+        return;
+
+#ifdef SO_REUSEPORT
+    /*
+     * Only now, once a group is wanted: a lone server keeps failing
+     * with EADDRINUSE against a second one started on its port
+     */
+    int opt = 1;
+    setsockopt(server->socket_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+#endif
+
+    while (reuseport_count < count)
+        reuseport_fds[reuseport_count++] = open_core_listener(server);
+}
+
+void launch_server_cores(ForgeServer *server, int cores)
+{
+    if (cores <= 0)
+        cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    /* Listeners that several cores accept from must not block */
+    if (cores > 1)
+        listeners_nonblocking(server);
+
+    reuseport_open(server, cores);
+#ifdef __linux__
+    placement_apply();
+#endif
+
+    /* Cores share the compiled route table read-only */
+    forge_router_commit(routes, (int)(sizeof(routes) / sizeof(routes[0])));
+    signal(SIGHUP, reload_signal);
+
+    /* A client that hangs up mid-response fails that write only */
+    signal(SIGPIPE, SIG_IGN);
+    control_start();
+
+    if (forge_core_run(cores, core_loop, server) != 0)
+    {
+        fprintf(stderr, "core runtime failed to start\n");
+        exit(EXIT_FAILURE);
+    }
+}
+#endif
+
+/* =========================================================
+   Pre-fork Workers
+   ========================================================= */
+
+#ifdef _WIN32
+void launch_server_workers(ForgeServer *server, int workers)
+{
+    (void)workers;
+    launch_server(server);
+}
+
+int forge_worker_id(void)
+{
+    return -1;
+}
+
+static int workers_stats(ForgeCoreStats *out, unsigned long long *restarts)
+{
+    (void)out;
+    (void)restarts;
+    return -1;
+}
+#else
+static volatile sig_atomic_t master_stop;
+
+int forge_worker_id(void)
+{
+    return worker_index;
+}
+
+/* Copy this worker's counters into its shared slot */
+static void worker_publish(void)
+{
+    ForgeCoreStats st;
+    forge_core_stats(-1, &st);
+
+    const uint64_t *words = (const uint64_t *)&st;
+    WorkerSlot *slot = &worker_shared->slots[worker_index];
+    for (size_t w = 0; w < STAT_WORDS; w++)
+        atomic_store_explicit(&slot->words[w], words[w], memory_order_relaxed);
+}
+
+static void worker_publish_tick(ForgeCore *core, void *arg)
+{
+    (void)core;
+    (void)arg;
+    worker_publish();
+}
+
+static void worker_start(ForgeCore *core, void *arg)
+{
+    (void)arg;
+    forge_core_every(core, 100, worker_publish_tick, NULL);
+}
+
+static int workers_stats(ForgeCoreStats *out, unsigned long long *restarts)
+{
+    if (!worker_shared || worker_index < 0)
+        return -1;
+
+    /* Our own numbers fresh, the others' as of their last tick */
+    worker_publish();
+
+    uint64_t sum[STAT_WORDS];
+    for (size_t w = 0; w < STAT_WORDS; w++)
+        sum[w] = atomic_load_explicit(&worker_shared->retired.words[w],
+                                      memory_order_relaxed);
+
+    for (int i = 0; i < worker_shared->workers; i++)
+    {
+        for (size_t w = 0; w < STAT_WORDS; w++)
+        {
+            uint64_t v = atomic_load_explicit(&worker_shared->slots[i].words[w],
+                                              memory_order_relaxed);
+            if (w == STAT_WORD(queue_delay_max_ns))
+                sum[w] = v > sum[w] ? v : sum[w];
+            else
+                sum[w] += v;
+        }
+    }
+
+    memcpy(out, sum, sizeof(*out));
+    *restarts = atomic_load_explicit(&worker_shared->restarts, memory_order_relaxed);
+    return worker_shared->workers;
+}
+
+/* Master, after reaping a worker: keep its totals, drop its gauges */
+static void worker_retire(int index)
+{
+    WorkerSlot *slot = &worker_shared->slots[index];
+    WorkerSlot *retired = &worker_shared->retired;
+
+    for (size_t w = 0; w < STAT_WORDS; w++)
+    {
+        uint64_t v = atomic_exchange_explicit(&slot->words[w], 0, memory_order_relaxed);
+        uint64_t kept = atomic_load_explicit(&retired->words[w], memory_order_relaxed);
+
+        if (w == STAT_WORD(active) || w == STAT_WORD(overloaded))
+            continue;
+        if (w == STAT_WORD(queue_delay_max_ns))
+            v = v > kept ? v : kept;
+        else
+            v += kept;
+        atomic_store_explicit(&retired->words[w], v, memory_order_relaxed);
+    }
+}
+
+static void master_signal(int sig)
+{
+    (void)sig;
+    master_stop = 1;
+}
+
+/* Fork worker `index`; in the child this serves and never returns */
+static pid_t spawn_worker(ForgeServer *server, int index)
+{
+    pid_t master = getpid();
+
+    /* Buffered output would otherwise be written twice */
+    fflush(NULL);
+
+    pid_t pid = fork();
+    if (pid < 0)
+        perror("fork failed");
+    if (pid != 0)
+        return pid;
+
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+#ifdef __linux__
+    /* Do not outlive a master that was killed outright */
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() != master)
+        _exit(EXIT_FAILURE);
+#else
+    (void)master;
+#endif
+
+    worker_index = index;
+    forge_access_log_after_fork();
+
+    /* Steered: accept only from this worker's own group member */
+    if (index < reuseport_count && reuseport_fds[index] >= 0)
+        server->socket_fd = reuseport_fds[index];
+    forge_core_on_start(worker_start, NULL);
+    control_start();
+
+    forge_core_run(1, core_loop, server);
+    _exit(EXIT_FAILURE);
+}
+
+/* A failed fork is retried, backing off from 100 ms to 30 s */
+#define FORK_RETRY_MIN_MS 100
+#define FORK_RETRY_MAX_MS 30000
+
+/* Master's view of one worker slot */
+typedef struct
+{
+    pid_t pid; /* 0 once reaped, -1 while a fork retry is pending */
+    uint64_t started_ns;
+    uint64_t retry_ns;
+    unsigned backoff_ms;
+} WorkerProc;
+
+/* Fork into slot `index`, or schedule the next attempt */
+static void worker_fill(ForgeServer *server, WorkerProc *w, int index)
+{
+    uint64_t now = forge_access_log_clock();
+
+    w->pid = spawn_worker(server, index);
+    w->started_ns = now;
+    if (w->pid > 0)
+    {
+        w->backoff_ms = 0;
+        return;
+    }
+
+    w->backoff_ms = w->backoff_ms ? w->backoff_ms * 2 : FORK_RETRY_MIN_MS;
+    if (w->backoff_ms > FORK_RETRY_MAX_MS)
+        w->backoff_ms = FORK_RETRY_MAX_MS;
+    w->retry_ns = now + (uint64_t)w->backoff_ms * 1000000ULL;
+    fprintf(stderr, "worker %d: retrying fork in %u ms\n", index, w->backoff_ms);
+}
+
+/* Retry the forks that are due; returns when the next one is, or 0 */
+static uint64_t workers_retry(ForgeServer *server, WorkerProc *procs, int workers)
+{
+    uint64_t next = 0;
+
+    for (int i = 0; i < workers; i++)
+    {
+        if (procs[i].pid >= 0)
+            continue;
+        if (procs[i].retry_ns <= forge_access_log_clock())
+            worker_fill(server, &procs[i], i);
+        if (procs[i].pid < 0 && (next == 0 || procs[i].retry_ns < next))
+            next = procs[i].retry_ns;
+    }
+    return next;
+}
+
+void launch_server_workers(ForgeServer *server, int workers)
+{
+    if (workers <= 0)
+        workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers > FORGE_MAX_WORKERS)
+        workers = FORGE_MAX_WORKERS;
+
+    worker_shared = mmap(NULL, sizeof(*worker_shared), PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    WorkerProc *procs = calloc((size_t)workers, sizeof(*procs));
+    if (worker_shared == MAP_FAILED || !procs)
+    {
+        perror("worker setup failed");
+        exit(EXIT_FAILURE);
+    }
+    worker_shared->workers = workers;
+
+    /* Inherited by every worker: see launch_server_cores() */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Every worker accepts from the same listeners */
+    listeners_nonblocking(server);
+
+#ifdef __linux__
+    /* Steered, each worker gets a listener of its own; the master keeps
+       them all open so a restarted worker takes its old group index */
+    if (placement_steer)
+        reuseport_open(server, workers);
+
+    /* Workers inherit the pinning hook */
+    placement_apply();
+#endif
+
+    /* Workers inherit the compiled route table */
+    forge_router_commit(routes, (int)(sizeof(routes) / sizeof(routes[0])));
+
+    /* No SA_RESTART: waitpid() has to return for the stop flag */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = master_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    sa.sa_handler = reload_signal;
+    sigaction(SIGHUP, &sa, NULL);
+
+    for (int i = 0; i < workers; i++)
+        worker_fill(server, &procs[i], i);
+    printf("✅ Pre-fork master %d running %d workers\n", (int)getpid(), workers);
+
+    while (!master_stop)
+    {
+        /* Each worker rebuilds its own copy of the table */
+        if (reload_requested)
+        {
+            reload_requested = 0;
+            for (int i = 0; i < workers; i++)
+            {
+                if (procs[i].pid > 0)
+                    kill(procs[i].pid, SIGHUP);
+            }
+        }
+
+        /* With a fork retry pending, wait for children only until it is due */
+        uint64_t retry_ns = workers_retry(server, procs, workers);
+
+        int status;
+        pid_t pid = waitpid(-1, &status, retry_ns ? WNOHANG : 0);
+        if (pid == 0 || (pid < 0 && errno == ECHILD && retry_ns))
+        {
+            uint64_t now = forge_access_log_clock();
+            uint64_t wait_ns = retry_ns > now ? retry_ns - now : 0;
+            if (wait_ns > 100000000ULL)
+                wait_ns = 100000000ULL; /* still notice exits and signals */
+            struct timespec ts = {0, (long)wait_ns};
+            nanosleep(&ts, NULL);
+            continue;
+        }
+        if (pid < 0)
+        {
+            if (errno == ECHILD)
+                break;
+            continue;
+        }
+
+        int i = 0;
+        while (i < workers && procs[i].pid != pid)
+            i++;
+        if (i == workers)
+            continue;
+
+        worker_retire(i);
+        procs[i].pid = 0;
+        if (master_stop)
+            break;
+
+        if (WIFSIGNALED(status))
+            fprintf(stderr, "worker %d (pid %d) killed by signal %d, restarting\n",
+                    i, (int)pid, WTERMSIG(status));
+        else
+            fprintf(stderr, "worker %d (pid %d) exited with %d, restarting\n",
+                    i, (int)pid, WEXITSTATUS(status));
+
+        /* A worker that dies on startup must not make the master spin */
+        if (forge_access_log_clock() - procs[i].started_ns < 1000000000ULL)
+            sleep(1);
+
+        atomic_fetch_add_explicit(&worker_shared->restarts, 1, memory_order_relaxed);
+        worker_fill(server, &procs[i], i);
+    }
+
+    for (int i = 0; i < workers; i++)
+    {
+        if (procs[i].pid > 0)
+            kill(procs[i].pid, SIGTERM);
+    }
+    while (waitpid(-1, NULL, 0) > 0 || errno == EINTR)
+        ;
+
+    shutdown_server();
+    exit(EXIT_SUCCESS);
+}
+#endif
+
+/* =========================================================
+   Client Handler
+   ========================================================= */
+
+/* Serve one connection to completion (keep-alive, pipelining, h2c) */
+#ifdef _WIN32
+void handle_client(SOCKET client_socket)
+#else
+void handle_client(int client_socket)
+#endif
+{
+    ForgeConn *c = conn_open((int)client_socket, 0);
+    if (!c)
+    {
+#ifdef _WIN32
+        closesocket(client_socket);
+#else
+        close(client_socket);
+#endif
+        return;
+    }
+
+    while (1)
+    {
+#ifndef _WIN32
+        /* Reads never wait: a request in progress until its deadline, idle ones as long */
+        uint64_t now = forge_access_log_clock();
+        uint64_t wait_ns = FORGE_HEAD_TIMEOUT_NS;
+        if (c->deadline_ns)
+            wait_ns = c->deadline_ns > now ? c->deadline_ns - now : 0;
+
+        struct pollfd pfd = {c->fd, POLLIN, 0};
+        if (poll(&pfd, 1, (int)(wait_ns / 1000000ULL)) <= 0)
+            break;
+        if (pfd.revents == POLLERR && c->zc && forge_zerocopy_reap(c, 0) > 0)
+            continue;
+#endif
+        c->ready_ns = forge_access_log_clock();
+        forge_http_tick();
+        if (conn_serve(c) != 0)
+            break;
+    }
+
+    conn_close(c);
+}
+
+/* =========================================================
+   404 Helper
+   ========================================================= */
+
+static void send_404(int client_socket)
+{
+    forge_send_text(client_socket, "404 Not Found", "Not Found\n");
+}
+
+/* =========================================================
+   Shutdown
+   ========================================================= */
+
+void shutdown_server(void)
+{
+    forge_access_log_close();
+
+#ifdef _WIN32
+    WSACleanup();
+#else
+    if (unix_path[0])
+    {
+        unlink(unix_path);
+        unix_path[0] = '\0';
+    }
 #endif
 }
@@ -0,0 +1,518 @@
+#define _GNU_SOURCE
+#include "forge_sse.h"
+#include "forge_http.h"
+#include "forge_router.h"
+#include "forge_internal.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+/* =========================================================
+   Topics
+   ========================================================= */
+
+#define MAX_SSE_TOPICS 64
+#define SSE_IOV_MAX 64
+
+/* One event, serialized once and shared by every subscriber queue */
+typedef struct
+{
+  _Atomic size_t refs;
+  ForgeSseTopic *topic;
+  const char *data; /* a complete chunk: size line, event, CRLF */
+  size_t len;
+  char bytes[];
+} SseEvent;
+
+typedef struct ForgeSseSub ForgeSseSub;
+
+/* A core's subscribers of one topic; only that core touches the array */
+typedef struct
+{
+  ForgeSseSub **subs;
+  int count;
+  int cap;
+  _Atomic int live; /* count, readable by publishers */
+} SseCoreList;
+
+struct ForgeSseTopic
+{
+  int policy;
+  size_t max_queue;
+  SseCoreList cores[FORGE_MAX_CORES];
+
+  _Atomic uint64_t subscribers;
+  _Atomic uint64_t published;
+  _Atomic uint64_t dropped;
+  _Atomic uint64_t coalesced;
+};
+
+struct ForgeSseSub
+{
+  ForgeConn *conn;
+  ForgeSseTopic *topic;
+  int core;
+  int index; /* in topic->cores[core] */
+  int dead;  /* disconnect requested; the loop closes it */
+
+  /* Ring of queued events; the head is written from `offset` on */
+  SseEvent **queue;
+  size_t head;
+  size_t count;
+  size_t offset;
+};
+
+/* Filled before launch, read-only while serving */
+static ForgeSseTopic *topics[MAX_SSE_TOPICS];
+static int topic_count;
+
+static unsigned heartbeat_sec = FORGE_SSE_DEFAULT_HEARTBEAT;
+static _Thread_local int heartbeat_armed;
+
+/* ":" comment chunk; never freed */
+static const char heartbeat_chunk[] = "3\r\n:\n\n\r\n";
+static SseEvent heartbeat = {0, NULL, heartbeat_chunk, sizeof(heartbeat_chunk) - 1};
+
+static void sse_handler(const ForgeHttpRequest *req, int client_socket);
+
+ForgeSseTopic *forge_sse_topic(int policy, size_t max_queue)
+{
+  if ((policy != FORGE_SSE_DROP && policy != FORGE_SSE_COALESCE) ||
+      topic_count == MAX_SSE_TOPICS)
+    return NULL;
+
+  ForgeSseTopic *topic = calloc(1, sizeof(*topic));
+  if (!topic)
+    return NULL;
+
+  /* Coalescing replaces the tail, which must not be the head in flight */
+  topic->policy = policy;
+  topic->max_queue = max_queue ? max_queue : FORGE_SSE_DEFAULT_QUEUE;
+  if (topic->max_queue < 2)
+    topic->max_queue = 2;
+
+  topics[topic_count++] = topic;
+  return topic;
+}
+
+int forge_sse_route(const char *path, ForgeSseTopic *topic)
+{
+  if (!path || !topic)
+    return -1;
+
+  /* The topic travels with the route table */
+  ForgeRoute route = {"GET", path, sse_handler, 0, topic};
+  return forge_router_add_route(&route);
+}
+
+void forge_sse_set_heartbeat(unsigned seconds)
+{
+  heartbeat_sec = seconds;
+}
+
+void forge_sse_stats(const ForgeSseTopic *topic, ForgeSseStats *out)
+{
+  memset(out, 0, sizeof(*out));
+
+  for (int i = 0; i < topic_count; i++)
+  {
+    const ForgeSseTopic *t = topics[i];
+    if (topic && t != topic)
+      continue;
+
+    out->subscribers += atomic_load_explicit(&t->subscribers, memory_order_relaxed);
+    out->published += atomic_load_explicit(&t->published, memory_order_relaxed);
+    out->dropped += atomic_load_explicit(&t->dropped, memory_order_relaxed);
+    out->coalesced += atomic_load_explicit(&t->coalesced, memory_order_relaxed);
+  }
+}
+
+/* =========================================================
+   Events
+   ========================================================= */
+
+static void event_release(SseEvent *ev)
+{
+  if (ev != &heartbeat &&
+      atomic_fetch_sub_explicit(&ev->refs, 1, memory_order_acq_rel) == 1)
+    free(ev);
+}
+
+/*
+ * "data: " lines for `data`, split at CR, LF or CRLF as the client
+ * will split them. Returns the length; writes only when `out` is set.
+ */
+static size_t put_data(char *out, const char *data, size_t len)
+{
+  size_t n = 0;
+  size_t start = 0;
+
+  for (size_t i = 0; i <= len; i++)
+  {
+    if (i < len && data[i] != '\r' && data[i] != '\n')
+      continue;
+
+    if (out)
+    {
+      memcpy(out + n, "data: ", 6);
+      memcpy(out + n + 6, data + start, i - start);
+      out[n + 6 + i - start] = '\n';
+    }
+    n += 6 + (i - start) + 1;
+
+    if (i + 1 < len && data[i] == '\r' && data[i + 1] == '\n')
+      i++;
+    start = i + 1;
+  }
+  return n;
+}
+
+/* The event as one complete chunk; one reference held by the caller */
+static SseEvent *event_new(ForgeSseTopic *topic,
+                           const char *event,
+                           const char *data,
+                           size_t len)
+{
+  size_t name_len = event ? strlen(event) : 0;
+  size_t body_len = (event ? 7 + name_len + 1 : 0) + put_data(NULL, data, len) + 1;
+
+  char size_line[24];
+  int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", body_len);
+
+  SseEvent *ev = malloc(sizeof(*ev) + (size_t)n + body_len + 2);
+  if (!ev)
+    return NULL;
+
+  char *p = ev->bytes;
+  memcpy(p, size_line, (size_t)n);
+  p += n;
+  if (event)
+  {
+    memcpy(p, "event: ", 7);
+    memcpy(p + 7, event, name_len);
+    p[7 + name_len] = '\n';
+    p += 7 + name_len + 1;
+  }
+  p += put_data(p, data, len);
+  memcpy(p, "\n\r\n", 3);
+
+  atomic_init(&ev->refs, 1);
+  ev->topic = topic;
+  ev->data = ev->bytes;
+  ev->len = (size_t)n + body_len + 2;
+  return ev;
+}
+
+/* =========================================================
+   Subscribers
+   ========================================================= */
+
+/* Ask the loop to close `s`: its socket wakes poll() with a hangup */
+static void sub_kill(ForgeSseSub *s)
+{
+  if (s->dead)
+    return;
+  s->dead = 1;
+#ifndef _WIN32
+  shutdown(s->conn->fd, SHUT_RDWR);
+#endif
+}
+
+/* Queue one reference to `ev`, applying the topic's overflow policy */
+static void sub_enqueue(ForgeSseSub *s, SseEvent *ev)
+{
+  ForgeSseTopic *topic = s->topic;
+  if (s->dead)
+    return;
+
+  if (ev != &heartbeat)
+    atomic_fetch_add_explicit(&ev->refs, 1, memory_order_relaxed);
+
+  if (s->count == topic->max_queue)
+  {
+    if (topic->policy == FORGE_SSE_DROP)
+    {
+      event_release(ev);
+      atomic_fetch_add_explicit(&topic->dropped, 1, memory_order_relaxed);
+      sub_kill(s);
+      return;
+    }
+
+    /* max_queue >= 2: the tail is never the partly written head */
+    size_t tail = (s->head + s->count - 1) % topic->max_queue;
+    event_release(s->queue[tail]);
+    s->queue[tail] = ev;
+    atomic_fetch_add_explicit(&topic->coalesced, 1, memory_order_relaxed);
+    return;
+  }
+
+  s->queue[(s->head + s->count) % topic->max_queue] = ev;
+  s->count++;
+}
+
+/*
+ * Write as much of the queue as the socket takes, up to SSE_IOV_MAX
+ * events per sendmsg(). Sets want_write while output is pending.
+ * Returns 0, or -1 when the connection failed.
+ */
+static int sub_flush(ForgeSseSub *s)
+{
+#ifdef _WIN32
+  (void)s;
+  return -1;
+#else
+  size_t qcap = s->topic->max_queue;
+
+  while (s->count > 0)
+  {
+    struct iovec iov[SSE_IOV_MAX];
+    size_t n = 0;
+    size_t total = 0;
+
+    for (; n < s->count && n < SSE_IOV_MAX; n++)
+    {
+      const SseEvent *ev = s->queue[(s->head + n) % qcap];
+      size_t skip = n == 0 ? s->offset : 0;
+      iov[n].iov_base = (void *)(ev->data + skip);
+      iov[n].iov_len = ev->len - skip;
+      total += iov[n].iov_len;
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n;
+
+    ssize_t sent = sendmsg(s->conn->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      return -1;
+    }
+
+    /* Retire what went out; a partly written event stays at the head */
+    size_t left = (size_t)sent;
+    while (left > 0)
+    {
+      SseEvent *ev = s->queue[s->head];
+      size_t rest = ev->len - s->offset;
+      if (left < rest)
+      {
+        s->offset += left;
+        break;
+      }
+      left -= rest;
+      s->offset = 0;
+      s->head = (s->head + 1) % qcap;
+      s->count--;
+      event_release(ev);
+    }
+
+    if ((size_t)sent < total)
+      break;
+  }
+
+  s->conn->want_write = s->count > 0;
+  return 0;
+#endif
+}
+
+static void sub_push(ForgeSseSub *s, SseEvent *ev)
+{
+  sub_enqueue(s, ev);
+  if (!s->dead && !s->conn->want_write && sub_flush(s) != 0)
+    sub_kill(s);
+}
+
+/* Executed on each core: queue the event on that core's subscribers */
+static void deliver(ForgeCore *core, void *arg)
+{
+  SseEvent *ev = arg;
+  SseCoreList *list = &ev->topic->cores[forge_core_id(core)];
+
+  for (int i = 0; i < list->count; i++)
+    sub_push(list->subs[i], ev);
+
+  event_release(ev);
+}
+
+int forge_sse_publish(ForgeSseTopic *topic,
+                      const char *event,
+                      const char *data,
+                      size_t len)
+{
+  if (!topic || (!data && len > 0) ||
+      (event && (strchr(event, '\n') || strchr(event, '\r'))))
+    return -1;
+
+  SseEvent *ev = event_new(topic, event, data ? data : "", len);
+  if (!ev)
+    return -1;
+
+  atomic_fetch_add_explicit(&topic->published, 1, memory_order_relaxed);
+
+  int missed = 0;
+  int cores = forge_core_count();
+  for (int i = 0; i < cores; i++)
+  {
+    if (atomic_load_explicit(&topic->cores[i].live, memory_order_relaxed) == 0)
+      continue;
+
+    atomic_fetch_add_explicit(&ev->refs, 1, memory_order_relaxed);
+    if (forge_core_post(i, deliver, ev) != 0)
+    {
+      event_release(ev);
+      missed++;
+    }
+  }
+
+  event_release(ev);
+  return missed;
+}
+
+/* Timer: a comment line for every stream with nothing queued */
+static void send_heartbeats(ForgeCore *core, void *arg)
+{
+  (void)arg;
+  int id = forge_core_id(core);
+
+  for (int t = 0; t < topic_count; t++)
+  {
+    SseCoreList *list = &topics[t]->cores[id];
+    for (int i = 0; i < list->count; i++)
+    {
+      if (list->subs[i]->count == 0)
+        sub_push(list->subs[i], &heartbeat);
+    }
+  }
+}
+
+/* =========================================================
+   Connection Hooks
+   ========================================================= */
+
+int forge_sse_serve(ForgeConn *c)
+{
+  ForgeSseSub *s = c->sse;
+  if (s->dead)
+    return -1;
+
+#ifndef _WIN32
+  /* Nothing is expected from the client; EOF ends the stream */
+  char scratch[512];
+  ssize_t n = recv(c->fd, scratch, sizeof(scratch), MSG_DONTWAIT);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+                 errno != EINTR))
+    return -1;
+#endif
+
+  return sub_flush(s);
+}
+
+void forge_sse_free(ForgeConn *c)
+{
+  ForgeSseSub *s = c->sse;
+  if (!s)
+    return;
+
+  ForgeSseTopic *topic = s->topic;
+  SseCoreList *list = &topic->cores[s->core];
+
+  list->subs[s->index] = list->subs[--list->count];
+  list->subs[s->index]->index = s->index;
+  atomic_store_explicit(&list->live, list->count, memory_order_relaxed);
+  atomic_fetch_sub_explicit(&topic->subscribers, 1, memory_order_relaxed);
+
+  for (; s->count > 0; s->count--)
+  {
+    event_release(s->queue[s->head]);
+    s->head = (s->head + 1) % topic->max_queue;
+  }
+
+  free(s->queue);
+  free(s);
+  c->sse = NULL;
+  c->want_write = 0;
+  c->proto = FORGE_PROTO_HTTP1;
+}
+
+/* =========================================================
+   Handshake
+   ========================================================= */
+
+static ForgeSseSub *sub_attach(ForgeSseTopic *topic, ForgeConn *c, int core)
+{
+  SseCoreList *list = &topic->cores[core];
+
+  if (list->count == list->cap)
+  {
+    int cap = list->cap ? list->cap * 2 : 16;
+    ForgeSseSub **subs = realloc(list->subs, (size_t)cap * sizeof(*subs));
+    if (!subs)
+      return NULL;
+    list->subs = subs;
+    list->cap = cap;
+  }
+
+  ForgeSseSub *s = calloc(1, sizeof(*s));
+  if (!s || !(s->queue = calloc(topic->max_queue, sizeof(*s->queue))))
+  {
+    free(s);
+    return NULL;
+  }
+
+  s->conn = c;
+  s->topic = topic;
+  s->core = core;
+  s->index = list->count;
+  list->subs[list->count++] = s;
+  atomic_store_explicit(&list->live, list->count, memory_order_relaxed);
+  atomic_fetch_add_explicit(&topic->subscribers, 1, memory_order_relaxed);
+  return s;
+}
+
+static void sse_handler(const ForgeHttpRequest *req, int client_socket)
+{
+  ForgeSseTopic *topic = forge_route_arg();
+  ForgeConn *c = req->conn;
+
+  if (!topic || forge_exchange.h2 || !c || c->fd != client_socket ||
+      !c->polled || !forge_exchange.chunked_ok)
+  {
+    forge_send_text(client_socket, "400 Bad Request",
+                    "Event streams need an HTTP/1.1 connection\n");
+    return;
+  }
+
+  ForgeCore *core = forge_current_core();
+  c->sse = sub_attach(topic, c, forge_core_id(core));
+  if (!c->sse)
+  {
+    forge_send_text(client_socket, "503 Service Unavailable",
+                    "Service Unavailable\n");
+    return;
+  }
+  c->proto = FORGE_PROTO_SSE;
+
+  forge_response_header(client_socket, "Cache-Control", "no-cache");
+  if (forge_http_chunked_begin(client_socket, "200 OK", "text/event-stream") != 0)
+  {
+    forge_exchange.keep_alive = 0; /* closing frees the subscriber */
+    return;
+  }
+
+  if (!heartbeat_armed && heartbeat_sec > 0)
+    heartbeat_armed = forge_core_every(core, heartbeat_sec * 1000,
+                                       send_heartbeats, NULL) == 0;
+}
@@ -0,0 +1,594 @@
+#define _GNU_SOURCE
+#include "forge_ws.h"
+#include "forge_http.h"
+#include "forge_router.h"
+#include "forge_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+/* =========================================================
+   Routes
+   ========================================================= */
+
+static const char ws_guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+struct ForgeWs
+{
+  ForgeConn *conn;
+  const ForgeWsHandler *handler;
+  void *user;
+  size_t max_message;
+
+  /* Data frame being streamed into `msg` */
+  unsigned long long remaining;
+  unsigned char mask[4];
+  size_t mask_pos;
+  int frame_fin;
+
+  /* Message being reassembled; opcode 0 when none */
+  int msg_opcode;
+  char *msg;
+  size_t msg_len;
+
+  int close_sent;
+  int close_code; /* reported to on_close */
+  int ping_sent;  /* keep-alive ping still unanswered */
+};
+
+static void ws_handler(const ForgeHttpRequest *req, int client_socket);
+
+int forge_ws_route(const char *path, const ForgeWsHandler *handler)
+{
+  if (!path || !handler || !handler->on_message)
+    return -1;
+
+  /* The handler travels with the route table */
+  ForgeRoute route = {"GET", path, ws_handler, 0, (void *)handler};
+  return forge_router_add_route(&route);
+}
+
+void forge_ws_set_user(ForgeWs *ws, void *user)
+{
+  ws->user = user;
+}
+
+void *forge_ws_user(const ForgeWs *ws)
+{
+  return ws->user;
+}
+
+/* =========================================================
+   Frames
+   ========================================================= */
+
+#define OP_CONTINUATION 0x0
+#define OP_CLOSE 0x8
+#define OP_PING 0x9
+#define OP_PONG 0xA
+
+#define WS_NO_STATUS 1005
+
+/*
+ * XOR `len` bytes with the masking key, starting `pos` bytes into
+ * the key stream. The key is widened to 16 bytes once; since 16
+ * and 8 are multiples of 4 the phase holds across the wide loops.
+ */
+static void unmask(unsigned char *p, size_t len,
+                   const unsigned char key[4], size_t pos)
+{
+  unsigned char k[16];
+  for (int i = 0; i < 16; i++)
+    k[i] = key[(pos + (size_t)i) & 3];
+
+  size_t i = 0;
+
+#ifdef __SSE2__
+  __m128i m = _mm_loadu_si128((const __m128i *)k);
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+    _mm_storeu_si128((__m128i *)(p + i), _mm_xor_si128(v, m));
+  }
+#endif
+
+  uint64_t m64;
+  memcpy(&m64, k, 8);
+  for (; i + 8 <= len; i += 8)
+  {
+    uint64_t v;
+    memcpy(&v, p + i, 8);
+    v ^= m64;
+    memcpy(p + i, &v, 8);
+  }
+
+  for (; i < len; i++)
+    p[i] ^= k[i & 3];
+}
+
+/* Well-formed UTF-8: no overlongs, surrogates or code points > U+10FFFF */
+static int utf8_valid(const unsigned char *s, size_t len)
+{
+  size_t i = 0;
+
+  while (i < len)
+  {
+    /* ASCII runs eight bytes at a time */
+    while (i + 8 <= len)
+    {
+      uint64_t v;
+      memcpy(&v, s + i, 8);
+      if (v & 0x8080808080808080ULL)
+        break;
+      i += 8;
+    }
+    if (i >= len)
+      break;
+
+    unsigned char c = s[i];
+    if (c < 0x80)
+    {
+      i++;
+      continue;
+    }
+
+    size_t n;
+    unsigned char lo = 0x80, hi = 0xBF; /* bounds of the first continuation */
+    if (c >= 0xC2 && c <= 0xDF)
+      n = 1;
+    else if (c >= 0xE0 && c <= 0xEF)
+    {
+      n = 2;
+      if (c == 0xE0)
+        lo = 0xA0;
+      else if (c == 0xED)
+        hi = 0x9F;
+    }
+    else if (c >= 0xF0 && c <= 0xF4)
+    {
+      n = 3;
+      if (c == 0xF0)
+        lo = 0x90;
+      else if (c == 0xF4)
+        hi = 0x8F;
+    }
+    else
+      return 0;
+
+    if (i + n >= len)
+      return 0;
+    if (s[i + 1] < lo || s[i + 1] > hi)
+      return 0;
+    for (size_t j = 2; j <= n; j++)
+    {
+      if ((s[i + j] & 0xC0) != 0x80)
+        return 0;
+    }
+    i += n + 1;
+  }
+  return 1;
+}
+
+/* One unfragmented frame, head and payload in one forge_conn_writev() */
+static int write_frame(int fd, int opcode, const void *data, size_t len)
+{
+  unsigned char head[10];
+  size_t n = 0;
+
+  head[n++] = (unsigned char)(0x80 | opcode);
+  if (len < 126)
+  {
+    head[n++] = (unsigned char)len;
+  }
+  else if (len <= 0xFFFF)
+  {
+    head[n++] = 126;
+    head[n++] = (unsigned char)(len >> 8);
+    head[n++] = (unsigned char)len;
+  }
+  else
+  {
+    head[n++] = 127;
+    for (int i = 7; i >= 0; i--)
+      head[n++] = (unsigned char)((uint64_t)len >> (8 * i));
+  }
+
+#ifdef _WIN32
+  if (forge_conn_write_all(fd, head, n) != 0)
+    return -1;
+  return len ? forge_conn_write_all(fd, data, len) : 0;
+#else
+  struct iovec iov[2] = {{head, n}, {(void *)data, len}};
+  long sent = forge_conn_writev(fd, iov, len ? 2 : 1);
+  if (sent < 0)
+    return -1;
+
+  /* A full socket buffer: finish blocking */
+  size_t done = (size_t)sent;
+  if (done < n)
+  {
+    if (forge_conn_write_all(fd, head + done, n - done) != 0)
+      return -1;
+    done = n;
+  }
+  if (done < n + len)
+    return forge_conn_write_all(fd, (const char *)data + (done - n),
+                                n + len - done);
+  return 0;
+#endif
+}
+
+static int send_close(ForgeWs *ws, int code, const char *reason)
+{
+  if (ws->close_sent)
+    return 0;
+  ws->close_sent = 1;
+
+  unsigned char payload[125];
+  size_t len = 0;
+  if (code)
+  {
+    size_t reason_len = reason ? strlen(reason) : 0;
+    if (reason_len > sizeof(payload) - 2)
+      reason_len = sizeof(payload) - 2;
+
+    payload[0] = (unsigned char)(code >> 8);
+    payload[1] = (unsigned char)code;
+    if (reason_len)
+      memcpy(payload + 2, reason, reason_len);
+    len = 2 + reason_len;
+  }
+  return write_frame(ws->conn->fd, OP_CLOSE, payload, len);
+}
+
+int forge_ws_send(ForgeWs *ws, int opcode, const void *data, size_t len)
+{
+  if (ws->close_sent || (opcode != FORGE_WS_TEXT && opcode != FORGE_WS_BINARY))
+    return -1;
+  return write_frame(ws->conn->fd, opcode, data, len);
+}
+
+int forge_ws_close(ForgeWs *ws, int code, const char *reason)
+{
+  return send_close(ws, code, reason);
+}
+
+/* =========================================================
+   Receiving
+   ========================================================= */
+
+/* Protocol violation: close with `code`; -1 ends the connection */
+static int fail(ForgeWs *ws, int code)
+{
+  send_close(ws, code, NULL);
+  ws->close_code = code;
+  return -1;
+}
+
+static int deliver(ForgeWs *ws, int opcode, const char *data, size_t len)
+{
+  if (opcode == FORGE_WS_TEXT && !utf8_valid((const unsigned char *)data, len))
+    return fail(ws, FORGE_WS_INVALID_DATA);
+
+  ws->handler->on_message(ws, opcode, data, len);
+  return 0;
+}
+
+/* The streamed frame is complete; deliver the message on FIN */
+static int frame_done(ForgeWs *ws)
+{
+  if (!ws->frame_fin)
+    return 0;
+
+  int rc = deliver(ws, ws->msg_opcode, ws->msg ? ws->msg : "", ws->msg_len);
+
+  /* Idle connections keep no reassembly memory */
+  free(ws->msg);
+  ws->msg = NULL;
+  ws->msg_len = 0;
+  ws->msg_opcode = 0;
+  return rc;
+}
+
+/* Codes a peer may send: 1004-1006 and 1015 are reserved for reports */
+static int close_code_valid(int code)
+{
+  if (code >= 1000 && code <= 1014)
+    return code != 1004 && code != 1005 && code != 1006;
+  return code >= 3000 && code <= 4999;
+}
+
+static int control(ForgeWs *ws, int opcode, const unsigned char *p, size_t len)
+{
+  if (opcode == OP_PING)
+    return ws->close_sent ? 0 : write_frame(ws->conn->fd, OP_PONG, p, len);
+
+  if (opcode == OP_PONG)
+  {
+    ws->ping_sent = 0;
+    return 0;
+  }
+
+  if (len == 1)
+    return fail(ws, FORGE_WS_PROTOCOL_ERROR);
+  if (len >= 2 && !close_code_valid(p[0] << 8 | p[1]))
+    return fail(ws, FORGE_WS_PROTOCOL_ERROR);
+  if (len > 2 && !utf8_valid(p + 2, len - 2))
+    return fail(ws, FORGE_WS_INVALID_DATA);
+
+  /* Close: echo the code unless we started the handshake */
+  ws->close_code = len >= 2 ? (p[0] << 8 | p[1]) : WS_NO_STATUS;
+  send_close(ws, len >= 2 ? ws->close_code : 0, NULL);
+  return -1;
+}
+
+int forge_ws_process(ForgeConn *c)
+{
+  ForgeWs *ws = c->ws;
+  int rc = 0;
+
+  while (rc == 0)
+  {
+    size_t avail = c->len - c->pos;
+    unsigned char *p = (unsigned char *)c->buf + c->pos;
+
+    if (ws->remaining > 0)
+    {
+      if (avail == 0)
+        break;
+
+      size_t take = avail < ws->remaining ? avail : (size_t)ws->remaining;
+      unmask(p, take, ws->mask, ws->mask_pos);
+      memcpy(ws->msg + ws->msg_len, p, take);
+      ws->msg_len += take;
+      ws->mask_pos += take;
+      ws->remaining -= take;
+      c->pos += take;
+
+      if (ws->remaining == 0)
+        rc = frame_done(ws);
+      continue;
+    }
+
+    if (avail < 2)
+      break;
+
+    int fin = (p[0] & 0x80) != 0;
+    int opcode = p[0] & 0x0F;
+    unsigned long long len = p[1] & 0x7F;
+    size_t head = 2;
+
+    if (len == 126)
+    {
+      if (avail < 4)
+        break;
+      len = (unsigned long long)p[2] << 8 | p[3];
+      head = 4;
+    }
+    else if (len == 127)
+    {
+      if (avail < 10)
+        break;
+      len = 0;
+      for (int i = 0; i < 8; i++)
+        len = len << 8 | p[2 + i];
+      head = 10;
+    }
+
+    /* Reserved bits unset, and every client frame is masked */
+    if ((p[0] & 0x70) || !(p[1] & 0x80))
+    {
+      rc = fail(ws, FORGE_WS_PROTOCOL_ERROR);
+      break;
+    }
+
+    if (avail < head + 4)
+      break;
+    unsigned char mask[4];
+    memcpy(mask, p + head, 4);
+    head += 4;
+
+    if (opcode >= OP_CLOSE)
+    {
+      if (!fin || len > 125 || opcode > OP_PONG)
+      {
+        rc = fail(ws, FORGE_WS_PROTOCOL_ERROR);
+        break;
+      }
+      if (avail < head + len)
+        break;
+
+      unmask(p + head, (size_t)len, mask, 0);
+      c->pos += head + (size_t)len;
+      rc = control(ws, opcode, p + head, (size_t)len);
+      continue;
+    }
+
+    /* Continuations only inside a message, new messages only outside */
+    if (opcode == OP_CONTINUATION ? ws->msg_opcode == 0
+                                  : (opcode > FORGE_WS_BINARY || ws->msg_opcode != 0))
+    {
+      rc = fail(ws, FORGE_WS_PROTOCOL_ERROR);
+      break;
+    }
+
+    if (len > ws->max_message - ws->msg_len)
+    {
+      rc = fail(ws, FORGE_WS_TOO_BIG);
+      break;
+    }
+
+    /* A whole message that fits the buffer: unmasked and delivered in place */
+    if (opcode != OP_CONTINUATION && fin && head + len < c->cap)
+    {
+      if (avail < head + len)
+        break;
+
+      unmask(p + head, (size_t)len, mask, 0);
+      c->pos += head + (size_t)len;
+      rc = deliver(ws, opcode, (const char *)p + head, (size_t)len);
+      continue;
+    }
+
+    char *grown = realloc(ws->msg, ws->msg_len + (size_t)len + 1);
+    if (!grown)
+    {
+      rc = fail(ws, FORGE_WS_TOO_BIG);
+      break;
+    }
+    ws->msg = grown;
+
+    if (opcode != OP_CONTINUATION)
+      ws->msg_opcode = opcode;
+    memcpy(ws->mask, mask, 4);
+    ws->mask_pos = 0;
+    ws->remaining = len;
+    ws->frame_fin = fin;
+    c->pos += head;
+
+    if (len == 0)
+      rc = frame_done(ws);
+  }
+
+  /* Keep a partial frame at the front for the next read */
+  memmove(c->buf, c->buf + c->pos, c->len - c->pos);
+  c->len -= c->pos;
+  c->pos = 0;
+  return rc;
+}
+
+int forge_ws_serve(ForgeConn *c)
+{
+  long n = forge_conn_fill(c);
+  if (n == FORGE_CONN_AGAIN)
+    return 0;
+  if (n <= 0)
+    return -1;
+
+  c->ws->ping_sent = 0; /* any traffic shows the peer is alive */
+  return forge_ws_process(c);
+}
+
+int forge_ws_keepalive(ForgeConn *c)
+{
+  ForgeWs *ws = c->ws;
+  if (ws->ping_sent || ws->close_sent)
+    return -1;
+
+  ws->ping_sent = 1;
+  return write_frame(c->fd, OP_PING, NULL, 0);
+}
+
+void forge_ws_free(ForgeConn *c)
+{
+  ForgeWs *ws = c->ws;
+  if (!ws)
+    return;
+
+  if (ws->handler->on_close)
+    ws->handler->on_close(ws, ws->close_code ? ws->close_code : FORGE_WS_ABNORMAL);
+
+  free(ws->msg);
+  free(ws);
+  c->ws = NULL;
+  c->proto = FORGE_PROTO_HTTP1;
+}
+
+/* =========================================================
+   Handshake
+   ========================================================= */
+
+static void ws_handler(const ForgeHttpRequest *req, int client_socket)
+{
+  const ForgeWsHandler *handler = forge_route_arg();
+  ForgeConn *c = req->conn;
+
+  if (!handler || forge_exchange.h2 || !c || c->fd != client_socket ||
+      strcmp(req->version, "HTTP/1.1") != 0)
+  {
+    forge_send_text(client_socket, "400 Bad Request",
+                    "WebSocket needs an HTTP/1.1 connection\n");
+    return;
+  }
+
+  const ForgeHttpHeader *upgrade = forge_header_get(req, FORGE_HDR_UPGRADE);
+  const ForgeHttpHeader *connection = forge_header_get(req, FORGE_HDR_CONNECTION);
+  const ForgeHttpHeader *version = forge_header_get(req, FORGE_HDR_SEC_WEBSOCKET_VERSION);
+  const ForgeHttpHeader *key = forge_header_get(req, FORGE_HDR_SEC_WEBSOCKET_KEY);
+
+  if (!version || version->value_len != 2 || memcmp(version->value, "13", 2) != 0)
+  {
+    forge_response_header(client_socket, "Sec-WebSocket-Version", "13");
+    forge_send_text(client_socket, "426 Upgrade Required",
+                    "WebSocket version 13 required\n");
+    return;
+  }
+
+  unsigned char nonce[24];
+  if (!forge_http_has_token(upgrade, "websocket") ||
+      !forge_http_has_token(connection, "upgrade") ||
+      !key || key->value_len != 24 ||
+      forge_base64_decode(key->value, key->value_len, nonce) != 16)
+  {
+    forge_send_text(client_socket, "400 Bad Request",
+                    "Bad WebSocket handshake\n");
+    return;
+  }
+
+  /* Sec-WebSocket-Accept: base64(SHA-1(key + GUID)) */
+  char joined[24 + sizeof(ws_guid)];
+  memcpy(joined, key->value, 24);
+  memcpy(joined + 24, ws_guid, sizeof(ws_guid) - 1);
+
+  unsigned char digest[20];
+  char accept[32];
+  forge_sha1(joined, 24 + sizeof(ws_guid) - 1, digest);
+  forge_base64_encode(digest, sizeof(digest), accept);
+
+  ForgeWs *ws = calloc(1, sizeof(*ws));
+  if (!ws)
+  {
+    forge_send_text(client_socket, "503 Service Unavailable",
+                    "Service Unavailable\n");
+    return;
+  }
+
+  char head[256 + FORGE_RESPONSE_HEADERS_MAX];
+  int len = snprintf(head, sizeof(head),
+                     "HTTP/1.1 101 Switching Protocols\r\n"
+                     "Upgrade: websocket\r\n"
+                     "Connection: Upgrade\r\n"
+                     "Sec-WebSocket-Accept: %s\r\n"
+                     "%.*s\r\n",
+                     accept,
+                     (int)forge_exchange.headers_len, forge_exchange.headers);
+
+  forge_exchange.status = 101;
+  if (len < 0 || (size_t)len >= sizeof(head) ||
+      forge_conn_write_all(client_socket, head, (size_t)len) != 0)
+  {
+    free(ws);
+    forge_exchange.keep_alive = 0;
+    return;
+  }
+  forge_exchange.bytes += (size_t)len;
+
+  ws->conn = c;
+  ws->handler = handler;
+  ws->max_message = handler->max_message ? handler->max_message
+                                                : FORGE_WS_DEFAULT_MAX_MESSAGE;
+  c->ws = ws;
+  c->proto = FORGE_PROTO_WS;
+
+  if (handler->on_open)
+    handler->on_open(ws, req);
+}
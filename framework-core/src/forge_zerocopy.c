@@ -0,0 +1,325 @@
+#define _GNU_SOURCE
+#include "forge_zerocopy.h"
+#include "forge_http.h"
+#include "forge_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+#endif
+
+#if defined(__linux__) && defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) && \
+    defined(SO_EE_ORIGIN_ZEROCOPY)
+#define FORGE_HAVE_ZEROCOPY 1
+#endif
+
+static void respond_copy(int client_socket,
+                         const char *status,
+                         const char *content_type,
+                         const char *body,
+                         size_t body_len,
+                         ForgeReleaseFn release,
+                         void *user)
+{
+  forge_http_respond(client_socket, status, content_type, body, body_len);
+  if (release)
+    release(user);
+}
+
+#ifndef FORGE_HAVE_ZEROCOPY
+
+void forge_send_zerocopy(int client_socket,
+                         const char *status,
+                         const char *content_type,
+                         const char *body,
+                         size_t body_len,
+                         ForgeReleaseFn release,
+                         void *user)
+{
+  respond_copy(client_socket, status, content_type, body, body_len, release, user);
+}
+
+int forge_zerocopy_reap(ForgeConn *c, int wait_ms)
+{
+  (void)c;
+  (void)wait_ms;
+  return -1;
+}
+
+int forge_zerocopy_pending(const ForgeConn *c)
+{
+  (void)c;
+  return 0;
+}
+
+void forge_zerocopy_free(ForgeConn *c)
+{
+  (void)c;
+}
+
+#else
+
+/* =========================================================
+   Completion Tracking
+   ========================================================= */
+
+/*
+ * Every send() with MSG_ZEROCOPY gets the socket's next
+ * notification id, and the error queue reports finished id
+ * ranges. TCP frees its buffers in sequence order, so a body is
+ * done once the ids up to its last send have been reported.
+ */
+typedef struct
+{
+  uint32_t last_id;
+  ForgeReleaseFn release;
+  void *user;
+} ZcBody;
+
+struct ForgeZeroCopy
+{
+  uint32_t next_id; /* ids handed out by the kernel so far */
+  uint32_t done_id; /* ids below this one completed */
+  int copied;       /* kernel copied anyway (loopback, no SG): stop asking */
+  int count;
+  ZcBody bodies[FORGE_ZEROCOPY_PENDING];
+};
+
+static uint64_t clock_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static void release_done(struct ForgeZeroCopy *zc)
+{
+  int n = 0;
+  while (n < zc->count && (int32_t)(zc->done_id - zc->bodies[n].last_id) > 0)
+  {
+    if (zc->bodies[n].release)
+      zc->bodies[n].release(zc->bodies[n].user);
+    n++;
+  }
+
+  if (n > 0)
+  {
+    zc->count -= n;
+    memmove(zc->bodies, zc->bodies + n, (size_t)zc->count * sizeof(zc->bodies[0]));
+  }
+}
+
+/* One error-queue message: 1 for a zero-copy notification, 0 other, -1 empty */
+static int read_notification(ForgeConn *c)
+{
+  char control[128];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t n;
+  do
+  {
+    n = recvmsg(c->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0)
+    return -1;
+
+  int found = 0;
+  for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+  {
+    if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+          (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+      continue;
+
+    struct sock_extended_err ee;
+    memcpy(&ee, CMSG_DATA(cm), sizeof(ee));
+    if (ee.ee_errno != 0 || ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+      continue;
+
+    /* ids ee_info..ee_data finished */
+    if ((int32_t)(ee.ee_data + 1 - c->zc->done_id) > 0)
+      c->zc->done_id = ee.ee_data + 1;
+    if (ee.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+      c->zc->copied = 1;
+    found = 1;
+  }
+  return found;
+}
+
+int forge_zerocopy_reap(ForgeConn *c, int wait_ms)
+{
+  struct ForgeZeroCopy *zc = c->zc;
+  if (!zc)
+    return -1;
+
+  uint64_t deadline = clock_ms() + (uint64_t)(wait_ms > 0 ? wait_ms : 0);
+  int reaped = 0;
+  int polled = 0;
+
+  while (1)
+  {
+    int rc = read_notification(c);
+    if (rc >= 0)
+    {
+      reaped += rc;
+      release_done(zc);
+      polled = 0;
+      continue;
+    }
+
+    /* Woken with nothing queued: a socket error, not a completion */
+    uint64_t now = clock_ms();
+    if (zc->count == 0 || errno != EAGAIN || polled || now >= deadline)
+      break;
+
+    /* Events 0: only POLLERR (the error queue) and hangups report */
+    struct pollfd pfd = {c->fd, 0, 0};
+    if (poll(&pfd, 1, (int)(deadline - now)) <= 0)
+      break;
+    polled = 1;
+  }
+  return reaped;
+}
+
+int forge_zerocopy_pending(const ForgeConn *c)
+{
+  return c->zc ? c->zc->count : 0;
+}
+
+void forge_zerocopy_free(ForgeConn *c)
+{
+  struct ForgeZeroCopy *zc = c->zc;
+  if (!zc)
+    return;
+
+  if (zc->count > 0)
+    forge_zerocopy_reap(c, c->polled ? 0 : FORGE_ZEROCOPY_CLOSE_WAIT_MS);
+
+  /* The kernel may still read them: leaking beats handing them back */
+  if (zc->count > 0)
+    fprintf(stderr, "zerocopy: %d body(s) never completed on fd %d, not released\n",
+            zc->count, c->fd);
+
+  free(zc);
+  c->zc = NULL;
+}
+
+/* =========================================================
+   Sending
+   ========================================================= */
+
+static int zerocopy_ready(ForgeConn *c)
+{
+  if (!c->zc)
+  {
+    int one = 1;
+    if (setsockopt(c->fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0)
+      return 0; /* Unix sockets, old kernels */
+
+    c->zc = calloc(1, sizeof(*c->zc));
+    if (!c->zc)
+      return 0;
+  }
+
+  forge_zerocopy_reap(c, 0);
+  return !c->zc->copied && c->zc->count < FORGE_ZEROCOPY_PENDING;
+}
+
+static int send_all(int fd, const char *data, size_t len, int flags)
+{
+  while (len > 0)
+  {
+    ssize_t n = send(fd, data, len, flags | MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    data += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+void forge_send_zerocopy(int client_socket,
+                         const char *status,
+                         const char *content_type,
+                         const char *body,
+                         size_t body_len,
+                         ForgeReleaseFn release,
+                         void *user)
+{
+  ForgeConn *c = forge_exchange.conn;
+
+  if (body_len < FORGE_ZEROCOPY_MIN || !c || c->fd != client_socket ||
+      forge_exchange.h2 || forge_exchange.capture || !zerocopy_ready(c))
+  {
+    respond_copy(client_socket, status, content_type, body, body_len, release, user);
+    return;
+  }
+
+  forge_exchange.status = atoi(status);
+
+  /* The head lives on this stack: it is copied, the body is not */
+  char head[512 + FORGE_RESPONSE_HEADERS_MAX];
+  int len = forge_http_build_head(head, sizeof(head), status, content_type,
+                                  (long long)body_len);
+  if (len < 0 || send_all(c->fd, head, (size_t)len, MSG_MORE) != 0)
+  {
+    forge_exchange.keep_alive = 0;
+    if (release)
+      release(user);
+    return;
+  }
+  forge_exchange.bytes += (size_t)len;
+
+  uint32_t first_id = c->zc->next_id;
+  size_t off = 0;
+  while (off < body_len)
+  {
+    ssize_t n = send(c->fd, body + off, body_len - off,
+                     MSG_ZEROCOPY | MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && errno == ENOBUFS)
+    {
+      /* Out of optmem for page pins: copy the rest */
+      if (send_all(c->fd, body + off, body_len - off, 0) == 0)
+        off = body_len;
+      break;
+    }
+    if (n <= 0)
+      break;
+
+    off += (size_t)n;
+    c->zc->next_id++;
+  }
+
+  forge_exchange.bytes += off;
+  if (off < body_len)
+    forge_exchange.keep_alive = 0;
+
+  if (c->zc->next_id == first_id)
+  {
+    if (release)
+      release(user);
+    return;
+  }
+
+  ZcBody *b = &c->zc->bodies[c->zc->count++];
+  b->last_id = c->zc->next_id - 1;
+  b->release = release;
+  b->user = user;
+}
+
+#endif
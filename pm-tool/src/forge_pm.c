@@ -71,7 +71,7 @@ static int fetch_latest_version(const char *name, char *out, size_t sz);
 extern const int forge_abi_version;
 
 STATIC_ASSERT(
-    FORGE_ABI_VERSION == 1,
+    FORGE_ABI_VERSION == 6,
     forge_pm_abi_mismatch);
 
 /* ---------------- Dependency Stack ---------------- */
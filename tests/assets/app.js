@@ -0,0 +1 @@
+document.getElementById("app").dataset.ready = "1";
@@ -5,13 +5,17 @@
 #include <stdio.h>
 #include <stdbool.h>
 
+static int forge_test_failures = 0;
+
 #define TEST(name) void test_##name(void)
-#define RUN_TEST(name)        \
-  do                          \
-  {                           \
-    printf("  ✓ %s ", #name); \
-    test_##name();            \
-    printf("PASS\n");         \
+#define RUN_TEST(name)                          \
+  do                                            \
+  {                                             \
+    int failures_before = forge_test_failures;  \
+    printf("  ✓ %s ", #name);                   \
+    test_##name();                              \
+    if (forge_test_failures == failures_before) \
+      printf("PASS\n");                         \
   } while (0)
 
 #define ASSERT_TRUE(cond)                          \
@@ -20,6 +24,7 @@
     if (!(cond))                                   \
     {                                              \
       printf("FAIL: %s:%d\n", __FILE__, __LINE__); \
+      forge_test_failures++;                       \
       return;                                      \
     }                                              \
   } while (0)
@@ -31,6 +36,7 @@
     if ((a) != (b))                                                                       \
     {                                                                                     \
       printf("FAIL: %s:%d expected %d got %d\n", __FILE__, __LINE__, (int)(a), (int)(b)); \
+      forge_test_failures++;                                                              \
       return;                                                                             \
     }                                                                                     \
   } while (0)
@@ -41,6 +47,7 @@
     if (strcmp(a, b) != 0)                                                      \
     {                                                                           \
       printf("FAIL: %s:%d expected '%s' got '%s'\n", __FILE__, __LINE__, b, a); \
+      forge_test_failures++;                                                    \
       return;                                                                   \
     }                                                                           \
   } while (0)
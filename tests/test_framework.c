@@ -0,0 +1,3204 @@
+#define _GNU_SOURCE
+#include "forge_test.h"
+#include "forge_server.h"
+#include "forge_http.h"
+#include "forge_log.h"
+#include "forge_hpack.h"
+#include "forge_h2.h"
+#include "forge_router.h"
+#include "forge_core.h"
+#include "forge_json.h"
+#include "forge_pool.h"
+#include "forge_cache.h"
+#include "forge_ws.h"
+#include "forge_proxy.h"
+#include "forge_sse.h"
+#include "forge_multipart.h"
+#include "forge_digest.h"
+#include "forge_embed.h"
+#include "forge_zerocopy.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <math.h>
+#include <stdatomic.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#endif
+
+/* ---------------- Helpers ---------------- */
+
+#ifndef _WIN32
+// Run raw request bytes through handle_client over a socketpair
+static int roundtrip_n(const char *raw, size_t raw_len, char *out, size_t out_sz)
+{
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+    return -1;
+
+  if (write(sv[0], raw, raw_len) < 0)
+    return -1;
+  shutdown(sv[0], SHUT_WR);
+
+  handle_client(sv[1]);
+
+  size_t total = 0;
+  ssize_t n;
+  while (total + 1 < out_sz &&
+         (n = read(sv[0], out + total, out_sz - 1 - total)) > 0)
+    total += (size_t)n;
+  out[total] = '\0';
+
+  close(sv[0]);
+  return (int)total;
+}
+
+static int roundtrip(const char *raw, char *out, size_t out_sz)
+{
+  return roundtrip_n(raw, strlen(raw), out, out_sz);
+}
+#endif
+
+/* ---------------- HTTP Parser ---------------- */
+
+TEST(parse_request_line)
+{
+  ForgeHttpRequest req;
+  memset(&req, 0, sizeof(req));
+  ASSERT_EQUAL(0, forge_parse_http_request("GET /health HTTP/1.1\r\n\r\n", &req));
+  ASSERT_STR_EQUAL(req.method, "GET");
+  ASSERT_STR_EQUAL(req.path, "/health");
+  ASSERT_STR_EQUAL(req.version, "HTTP/1.1");
+}
+
+TEST(parse_rejects_garbage)
+{
+  ForgeHttpRequest req;
+  memset(&req, 0, sizeof(req));
+  ASSERT_EQUAL(-1, forge_parse_http_request("get / HTTP/1.1\r\n\r\n", &req));
+  ASSERT_EQUAL(-1, forge_parse_http_request("GET health HTTP/1.1\r\n\r\n", &req));
+  ASSERT_EQUAL(-1, forge_parse_http_request("GET / HTTP/2\r\n\r\n", &req));
+}
+
+TEST(parse_headers)
+{
+  ForgeHttpRequest req;
+  memset(&req, 0, sizeof(req));
+  ASSERT_EQUAL(0, forge_parse_http_request(
+                      "POST /api/upload HTTP/1.1\r\n"
+                      "Host: localhost\r\n"
+                      "content-length:  42 \r\n"
+                      "\r\n",
+                      &req));
+  ASSERT_EQUAL(2, req.header_count);
+  ASSERT_EQUAL(42, (int)req.content_length);
+
+  const ForgeHttpHeader *h = forge_http_header(&req, "HOST");
+  ASSERT_TRUE(h != NULL);
+  ASSERT_TRUE(h->value_len == 9 && memcmp(h->value, "localhost", 9) == 0);
+  ASSERT_TRUE(forge_http_header(&req, "Accept") == NULL);
+}
+
+TEST(known_header_ids)
+{
+  /* Every known name has a slot of its own, in any case */
+  for (int id = 0; id < FORGE_HDR_COUNT; id++)
+  {
+    const char *name = forge_header_name((ForgeHeaderId)id);
+    ASSERT_TRUE(name != NULL);
+
+    char upper[64];
+    size_t len = strlen(name);
+    for (size_t i = 0; i <= len; i++)
+      upper[i] = (char)toupper((unsigned char)name[i]);
+    ASSERT_EQUAL(id, forge_header_id(name, len));
+    ASSERT_EQUAL(id, forge_header_id(upper, len));
+  }
+  ASSERT_TRUE(forge_header_name(FORGE_HDR_COUNT) == NULL);
+  ASSERT_EQUAL(-1, forge_header_id("x-custom", 8));
+  ASSERT_EQUAL(-1, forge_header_id("hosts", 5));
+  ASSERT_EQUAL(-1, forge_header_id("", 0));
+
+  ForgeHttpRequest req;
+  memset(&req, 0, sizeof(req));
+  ASSERT_EQUAL(0, forge_parse_http_request(
+                      "GET / HTTP/1.1\r\n"
+                      "X-Custom: 1\r\n"
+                      "hOsT: a.example\r\n"
+                      "Host: b.example\r\n"
+                      "Accept-Encoding: gzip\r\n"
+                      "\r\n",
+                      &req));
+
+  /* Repeated headers: the first is indexed, as forge_http_header finds it */
+  const ForgeHttpHeader *host = forge_header_get(&req, FORGE_HDR_HOST);
+  ASSERT_TRUE(host == &req.headers[1]);
+  ASSERT_TRUE(host == forge_http_header(&req, "host"));
+  ASSERT_TRUE(forge_header_get(&req, FORGE_HDR_ACCEPT_ENCODING) == &req.headers[3]);
+  ASSERT_TRUE(forge_header_get(&req, FORGE_HDR_CONTENT_TYPE) == NULL);
+  ASSERT_TRUE(forge_http_header(&req, "x-custom") == &req.headers[0]);
+
+  /* A reused request starts with an empty index */
+  ASSERT_EQUAL(0, forge_parse_http_request("GET / HTTP/1.1\r\n\r\n", &req));
+  ASSERT_TRUE(forge_header_get(&req, FORGE_HDR_HOST) == NULL);
+}
+
+TEST(parse_rejects_ambiguous_framing)
+{
+  ForgeHttpRequest req;
+  memset(&req, 0, sizeof(req));
+  ASSERT_EQUAL(-1, forge_parse_http_request(
+                       "POST / HTTP/1.1\r\nContent-Length: 5\r\n"
+                       "Transfer-Encoding: chunked\r\n\r\n",
+                       &req));
+  ASSERT_EQUAL(-1, forge_parse_http_request(
+                       "POST / HTTP/1.1\r\nContent-Length: 5\r\n"
+                       "Content-Length: 6\r\n\r\n",
+                       &req));
+  ASSERT_EQUAL(-1, forge_parse_http_request(
+                       "POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n",
+                       &req));
+
+  /* Exactly one chunked coding, and nothing else */
+  ASSERT_EQUAL(0, forge_parse_http_request(
+                      "POST / HTTP/1.1\r\nTransfer-Encoding: , Chunked\r\n\r\n",
+                      &req));
+  ASSERT_EQUAL(1, req.chunked);
+  ASSERT_EQUAL(-1, forge_parse_http_request(
+                       "POST / HTTP/1.1\r\nTransfer-Encoding: chunked, chunked\r\n\r\n",
+                       &req));
+  ASSERT_EQUAL(-1, forge_parse_http_request(
+                       "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n"
+                       "Transfer-Encoding: chunked\r\n\r\n",
+                       &req));
+  ASSERT_EQUAL(-1, forge_parse_http_request(
+                       "POST / HTTP/1.1\r\nTransfer-Encoding: ,\r\n\r\n",
+                       &req));
+  ASSERT_EQUAL(FORGE_PARSE_UNSUPPORTED,
+               forge_parse_http_request(
+                   "POST / HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n\r\n",
+                   &req));
+  ASSERT_EQUAL(FORGE_PARSE_UNSUPPORTED,
+               forge_parse_http_request(
+                   "POST / HTTP/1.1\r\nTransfer-Encoding: xchunked\r\n\r\n",
+                   &req));
+
+  char resp[512];
+  ASSERT_TRUE(roundtrip("POST /api/upload HTTP/1.1\r\n"
+                        "Transfer-Encoding: gzip, chunked\r\n\r\n"
+                        "0\r\n\r\n",
+                        resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 501 Not Implemented\r\n", 30) == 0);
+}
+
+static const char *target_path(const char *target)
+{
+  static ForgeHttpRequest req;
+  static char raw[512];
+  snprintf(raw, sizeof(raw), "GET %s HTTP/1.1\r\n\r\n", target);
+  memset(&req, 0, sizeof(req));
+  return forge_parse_http_request(raw, &req) == 0 ? req.path : NULL;
+}
+
+TEST(parse_target_normalization)
+{
+  ASSERT_STR_EQUAL("/health", target_path("/health?x=1"));
+  ASSERT_STR_EQUAL("/a/c/", target_path("/a//b/../c/./"));
+  ASSERT_STR_EQUAL("/etc/passwd", target_path("/static/..%2F..%2f../etc/passwd"));
+  ASSERT_STR_EQUAL("/a b", target_path("/a%20b"));
+  ASSERT_STR_EQUAL("/", target_path("/.."));
+  ASSERT_STR_EQUAL("/x/file.txt", target_path("/x/.hidden/../file.txt"));
+  ASSERT_STR_EQUAL("/api/v1/users/1234567890/orders/0987654321/items",
+                   target_path("/api/v1/users/1234567890/orders/0987654321/items"));
+  ASSERT_STR_EQUAL("/api/v1/users/1234567890/orders/items",
+                   target_path("/api/v1/users/1234567890//orders/0987654321/../items"));
+  ASSERT_TRUE(target_path("/a%2") == NULL);
+  ASSERT_TRUE(target_path("/a%zz") == NULL);
+  ASSERT_TRUE(target_path("/a%00b") == NULL);
+
+  ForgeHttpRequest req;
+  memset(&req, 0, sizeof(req));
+  ASSERT_EQUAL(0, forge_parse_http_request(
+                      "GET /s?q=a+b%21&flag&=x&q=second&bad=%zz HTTP/1.1\r\n\r\n",
+                      &req));
+  ASSERT_STR_EQUAL("q=a+b%21&flag&=x&q=second&bad=%zz", req.query);
+  ASSERT_EQUAL(0, req.query_indexed);
+  ASSERT_STR_EQUAL("a b!", forge_query_get(&req, "q"));
+  ASSERT_EQUAL(1, req.query_indexed);
+  ASSERT_STR_EQUAL("", forge_query_get(&req, "flag"));
+  ASSERT_STR_EQUAL("x", forge_query_get(&req, ""));
+  ASSERT_STR_EQUAL("%zz", forge_query_get(&req, "bad"));
+  ASSERT_TRUE(forge_query_get(&req, "missing") == NULL);
+}
+
+/* ---------------- HPACK ---------------- */
+
+static size_t unhex(const char *hex, uint8_t *out)
+{
+  size_t n = 0;
+  for (; hex[0] && hex[1]; hex += 2)
+  {
+    unsigned v;
+    sscanf(hex, "%2x", &v);
+    out[n++] = (uint8_t)v;
+  }
+  return n;
+}
+
+typedef struct
+{
+  char text[512];
+  size_t len;
+} FieldDump;
+
+static int dump_field(const char *name, size_t name_len,
+                      const char *value, size_t value_len, void *user)
+{
+  FieldDump *d = user;
+  d->len += (size_t)snprintf(d->text + d->len, sizeof(d->text) - d->len,
+                             "%.*s=%.*s;", (int)name_len, name,
+                             (int)value_len, value);
+  return 0;
+}
+
+TEST(hpack_integer)
+{
+  /* RFC 7541 C.1.2: 1337 with a 5-bit prefix */
+  uint8_t out[8];
+  uint64_t v = 0;
+  ASSERT_EQUAL(3, (int)forge_hpack_encode_int(out, sizeof(out), 0, 5, 1337));
+  ASSERT_TRUE(out[0] == 0x1f && out[1] == 0x9a && out[2] == 0x0a);
+  ASSERT_EQUAL(3, (int)forge_hpack_decode_int(out, 3, 5, &v));
+  ASSERT_EQUAL(1337, (int)v);
+  ASSERT_EQUAL(-1, (int)forge_hpack_decode_int(out, 2, 5, &v));
+}
+
+TEST(hpack_rfc_requests_huffman)
+{
+  /* RFC 7541 C.4: three requests sharing one dynamic table */
+  static const char *blocks[] = {
+      "828684418cf1e3c2e5f23a6ba0ab90f4ff",
+      "828684be5886a8eb10649cbf",
+      "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf",
+  };
+  static const char *expect[] = {
+      ":method=GET;:scheme=http;:path=/;:authority=www.example.com;",
+      ":method=GET;:scheme=http;:path=/;:authority=www.example.com;"
+      "cache-control=no-cache;",
+      ":method=GET;:scheme=https;:path=/index.html;"
+      ":authority=www.example.com;custom-key=custom-value;",
+  };
+
+  ForgeHpackTable t;
+  forge_hpack_init(&t, FORGE_HPACK_DEFAULT_TABLE);
+  char scratch[256];
+
+  for (int i = 0; i < 3; i++)
+  {
+    uint8_t in[64];
+    size_t n = unhex(blocks[i], in);
+    FieldDump d = {{0}, 0};
+    ASSERT_EQUAL(0, forge_hpack_decode(&t, in, n, scratch, sizeof(scratch),
+                                       dump_field, &d));
+    ASSERT_STR_EQUAL(d.text, expect[i]);
+  }
+  ASSERT_EQUAL(164, (int)t.size);
+  forge_hpack_free(&t);
+}
+
+TEST(hpack_encode_roundtrip)
+{
+  ForgeHpackTable enc, dec;
+  forge_hpack_init(&enc, FORGE_HPACK_DEFAULT_TABLE);
+  forge_hpack_init(&dec, FORGE_HPACK_DEFAULT_TABLE);
+
+  uint8_t block[256];
+  long n = 0;
+  n += forge_hpack_encode(&enc, block + n, sizeof(block) - (size_t)n,
+                          ":status", "200", 3, FORGE_HPACK_INDEX);
+  n += forge_hpack_encode(&enc, block + n, sizeof(block) - (size_t)n,
+                          "x-request", "abc/def?q=1", 11, FORGE_HPACK_INDEX);
+  n += forge_hpack_encode(&enc, block + n, sizeof(block) - (size_t)n,
+                          "x-request", "abc/def?q=1", 11, FORGE_HPACK_INDEX);
+
+  /* Static hit is one byte; the repeat is a single dynamic index */
+  ASSERT_EQUAL(0x88, block[0]);
+  ASSERT_EQUAL(0xbe, block[n - 1]);
+
+  char scratch[256];
+  FieldDump d = {{0}, 0};
+  ASSERT_EQUAL(0, forge_hpack_decode(&dec, block, (size_t)n, scratch,
+                                     sizeof(scratch), dump_field, &d));
+  ASSERT_STR_EQUAL(d.text, ":status=200;x-request=abc/def?q=1;"
+                           "x-request=abc/def?q=1;");
+
+  /* Truncated Huffman strings are a compression error */
+  uint8_t bad[] = {0x40, 0x82, 0xff};
+  ASSERT_EQUAL(-1, forge_hpack_decode(&dec, bad, sizeof(bad), scratch,
+                                      sizeof(scratch), dump_field, &d));
+
+  forge_hpack_free(&enc);
+  forge_hpack_free(&dec);
+}
+
+/* ---------------- Server ---------------- */
+
+#ifndef _WIN32
+TEST(handle_client_routes)
+{
+  char resp[2048];
+  ASSERT_TRUE(roundtrip("GET /health HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 OK\r\n", 17) == 0);
+  ASSERT_TRUE(strstr(resp, "\r\n\r\nOK\n") != NULL);
+
+  /* Routed on the canonical path, query split off */
+  ASSERT_TRUE(roundtrip("GET /api/..//health?verbose=1 HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 OK\r\n", 17) == 0);
+
+  ASSERT_TRUE(roundtrip("GET /missing HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 404 Not Found\r\n", 24) == 0);
+}
+
+TEST(keep_alive_pipelining)
+{
+  char resp[4096];
+  ASSERT_TRUE(roundtrip("GET /health HTTP/1.1\r\n\r\n"
+                        "GET /api/version HTTP/1.1\r\nConnection: close\r\n\r\n"
+                        "GET /health HTTP/1.1\r\n\r\n",
+                        resp, sizeof(resp)) > 0);
+
+  char *second = strstr(resp + 1, "HTTP/1.1 200 OK");
+  ASSERT_TRUE(strstr(resp, "Connection: keep-alive\r\n") < second);
+  ASSERT_TRUE(second && strstr(second, "Connection: close\r\n") != NULL);
+  ASSERT_TRUE(strstr(second, "\"version\"") != NULL);
+  ASSERT_TRUE(strstr(second + 1, "HTTP/1.1") == NULL); /* closed */
+
+  ASSERT_TRUE(roundtrip("GET /health HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "Connection: close\r\n") != NULL);
+}
+
+TEST(h2_prior_knowledge)
+{
+  uint8_t req[256];
+  size_t n = FORGE_H2_PREFACE_LEN;
+  memcpy(req, FORGE_H2_PREFACE, n);
+
+  ForgeH2Frame f = {0, FORGE_H2_SETTINGS, 0, 0};
+  forge_h2_pack_frame(req + n, &f);
+  n += FORGE_H2_FRAME_HEADER;
+
+  ForgeHpackTable enc;
+  forge_hpack_init(&enc, FORGE_HPACK_DEFAULT_TABLE);
+  uint8_t block[128];
+  long blen = 0;
+  blen += forge_hpack_encode(&enc, block + blen, sizeof(block) - (size_t)blen,
+                             ":method", "GET", 3, FORGE_HPACK_NO_INDEX);
+  blen += forge_hpack_encode(&enc, block + blen, sizeof(block) - (size_t)blen,
+                             ":scheme", "http", 4, FORGE_HPACK_NO_INDEX);
+  blen += forge_hpack_encode(&enc, block + blen, sizeof(block) - (size_t)blen,
+                             ":authority", "localhost", 9, FORGE_HPACK_NO_INDEX);
+  blen += forge_hpack_encode(&enc, block + blen, sizeof(block) - (size_t)blen,
+                             ":path", "/health", 7, FORGE_HPACK_NO_INDEX);
+  forge_hpack_free(&enc);
+
+  ForgeH2Frame h = {(uint32_t)blen, FORGE_H2_HEADERS,
+                    FORGE_H2_FLAG_END_HEADERS | FORGE_H2_FLAG_END_STREAM, 1};
+  forge_h2_pack_frame(req + n, &h);
+  memcpy(req + n + FORGE_H2_FRAME_HEADER, block, (size_t)blen);
+  n += FORGE_H2_FRAME_HEADER + (size_t)blen;
+
+  int sv[2];
+  ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+  ASSERT_TRUE(write(sv[0], req, n) == (ssize_t)n);
+  shutdown(sv[0], SHUT_WR);
+  handle_client(sv[1]);
+
+  uint8_t out[1024];
+  size_t total = 0;
+  ssize_t got;
+  while ((got = read(sv[0], out + total, sizeof(out) - total)) > 0)
+    total += (size_t)got;
+  close(sv[0]);
+
+  /* SETTINGS, SETTINGS ACK, HEADERS(1), DATA(1, END_STREAM) */
+  ForgeHpackTable dec;
+  forge_hpack_init(&dec, FORGE_HPACK_DEFAULT_TABLE);
+  char scratch[256];
+  FieldDump d = {{0}, 0};
+  char body[16] = {0};
+  int acked = 0;
+
+  for (size_t pos = 0; pos + FORGE_H2_FRAME_HEADER <= total;)
+  {
+    forge_h2_unpack_frame(out + pos, &f);
+    const uint8_t *p = out + pos + FORGE_H2_FRAME_HEADER;
+    pos += FORGE_H2_FRAME_HEADER + f.length;
+
+    if (f.type == FORGE_H2_SETTINGS && (f.flags & FORGE_H2_FLAG_ACK))
+      acked = 1;
+    if (f.type == FORGE_H2_HEADERS)
+      ASSERT_EQUAL(0, forge_hpack_decode(&dec, p, f.length, scratch,
+                                         sizeof(scratch), dump_field, &d));
+    if (f.type == FORGE_H2_DATA && f.length < sizeof(body))
+    {
+      memcpy(body, p, f.length);
+      ASSERT_TRUE(f.flags & FORGE_H2_FLAG_END_STREAM);
+      ASSERT_EQUAL(1, (int)f.stream_id);
+    }
+  }
+  forge_hpack_free(&dec);
+
+  ASSERT_TRUE(acked);
+  const char *want = ":status=200;content-type=text/plain; charset=utf-8;"
+                     "content-length=3;server=Forge;date=";
+  ASSERT_TRUE(strncmp(d.text, want, strlen(want)) == 0);
+  ASSERT_TRUE(strstr(d.text, " GMT;") == d.text + strlen(want) + 25);
+  ASSERT_STR_EQUAL(body, "OK\n");
+}
+
+TEST(h2_upload_spools)
+{
+  static uint8_t req[128 * 1024];
+  size_t n = FORGE_H2_PREFACE_LEN;
+  memcpy(req, FORGE_H2_PREFACE, n);
+
+  ForgeH2Frame f = {0, FORGE_H2_SETTINGS, 0, 0};
+  forge_h2_pack_frame(req + n, &f);
+  n += FORGE_H2_FRAME_HEADER;
+
+  ForgeHpackTable enc;
+  forge_hpack_init(&enc, FORGE_HPACK_DEFAULT_TABLE);
+  uint8_t block[128];
+  long blen = 0;
+  blen += forge_hpack_encode(&enc, block + blen, sizeof(block) - (size_t)blen,
+                             ":method", "POST", 4, FORGE_HPACK_NO_INDEX);
+  blen += forge_hpack_encode(&enc, block + blen, sizeof(block) - (size_t)blen,
+                             ":scheme", "http", 4, FORGE_HPACK_NO_INDEX);
+  blen += forge_hpack_encode(&enc, block + blen, sizeof(block) - (size_t)blen,
+                             ":path", "/api/upload", 11, FORGE_HPACK_NO_INDEX);
+  forge_hpack_free(&enc);
+
+  ForgeH2Frame h = {(uint32_t)blen, FORGE_H2_HEADERS, FORGE_H2_FLAG_END_HEADERS, 1};
+  forge_h2_pack_frame(req + n, &h);
+  memcpy(req + n + FORGE_H2_FRAME_HEADER, block, (size_t)blen);
+  n += FORGE_H2_FRAME_HEADER + (size_t)blen;
+
+  /* Past the in-memory share of a stream: the rest goes to the spool */
+  for (size_t sent = 0; sent < 100000;)
+  {
+    size_t len = 100000 - sent < 16384 ? 100000 - sent : 16384;
+    sent += len;
+    ForgeH2Frame d = {(uint32_t)len, FORGE_H2_DATA,
+                      sent == 100000 ? FORGE_H2_FLAG_END_STREAM : 0, 1};
+    forge_h2_pack_frame(req + n, &d);
+    memset(req + n + FORGE_H2_FRAME_HEADER, 'x', len);
+    n += FORGE_H2_FRAME_HEADER + len;
+  }
+
+  int sv[2];
+  ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+  int sndbuf = (int)sizeof(req);
+  setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+  ASSERT_TRUE(write(sv[0], req, n) == (ssize_t)n);
+  shutdown(sv[0], SHUT_WR);
+  handle_client(sv[1]);
+
+  char out[4096];
+  size_t total = 0;
+  ssize_t got;
+  while ((got = read(sv[0], out + total, sizeof(out) - 1 - total)) > 0)
+    total += (size_t)got;
+  close(sv[0]);
+
+  char body[64] = {0};
+  for (size_t pos = 0; pos + FORGE_H2_FRAME_HEADER <= total;)
+  {
+    forge_h2_unpack_frame((const uint8_t *)out + pos, &f);
+    if (f.type == FORGE_H2_DATA && f.stream_id == 1 && f.length < sizeof(body))
+      memcpy(body, out + pos + FORGE_H2_FRAME_HEADER, f.length);
+    pos += FORGE_H2_FRAME_HEADER + f.length;
+  }
+  ASSERT_STR_EQUAL(body, "{\"received\":100000}");
+}
+
+/* A POST to /api/upload on stream `id`: content-length values, then DATA */
+static size_t h2_post(uint8_t *out, uint32_t id, const char *cl1, const char *cl2,
+                      size_t data_len)
+{
+  ForgeHpackTable enc;
+  forge_hpack_init(&enc, FORGE_HPACK_DEFAULT_TABLE);
+  uint8_t block[128];
+  long blen = 0;
+  blen += forge_hpack_encode(&enc, block + blen, sizeof(block) - (size_t)blen,
+                             ":method", "POST", 4, FORGE_HPACK_NO_INDEX);
+  blen += forge_hpack_encode(&enc, block + blen, sizeof(block) - (size_t)blen,
+                             ":scheme", "http", 4, FORGE_HPACK_NO_INDEX);
+  blen += forge_hpack_encode(&enc, block + blen, sizeof(block) - (size_t)blen,
+                             ":path", "/api/upload", 11, FORGE_HPACK_NO_INDEX);
+  const char *cl[] = {cl1, cl2};
+  for (int i = 0; i < 2 && cl[i]; i++)
+    blen += forge_hpack_encode(&enc, block + blen, sizeof(block) - (size_t)blen,
+                               "content-length", cl[i], strlen(cl[i]),
+                               FORGE_HPACK_NO_INDEX);
+  forge_hpack_free(&enc);
+
+  ForgeH2Frame h = {(uint32_t)blen, FORGE_H2_HEADERS, FORGE_H2_FLAG_END_HEADERS, id};
+  forge_h2_pack_frame(out, &h);
+  memcpy(out + FORGE_H2_FRAME_HEADER, block, (size_t)blen);
+  size_t n = FORGE_H2_FRAME_HEADER + (size_t)blen;
+
+  ForgeH2Frame d = {(uint32_t)data_len, FORGE_H2_DATA, FORGE_H2_FLAG_END_STREAM, id};
+  forge_h2_pack_frame(out + n, &d);
+  memset(out + n + FORGE_H2_FRAME_HEADER, 'x', data_len);
+  return n + FORGE_H2_FRAME_HEADER + data_len;
+}
+
+TEST(h2_content_length)
+{
+  static uint8_t req[2048];
+  size_t n = FORGE_H2_PREFACE_LEN;
+  memcpy(req, FORGE_H2_PREFACE, n);
+
+  ForgeH2Frame f = {0, FORGE_H2_SETTINGS, 0, 0};
+  forge_h2_pack_frame(req + n, &f);
+  n += FORGE_H2_FRAME_HEADER;
+
+  /* Malformed, duplicated, too much, too little; then a good one */
+  n += h2_post(req + n, 1, "-3", NULL, 0);
+  n += h2_post(req + n, 3, "4", "4", 4);
+  n += h2_post(req + n, 5, "4", NULL, 5);
+  n += h2_post(req + n, 7, "4", NULL, 3);
+  n += h2_post(req + n, 9, "4", NULL, 4);
+
+  int sv[2];
+  ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+  ASSERT_TRUE(write(sv[0], req, n) == (ssize_t)n);
+  shutdown(sv[0], SHUT_WR);
+  handle_client(sv[1]);
+
+  static uint8_t out[4096];
+  size_t total = 0;
+  ssize_t got;
+  while ((got = read(sv[0], out + total, sizeof(out) - total)) > 0)
+    total += (size_t)got;
+  close(sv[0]);
+
+  uint32_t reset[10] = {0};
+  char body[64] = {0};
+  for (size_t pos = 0; pos + FORGE_H2_FRAME_HEADER <= total;)
+  {
+    forge_h2_unpack_frame(out + pos, &f);
+    const uint8_t *p = out + pos + FORGE_H2_FRAME_HEADER;
+    /* The first reset; DATA behind it only finds the stream closed */
+    if (f.type == FORGE_H2_RST_STREAM && f.stream_id < 10 && !reset[f.stream_id])
+      reset[f.stream_id] = (uint32_t)p[3] | 0x100;
+    if (f.type == FORGE_H2_DATA && f.stream_id == 9 && f.length < sizeof(body))
+      memcpy(body, p, f.length);
+    pos += FORGE_H2_FRAME_HEADER + f.length;
+  }
+
+  for (int id = 1; id < 9; id += 2)
+    ASSERT_EQUAL(0x100 | FORGE_H2_PROTOCOL_ERROR, (int)reset[id]);
+  ASSERT_EQUAL(0, (int)reset[9]);
+  ASSERT_STR_EQUAL(body, "{\"received\":4}");
+}
+
+static char mw_trace[64];
+
+static int mw_outer(const ForgeHttpRequest *req, int client_socket)
+{
+  (void)req;
+  (void)client_socket;
+  strcat(mw_trace, "a");
+  return FORGE_NEXT;
+}
+
+static int mw_auth(const ForgeHttpRequest *req, int client_socket)
+{
+  strcat(mw_trace, "b");
+  if (forge_http_header(req, "authorization"))
+    return FORGE_NEXT;
+
+  forge_response_header(client_socket, "WWW-Authenticate", "Bearer");
+  forge_send_text(client_socket, "401 Unauthorized", "denied\n");
+  return FORGE_HALT;
+}
+
+static void mw_done(const ForgeHttpRequest *req, int client_socket, int status)
+{
+  (void)req;
+  (void)client_socket;
+  snprintf(mw_trace + strlen(mw_trace), sizeof(mw_trace) - strlen(mw_trace),
+           "%d;", status);
+}
+
+static void handle_mw(const ForgeHttpRequest *req, int client_socket)
+{
+  (void)req;
+  strcat(mw_trace, "h");
+  forge_send_text(client_socket, "200 OK", "mw\n");
+}
+
+static void handle_shadowed(const ForgeHttpRequest *req, int client_socket)
+{
+  (void)req;
+  forge_send_text(client_socket, "500 Internal Server Error", "shadowed\n");
+}
+
+TEST(router_middleware_chain)
+{
+  char resp[2048];
+
+  ASSERT_EQUAL(0, forge_router_add("GET", "/mw/ok", handle_mw));
+  ASSERT_EQUAL(0, forge_router_add("GET", "/mw/ok", handle_shadowed));
+  ASSERT_EQUAL(0, forge_use("/mw", mw_outer, mw_done));
+  ASSERT_EQUAL(0, forge_use("/mw/ok/", mw_auth, NULL));
+  ASSERT_EQUAL(-1, forge_use("mw", mw_outer, NULL));
+  ASSERT_EQUAL(-1, forge_router_add("GET", "relative", handle_mw));
+
+  mw_trace[0] = '\0';
+  ASSERT_TRUE(roundtrip("GET /mw/ok HTTP/1.1\r\nAuthorization: Bearer x\r\n\r\n",
+                        resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\r\n\r\nmw\n") != NULL);
+  ASSERT_STR_EQUAL(mw_trace, "abh200;");
+
+  mw_trace[0] = '\0';
+  ASSERT_TRUE(roundtrip("GET /mw/ok HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 401 ", 13) == 0);
+  ASSERT_TRUE(strstr(resp, "\r\nWWW-Authenticate: Bearer\r\n") != NULL);
+  ASSERT_STR_EQUAL(mw_trace, "ab401;");
+
+  /* Prefixed middleware never runs for unmatched paths */
+  mw_trace[0] = '\0';
+  ASSERT_TRUE(roundtrip("GET /mw/missing HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 404 ", 13) == 0);
+  ASSERT_STR_EQUAL(mw_trace, "");
+
+  /* Built-in routes stay reachable */
+  ASSERT_TRUE(roundtrip("GET /health HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 OK\r\n", 17) == 0);
+}
+
+/* ---------------- Cores ---------------- */
+
+#define INBOX_PRODUCERS 4
+#define INBOX_MESSAGES 2000
+
+static int inbox_sum;
+
+static void inbox_add(ForgeCore *core, void *arg)
+{
+  (void)core;
+  inbox_sum += (int)(intptr_t)arg;
+}
+
+static void *inbox_producer(void *arg)
+{
+  (void)arg;
+  for (int i = 0; i < INBOX_MESSAGES; i++)
+  {
+    /* A full inbox is backpressure: retry until core 0 drains */
+    while (forge_core_post(0, inbox_add, (void *)(intptr_t)1) != 0)
+      sched_yield();
+  }
+  return NULL;
+}
+
+TEST(core_inbox_mpsc)
+{
+  ForgeCore *core = forge_current_core();
+  ASSERT_EQUAL(0, forge_core_id(core));
+  ASSERT_EQUAL(-1, forge_core_post(forge_core_count(), inbox_add, NULL));
+
+  pthread_t threads[INBOX_PRODUCERS];
+  for (int i = 0; i < INBOX_PRODUCERS; i++)
+    pthread_create(&threads[i], NULL, inbox_producer, NULL);
+
+  inbox_sum = 0;
+  while (inbox_sum < INBOX_PRODUCERS * INBOX_MESSAGES)
+    forge_core_drain(core);
+
+  for (int i = 0; i < INBOX_PRODUCERS; i++)
+    pthread_join(threads[i], NULL);
+
+  ASSERT_EQUAL(0, forge_core_drain(core));
+  ASSERT_EQUAL(INBOX_PRODUCERS * INBOX_MESSAGES, inbox_sum);
+}
+
+TEST(core_arena_and_stats)
+{
+  ForgeCore *core = forge_current_core();
+
+  char *a = forge_core_alloc(core, 3);
+  char *b = forge_core_alloc(core, 100 * 1024);
+  ASSERT_TRUE(a != NULL && b != NULL);
+  ASSERT_EQUAL(0, (int)((uintptr_t)a % 16));
+  ASSERT_EQUAL(0, (int)((uintptr_t)b % 16));
+  memset(b, 0xAB, 100 * 1024);
+
+  ForgeCoreStats before, after;
+  forge_core_stats(0, &before);
+
+  char resp[2048];
+  ASSERT_TRUE(roundtrip("GET /health HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+
+  forge_core_stats(-1, &after);
+  ASSERT_EQUAL(1, (int)(after.requests - before.requests));
+  ASSERT_EQUAL(1, (int)(after.accepted - before.accepted));
+  ASSERT_EQUAL((int)before.active, (int)after.active);
+  ASSERT_TRUE(after.bytes_out > before.bytes_out);
+}
+
+static void handle_slow(const ForgeHttpRequest *req, int client_socket)
+{
+  (void)req;
+  usleep(30 * 1000);
+  forge_send_text(client_socket, "200 OK", "slow\n");
+}
+
+TEST(admission_sheds_queued_requests)
+{
+  char resp[4096];
+  ForgeCoreStats before, after;
+
+  ASSERT_EQUAL(0, forge_router_add("GET", "/slow", handle_slow));
+  forge_server_set_admission(2, 10, 3);
+  forge_core_stats(-1, &before);
+
+  /* The later requests queue behind the first one's 30ms */
+  int n = roundtrip("GET /slow HTTP/1.1\r\n\r\n"
+                    "GET /slow HTTP/1.1\r\n\r\n"
+                    "GET /api/version HTTP/1.1\r\n\r\n"
+                    "GET /health HTTP/1.1\r\n\r\n",
+                    resp, sizeof(resp));
+  forge_server_set_admission(5, 100, 1);
+
+  ASSERT_TRUE(n > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 OK\r\n", 17) == 0);
+
+  char *shed = strstr(resp, "HTTP/1.1 503 Service Unavailable\r\n");
+  ASSERT_TRUE(shed != NULL);
+  ASSERT_TRUE(strstr(shed, "\r\nRetry-After: 3\r\n") != NULL);
+  ASSERT_TRUE(strstr(shed, "\r\nConnection: keep-alive\r\n") != NULL);
+  ASSERT_TRUE(strstr(shed, "\r\nServer: Forge\r\nDate: ") != NULL);
+  ASSERT_TRUE(strstr(shed, "\r\n\r\nService Unavailable\n") != NULL);
+
+  /* The connection survives; /api/version also waited too long */
+  shed = strstr(shed + 1, "HTTP/1.1 503 ");
+  ASSERT_TRUE(shed != NULL);
+
+  /* /health is high priority: served however long it queued */
+  ASSERT_TRUE(strstr(shed, "HTTP/1.1 200 OK\r\n") != NULL);
+  ASSERT_TRUE(strstr(shed, "\r\n\r\nOK\n") != NULL);
+
+  forge_core_stats(-1, &after);
+  ASSERT_EQUAL(2, (int)(after.shed - before.shed));
+  ASSERT_TRUE(after.queue_delay_max_ns >= 20ULL * 1000000ULL);
+
+  ASSERT_TRUE(roundtrip("GET /metrics HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\nforge_requests_shed_total ") != NULL);
+  ASSERT_TRUE(strstr(resp, "\nforge_queue_delay_seconds_max ") != NULL);
+}
+
+TEST(common_headers_date)
+{
+  char resp[2048];
+  time_t before = time(NULL);
+  ASSERT_TRUE(roundtrip("GET /health HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  time_t after = time(NULL);
+
+  ASSERT_TRUE(strstr(resp, "\r\nServer: Forge\r\n") != NULL);
+  ASSERT_TRUE(strstr(resp, "\r\nConnection: keep-alive\r\n") != NULL);
+
+  char *date = strstr(resp, "\r\nDate: ");
+  ASSERT_TRUE(date != NULL);
+  date += 8;
+  ASSERT_TRUE(strncmp(date + 25, " GMT\r\n", 6) == 0);
+
+  /* Same text as the C library's formatting of either second */
+  char want[2][64];
+  struct tm tm;
+  time_t secs[2] = {before, after};
+  for (int i = 0; i < 2; i++)
+  {
+    tm = *gmtime(&secs[i]);
+    strftime(want[i], sizeof(want[i]), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  }
+  ASSERT_TRUE(strncmp(date, want[0], 29) == 0 || strncmp(date, want[1], 29) == 0);
+}
+
+static void handle_json_values(const ForgeHttpRequest *req, int client_socket)
+{
+  (void)req;
+  ForgeJsonWriter w;
+  forge_json_begin(&w, client_socket, "200 OK");
+  forge_json_object_begin(&w);
+  forge_json_key(&w, "ints");
+  forge_json_array_begin(&w);
+  forge_json_int(&w, 0);
+  forge_json_int(&w, -7);
+  forge_json_int(&w, 1234567890123LL);
+  forge_json_int(&w, LLONG_MIN);
+  forge_json_array_end(&w);
+  forge_json_key(&w, "doubles");
+  forge_json_array_begin(&w);
+  forge_json_double(&w, 0.1);
+  forge_json_double(&w, -2.5);
+  forge_json_double(&w, 1.0 / 3.0);
+  forge_json_double(&w, 1e21);
+  forge_json_double(&w, 0.000015);
+  forge_json_double(&w, 5e-324);
+  forge_json_double(&w, NAN);
+  forge_json_array_end(&w);
+  forge_json_key(&w, "s\n");
+  forge_json_string(&w, "q\"b\\t\t\x01 \xc3\xa9 0123456789abcdef\x1f");
+  forge_json_key(&w, "ok");
+  forge_json_bool(&w, 1);
+  forge_json_key(&w, "none");
+  forge_json_null(&w);
+  forge_json_object_end(&w);
+  forge_json_end(&w);
+}
+
+static void handle_json_big(const ForgeHttpRequest *req, int client_socket)
+{
+  (void)req;
+  ForgeJsonWriter w;
+  forge_json_begin(&w, client_socket, "200 OK");
+  forge_json_array_begin(&w);
+  for (int i = 0; i < 1000; i++)
+    forge_json_string(&w, "a fairly long string with a \"quote\" in it");
+  forge_json_array_end(&w);
+  forge_json_end(&w);
+}
+
+static void handle_json_misuse(const ForgeHttpRequest *req, int client_socket)
+{
+  (void)req;
+  ForgeJsonWriter w;
+  forge_json_begin(&w, client_socket, "200 OK");
+  forge_json_array_begin(&w);
+  forge_json_key(&w, "not in an object");
+  forge_json_array_end(&w);
+  forge_json_end(&w);
+}
+
+/* Concatenated chunk payloads of a chunked body; -1 if malformed */
+static long dechunk(const char *body, char *out, size_t cap)
+{
+  size_t n = 0;
+  while (1)
+  {
+    char *end;
+    unsigned long size = strtoul(body, &end, 16);
+    if (end == body || strncmp(end, "\r\n", 2) != 0)
+      return -1;
+    body = end + 2;
+    if (size == 0)
+      return strncmp(body, "\r\n", 2) == 0 ? (long)n : -1;
+    if (n + size > cap || strlen(body) < size + 2)
+      return -1;
+    memcpy(out + n, body, size);
+    n += size;
+    body += size;
+    if (strncmp(body, "\r\n", 2) != 0)
+      return -1;
+    body += 2;
+  }
+}
+
+TEST(json_writer)
+{
+  static char resp[65536];
+  static char body[65536];
+
+  ASSERT_EQUAL(0, forge_router_add("GET", "/json/values", handle_json_values));
+  ASSERT_EQUAL(0, forge_router_add("GET", "/json/big", handle_json_big));
+  ASSERT_EQUAL(0, forge_router_add("GET", "/json/misuse", handle_json_misuse));
+
+  ASSERT_TRUE(roundtrip("GET /json/values HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\r\nContent-Type: application/json; charset=utf-8\r\n") != NULL);
+  ASSERT_TRUE(strstr(resp, "\r\nContent-Length: ") != NULL);
+  const char *want =
+      "{\"ints\":[0,-7,1234567890123,-9223372036854775808],"
+      "\"doubles\":[0.1,-2.5,0.3333333333333333,1e+21,0.000015,"
+      "4.94065645841247e-324,null],"
+      "\"s\\n\":\"q\\\"b\\\\t\\t\\u0001 \xc3\xa9 0123456789abcdef\\u001f\","
+      "\"ok\":true,\"none\":null}";
+  char *json = strstr(resp, "\r\n\r\n");
+  ASSERT_TRUE(json != NULL);
+  ASSERT_STR_EQUAL(json + 4, want);
+
+  /* Larger than the buffer: chunked on HTTP/1.1 ... */
+  ASSERT_TRUE(roundtrip("GET /json/big HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\r\nTransfer-Encoding: chunked\r\n") != NULL);
+  long n = dechunk(strstr(resp, "\r\n\r\n") + 4, body, sizeof(body) - 1);
+  ASSERT_TRUE(n > FORGE_JSON_BUFFER);
+  body[n] = '\0';
+  ASSERT_EQUAL(1000 * 46 + 1, (int)n);
+  ASSERT_TRUE(strncmp(body, "[\"a fairly long string with a \\\"quote\\\" in it\",", 47) == 0);
+  ASSERT_TRUE(strcmp(body + n - 2, "\"]") == 0);
+
+  /* ... one Content-Length body for HTTP/1.0 */
+  ASSERT_TRUE(roundtrip("GET /json/big HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\r\nContent-Length: 46001\r\n") != NULL);
+  ASSERT_TRUE(strcmp(strstr(resp, "\r\n\r\n") + 4, body) == 0);
+
+  ASSERT_TRUE(roundtrip("GET /json/misuse HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 500 ", 13) == 0);
+}
+
+static uint64_t pool_used(size_t slot_size)
+{
+  ForgePoolStats st[FORGE_POOL_MAX_NODES * FORGE_POOL_CLASSES];
+  int n = forge_pool_stats(st, (int)(sizeof(st) / sizeof(st[0])));
+  uint64_t used = 0;
+  for (int i = 0; i < n; i++)
+  {
+    if (st[i].slot_size == slot_size)
+      used += st[i].slots_used;
+  }
+  return used;
+}
+
+TEST(pool_alloc_free)
+{
+  enum { COUNT = 200 }; /* more than one 2 MB region of 32 KB slots */
+  static char *bufs[COUNT];
+
+  ASSERT_TRUE(forge_pool_alloc(1024 * 1024) == NULL);
+
+  uint64_t before = pool_used(32768);
+  for (int i = 0; i < COUNT; i++)
+  {
+    bufs[i] = forge_pool_alloc(30000);
+    ASSERT_TRUE(bufs[i] != NULL);
+    ASSERT_EQUAL(0, (int)((uintptr_t)bufs[i] % 4096));
+    memset(bufs[i], i, 30000);
+  }
+  ASSERT_EQUAL(COUNT, (int)(pool_used(32768) - before));
+
+  for (int i = 0; i < COUNT; i++)
+    ASSERT_EQUAL((unsigned char)i, (unsigned char)bufs[i][29999]);
+
+  for (int i = 0; i < COUNT; i++)
+    forge_pool_free(bufs[i]);
+  ASSERT_EQUAL(0, (int)(pool_used(32768) - before));
+
+  /* Freed slots are reused before new regions are mapped */
+  char *again = forge_pool_alloc(32768);
+  ASSERT_TRUE(again == bufs[COUNT - 1]);
+  forge_pool_free(again);
+
+  char resp[4096];
+  ASSERT_TRUE(roundtrip("GET /metrics HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\nforge_pool_slots_total{node=\"0\",size=\"32768\"} ") != NULL);
+}
+
+static void *client_thread(void *arg)
+{
+  handle_client(*(int *)arg);
+  return NULL;
+}
+
+/* The server releases the buffer right after its write: poll briefly */
+static int pool_settles(size_t slot_size, uint64_t want)
+{
+  for (int i = 0; i < 200; i++)
+  {
+    if (pool_used(slot_size) == want)
+      return 1;
+    usleep(5000);
+  }
+  return 0;
+}
+
+static int read_response(int fd, char *out, size_t cap)
+{
+  size_t total = 0;
+  while (total + 1 < cap)
+  {
+    ssize_t n = read(fd, out + total, cap - 1 - total);
+    if (n <= 0)
+      break;
+    total += (size_t)n;
+    out[total] = '\0';
+    if (strstr(out, "\r\n\r\nOK\n"))
+      break;
+  }
+  out[total] = '\0';
+  return (int)total;
+}
+
+TEST(conn_buffer_tiers)
+{
+  uint64_t small = pool_used(512), mid = pool_used(4096), big = pool_used(65536);
+
+  int sv[2];
+  ASSERT_TRUE(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+  pthread_t thread;
+  pthread_create(&thread, NULL, client_thread, &sv[1]);
+
+  /* Idle keep-alive connection: its state and a 512 B buffer */
+  char resp[2048];
+  const char get[] = "GET /health HTTP/1.1\r\n\r\n";
+  ASSERT_TRUE(write(sv[0], get, sizeof(get) - 1) == (ssize_t)(sizeof(get) - 1));
+  ASSERT_TRUE(read_response(sv[0], resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 OK\r\n", 17) == 0);
+  ASSERT_TRUE(pool_settles(512, small + 2));
+  ASSERT_TRUE(pool_used(4096) == mid && pool_used(65536) == big);
+
+  /* ...kept across requests */
+  ASSERT_TRUE(write(sv[0], get, sizeof(get) - 1) == (ssize_t)(sizeof(get) - 1));
+  ASSERT_TRUE(read_response(sv[0], resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(pool_settles(512, small + 2));
+
+  /* A 40 KB head promotes through the tiers to the largest... */
+  enum { PAD = 40000 };
+  static char req[PAD + 64];
+  int n = snprintf(req, sizeof(req), "GET /health HTTP/1.1\r\nX-Pad: ");
+  memset(req + n, 'a', PAD);
+  memcpy(req + n + PAD, "\r\n\r\n", 4);
+  ASSERT_TRUE(write(sv[0], req, (size_t)n + PAD + 4) == (ssize_t)n + PAD + 4);
+  ASSERT_TRUE(read_response(sv[0], resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 OK\r\n", 17) == 0);
+
+  /* ...and that buffer is back in the pool once the request is done */
+  ASSERT_TRUE(pool_settles(65536, big));
+  ASSERT_TRUE(pool_used(512) == small + 1 && pool_used(4096) == mid);
+
+  close(sv[0]);
+  pthread_join(thread, NULL);
+  ASSERT_TRUE(pool_settles(512, small));
+
+  /* Beyond the largest tier the head is refused */
+  static char huge[70000 + 64];
+  n = snprintf(huge, sizeof(huge), "GET /health HTTP/1.1\r\nX-Pad: ");
+  memset(huge + n, 'a', 70000);
+  memcpy(huge + n + 70000, "\r\n\r\n", 4);
+  ASSERT_TRUE(roundtrip_n(huge, (size_t)n + 70004, resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200", 12) != 0);
+}
+
+enum { REPORT_SIZE = 256 * 1024 };
+static char report[REPORT_SIZE];
+static atomic_int reports_released;
+
+static void report_release(void *user)
+{
+  atomic_fetch_add((atomic_int *)user, 1);
+}
+
+static void handle_report(const ForgeHttpRequest *req, int client_socket)
+{
+  size_t len = forge_query_get(req, "small") ? 1024 : sizeof(report);
+  forge_send_zerocopy(client_socket, "200 OK", "text/plain", report, len,
+                      report_release, &reports_released);
+}
+
+/* One response's body into out; returns its length or -1 */
+static long read_report(int fd, char *out, size_t cap)
+{
+  char head[1024];
+  size_t len = 0;
+  char *end = NULL;
+  while (!end && len + 1 < sizeof(head))
+  {
+    ssize_t n = read(fd, head + len, 1);
+    if (n <= 0)
+      return -1;
+    head[++len] = '\0';
+    end = strstr(head, "\r\n\r\n");
+  }
+
+  const char *cl = strstr(head, "Content-Length: ");
+  size_t body = cl ? (size_t)atol(cl + 16) : 0;
+  if (!end || body > cap)
+    return -1;
+
+  for (size_t got = 0; got < body;)
+  {
+    ssize_t n = read(fd, out + got, body - got);
+    if (n <= 0)
+      return -1;
+    got += (size_t)n;
+  }
+  return (long)body;
+}
+
+TEST(zerocopy_large_body)
+{
+  for (size_t i = 0; i < sizeof(report); i++)
+    report[i] = (char)('a' + i % 23);
+  ASSERT_EQUAL(0, forge_router_add("GET", "/report", handle_report));
+
+  static char resp[REPORT_SIZE];
+
+  /* Unix sockets cannot: a plain send, released at once */
+  atomic_store(&reports_released, 0);
+  ASSERT_TRUE(roundtrip("GET /report?small=1 HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 1024);
+  ASSERT_EQUAL(1, atomic_load(&reports_released));
+
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr = {0};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(addr);
+  ASSERT_TRUE(bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  ASSERT_TRUE(listen(lfd, 1) == 0);
+  ASSERT_TRUE(getsockname(lfd, (struct sockaddr *)&addr, &addr_len) == 0);
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_TRUE(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  int server_fd = accept(lfd, NULL, NULL);
+  close(lfd);
+  pthread_t thread;
+  pthread_create(&thread, NULL, client_thread, &server_fd);
+
+  /* TCP: released by the completion, after the bytes went out */
+  atomic_store(&reports_released, 0);
+  const char get[] = "GET /report HTTP/1.1\r\n\r\n";
+  ASSERT_TRUE(write(fd, get, sizeof(get) - 1) == (ssize_t)(sizeof(get) - 1));
+  ASSERT_EQUAL(REPORT_SIZE, (int)read_report(fd, resp, sizeof(resp)));
+  ASSERT_TRUE(memcmp(resp, report, REPORT_SIZE) == 0);
+  for (int i = 0; i < 200 && atomic_load(&reports_released) == 0; i++)
+    usleep(5000);
+  ASSERT_EQUAL(1, atomic_load(&reports_released));
+
+  /* Below the threshold the body is copied and released at once */
+  const char small[] = "GET /report?small=1 HTTP/1.1\r\n\r\n";
+  ASSERT_TRUE(write(fd, small, sizeof(small) - 1) == (ssize_t)(sizeof(small) - 1));
+  ASSERT_EQUAL(1024, (int)read_report(fd, resp, sizeof(resp)));
+  for (int i = 0; i < 200 && atomic_load(&reports_released) == 1; i++)
+    usleep(5000);
+  ASSERT_EQUAL(2, atomic_load(&reports_released));
+
+  const char last[] = "GET /report HTTP/1.1\r\nConnection: close\r\n\r\n";
+  ASSERT_TRUE(write(fd, last, sizeof(last) - 1) == (ssize_t)(sizeof(last) - 1));
+  ASSERT_EQUAL(REPORT_SIZE, (int)read_report(fd, resp, sizeof(resp)));
+  ASSERT_TRUE(memcmp(resp, report, REPORT_SIZE) == 0);
+
+  close(fd);
+  pthread_join(thread, NULL);
+  ASSERT_EQUAL(3, atomic_load(&reports_released));
+}
+
+static int cached_calls;
+
+static void handle_cached(const ForgeHttpRequest *req, int client_socket)
+{
+  (void)req;
+  char body[32];
+  snprintf(body, sizeof(body), "calls=%d", ++cached_calls);
+  forge_send_text(client_socket, "200 OK", body);
+}
+
+static void handle_cookie(const ForgeHttpRequest *req, int client_socket)
+{
+  (void)req;
+  cached_calls++;
+  forge_response_header(client_socket, "Set-Cookie", "id=1");
+  forge_send_text(client_socket, "200 OK", "private");
+}
+
+TEST(response_cache)
+{
+  char resp[2048];
+  char raw[256];
+
+  ASSERT_EQUAL(0, forge_cache_route("GET", "/cached", 60, "Accept"));
+  ASSERT_EQUAL(0, forge_cache_route("GET", "/cached/cookie", 60000, NULL));
+  ASSERT_EQUAL(-1, forge_cache_route("GET", "/x", 0, NULL));
+  ASSERT_EQUAL(0, forge_router_add("GET", "/cached", handle_cached));
+  ASSERT_EQUAL(0, forge_router_add("GET", "/cached/cookie", handle_cookie));
+
+  ForgeCacheStats before, after;
+  forge_cache_stats(&before);
+
+  ASSERT_TRUE(roundtrip("GET /cached HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\r\n\r\ncalls=1") != NULL);
+  ASSERT_TRUE(strstr(resp, "\r\nVary: Accept\r\n") != NULL);
+  char *etag = strstr(resp, "\r\nETag: \"");
+  ASSERT_TRUE(etag != NULL);
+  char tag[64];
+  ASSERT_EQUAL(1, sscanf(etag + 8, "%63[^\r]", tag));
+
+  /* Served without the handler, Date and Connection still per request */
+  ASSERT_TRUE(roundtrip("GET /cached HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 OK\r\n", 17) == 0);
+  ASSERT_TRUE(strstr(resp, "\r\nConnection: close\r\n") != NULL);
+  ASSERT_TRUE(strstr(resp, "\r\nDate: ") != NULL);
+  ASSERT_TRUE(strstr(resp, "\r\nContent-Length: 7\r\n") != NULL);
+  ASSERT_TRUE(strstr(resp, tag) != NULL);
+  ASSERT_TRUE(strstr(resp, "\r\n\r\ncalls=1") != NULL);
+
+  snprintf(raw, sizeof(raw), "GET /cached HTTP/1.1\r\nIf-None-Match: W/\"x\", %s\r\n\r\n", tag);
+  ASSERT_TRUE(roundtrip(raw, resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 304 Not Modified\r\n", 27) == 0);
+  ASSERT_TRUE(strstr(resp, "Content-Length") == NULL);
+  ASSERT_TRUE(strcmp(resp + strlen(resp) - 4, "\r\n\r\n") == 0);
+
+  /* Another Accept value is another variant */
+  ASSERT_TRUE(roundtrip("GET /cached HTTP/1.1\r\nAccept: text/plain\r\n\r\n",
+                        resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\r\n\r\ncalls=2") != NULL);
+
+  /* Expired after the TTL */
+  struct timespec ttl = {0, 80 * 1000000L};
+  nanosleep(&ttl, NULL);
+  ASSERT_TRUE(roundtrip("GET /cached HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\r\n\r\ncalls=3") != NULL);
+
+  /* Cookies are never shared */
+  ASSERT_TRUE(roundtrip("GET /cached/cookie HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(roundtrip("GET /cached/cookie HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_EQUAL(5, cached_calls);
+
+  forge_cache_stats(&after);
+  ASSERT_EQUAL(2, (int)(after.hits - before.hits));
+  ASSERT_EQUAL(1, (int)(after.not_modified - before.not_modified));
+  ASSERT_EQUAL(5, (int)(after.misses - before.misses));
+  ASSERT_EQUAL(3, (int)(after.stores - before.stores));
+
+  forge_cache_purge();
+  forge_cache_stats(&after);
+  ASSERT_EQUAL(0, (int)after.entries);
+  ASSERT_EQUAL(0, (int)after.bytes);
+}
+
+static atomic_int report_calls;
+
+static void handle_report_build(const ForgeHttpRequest *req, int client_socket)
+{
+  (void)req;
+  int n = atomic_fetch_add(&report_calls, 1) + 1;
+  struct timespec work = {0, 300 * 1000000L};
+  nanosleep(&work, NULL);
+
+  char body[32];
+  snprintf(body, sizeof(body), "calls=%d", n);
+  forge_send_text(client_socket, "200 OK", body);
+}
+
+static void *coalesce_client(void *arg)
+{
+  char *resp = arg;
+  roundtrip("GET /herd?q=1 HTTP/1.0\r\n\r\n", resp, 512);
+  return NULL;
+}
+
+TEST(coalesce_identical_gets)
+{
+  static char resp[4][512];
+  char one[512];
+
+  ASSERT_EQUAL(-1, forge_cache_coalesce(NULL, "/herd", 0));
+  ASSERT_EQUAL(0, forge_cache_coalesce("GET", "/herd", 0));
+  ASSERT_EQUAL(0, forge_router_add("GET", "/herd", handle_report_build));
+
+  ForgeCacheStats before, after;
+  forge_cache_stats(&before);
+
+  /* Four at once: one handler call, its response sent four times */
+  pthread_t threads[4];
+  for (int i = 0; i < 4; i++)
+    ASSERT_EQUAL(0, pthread_create(&threads[i], NULL, coalesce_client, resp[i]));
+  for (int i = 0; i < 4; i++)
+    pthread_join(threads[i], NULL);
+
+  ASSERT_EQUAL(1, atomic_load(&report_calls));
+  for (int i = 0; i < 4; i++)
+  {
+    ASSERT_TRUE(strncmp(resp[i], "HTTP/1.1 200 OK\r\n", 17) == 0);
+    ASSERT_TRUE(strstr(resp[i], "\r\n\r\ncalls=1") != NULL);
+  }
+
+  forge_cache_stats(&after);
+  ASSERT_EQUAL(3, (int)(after.coalesced - before.coalesced));
+  ASSERT_EQUAL(0, (int)(after.stores - before.stores));
+
+  /* No TTL: once the flight landed the next request runs again */
+  ASSERT_TRUE(roundtrip("GET /herd?q=1 HTTP/1.0\r\n\r\n", one, sizeof(one)) > 0);
+  ASSERT_TRUE(strstr(one, "\r\n\r\ncalls=2") != NULL);
+}
+
+/* A masked client frame; returns its length */
+static size_t ws_frame(char *out, int fin, int opcode, const char *data, size_t len)
+{
+  static const unsigned char key[4] = {0x37, 0xfa, 0x21, 0x3d};
+  unsigned char *p = (unsigned char *)out;
+  size_t n = 0;
+
+  p[n++] = (unsigned char)((fin ? 0x80 : 0) | opcode);
+  if (len < 126)
+    p[n++] = (unsigned char)(0x80 | len);
+  else if (len <= 0xFFFF)
+  {
+    p[n++] = 0x80 | 126;
+    p[n++] = (unsigned char)(len >> 8);
+    p[n++] = (unsigned char)len;
+  }
+  else
+  {
+    p[n++] = 0x80 | 127;
+    for (int i = 7; i >= 0; i--)
+      p[n++] = (unsigned char)((uint64_t)len >> (8 * i));
+  }
+  memcpy(p + n, key, 4);
+  n += 4;
+  for (size_t i = 0; i < len; i++)
+    p[n + i] = (unsigned char)data[i] ^ key[i & 3];
+  return n + len;
+}
+
+/* Next unmasked server frame at *p: opcode, payload and its length */
+static int ws_next(const unsigned char **p, const unsigned char **payload,
+                   size_t *len)
+{
+  const unsigned char *f = *p;
+  int opcode = f[0] & 0x0F;
+  size_t n = f[1] & 0x7F, head = 2;
+  if (n == 126)
+  {
+    n = (size_t)f[2] << 8 | f[3];
+    head = 4;
+  }
+  else if (n == 127)
+  {
+    n = 0;
+    for (int i = 0; i < 8; i++)
+      n = n << 8 | f[2 + i];
+    head = 10;
+  }
+  *payload = f + head;
+  *len = n;
+  *p = f + head + n;
+  return opcode;
+}
+
+static int ws_closed_with;
+
+static void ws_echo(ForgeWs *ws, int opcode, const char *data, size_t len)
+{
+  forge_ws_send(ws, opcode, data, len);
+}
+
+static void ws_on_close(ForgeWs *ws, int code)
+{
+  (void)ws;
+  ws_closed_with = code;
+}
+
+static const ForgeWsHandler ws_echo_handler = {NULL, ws_echo, ws_on_close, 0};
+
+TEST(websocket_echo)
+{
+  static char raw[80000];
+  static char resp[160000];
+  static char big[70000];
+  const char *handshake = "GET /ws HTTP/1.1\r\n"
+                          "Host: x\r\n"
+                          "Upgrade: websocket\r\n"
+                          "Connection: keep-alive, Upgrade\r\n"
+                          "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                          "Sec-WebSocket-Version: 13\r\n\r\n";
+
+  ASSERT_EQUAL(0, forge_ws_route("/ws", &ws_echo_handler));
+
+  for (size_t i = 0; i < sizeof(big); i++)
+    big[i] = (char)(i * 7);
+
+  size_t n = strlen(handshake);
+  memcpy(raw, handshake, n);
+  n += ws_frame(raw + n, 1, FORGE_WS_TEXT, "hello", 5);
+  n += ws_frame(raw + n, 0, FORGE_WS_TEXT, "frag", 4);
+  n += ws_frame(raw + n, 1, 0x9, "p", 1); /* ping between fragments */
+  n += ws_frame(raw + n, 1, 0x0, "mented \xc3\xa9", 9);
+  n += ws_frame(raw + n, 1, FORGE_WS_BINARY, big, sizeof(big));
+  n += ws_frame(raw + n, 1, 0x8, "\x03\xe8", 2);
+
+  int total = roundtrip_n(raw, n, resp, sizeof(resp));
+  ASSERT_TRUE(total > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 101 Switching Protocols\r\n", 34) == 0);
+  ASSERT_TRUE(strstr(resp, "\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != NULL);
+
+  const unsigned char *p = (const unsigned char *)strstr(resp, "\r\n\r\n") + 4;
+  const unsigned char *payload;
+  size_t len;
+
+  ASSERT_EQUAL(FORGE_WS_TEXT, ws_next(&p, &payload, &len));
+  ASSERT_TRUE(len == 5 && memcmp(payload, "hello", 5) == 0);
+  ASSERT_EQUAL(0xA, ws_next(&p, &payload, &len));
+  ASSERT_TRUE(len == 1 && payload[0] == 'p');
+  ASSERT_EQUAL(FORGE_WS_TEXT, ws_next(&p, &payload, &len));
+  ASSERT_TRUE(len == 13 && memcmp(payload, "fragmented \xc3\xa9", 13) == 0);
+  ASSERT_EQUAL(FORGE_WS_BINARY, ws_next(&p, &payload, &len));
+  ASSERT_TRUE(len == sizeof(big) && memcmp(payload, big, sizeof(big)) == 0);
+  ASSERT_EQUAL(0x8, ws_next(&p, &payload, &len));
+  ASSERT_TRUE(len == 2 && payload[0] == 0x03 && payload[1] == 0xe8);
+  ASSERT_EQUAL(total, (int)((const char *)p - resp));
+  ASSERT_EQUAL(1000, ws_closed_with);
+
+  /* Invalid UTF-8 and unmasked frames end with a close code */
+  n = strlen(handshake);
+  n += ws_frame(raw + n, 1, FORGE_WS_TEXT, "\xed\xa0\x80", 3);
+  ASSERT_TRUE((total = roundtrip_n(raw, n, resp, sizeof(resp))) > 0);
+  p = (const unsigned char *)strstr(resp, "\r\n\r\n") + 4;
+  ASSERT_EQUAL(0x8, ws_next(&p, &payload, &len));
+  ASSERT_TRUE(len == 2 && (payload[0] << 8 | payload[1]) == FORGE_WS_INVALID_DATA);
+
+  n = strlen(handshake);
+  memcpy(raw + n, "\x81\x02hi", 4);
+  ASSERT_TRUE(roundtrip_n(raw, n + 4, resp, sizeof(resp)) > 0);
+  p = (const unsigned char *)strstr(resp, "\r\n\r\n") + 4;
+  ASSERT_EQUAL(0x8, ws_next(&p, &payload, &len));
+  ASSERT_TRUE(len == 2 && (payload[0] << 8 | payload[1]) == FORGE_WS_PROTOCOL_ERROR);
+
+  /* A dropped connection is reported as abnormal */
+  ASSERT_TRUE(roundtrip(handshake, resp, sizeof(resp)) > 0);
+  ASSERT_EQUAL(FORGE_WS_ABNORMAL, ws_closed_with);
+
+  ASSERT_TRUE(roundtrip("GET /ws HTTP/1.1\r\nUpgrade: websocket\r\n"
+                        "Connection: Upgrade\r\nSec-WebSocket-Version: 8\r\n\r\n",
+                        resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 426 ", 13) == 0);
+  ASSERT_TRUE(strstr(resp, "\r\nSec-WebSocket-Version: 13\r\n") != NULL);
+
+  ASSERT_TRUE(roundtrip("GET /ws HTTP/1.1\r\nUpgrade: websocket\r\n"
+                        "Connection: Upgrade\r\nSec-WebSocket-Version: 13\r\n\r\n",
+                        resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 400 ", 13) == 0);
+}
+
+/* The close code the server answers a client's close frame with */
+static int ws_close_reply(const char *payload, size_t payload_len)
+{
+  static char raw[512];
+  static char resp[1024];
+  const char *handshake = "GET /ws HTTP/1.1\r\n"
+                          "Host: x\r\n"
+                          "Upgrade: websocket\r\n"
+                          "Connection: Upgrade\r\n"
+                          "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                          "Sec-WebSocket-Version: 13\r\n\r\n";
+
+  size_t n = strlen(handshake);
+  memcpy(raw, handshake, n);
+  n += ws_frame(raw + n, 1, 0x8, payload, payload_len);
+  if (roundtrip_n(raw, n, resp, sizeof(resp)) <= 0)
+    return -1;
+
+  const unsigned char *p = (const unsigned char *)strstr(resp, "\r\n\r\n") + 4;
+  const unsigned char *data;
+  size_t len;
+  if (ws_next(&p, &data, &len) != 0x8 || len < 2)
+    return -1;
+  return data[0] << 8 | data[1];
+}
+
+TEST(websocket_close_codes)
+{
+  /* Registered and private codes are echoed */
+  ASSERT_EQUAL(1001, ws_close_reply("\x03\xe9", 2));
+  ASSERT_EQUAL(1011, ws_close_reply("\x03\xf3" "bye", 5));
+  ASSERT_EQUAL(3000, ws_close_reply("\x0b\xb8", 2));
+  ASSERT_EQUAL(4999, ws_close_reply("\x13\x87", 2));
+
+  /* Reserved or unassigned codes are a protocol error */
+  static const int bad[] = {0, 999, 1004, 1005, 1006, 1015, 1016, 2999, 5000};
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+  {
+    char code[2] = {(char)(bad[i] >> 8), (char)bad[i]};
+    ASSERT_EQUAL(FORGE_WS_PROTOCOL_ERROR, ws_close_reply(code, 2));
+  }
+
+  /* The reason must be UTF-8 */
+  ASSERT_EQUAL(1000, ws_close_reply("\x03\xe8" "caf\xc3\xa9", 7));
+  ASSERT_EQUAL(FORGE_WS_INVALID_DATA, ws_close_reply("\x03\xe8\xc3\x28", 4));
+  ASSERT_EQUAL(FORGE_WS_INVALID_DATA, ws_close_reply("\x03\xe8\xed\xa0\x80", 5));
+}
+
+/* ---------------- Embedded Assets ---------------- */
+
+/* Generated from tests/assets by forge-embed (see the Makefile) */
+extern const ForgeEmbedTable test_assets;
+
+TEST(embedded_assets)
+{
+  static const char *paths[] = {"/", "/index.html", "/docs/", "/docs/index.html", "/app.js"};
+  for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++)
+  {
+    const ForgeEmbedAsset *a = forge_embed_find(&test_assets, paths[i], strlen(paths[i]));
+    ASSERT_TRUE(a != NULL);
+    ASSERT_STR_EQUAL(paths[i], a->path);
+  }
+  ASSERT_TRUE(forge_embed_find(&test_assets, "/docs", 5) == NULL);
+  ASSERT_TRUE(forge_embed_find(&test_assets, "/app.jsx", 8) == NULL);
+
+  const ForgeEmbedAsset *root = forge_embed_find(&test_assets, "/", 1);
+  const ForgeEmbedAsset *index = forge_embed_find(&test_assets, "/index.html", 11);
+  ASSERT_TRUE(root->identity.body == index->identity.body);
+  ASSERT_TRUE(index->gzip.body != NULL);
+  ASSERT_STR_EQUAL("text/html; charset=utf-8", index->content_type);
+
+  ASSERT_EQUAL(0, forge_embed_register(&test_assets));
+
+  char resp[4096];
+  int n = roundtrip("GET /app.js HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n", resp, sizeof(resp));
+  ASSERT_TRUE(n > 0);
+  ASSERT_TRUE(strstr(resp, "Content-Type: text/javascript; charset=utf-8\r\n") != NULL);
+  ASSERT_TRUE(strstr(resp, "Content-Encoding") == NULL);
+  ASSERT_TRUE(strstr(resp, "\r\n\r\ndocument.getElementById") != NULL);
+
+  /* gzip when offered, unless with q=0 */
+  n = roundtrip("GET / HTTP/1.1\r\nAccept-Encoding: br, gzip;q=0.8\r\n\r\n", resp, sizeof(resp));
+  const char *body = strstr(resp, "\r\n\r\n");
+  ASSERT_TRUE(body != NULL);
+  ASSERT_TRUE(strstr(resp, "Content-Encoding: gzip\r\n") != NULL);
+  ASSERT_TRUE(strstr(resp, "Vary: Accept-Encoding\r\n") != NULL);
+  ASSERT_EQUAL((int)index->gzip.body_len, n - (int)(body + 4 - resp));
+  ASSERT_TRUE(memcmp(body + 4, "\x1f\x8b", 2) == 0);
+
+  roundtrip("GET /index.html HTTP/1.1\r\nAccept-Encoding: gzip;q=0\r\n\r\n", resp, sizeof(resp));
+  ASSERT_TRUE(strstr(resp, "Content-Encoding") == NULL);
+  ASSERT_TRUE(strstr(resp, "<!doctype html>") != NULL);
+
+  /* Revalidation of the variant the client holds */
+  char raw[256];
+  snprintf(raw, sizeof(raw), "GET /index.html HTTP/1.1\r\nIf-None-Match: %s\r\n\r\n",
+           index->identity.etag);
+  roundtrip(raw, resp, sizeof(resp));
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 304 Not Modified\r\n", 27) == 0);
+  ASSERT_TRUE(strstr(resp, index->identity.etag) != NULL);
+}
+
+TEST(upload_content_length)
+{
+  char resp[2048];
+  ASSERT_TRUE(roundtrip("POST /api/upload HTTP/1.1\r\n"
+                        "Content-Length: 11\r\n\r\n"
+                        "hello world",
+                        resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "{\"received\":11}") != NULL);
+}
+
+TEST(upload_chunked)
+{
+  char resp[2048];
+  ASSERT_TRUE(roundtrip("POST /api/upload HTTP/1.1\r\n"
+                        "Transfer-Encoding: chunked\r\n\r\n"
+                        "5;name=value\r\nhello\r\n"
+                        "1\r\n \r\n"
+                        "A\r\n0123456789\r\n"
+                        "0\r\nX-Trailer: 1\r\n\r\n",
+                        resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "{\"received\":16}") != NULL);
+
+  ASSERT_TRUE(roundtrip("POST /api/upload HTTP/1.1\r\n"
+                        "Transfer-Encoding: chunked\r\n\r\n"
+                        "zz\r\nhello\r\n0\r\n\r\n",
+                        resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 400 ", 13) == 0);
+}
+
+/* ---------------- SHA-256 ---------------- */
+
+static void sha256_hex_of(const char *data, size_t len, size_t step, char out[65])
+{
+  ForgeSha256 ctx;
+  unsigned char hash[32];
+
+  forge_sha256_init(&ctx);
+  for (size_t i = 0; i < len; i += step)
+    forge_sha256_update(&ctx, data + i, len - i < step ? len - i : step);
+  forge_sha256_final(&ctx, hash);
+
+  for (int i = 0; i < 32; i++)
+    snprintf(out + i * 2, 3, "%02x", hash[i]);
+}
+
+TEST(sha256_incremental)
+{
+  static const char two_blocks[] =
+      "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  char hex[65];
+
+  /* FIPS 180-4 examples, in one update and split at every size */
+  sha256_hex_of("abc", 3, 3, hex);
+  ASSERT_TRUE(strcmp(hex, "ba7816bf8f01cfea414140de5dae2223"
+                          "b00361a396177a9cb410ff61f20015ad") == 0);
+
+  for (size_t step = 1; step <= sizeof(two_blocks); step++)
+  {
+    sha256_hex_of(two_blocks, sizeof(two_blocks) - 1, step, hex);
+    ASSERT_TRUE(strcmp(hex, "248d6a61d20638b8e5c026930c3e6039"
+                            "a33ce45964ff2167f6ecedd419db06c1") == 0);
+  }
+
+  sha256_hex_of("", 0, 1, hex);
+  ASSERT_TRUE(strcmp(hex, "e3b0c44298fc1c149afbf4c8996fb924"
+                          "27ae41e4649b934ca495991b7852b855") == 0);
+}
+
+/* ---------------- Multipart ---------------- */
+
+static const char form_body[] =
+    "preamble\r\n"
+    "--XyZ\r\n"
+    "Content-Disposition: form-data; name=\"meta\"\r\n"
+    "\r\n"
+    "{\"v\":1}\r\n"
+    "--XyZ\r\n"
+    "Content-Disposition: form-data; name=\"pkg\"; filename=\"a.tgz\"\r\n"
+    "Content-Type: application/gzip\r\n"
+    "\r\n"
+    "abc\r\n"
+    "--XyZ  \r\n"
+    "Content-Disposition: form-data; name=\"note\"\r\n"
+    "\r\n"
+    "x\r\n--XyQ\r\r\n"
+    "--XyZ--\r\n"
+    "epilogue";
+
+typedef struct
+{
+  char log[1024];
+  size_t len;
+  char spooled[256];
+} FormLog;
+
+static int form_begin(const ForgeMultipartPart *part, void *user)
+{
+  FormLog *f = user;
+  f->len += (size_t)snprintf(f->log + f->len, sizeof(f->log) - f->len, "[%s|%s|%s]",
+                             part->name, part->filename ? part->filename : "-",
+                             part->content_type);
+  return 0;
+}
+
+static int form_data(const ForgeMultipartPart *part, const char *data, size_t len, void *user)
+{
+  (void)part;
+  FormLog *f = user;
+  f->len += (size_t)snprintf(f->log + f->len, sizeof(f->log) - f->len, "%.*s", (int)len, data);
+  return 0;
+}
+
+static int form_end(const ForgeMultipartPart *part, void *user)
+{
+  FormLog *f = user;
+  f->len += (size_t)snprintf(f->log + f->len, sizeof(f->log) - f->len, "(%llu %02x%02x)",
+                             part->size, part->sha256[0], part->sha256[1]);
+  if (part->spool_path)
+    snprintf(f->spooled, sizeof(f->spooled), "%s", part->spool_path);
+  return 0;
+}
+
+TEST(multipart_split_anywhere)
+{
+  static const char type[] = "multipart/form-data; charset=utf-8; boundary=\"XyZ\"";
+  const ForgeMultipartHandler handler = {form_begin, form_data, form_end, NULL};
+  const char *expect = "[meta|-|]{\"v\":1}(7 afbf)"
+                       "[pkg|a.tgz|application/gzip]abc(3 ba78)"
+                       "[note|-|]x\r\n--XyQ\r(9 ";
+  size_t total = sizeof(form_body) - 1;
+
+  /* Every piece size, so the boundary lands across every edge */
+  for (size_t piece = 1; piece <= total; piece++)
+  {
+    FormLog f;
+    memset(&f, 0, sizeof(f));
+    ForgeMultipart *mp = forge_multipart_new(type, sizeof(type) - 1, &handler, &f);
+    ASSERT_TRUE(mp != NULL);
+
+    for (size_t off = 0; off < total; off += piece)
+      ASSERT_EQUAL(0, forge_multipart_feed(mp, form_body + off,
+                                           total - off < piece ? total - off : piece));
+    ASSERT_EQUAL(3, forge_multipart_finish(mp));
+    forge_multipart_free(mp);
+    ASSERT_TRUE(strncmp(f.log, expect, strlen(expect)) == 0);
+  }
+
+  /* Spooled file part: on disk, hashed, not passed to on_part_data */
+  const ForgeMultipartHandler spool = {form_begin, form_data, form_end, "/tmp"};
+  FormLog f;
+  memset(&f, 0, sizeof(f));
+  ForgeMultipart *mp = forge_multipart_new(type, sizeof(type) - 1, &spool, &f);
+  ASSERT_EQUAL(0, forge_multipart_feed(mp, form_body, total));
+  ASSERT_EQUAL(3, forge_multipart_finish(mp));
+  forge_multipart_free(mp);
+  ASSERT_TRUE(strstr(f.log, "[pkg|a.tgz|application/gzip](3 ba78)") != NULL);
+
+  FILE *in = fopen(f.spooled, "rb");
+  ASSERT_TRUE(in != NULL);
+  char content[16];
+  size_t n = fread(content, 1, sizeof(content), in);
+  fclose(in);
+  remove(f.spooled);
+  ASSERT_TRUE(n == 3 && memcmp(content, "abc", 3) == 0);
+
+  /* Truncated form, and not a multipart type */
+  mp = forge_multipart_new(type, sizeof(type) - 1, &handler, &f);
+  ASSERT_EQUAL(0, forge_multipart_feed(mp, form_body, 60));
+  ASSERT_EQUAL(FORGE_MULTIPART_MALFORMED, forge_multipart_finish(mp));
+  forge_multipart_free(mp);
+  ASSERT_TRUE(forge_multipart_new("text/plain", 10, &handler, &f) == NULL);
+}
+
+TEST(upload_multipart)
+{
+  char raw[1024];
+  char resp[2048];
+  snprintf(raw, sizeof(raw),
+           "POST /api/upload HTTP/1.1\r\n"
+           "Content-Type: multipart/form-data; boundary=XyZ\r\n"
+           "Content-Length: %zu\r\n\r\n%s",
+           sizeof(form_body) - 1, form_body);
+
+  ASSERT_TRUE(roundtrip(raw, resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "{\"received\":19,\"parts\":[") != NULL);
+  ASSERT_TRUE(strstr(resp, "{\"name\":\"pkg\",\"size\":3,\"sha256\":"
+                           "\"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad\"}") != NULL);
+}
+
+TEST(upload_too_large)
+{
+  char resp[2048];
+  ASSERT_TRUE(roundtrip("POST /api/upload HTTP/1.1\r\n"
+                        "Content-Length: 99999999999\r\n\r\n",
+                        resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 413 ", 13) == 0);
+}
+
+TEST(unix_listener)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/forge-test-%d.sock", (int)getpid());
+
+  ForgeServer server = create_forge_unix_server(path, 4);
+  ASSERT_TRUE(server.socket_fd < 0);
+  ASSERT_TRUE(server.unix_fd >= 0);
+
+  int client = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  ASSERT_EQUAL(0, connect(client, (struct sockaddr *)&addr, sizeof(addr)));
+
+  const char *raw = "GET /health HTTP/1.1\r\n\r\n";
+  ASSERT_TRUE(write(client, raw, strlen(raw)) > 0);
+  shutdown(client, SHUT_WR); /* end the keep-alive connection */
+
+  int conn = accept(server.unix_fd, NULL, NULL);
+  ASSERT_TRUE(conn >= 0);
+  handle_client(conn);
+
+  char resp[512];
+  ssize_t n = read(client, resp, sizeof(resp) - 1);
+  ASSERT_TRUE(n > 0);
+  resp[n] = '\0';
+  ASSERT_TRUE(strstr(resp, "200 OK") != NULL);
+  close(client);
+
+  /* A second instance must not take over a live endpoint */
+  ForgeServer second;
+  memset(&second, 0, sizeof(second));
+  second.unix_fd = -1;
+  second.backlog = 4;
+  ASSERT_EQUAL(-1, forge_server_listen_unix(&second, path));
+
+  close(server.unix_fd);
+  shutdown_server();
+  ASSERT_TRUE(access(path, F_OK) != 0);
+}
+
+TEST(access_log_binary_roundtrip)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/forge-test-%d.log", (int)getpid());
+  remove(path);
+
+  ASSERT_EQUAL(0, forge_access_log_open(path, FORGE_LOG_BINARY));
+
+  char resp[512];
+  ASSERT_TRUE(roundtrip("GET /health HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(roundtrip("GET /missing HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(roundtrip("GET /a%0d%0aX%22%5c HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  forge_access_log_close();
+  ASSERT_EQUAL(0, (int)forge_access_log_dropped());
+
+  FILE *in = fopen(path, "rb");
+  FILE *out = tmpfile();
+  ASSERT_TRUE(in && out);
+  ASSERT_EQUAL(3, (int)forge_access_log_decode(in, out));
+  fclose(in);
+  remove(path);
+
+  char text[512];
+  size_t n;
+  rewind(out);
+  n = fread(text, 1, sizeof(text) - 1, out);
+  text[n] = '\0';
+  fclose(out);
+
+  ASSERT_TRUE(strstr(text, "\"GET /health HTTP/1.0\" 200 ") != NULL);
+  ASSERT_TRUE(strstr(text, "\"GET /missing HTTP/1.1\" 404 ") != NULL);
+
+  /* Decoded control bytes cannot start a forged line */
+  ASSERT_TRUE(strstr(text, "\"GET /a\\x0D\\x0AX\\x22\\x5C HTTP/1.1\" 404 ") != NULL);
+}
+
+/* Backend for the proxy test: one connection at a time, each kept open */
+static void *proxy_backend(void *arg)
+{
+  int listen_fd = *(int *)arg;
+  while (1)
+  {
+    int conn = accept(listen_fd, NULL, NULL);
+    if (conn < 0)
+      return NULL;
+    handle_client(conn);
+  }
+}
+
+TEST(proxy_forwards_and_pools)
+{
+  static char resp[65536];
+  static char body[65536];
+
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQUAL(0, bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)));
+  ASSERT_EQUAL(0, listen(listen_fd, 4));
+  getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len);
+
+  /* Nothing listens on port 1: the first pick fails over */
+  char backend[32];
+  snprintf(backend, sizeof(backend), "127.0.0.1:%d", ntohs(addr.sin_port));
+  const char *upstreams[] = {"127.0.0.1:1", backend};
+  ForgeProxy *proxy = forge_proxy_create(upstreams, 2);
+  ASSERT_TRUE(proxy != NULL);
+
+  const char *dead[] = {"127.0.0.1:1"};
+  ForgeProxy *nowhere = forge_proxy_create(dead, 1);
+  ASSERT_TRUE(nowhere != NULL);
+  ASSERT_TRUE(forge_proxy_create(dead, 0) == NULL);
+
+  const char *bad[] = {"localhost"};
+  ASSERT_TRUE(forge_proxy_create(bad, 1) == NULL);
+
+  ASSERT_EQUAL(0, forge_proxy_route(proxy, "GET", "/px/version", "/api/version", 0));
+  ASSERT_EQUAL(0, forge_proxy_route(proxy, "POST", "/px/upload", "/api/upload", 0));
+  ASSERT_EQUAL(0, forge_proxy_route(proxy, "GET", "/json/big/px", "/json/big", 0));
+  ASSERT_EQUAL(0, forge_proxy_route(nowhere, "GET", "/px/down", NULL, 0));
+
+  /* Compile the routes before the backend thread resolves them too */
+  ASSERT_TRUE(roundtrip("GET /health HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+
+  pthread_t thread;
+  ASSERT_EQUAL(0, pthread_create(&thread, NULL, proxy_backend, &listen_fd));
+  pthread_detach(thread);
+
+  ASSERT_TRUE(roundtrip("GET /px/version HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 OK\r\n", 17) == 0);
+  ASSERT_TRUE(strstr(resp, "\"version\"") != NULL);
+
+  /* Chunked request body streamed through */
+  ASSERT_TRUE(roundtrip("POST /px/upload HTTP/1.1\r\n"
+                        "Transfer-Encoding: chunked\r\n\r\n"
+                        "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n",
+                        resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "{\"received\":11}") != NULL);
+
+  /* Chunked response relayed chunk by chunk */
+  ASSERT_TRUE(roundtrip("GET /json/big/px HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\r\nTransfer-Encoding: chunked\r\n") != NULL);
+  ASSERT_EQUAL(1000 * 46 + 1, (int)dechunk(strstr(resp, "\r\n\r\n") + 4,
+                                           body, sizeof(body)));
+
+  /* HTTP/1.0 client: the same body, delimited by close */
+  ASSERT_TRUE(roundtrip("GET /json/big/px HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\r\nConnection: close\r\n") != NULL);
+  ASSERT_EQUAL(1000 * 46 + 1, (int)strlen(strstr(resp, "\r\n\r\n") + 4));
+
+  /* More header than the forwarded head can hold: refused, not truncated */
+  static char big[16384];
+  int big_len = snprintf(big, sizeof(big), "GET /px/version HTTP/1.1\r\nX-Big: ");
+  memset(big + big_len, 'a', 12000);
+  memcpy(big + big_len + 12000, "\r\n\r\n", 5);
+  ASSERT_TRUE(roundtrip(big, resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 431 ", 13) == 0);
+
+  ForgeUpstreamStats st;
+  ASSERT_EQUAL(0, forge_proxy_stats(proxy, 0, &st));
+  ASSERT_TRUE(st.connect_failures <= 1);
+  ASSERT_EQUAL(0, (int)st.requests);
+  ASSERT_EQUAL(0, forge_proxy_stats(proxy, 1, &st));
+  ASSERT_EQUAL(5, (int)st.requests);
+  ASSERT_EQUAL(4, (int)st.reused);
+  ASSERT_EQUAL(0, (int)st.outstanding);
+  ASSERT_EQUAL(-1, forge_proxy_stats(proxy, 2, &st));
+
+  ASSERT_TRUE(roundtrip("GET /px/down HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 502 ", 13) == 0);
+  ASSERT_EQUAL(0, forge_proxy_stats(nowhere, 0, &st));
+  ASSERT_EQUAL(1, (int)st.connect_failures);
+}
+
+/* Backend answering the first request per connection; it drops the second unanswered */
+static _Atomic int dropper_requests;
+
+static void *proxy_dropper(void *arg)
+{
+  int listen_fd = *(int *)arg;
+  static const char ok[] = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+  char buf[4096];
+  while (1)
+  {
+    int conn = accept(listen_fd, NULL, NULL);
+    if (conn < 0)
+      return NULL;
+    if (recv(conn, buf, sizeof(buf), 0) > 0)
+    {
+      atomic_fetch_add(&dropper_requests, 1);
+      if (write(conn, ok, sizeof(ok) - 1) > 0 && recv(conn, buf, sizeof(buf), 0) > 0)
+        atomic_fetch_add(&dropper_requests, 1);
+    }
+    close(conn);
+  }
+}
+
+TEST(proxy_no_replay)
+{
+  static char resp[4096];
+
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQUAL(0, bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)));
+  ASSERT_EQUAL(0, listen(listen_fd, 4));
+  getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len);
+
+  char backend[32];
+  snprintf(backend, sizeof(backend), "127.0.0.1:%d", ntohs(addr.sin_port));
+  const char *upstreams[] = {backend};
+  ForgeProxy *proxy = forge_proxy_create(upstreams, 1);
+  ASSERT_TRUE(proxy != NULL);
+  ASSERT_EQUAL(0, forge_proxy_route(proxy, "POST", "/px/drop", NULL, 0));
+  ASSERT_EQUAL(0, forge_proxy_route(proxy, "GET", "/px/drop", NULL, 0));
+
+  pthread_t thread;
+  ASSERT_EQUAL(0, pthread_create(&thread, NULL, proxy_dropper, &listen_fd));
+  pthread_detach(thread);
+
+  ASSERT_TRUE(roundtrip("GET /px/drop HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 OK\r\n", 17) == 0);
+  ASSERT_EQUAL(1, atomic_load(&dropper_requests));
+
+  /* Not idempotent: the backend may have acted on it, so no replay */
+  ASSERT_TRUE(roundtrip("POST /px/drop HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 502 ", 13) == 0);
+  ASSERT_EQUAL(2, atomic_load(&dropper_requests));
+
+  ASSERT_TRUE(roundtrip("GET /px/drop HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 OK\r\n", 17) == 0);
+  ASSERT_EQUAL(3, atomic_load(&dropper_requests));
+
+  /* Idempotent over a pooled connection that died: sent again fresh */
+  ASSERT_TRUE(roundtrip("GET /px/drop HTTP/1.1\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 OK\r\n", 17) == 0);
+  ASSERT_EQUAL(5, atomic_load(&dropper_requests));
+}
+
+/* ---------------- Pre-fork Workers ---------------- */
+
+static void handle_worker_id(const ForgeHttpRequest *req, int client_socket)
+{
+  (void)req;
+  char body[16];
+  snprintf(body, sizeof(body), "%d", forge_worker_id());
+  forge_send_text(client_socket, "200 OK", body);
+}
+
+static void handle_worker_crash(const ForgeHttpRequest *req, int client_socket)
+{
+  (void)req;
+  (void)client_socket;
+  _exit(3);
+}
+
+/* One request on a fresh connection; the response until close */
+static int http_get(const struct sockaddr_in *addr, const char *path, char *out, size_t cap)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct timeval tv = {5, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) != 0)
+  {
+    close(fd);
+    return -1;
+  }
+
+  char raw[256];
+  int raw_len = snprintf(raw, sizeof(raw), "GET %s HTTP/1.1\r\nConnection: close\r\n\r\n", path);
+  size_t len = 0;
+  ssize_t n = write(fd, raw, (size_t)raw_len);
+  while (n > 0 && len + 1 < cap && (n = read(fd, out + len, cap - 1 - len)) > 0)
+    len += (size_t)n;
+  out[len] = '\0';
+  close(fd);
+  return (int)len;
+}
+
+TEST(prefork_workers)
+{
+  static char resp[8192];
+
+  ASSERT_EQUAL(-1, forge_worker_id());
+  ASSERT_EQUAL(0, forge_router_add("GET", "/worker/id", handle_worker_id));
+  ASSERT_EQUAL(0, forge_router_add("GET", "/worker/crash", handle_worker_crash));
+
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  ForgeServer server;
+  memset(&server, 0, sizeof(server));
+  server.unix_fd = -1;
+  server.backlog = 16;
+  server.socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQUAL(0, bind(server.socket_fd, (struct sockaddr *)&addr, sizeof(addr)));
+  ASSERT_EQUAL(0, listen(server.socket_fd, 16));
+  getsockname(server.socket_fd, (struct sockaddr *)&addr, &addr_len);
+
+  /* Probes get a listener and thread of their own in every worker */
+  ASSERT_EQUAL(-1, forge_route_priority("GET", "/worker/id", 7));
+  ASSERT_EQUAL(0, forge_route_priority("GET", "/worker/id", FORGE_PRIORITY_HIGH));
+  struct sockaddr_in control = addr;
+  int control_port = forge_server_listen_control(&server, 0);
+  ASSERT_TRUE(control_port > 0);
+  control.sin_port = htons((uint16_t)control_port);
+
+  fflush(stdout);
+  pid_t master = fork();
+  ASSERT_TRUE(master >= 0);
+  if (master == 0)
+    launch_server_workers(&server, 2);
+  close(server.socket_fd);
+
+  ASSERT_TRUE(http_get(&control, "/health", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 OK\r\n", 17) == 0);
+  ASSERT_TRUE(strstr(resp, "\r\nConnection: close\r\n") != NULL);
+  ASSERT_TRUE(http_get(&control, "/worker/id", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 OK\r\n", 17) == 0);
+
+  /* Normal routes are not served on the control lane */
+  ASSERT_TRUE(http_get(&control, "/worker/crash", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 404 ", 13) == 0);
+
+  for (int i = 0; i < 4; i++)
+  {
+    ASSERT_TRUE(http_get(&addr, "/worker/id", resp, sizeof(resp)) > 0);
+    const char *body = strstr(resp, "\r\n\r\n");
+    ASSERT_TRUE(body != NULL);
+    ASSERT_TRUE(strcmp(body + 4, "0") == 0 || strcmp(body + 4, "1") == 0);
+  }
+
+  /* A dead worker is replaced; the survivor keeps serving meanwhile */
+  ASSERT_EQUAL(0, http_get(&addr, "/worker/crash", resp, sizeof(resp)));
+  int restarted = 0;
+  for (int tries = 0; tries < 50 && !restarted; tries++)
+  {
+    usleep(100000);
+    ASSERT_TRUE(http_get(&addr, "/metrics", resp, sizeof(resp)) > 0);
+    restarted = strstr(resp, "\nforge_worker_restarts_total 1\n") != NULL;
+  }
+  ASSERT_TRUE(restarted);
+  ASSERT_TRUE(strstr(resp, "\nforge_workers 2\n") != NULL);
+
+  /* Counters summed over both processes, the crashed one included */
+  const char *total = strstr(resp, "\nforge_requests_total ");
+  ASSERT_TRUE(total != NULL);
+  ASSERT_TRUE(atoi(total + 22) >= 5);
+
+  ASSERT_EQUAL(0, kill(master, SIGTERM));
+  int status = 0;
+  ASSERT_EQUAL(master, waitpid(master, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+static void handle_worker_cpu(const ForgeHttpRequest *req, int client_socket)
+{
+  (void)req;
+  char body[16];
+  snprintf(body, sizeof(body), "%d", sched_getcpu());
+  forge_send_text(client_socket, "200 OK", body);
+}
+
+TEST(cpu_placement)
+{
+  static char resp[8192];
+  int cpus[8];
+
+  ASSERT_EQUAL(6, forge_parse_cpu_list("0-3,8,10", cpus, 8));
+  ASSERT_EQUAL(3, cpus[3]);
+  ASSERT_EQUAL(10, cpus[5]);
+  ASSERT_EQUAL(-1, forge_parse_cpu_list("0-9", cpus, 8));
+  ASSERT_EQUAL(-1, forge_parse_cpu_list("3-1", cpus, 8));
+  ASSERT_EQUAL(-1, forge_parse_cpu_list("1,x", cpus, 8));
+  ASSERT_EQUAL(-1, forge_parse_cpu_list("", cpus, 8));
+
+  cpu_set_t allowed;
+  ASSERT_EQUAL(0, sched_getaffinity(0, sizeof(allowed), &allowed));
+  int cpu = 0;
+  while (!CPU_ISSET(cpu, &allowed))
+    cpu++;
+
+  ASSERT_EQUAL(0, forge_router_add("GET", "/worker/cpu", handle_worker_cpu));
+
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  /* A reuseport group, so each worker gets a listener of its own */
+  ForgeServer server;
+  memset(&server, 0, sizeof(server));
+  server.unix_fd = -1;
+  server.backlog = 16;
+  server.socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(server.socket_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+  ASSERT_EQUAL(0, bind(server.socket_fd, (struct sockaddr *)&addr, sizeof(addr)));
+  getsockname(server.socket_fd, (struct sockaddr *)&addr, &addr_len);
+  server.address = addr;
+  ASSERT_EQUAL(0, listen(server.socket_fd, 16));
+
+  fflush(stdout);
+  pid_t master = fork();
+  ASSERT_TRUE(master >= 0);
+  if (master == 0)
+  {
+    /* Placement is process state: set it where the workers come from */
+    if (forge_server_pin_cpus(&cpu, 1) != 0 || forge_server_steer_connections(1) != 0)
+      _exit(EXIT_FAILURE);
+    launch_server_workers(&server, 2);
+  }
+  close(server.socket_fd);
+
+  /* Both workers sit on the one CPU, whichever gets the connection */
+  char want[16];
+  snprintf(want, sizeof(want), "%d", cpu);
+  for (int i = 0; i < 4; i++)
+  {
+    ASSERT_TRUE(http_get(&addr, "/worker/cpu", resp, sizeof(resp)) > 0);
+    const char *body = strstr(resp, "\r\n\r\n");
+    ASSERT_TRUE(body != NULL);
+    ASSERT_TRUE(strcmp(body + 4, want) == 0);
+  }
+
+  ASSERT_TRUE(http_get(&addr, "/metrics", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\nforge_connections_off_cpu_total ") != NULL);
+
+  ASSERT_EQUAL(0, kill(master, SIGTERM));
+  int status = 0;
+  ASSERT_EQUAL(master, waitpid(master, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+static int reload_builds;
+static int reload_fail;
+
+static void handle_reload_build(const ForgeHttpRequest *req, int client_socket)
+{
+  (void)req;
+  char body[16];
+  snprintf(body, sizeof(body), "%d", reload_builds);
+  forge_send_text(client_socket, "200 OK", body);
+}
+
+/* Handler data that changes with every build */
+static ForgeProxy *reload_proxy;
+static ForgeSseTopic *reload_topics[2];
+
+static const ForgeEmbedAsset reload_assets[2] = {
+    {"/reload/asset", "text/plain",
+     {"HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 4\r\n", 62,
+      "", 0, (const unsigned char *)"even", 4, "\"e\""},
+     {NULL, 0, NULL, 0, NULL, 0, NULL}},
+    {"/reload/asset", "text/plain",
+     {"HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 3\r\n", 62,
+      "", 0, (const unsigned char *)"odd", 3, "\"o\""},
+     {NULL, 0, NULL, 0, NULL, 0, NULL}},
+};
+static const ForgeEmbedTable reload_tables[2] = {
+    {&reload_assets[0], 1, NULL, 0},
+    {&reload_assets[1], 1, NULL, 0},
+};
+
+/* Odd builds serve /reload/odd, even ones /reload/even */
+static int build_reload_routes(void *arg)
+{
+  (void)arg;
+  if (reload_fail)
+    return -1;
+  reload_builds++;
+
+  int odd = reload_builds % 2;
+  if (forge_ws_route("/reload/ws", &ws_echo_handler) != 0 ||
+      forge_sse_route("/reload/events", reload_topics[odd]) != 0 ||
+      forge_embed_register(&reload_tables[odd]) != 0 ||
+      forge_proxy_route(reload_proxy, "GET", "/reload/px", odd ? "/odd" : "/even", 0) != 0)
+    return -1;
+  return forge_router_add("GET", odd ? "/reload/odd" : "/reload/even",
+                          handle_reload_build);
+}
+
+/* Backend answering each connection with the target it was asked for */
+static void *path_backend(void *arg)
+{
+  int listen_fd = *(int *)arg;
+  char buf[4096];
+  while (1)
+  {
+    int conn = accept(listen_fd, NULL, NULL);
+    if (conn < 0)
+      return NULL;
+    ssize_t n = recv(conn, buf, sizeof(buf) - 1, 0);
+    if (n > 0)
+    {
+      buf[n] = '\0';
+      char *target = strchr(buf, ' ');
+      char *end = target ? strchr(target + 1, ' ') : NULL;
+      if (end)
+      {
+        char resp[256];
+        int len = snprintf(resp, sizeof(resp),
+                           "HTTP/1.1 200 OK\r\nConnection: close\r\n"
+                           "Content-Length: %d\r\n\r\n%.*s",
+                           (int)(end - target - 1), (int)(end - target - 1), target + 1);
+        if (write(conn, resp, (size_t)len) < 0)
+          perror("write");
+      }
+    }
+    close(conn);
+  }
+}
+
+static atomic_int reload_bad;
+
+static void *reload_reader(void *arg)
+{
+  (void)arg;
+  char resp[1024];
+  for (int i = 0; i < 300; i++)
+  {
+    const char *raw = i % 2 ? "GET /reload/odd HTTP/1.0\r\n\r\n"
+                            : "GET /reload/even HTTP/1.0\r\n\r\n";
+    if (roundtrip(raw, resp, sizeof(resp)) <= 0 ||
+        (strncmp(resp, "HTTP/1.1 200 ", 13) != 0 && strncmp(resp, "HTTP/1.1 404 ", 13) != 0))
+      atomic_fetch_add(&reload_bad, 1);
+  }
+  return NULL;
+}
+
+TEST(route_table_reload)
+{
+  static char resp[4096];
+
+  static int listen_fd;
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQUAL(0, bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)));
+  ASSERT_EQUAL(0, listen(listen_fd, 4));
+  getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len);
+
+  char backend[32];
+  snprintf(backend, sizeof(backend), "127.0.0.1:%d", ntohs(addr.sin_port));
+  const char *upstreams[] = {backend};
+  reload_proxy = forge_proxy_create(upstreams, 1);
+  ASSERT_TRUE(reload_proxy != NULL);
+  reload_topics[0] = forge_sse_topic(FORGE_SSE_DROP, 0);
+  reload_topics[1] = forge_sse_topic(FORGE_SSE_DROP, 0);
+  ASSERT_TRUE(reload_topics[0] && reload_topics[1]);
+
+  pthread_t backend_thread;
+  ASSERT_EQUAL(0, pthread_create(&backend_thread, NULL, path_backend, &listen_fd));
+  pthread_detach(backend_thread);
+
+  /* Registered before forge_router_on_reload(): kept by every reload */
+  ASSERT_EQUAL(0, forge_router_add("POST", "/reload/now", forge_handle_reload));
+  ASSERT_EQUAL(-1, forge_router_on_reload(NULL, NULL));
+  ASSERT_EQUAL(0, forge_router_on_reload(build_reload_routes, NULL));
+  ASSERT_EQUAL(1, reload_builds);
+
+  ASSERT_TRUE(roundtrip("GET /reload/odd HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 ", 13) == 0);
+  ASSERT_TRUE(roundtrip("GET /reload/even HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 404 ", 13) == 0);
+  ASSERT_TRUE(roundtrip("GET /reload/asset HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\r\n\r\nodd") != NULL);
+  ASSERT_TRUE(roundtrip("GET /reload/px HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\r\n\r\n/odd") != NULL);
+
+  /* The rebuilt layer replaces the old one; the rest stays */
+  ASSERT_EQUAL(0, forge_router_reload());
+  ASSERT_TRUE(roundtrip("GET /reload/even HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 ", 13) == 0);
+  ASSERT_TRUE(strstr(resp, "\r\n\r\n2") != NULL);
+  ASSERT_TRUE(roundtrip("GET /reload/odd HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 404 ", 13) == 0);
+  ASSERT_TRUE(roundtrip("GET /health HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 ", 13) == 0);
+
+  /* Handler data is re-pointed with the table, not first-match */
+  ASSERT_TRUE(roundtrip("GET /reload/asset HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\r\n\r\neven") != NULL);
+  ASSERT_TRUE(roundtrip("GET /reload/px HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, "\r\n\r\n/even") != NULL);
+
+  /* A failed build keeps the previous routes and table */
+  reload_fail = 1;
+  ASSERT_EQUAL(-1, forge_router_reload());
+  reload_fail = 0;
+  ASSERT_TRUE(roundtrip("GET /reload/even HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 ", 13) == 0);
+
+  /* Reloading from inside a request: its own table outlives the swap */
+  ASSERT_TRUE(roundtrip("POST /reload/now HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 ", 13) == 0);
+  ASSERT_TRUE(roundtrip("GET /reload/odd HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strncmp(resp, "HTTP/1.1 200 ", 13) == 0);
+
+  /* Readers on other threads keep dispatching through the swaps */
+  pthread_t threads[2];
+  for (int i = 0; i < 2; i++)
+    ASSERT_EQUAL(0, pthread_create(&threads[i], NULL, reload_reader, NULL));
+  int published = 0;
+  for (int i = 0; i < 100; i++)
+  {
+    published += forge_router_reload() == 0;
+    sched_yield();
+  }
+  for (int i = 0; i < 2; i++)
+    pthread_join(threads[i], NULL);
+  ASSERT_EQUAL(0, atomic_load(&reload_bad));
+  ASSERT_TRUE(published > 0);
+
+  /* Every build registered the same routes again: none ran out of room */
+  ASSERT_TRUE(reload_builds > 64);
+  ASSERT_EQUAL(0, forge_router_reload());
+  ASSERT_TRUE(roundtrip("GET /reload/px HTTP/1.0\r\n\r\n", resp, sizeof(resp)) > 0);
+  ASSERT_TRUE(strstr(resp, reload_builds % 2 ? "\r\n\r\n/odd" : "\r\n\r\n/even") != NULL);
+}
+
+static void *sse_server(void *arg)
+{
+  launch_server(arg); /* never returns: the loop outlives the test */
+  return NULL;
+}
+
+/* Read from `fd` until `needle` shows up in `buf`; 0 on timeout */
+static int read_until(int fd, char *buf, size_t cap, size_t *len, const char *needle)
+{
+  while (!strstr(buf, needle))
+  {
+    ssize_t n = read(fd, buf + *len, cap - 1 - *len);
+    if (n <= 0)
+      return 0;
+    *len += (size_t)n;
+    buf[*len] = '\0';
+  }
+  return 1;
+}
+
+/* Address of the event loop sse_fanout leaves running */
+static struct sockaddr_in loop_addr;
+
+TEST(sse_fanout)
+{
+  static ForgeServer server;
+  static char buf[8192];
+  size_t len = 0;
+
+  ForgeSseTopic *topic = forge_sse_topic(FORGE_SSE_DROP, 0);
+  ASSERT_TRUE(topic != NULL);
+  ASSERT_TRUE(forge_sse_topic(7, 0) == NULL);
+  ASSERT_EQUAL(0, forge_sse_route("/events", topic));
+  forge_sse_set_heartbeat(1);
+
+  /* Outside the event loop streams are refused */
+  ASSERT_TRUE(roundtrip("GET /events HTTP/1.1\r\n\r\n", buf, sizeof(buf)) > 0);
+  ASSERT_TRUE(strncmp(buf, "HTTP/1.1 400 ", 13) == 0);
+
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  memset(&server, 0, sizeof(server));
+  server.unix_fd = -1;
+  server.socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQUAL(0, bind(server.socket_fd, (struct sockaddr *)&addr, sizeof(addr)));
+  ASSERT_EQUAL(0, listen(server.socket_fd, 64));
+  getsockname(server.socket_fd, (struct sockaddr *)&addr, &addr_len);
+  loop_addr = addr;
+
+  pthread_t thread;
+  ASSERT_EQUAL(0, pthread_create(&thread, NULL, sse_server, &server));
+  pthread_detach(thread);
+
+  int subs[2];
+  for (int i = 0; i < 2; i++)
+  {
+    subs[i] = socket(AF_INET, SOCK_STREAM, 0);
+    struct timeval tv = {5, 0};
+    setsockopt(subs[i], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ASSERT_EQUAL(0, connect(subs[i], (struct sockaddr *)&addr, sizeof(addr)));
+
+    const char *raw = "GET /events HTTP/1.1\r\nHost: t\r\n\r\n";
+    ASSERT_TRUE(write(subs[i], raw, strlen(raw)) > 0);
+
+    len = 0;
+    buf[0] = '\0';
+    ASSERT_TRUE(read_until(subs[i], buf, sizeof(buf), &len, "\r\n\r\n"));
+    ASSERT_TRUE(strncmp(buf, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    ASSERT_TRUE(strstr(buf, "text/event-stream") != NULL);
+    ASSERT_TRUE(strstr(buf, "Transfer-Encoding: chunked") != NULL);
+    ASSERT_TRUE(strstr(buf, "Cache-Control: no-cache") != NULL);
+  }
+
+  ForgeSseStats st;
+  forge_sse_stats(topic, &st);
+  ASSERT_EQUAL(2, (int)st.subscribers);
+
+  /* One event, two lines, framed as one chunk on both streams */
+  ASSERT_EQUAL(0, forge_sse_publish(topic, "tick", "a\r\nb", 4));
+  ASSERT_EQUAL(-1, forge_sse_publish(topic, "bad\nname", "x", 1));
+  for (int i = 0; i < 2; i++)
+  {
+    len = 0;
+    buf[0] = '\0';
+    ASSERT_TRUE(read_until(subs[i], buf, sizeof(buf), &len, "\n\n\r\n"));
+    ASSERT_STR_EQUAL("1d\r\nevent: tick\ndata: a\ndata: b\n\n\r\n", buf);
+  }
+
+  /* Idle streams get a comment from the heartbeat timer */
+  len = 0;
+  buf[0] = '\0';
+  ASSERT_TRUE(read_until(subs[0], buf, sizeof(buf), &len, "3\r\n:\n\n\r\n"));
+
+  close(subs[1]);
+  for (int tries = 0; tries < 200; tries++)
+  {
+    forge_sse_stats(NULL, &st);
+    if (st.subscribers == 1)
+      break;
+    usleep(10000);
+  }
+  ASSERT_EQUAL(1, (int)st.subscribers);
+  ASSERT_EQUAL(1, (int)st.published);
+  ASSERT_EQUAL(0, (int)st.dropped);
+  close(subs[0]);
+}
+
+static int loop_connect(void)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct timeval tv = {5, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  if (connect(fd, (struct sockaddr *)&loop_addr, sizeof(loop_addr)) != 0)
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+TEST(loop_partial_requests)
+{
+  static char buf[8192];
+  size_t len = 0;
+  buf[0] = '\0';
+
+  /* A head that never completes holds nobody else up */
+  int slow = loop_connect();
+  ASSERT_TRUE(slow >= 0);
+  ASSERT_TRUE(write(slow, "GET /health HTTP/1.1\r\nHo", 24) == 24);
+
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  int fast = loop_connect();
+  ASSERT_TRUE(fast >= 0);
+  const char *raw = "GET /health HTTP/1.1\r\nConnection: close\r\n\r\n";
+  ASSERT_TRUE(write(fast, raw, strlen(raw)) > 0);
+  ASSERT_TRUE(read_until(fast, buf, sizeof(buf), &len, "\r\n\r\n"));
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  ASSERT_TRUE(strncmp(buf, "HTTP/1.1 200 OK\r\n", 17) == 0);
+  ASSERT_TRUE(t1.tv_sec - t0.tv_sec < 2);
+  close(fast);
+
+  /* A body arriving in pieces is staged, past the largest buffer tier */
+  int up = loop_connect();
+  ASSERT_TRUE(up >= 0);
+  raw = "POST /api/upload HTTP/1.1\r\nContent-Length: 200000\r\n\r\n";
+  ASSERT_TRUE(write(up, raw, strlen(raw)) > 0);
+  memset(buf, 'x', sizeof(buf));
+  for (int sent = 0; sent < 200000;)
+  {
+    int n = 200000 - sent < 8000 ? 200000 - sent : 8000;
+    ASSERT_TRUE(write(up, buf, (size_t)n) == n);
+    sent += n;
+    if (sent % 40000 == 0)
+      usleep(10000);
+  }
+  len = 0;
+  buf[0] = '\0';
+  ASSERT_TRUE(read_until(up, buf, sizeof(buf), &len, "}"));
+  ASSERT_TRUE(strstr(buf, "{\"received\":200000}") != NULL);
+
+  /* Chunked, split inside a chunk-size line, on the same connection */
+  raw = "POST /api/upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n1";
+  ASSERT_TRUE(write(up, raw, strlen(raw)) > 0);
+  usleep(20000);
+  raw = "0\r\n0123456789abcdef\r\n0\r\n\r\n";
+  ASSERT_TRUE(write(up, raw, strlen(raw)) > 0);
+  len = 0;
+  buf[0] = '\0';
+  ASSERT_TRUE(read_until(up, buf, sizeof(buf), &len, "}"));
+  ASSERT_TRUE(strstr(buf, "{\"received\":16}") != NULL);
+
+  close(up);
+  close(slow);
+}
+
+/* Backend answering every request after half a second, a thread per connection */
+static void *slow_backend_conn(void *arg)
+{
+  int conn = (int)(intptr_t)arg;
+  static const char ok[] = "HTTP/1.1 200 OK\r\nContent-Length: 4\r\n\r\nslow";
+  char buf[4096];
+  while (recv(conn, buf, sizeof(buf), 0) > 0)
+  {
+    usleep(500000);
+    if (write(conn, ok, sizeof(ok) - 1) < 0)
+      break;
+  }
+  close(conn);
+  return NULL;
+}
+
+static void *slow_backend(void *arg)
+{
+  int listen_fd = *(int *)arg;
+  while (1)
+  {
+    int conn = accept(listen_fd, NULL, NULL);
+    if (conn < 0)
+      return NULL;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, slow_backend_conn, (void *)(intptr_t)conn) == 0)
+      pthread_detach(thread);
+    else
+      close(conn);
+  }
+}
+
+static double elapsed_ms(const struct timespec *t0)
+{
+  struct timespec t1;
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  return (double)(t1.tv_sec - t0->tv_sec) * 1e3 + (double)(t1.tv_nsec - t0->tv_nsec) / 1e6;
+}
+
+TEST(loop_proxy_parks)
+{
+  static char buf[8192];
+  static int listen_fd;
+  size_t len = 0;
+
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQUAL(0, bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)));
+  ASSERT_EQUAL(0, listen(listen_fd, 64));
+  getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len);
+
+  char backend[32];
+  snprintf(backend, sizeof(backend), "127.0.0.1:%d", ntohs(addr.sin_port));
+  const char *upstreams[] = {backend};
+  ForgeProxy *proxy = forge_proxy_create(upstreams, 1);
+  ASSERT_TRUE(proxy != NULL);
+  ASSERT_EQUAL(0, forge_proxy_route(proxy, "GET", "/px/slow", NULL, 0));
+
+  pthread_t thread;
+  ASSERT_EQUAL(0, pthread_create(&thread, NULL, slow_backend, &listen_fd));
+  pthread_detach(thread);
+
+  /* The loop keeps serving while a proxied request waits on its backend */
+  int px = loop_connect();
+  ASSERT_TRUE(px >= 0);
+  const char *raw = "GET /px/slow HTTP/1.1\r\n\r\n";
+  ASSERT_TRUE(write(px, raw, strlen(raw)) > 0);
+  usleep(50000);
+
+  struct timespec t0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  int fast = loop_connect();
+  ASSERT_TRUE(fast >= 0);
+  raw = "GET /health HTTP/1.1\r\nConnection: close\r\n\r\n";
+  ASSERT_TRUE(write(fast, raw, strlen(raw)) > 0);
+  buf[0] = '\0';
+  ASSERT_TRUE(read_until(fast, buf, sizeof(buf), &len, "\r\n\r\n"));
+  ASSERT_TRUE(elapsed_ms(&t0) < 300);
+  close(fast);
+
+  len = 0;
+  buf[0] = '\0';
+  ASSERT_TRUE(read_until(px, buf, sizeof(buf), &len, "slow"));
+  ASSERT_TRUE(strncmp(buf, "HTTP/1.1 200 OK\r\n", 17) == 0);
+
+  /* Resumed connections carry on with the next request */
+  raw = "GET /health HTTP/1.1\r\n\r\n";
+  ASSERT_TRUE(write(px, raw, strlen(raw)) > 0);
+  len = 0;
+  buf[0] = '\0';
+  ASSERT_TRUE(read_until(px, buf, sizeof(buf), &len, "OK\n"));
+  ASSERT_TRUE(strncmp(buf, "HTTP/1.1 200 OK\r\n", 17) == 0);
+  close(px);
+
+  /* HTTP/2: the proxied stream parks, the one behind it is answered first */
+  static uint8_t req[512];
+  size_t n = FORGE_H2_PREFACE_LEN;
+  memcpy(req, FORGE_H2_PREFACE, n);
+  ForgeH2Frame f = {0, FORGE_H2_SETTINGS, 0, 0};
+  forge_h2_pack_frame(req + n, &f);
+  n += FORGE_H2_FRAME_HEADER;
+
+  const char *paths[] = {"/px/slow", "/health"};
+  for (int i = 0; i < 2; i++)
+  {
+    ForgeHpackTable enc;
+    forge_hpack_init(&enc, FORGE_HPACK_DEFAULT_TABLE);
+    uint8_t block[128];
+    long blen = 0;
+    blen += forge_hpack_encode(&enc, block + blen, sizeof(block) - (size_t)blen,
+                               ":method", "GET", 3, FORGE_HPACK_NO_INDEX);
+    blen += forge_hpack_encode(&enc, block + blen, sizeof(block) - (size_t)blen,
+                               ":scheme", "http", 4, FORGE_HPACK_NO_INDEX);
+    blen += forge_hpack_encode(&enc, block + blen, sizeof(block) - (size_t)blen,
+                               ":path", paths[i], strlen(paths[i]), FORGE_HPACK_NO_INDEX);
+    forge_hpack_free(&enc);
+
+    ForgeH2Frame h = {(uint32_t)blen, FORGE_H2_HEADERS,
+                      FORGE_H2_FLAG_END_HEADERS | FORGE_H2_FLAG_END_STREAM,
+                      (uint32_t)(1 + 2 * i)};
+    forge_h2_pack_frame(req + n, &h);
+    memcpy(req + n + FORGE_H2_FRAME_HEADER, block, (size_t)blen);
+    n += FORGE_H2_FRAME_HEADER + (size_t)blen;
+  }
+
+  int h2 = loop_connect();
+  ASSERT_TRUE(h2 >= 0);
+  ASSERT_TRUE(write(h2, req, n) == (ssize_t)n);
+
+  static uint8_t out[8192];
+  size_t total = 0, pos = 0;
+  uint32_t first_data = 0;
+  char body[16] = {0};
+  while (!body[0])
+  {
+    ssize_t got = read(h2, out + total, sizeof(out) - total);
+    ASSERT_TRUE(got > 0);
+    total += (size_t)got;
+
+    while (pos + FORGE_H2_FRAME_HEADER <= total)
+    {
+      forge_h2_unpack_frame(out + pos, &f);
+      if (pos + FORGE_H2_FRAME_HEADER + f.length > total)
+        break;
+      if (f.type == FORGE_H2_DATA && !first_data)
+        first_data = f.stream_id;
+      if (f.type == FORGE_H2_DATA && f.stream_id == 1 && f.length < sizeof(body))
+        memcpy(body, out + pos + FORGE_H2_FRAME_HEADER, f.length);
+      pos += FORGE_H2_FRAME_HEADER + f.length;
+    }
+  }
+  ASSERT_EQUAL(3, (int)first_data);
+  ASSERT_STR_EQUAL(body, "slow");
+  close(h2);
+
+  /* More slow requests than the old fixed pool had threads: all wait at once */
+  int fds[24];
+  struct timespec t1;
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  raw = "GET /px/slow HTTP/1.1\r\nConnection: close\r\n\r\n";
+  for (int i = 0; i < 24; i++)
+  {
+    fds[i] = loop_connect();
+    ASSERT_TRUE(fds[i] >= 0);
+    ASSERT_TRUE(write(fds[i], raw, strlen(raw)) > 0);
+  }
+  for (int i = 0; i < 24; i++)
+  {
+    len = 0;
+    buf[0] = '\0';
+    ASSERT_TRUE(read_until(fds[i], buf, sizeof(buf), &len, "slow"));
+    close(fds[i]);
+  }
+  ASSERT_TRUE(elapsed_ms(&t1) < 900);
+}
+
+TEST(loop_client_hangup)
+{
+  static char raw[200 * 24];
+  static char buf[1024];
+  size_t len = 0, n = 0;
+
+  /* Pipelined requests, then gone before a response is read */
+  for (int i = 0; i < 200; i++)
+    n += (size_t)snprintf(raw + n, sizeof(raw) - n, "GET /health HTTP/1.1\r\n\r\n");
+  for (int round = 0; round < 3; round++)
+  {
+    int fd = loop_connect();
+    ASSERT_TRUE(fd >= 0);
+    ASSERT_TRUE(write(fd, raw, n) == (ssize_t)n);
+    close(fd);
+  }
+  usleep(100000);
+
+  /* The server lived through the failed writes */
+  int fd = loop_connect();
+  ASSERT_TRUE(fd >= 0);
+  const char *one = "GET /health HTTP/1.1\r\nConnection: close\r\n\r\n";
+  ASSERT_TRUE(write(fd, one, strlen(one)) > 0);
+  ASSERT_TRUE(read_until(fd, buf, sizeof(buf), &len, "OK\n"));
+  ASSERT_TRUE(strncmp(buf, "HTTP/1.1 200 OK\r\n", 17) == 0);
+  close(fd);
+}
+
+TEST(loop_stalled_reader)
+{
+  static char raw[64 * 32];
+  static char buf[1024];
+  size_t len = 0, n = 0;
+
+  /* Responses pile up until the server's writes can't progress */
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int rcvbuf = 4096;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  ASSERT_EQUAL(0, connect(fd, (struct sockaddr *)&loop_addr, sizeof(loop_addr)));
+  for (int i = 0; i < 64; i++)
+    n += (size_t)snprintf(raw + n, sizeof(raw) - n, "GET /report HTTP/1.1\r\n\r\n");
+  ASSERT_TRUE(write(fd, raw, n) == (ssize_t)n);
+  usleep(100000);
+
+  /*
+   * The loop gives up on that writer and serves the others: a few
+   * send timeouts while the kernel still grows the socket buffer
+   */
+  struct timespec t0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  int fast = loop_connect();
+  ASSERT_TRUE(fast >= 0);
+  const char *one = "GET /health HTTP/1.1\r\nConnection: close\r\n\r\n";
+  ASSERT_TRUE(write(fast, one, strlen(one)) > 0);
+  ASSERT_TRUE(read_until(fast, buf, sizeof(buf), &len, "OK\n"));
+  ASSERT_TRUE(elapsed_ms(&t0) < 4500);
+  close(fast);
+  close(fd);
+}
+
+static int screen_auth(const ForgeHttpRequest *req, int client_socket)
+{
+  if (forge_http_header(req, "authorization"))
+    return FORGE_NEXT;
+  forge_send_text(client_socket, "401 Unauthorized", "denied\n");
+  return FORGE_HALT;
+}
+
+static void handle_count_body(const ForgeHttpRequest *req, int client_socket)
+{
+  char buf[16384], out[32];
+  long long total = 0;
+  long n;
+  while ((n = forge_body_read(req, buf, sizeof(buf))) > 0)
+    total += n;
+  snprintf(out, sizeof(out), "%lld\n", total);
+  forge_send_text(client_socket, n < 0 ? "400 Bad Request" : "200 OK", out);
+}
+
+/* POST `len` body bytes to /screen/upload; the response lands in `buf` */
+static int screen_upload(const char *auth, size_t len, char *buf, size_t cap)
+{
+  static char chunk[65536];
+  char head[256];
+  size_t got = 0;
+
+  int fd = loop_connect();
+  if (fd < 0)
+    return -1;
+  int n = snprintf(head, sizeof(head),
+                   "POST /screen/upload HTTP/1.1\r\n%sContent-Length: %zu\r\n"
+                   "Connection: close\r\n\r\n",
+                   auth, len);
+  if (write(fd, head, (size_t)n) != n)
+    return -1;
+
+  /* Refused early, the rest of the body hits a closed socket */
+  for (size_t sent = 0; sent < len;)
+  {
+    size_t want = len - sent < sizeof(chunk) ? len - sent : sizeof(chunk);
+    ssize_t w = send(fd, chunk, want, MSG_NOSIGNAL);
+    if (w <= 0)
+      break;
+    sent += (size_t)w;
+  }
+
+  buf[0] = '\0';
+  while (got < cap - 1)
+  {
+    ssize_t r = read(fd, buf + got, cap - 1 - got);
+    if (r <= 0)
+      break;
+    got += (size_t)r;
+    buf[got] = '\0';
+  }
+  close(fd);
+  return 0;
+}
+
+TEST(loop_screens_before_staging)
+{
+  static char buf[4096];
+  size_t len = 0;
+
+  ForgeRoute route = {"POST", "/screen/upload", handle_count_body, 64 << 20, NULL};
+  ASSERT_EQUAL(0, forge_router_add_route(&route));
+  ASSERT_EQUAL(0, forge_use("/screen", screen_auth, NULL));
+
+  /* Refused by middleware while the body has not even started */
+  int fd = loop_connect();
+  ASSERT_TRUE(fd >= 0);
+  const char *raw = "POST /screen/upload HTTP/1.1\r\nContent-Length: 10000000\r\n"
+                    "Expect: 100-continue\r\n\r\n";
+  ASSERT_TRUE(write(fd, raw, strlen(raw)) > 0);
+  buf[0] = '\0';
+  ASSERT_TRUE(read_until(fd, buf, sizeof(buf), &len, "denied\n"));
+  ASSERT_TRUE(strncmp(buf, "HTTP/1.1 401 ", 13) == 0);
+  ASSERT_TRUE(read(fd, buf, sizeof(buf)) == 0); /* not kept to drain it */
+  close(fd);
+
+  /* Admitted: staged and spooled, then handled */
+  ASSERT_EQUAL(0, screen_upload("Authorization: x\r\n", 512 * 1024, buf, sizeof(buf)));
+  ASSERT_TRUE(strstr(buf, "\r\n\r\n524288\n") != NULL);
+
+  /* What all connections spool is capped; finished bodies give it back */
+  forge_server_set_spool_budget(1024 * 1024);
+  for (int i = 0; i < 3; i++)
+  {
+    ASSERT_EQUAL(0, screen_upload("Authorization: x\r\n", 512 * 1024, buf, sizeof(buf)));
+    ASSERT_TRUE(strncmp(buf, "HTTP/1.1 200 ", 13) == 0);
+  }
+  ASSERT_EQUAL(0, screen_upload("Authorization: x\r\n", 2 * 1024 * 1024, buf, sizeof(buf)));
+  ASSERT_TRUE(strncmp(buf, "HTTP/1.1 503 ", 13) == 0);
+  ASSERT_TRUE(strstr(buf, "\r\nRetry-After: ") != NULL);
+  ASSERT_EQUAL(0, screen_upload("Authorization: x\r\n", 512 * 1024, buf, sizeof(buf)));
+  ASSERT_TRUE(strncmp(buf, "HTTP/1.1 200 ", 13) == 0);
+  forge_server_set_spool_budget(FORGE_SPOOL_DEFAULT_BUDGET);
+}
+
+/* Body bytes stream_backend() waits for, and has received so far */
+static size_t stream_expected;
+static atomic_size_t stream_received;
+
+/* Backend reading one POST body, then answering with its length */
+static void *stream_backend(void *arg)
+{
+  int listen_fd = *(int *)arg;
+  static char buf[65536];
+  int conn = accept(listen_fd, NULL, NULL);
+  if (conn < 0)
+    return NULL;
+
+  size_t len = 0, body = 0;
+  char *end = NULL;
+  while (body < stream_expected)
+  {
+    ssize_t n = recv(conn, end ? buf : buf + len, end ? sizeof(buf) : sizeof(buf) - 1 - len, 0);
+    if (n <= 0)
+      break;
+    if (end)
+      body += (size_t)n;
+    else
+    {
+      len += (size_t)n;
+      buf[len] = '\0';
+      if ((end = strstr(buf, "\r\n\r\n")) != NULL)
+        body = len - (size_t)(end + 4 - buf);
+    }
+    atomic_store(&stream_received, body);
+  }
+
+  char resp[128], count[24];
+  int clen = snprintf(count, sizeof(count), "%zu", body);
+  int n = snprintf(resp, sizeof(resp), "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n%s",
+                   clen, count);
+  ssize_t w = write(conn, resp, (size_t)n);
+  (void)w;
+  close(conn);
+  return NULL;
+}
+
+TEST(loop_proxy_streams_body)
+{
+  static char buf[4096];
+  static char chunk[65536];
+  static int listen_fd;
+  size_t len = 0;
+
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQUAL(0, bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)));
+  ASSERT_EQUAL(0, listen(listen_fd, 4));
+  getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len);
+
+  char backend[32];
+  snprintf(backend, sizeof(backend), "127.0.0.1:%d", ntohs(addr.sin_port));
+  const char *upstreams[] = {backend};
+  ForgeProxy *proxy = forge_proxy_create(upstreams, 1);
+  ASSERT_TRUE(proxy != NULL);
+  ASSERT_EQUAL(0, forge_proxy_route(proxy, "POST", "/px/stream", NULL, 8 << 20));
+
+  stream_expected = 4 << 20;
+  pthread_t thread;
+  ASSERT_EQUAL(0, pthread_create(&thread, NULL, stream_backend, &listen_fd));
+
+  /* Larger than the spool budget: it was never staged */
+  forge_server_set_spool_budget(64 * 1024);
+
+  int fd = loop_connect();
+  ASSERT_TRUE(fd >= 0);
+  snprintf(buf, sizeof(buf), "POST /px/stream HTTP/1.1\r\nContent-Length: %zu\r\n\r\n",
+           stream_expected);
+  ASSERT_TRUE(write(fd, buf, strlen(buf)) > 0);
+  ASSERT_TRUE(write(fd, chunk, sizeof(chunk)) == (ssize_t)sizeof(chunk));
+
+  /* The backend has the first piece while the client still holds the rest */
+  for (int i = 0; i < 100 && atomic_load(&stream_received) < sizeof(chunk); i++)
+    usleep(10000);
+  ASSERT_EQUAL((int)sizeof(chunk), (int)atomic_load(&stream_received));
+
+  for (size_t sent = sizeof(chunk); sent < stream_expected; sent += sizeof(chunk))
+    ASSERT_TRUE(write(fd, chunk, sizeof(chunk)) == (ssize_t)sizeof(chunk));
+
+  buf[0] = '\0';
+  ASSERT_TRUE(read_until(fd, buf, sizeof(buf), &len, "4194304"));
+  ASSERT_TRUE(strncmp(buf, "HTTP/1.1 200 OK\r\n", 17) == 0);
+  close(fd);
+
+  pthread_join(thread, NULL);
+  close(listen_fd);
+  forge_server_set_spool_budget(FORGE_SPOOL_DEFAULT_BUDGET);
+}
+
+static void *coalesce_leader(void *arg)
+{
+  char *resp = arg;
+  roundtrip("GET /herd?q=loop HTTP/1.0\r\n\r\n", resp, 512);
+  return NULL;
+}
+
+TEST(loop_coalesce_parks)
+{
+  static char lead[512];
+  static char buf[1024];
+  size_t len = 0;
+
+  ForgeCacheStats before, after;
+  forge_cache_stats(&before);
+  int calls = atomic_load(&report_calls);
+
+  /* The leader runs off the loop; the loop's follower must not block it */
+  pthread_t thread;
+  ASSERT_EQUAL(0, pthread_create(&thread, NULL, coalesce_leader, lead));
+  usleep(50000);
+
+  int follower = loop_connect();
+  ASSERT_TRUE(follower >= 0);
+  const char *raw = "GET /herd?q=loop HTTP/1.1\r\n\r\n";
+  ASSERT_TRUE(write(follower, raw, strlen(raw)) > 0);
+  usleep(50000);
+
+  struct timespec t0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  int fast = loop_connect();
+  ASSERT_TRUE(fast >= 0);
+  raw = "GET /health HTTP/1.1\r\nConnection: close\r\n\r\n";
+  ASSERT_TRUE(write(fast, raw, strlen(raw)) > 0);
+  ASSERT_TRUE(read_until(fast, buf, sizeof(buf), &len, "\r\n\r\n"));
+  ASSERT_TRUE(elapsed_ms(&t0) < 150);
+  close(fast);
+
+  /* Resumed with the leader's response */
+  char body[32];
+  snprintf(body, sizeof(body), "calls=%d", calls + 1);
+  len = 0;
+  buf[0] = '\0';
+  ASSERT_TRUE(read_until(follower, buf, sizeof(buf), &len, body));
+  ASSERT_TRUE(strncmp(buf, "HTTP/1.1 200 OK\r\n", 17) == 0);
+  pthread_join(thread, NULL);
+  ASSERT_TRUE(strstr(lead, body) != NULL);
+  ASSERT_EQUAL(calls + 1, atomic_load(&report_calls));
+
+  forge_cache_stats(&after);
+  ASSERT_EQUAL(1, (int)(after.coalesced - before.coalesced));
+
+  /* And carries on with the next request */
+  raw = "GET /health HTTP/1.1\r\n\r\n";
+  ASSERT_TRUE(write(follower, raw, strlen(raw)) > 0);
+  len = 0;
+  buf[0] = '\0';
+  ASSERT_TRUE(read_until(follower, buf, sizeof(buf), &len, "OK\n"));
+  close(follower);
+}
+
+TEST(loop_zerocopy_linger)
+{
+  static char body[REPORT_SIZE];
+  static char buf[1024];
+  size_t len = 0;
+
+  /* The body stays unread, so the kernel holds its pages */
+  atomic_store(&reports_released, 0);
+  int fd = loop_connect();
+  ASSERT_TRUE(fd >= 0);
+  const char *raw = "GET /report HTTP/1.1\r\nConnection: close\r\n\r\n";
+  ASSERT_TRUE(write(fd, raw, strlen(raw)) > 0);
+  usleep(100000);
+
+  /* Closing it does not wait for them on the loop */
+  struct timespec t0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  int fast = loop_connect();
+  ASSERT_TRUE(fast >= 0);
+  raw = "GET /health HTTP/1.1\r\nConnection: close\r\n\r\n";
+  ASSERT_TRUE(write(fast, raw, strlen(raw)) > 0);
+  buf[0] = '\0';
+  ASSERT_TRUE(read_until(fast, buf, sizeof(buf), &len, "\r\n\r\n"));
+  ASSERT_TRUE(elapsed_ms(&t0) < 300);
+  close(fast);
+
+  /* The lingering socket still delivers all of it, then closes */
+  ASSERT_EQUAL(REPORT_SIZE, (int)read_report(fd, body, sizeof(body)));
+  ASSERT_TRUE(memcmp(body, report, REPORT_SIZE) == 0);
+  ASSERT_EQUAL(0, (int)read(fd, buf, sizeof(buf)));
+  close(fd);
+  for (int i = 0; i < 200 && atomic_load(&reports_released) == 0; i++)
+    usleep(5000);
+  ASSERT_EQUAL(1, atomic_load(&reports_released));
+}
+#endif
+
+int main()
+{
+  printf("🧪 Forge Framework Unit Tests\n");
+  printf("============================\n\n");
+
+  RUN_TEST(parse_request_line);
+  RUN_TEST(parse_rejects_garbage);
+  RUN_TEST(parse_headers);
+  RUN_TEST(known_header_ids);
+  RUN_TEST(parse_rejects_ambiguous_framing);
+  RUN_TEST(parse_target_normalization);
+  RUN_TEST(hpack_integer);
+  RUN_TEST(hpack_rfc_requests_huffman);
+  RUN_TEST(hpack_encode_roundtrip);
+#ifndef _WIN32
+  RUN_TEST(handle_client_routes);
+  RUN_TEST(keep_alive_pipelining);
+  RUN_TEST(h2_prior_knowledge);
+  RUN_TEST(h2_upload_spools);
+  RUN_TEST(h2_content_length);
+  RUN_TEST(router_middleware_chain);
+  RUN_TEST(core_inbox_mpsc);
+  RUN_TEST(core_arena_and_stats);
+  RUN_TEST(admission_sheds_queued_requests);
+  RUN_TEST(common_headers_date);
+  RUN_TEST(json_writer);
+  RUN_TEST(pool_alloc_free);
+  RUN_TEST(conn_buffer_tiers);
+  RUN_TEST(zerocopy_large_body);
+  RUN_TEST(response_cache);
+  RUN_TEST(coalesce_identical_gets);
+  RUN_TEST(websocket_echo);
+  RUN_TEST(websocket_close_codes);
+  RUN_TEST(embedded_assets);
+  RUN_TEST(upload_content_length);
+  RUN_TEST(upload_chunked);
+  RUN_TEST(sha256_incremental);
+  RUN_TEST(multipart_split_anywhere);
+  RUN_TEST(upload_multipart);
+  RUN_TEST(upload_too_large);
+  RUN_TEST(unix_listener);
+  RUN_TEST(access_log_binary_roundtrip);
+  RUN_TEST(proxy_forwards_and_pools);
+  RUN_TEST(proxy_no_replay);
+  RUN_TEST(prefork_workers);
+  RUN_TEST(cpu_placement);
+  RUN_TEST(route_table_reload);
+  RUN_TEST(sse_fanout); /* leaves the event loop running for the rest */
+  RUN_TEST(loop_partial_requests);
+  RUN_TEST(loop_proxy_parks);
+  RUN_TEST(loop_coalesce_parks);
+  RUN_TEST(loop_client_hangup);
+  RUN_TEST(loop_stalled_reader);
+  RUN_TEST(loop_screens_before_staging);
+  RUN_TEST(loop_proxy_streams_body);
+  RUN_TEST(loop_zerocopy_linger);
+#endif
+
+  if (forge_test_failures)
+  {
+    printf("\n❌ %d framework test(s) FAILED\n", forge_test_failures);
+    return 1;
+  }
+
+  printf("\n✅ Framework tests PASSED!\n");
+  return 0;
+}
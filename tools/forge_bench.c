@@ -0,0 +1,440 @@
+// tools/forge_bench.c - Closed-loop load generator for HTTP/1.1 keep-alive and h2c
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "forge_h2.h"
+#include "forge_hpack.h"
+
+/* =========================================================
+   Options / Results
+   ========================================================= */
+
+typedef struct
+{
+    const char *host;
+    int port;
+    const char *path;
+    int conns;
+    int streams; /* h2: requests in flight per connection */
+    int seconds;
+    int h2;
+} BenchOptions;
+
+typedef struct
+{
+    const BenchOptions *opt;
+    uint64_t deadline_ns;
+    uint64_t requests;
+    uint64_t errors;
+    uint64_t shed; /* 503 responses */
+    uint32_t *lat_us; /* one sample per completed request */
+    size_t lat_len;
+    size_t lat_cap;
+} BenchWorker;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void record(BenchWorker *w, uint64_t start_ns)
+{
+    if (w->lat_len == w->lat_cap)
+    {
+        size_t cap = w->lat_cap ? w->lat_cap * 2 : 65536;
+        uint32_t *grown = realloc(w->lat_us, cap * sizeof(*grown));
+        if (!grown)
+            return;
+        w->lat_us = grown;
+        w->lat_cap = cap;
+    }
+
+    w->lat_us[w->lat_len++] = (uint32_t)((now_ns() - start_ns) / 1000);
+    w->requests++;
+}
+
+static int dial(const BenchOptions *opt)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)opt->port);
+    inet_pton(AF_INET, opt->host, &addr.sin_addr);
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int write_all(int fd, const void *data, size_t len)
+{
+    const char *p = data;
+    while (len > 0)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* =========================================================
+   HTTP/1.1 keep-alive: one request in flight per connection
+   ========================================================= */
+
+static int h1_connection(BenchWorker *w)
+{
+    const BenchOptions *opt = w->opt;
+    int fd = dial(opt);
+    if (fd < 0)
+        return -1;
+
+    char req[512];
+    int req_len = snprintf(req, sizeof(req),
+                           "GET %s HTTP/1.1\r\nHost: %s\r\n\r\n",
+                           opt->path, opt->host);
+
+    char buf[16384];
+    size_t len = 0;
+
+    while (now_ns() < w->deadline_ns)
+    {
+        uint64_t start = now_ns();
+        if (write_all(fd, req, (size_t)req_len) != 0)
+            break;
+
+        /* Read head, then Content-Length bytes of body */
+        long need = -1;
+        while (1)
+        {
+            if (need < 0)
+            {
+                buf[len] = '\0';
+                char *end = strstr(buf, "\r\n\r\n");
+                if (end)
+                {
+                    char *cl = strcasestr(buf, "\r\nContent-Length:");
+                    long body = cl && cl < end ? strtol(cl + 17, NULL, 10) : 0;
+                    need = (long)(end + 4 - buf) + body;
+                }
+            }
+            if (need >= 0 && len >= (size_t)need)
+                break;
+            if (len + 1 >= sizeof(buf))
+                goto fail;
+
+            ssize_t n = read(fd, buf + len, sizeof(buf) - 1 - len);
+            if (n <= 0)
+                goto fail;
+            len += (size_t)n;
+        }
+
+        /* Shed by admission control: answered, but not goodput */
+        if (len >= 12 && memcmp(buf + 9, "503", 3) == 0)
+            w->shed++;
+        else
+            record(w, start);
+        memmove(buf, buf + need, len - (size_t)need);
+        len -= (size_t)need;
+    }
+
+    close(fd);
+    return 0;
+
+fail:
+    w->errors++;
+    close(fd);
+    return -1;
+}
+
+/* =========================================================
+   h2c (prior knowledge): `streams` requests in flight
+   ========================================================= */
+
+/* Send time per stream id; in-flight ids stay well inside this window */
+#define START_SLOTS 4096
+
+static void h2_frame(uint8_t *out, size_t *len, uint8_t type, uint8_t flags,
+                     uint32_t stream_id, const void *payload, size_t n)
+{
+    ForgeH2Frame f = {(uint32_t)n, type, flags, stream_id};
+    forge_h2_pack_frame(out + *len, &f);
+    if (n > 0)
+        memcpy(out + *len + FORGE_H2_FRAME_HEADER, payload, n);
+    *len += FORGE_H2_FRAME_HEADER + n;
+}
+
+static int h2_connection(BenchWorker *w)
+{
+    const BenchOptions *opt = w->opt;
+    int fd = dial(opt);
+    if (fd < 0)
+        return -1;
+
+    ForgeHpackTable enc;
+    forge_hpack_init(&enc, FORGE_HPACK_DEFAULT_TABLE);
+
+    uint8_t out[65536];
+    size_t out_len = 0;
+    memcpy(out, FORGE_H2_PREFACE, FORGE_H2_PREFACE_LEN);
+    out_len = FORGE_H2_PREFACE_LEN;
+    h2_frame(out, &out_len, FORGE_H2_SETTINGS, 0, 0, NULL, 0);
+
+    /* The request block is identical every time: index it once */
+    uint8_t block[256];
+    long block_len = 0;
+    const char *fields[4][2] = {
+        {":method", "GET"},
+        {":scheme", "http"},
+        {":authority", opt->host},
+        {":path", opt->path},
+    };
+
+    uint64_t *started = calloc(START_SLOTS, sizeof(*started));
+    uint32_t next_id = 1;
+    int inflight = 0;
+    int rc = 0;
+
+    uint8_t buf[65536];
+    size_t len = 0;
+
+    while (1)
+    {
+        int open = now_ns() < w->deadline_ns;
+
+        for (; open && inflight < opt->streams; inflight++)
+        {
+            block_len = 0;
+            for (int i = 0; i < 4; i++)
+                block_len += forge_hpack_encode(&enc, block + block_len,
+                                                sizeof(block) - (size_t)block_len,
+                                                fields[i][0], fields[i][1],
+                                                strlen(fields[i][1]),
+                                                FORGE_HPACK_INDEX);
+
+            started[(next_id / 2) % START_SLOTS] = now_ns();
+            h2_frame(out, &out_len, FORGE_H2_HEADERS,
+                     FORGE_H2_FLAG_END_HEADERS | FORGE_H2_FLAG_END_STREAM,
+                     next_id, block, (size_t)block_len);
+            next_id += 2;
+        }
+
+        if (out_len > 0 && write_all(fd, out, out_len) != 0)
+            goto fail;
+        out_len = 0;
+
+        if (!open && inflight == 0)
+            break;
+
+        ssize_t n = read(fd, buf + len, sizeof(buf) - len);
+        if (n <= 0)
+            goto fail;
+        len += (size_t)n;
+
+        size_t pos = 0;
+        uint32_t consumed = 0;
+        while (len - pos >= FORGE_H2_FRAME_HEADER)
+        {
+            ForgeH2Frame f;
+            forge_h2_unpack_frame(buf + pos, &f);
+            if (len - pos < FORGE_H2_FRAME_HEADER + f.length)
+                break;
+
+            pos += FORGE_H2_FRAME_HEADER + f.length;
+
+            if (f.type == FORGE_H2_SETTINGS && !(f.flags & FORGE_H2_FLAG_ACK))
+                h2_frame(out, &out_len, FORGE_H2_SETTINGS, FORGE_H2_FLAG_ACK, 0, NULL, 0);
+            else if (f.type == FORGE_H2_DATA)
+                consumed += f.length;
+            else if (f.type == FORGE_H2_RST_STREAM || f.type == FORGE_H2_GOAWAY)
+                goto fail;
+
+            /* Responses only carry END_STREAM on HEADERS or DATA */
+            if ((f.type == FORGE_H2_DATA || f.type == FORGE_H2_HEADERS) &&
+                (f.flags & FORGE_H2_FLAG_END_STREAM))
+            {
+                record(w, started[(f.stream_id / 2) % START_SLOTS]);
+                inflight--;
+            }
+        }
+
+        memmove(buf, buf + pos, len - pos);
+        len -= pos;
+
+        if (consumed > 0)
+        {
+            uint8_t inc[4] = {(uint8_t)(consumed >> 24), (uint8_t)(consumed >> 16),
+                              (uint8_t)(consumed >> 8), (uint8_t)consumed};
+            h2_frame(out, &out_len, FORGE_H2_WINDOW_UPDATE, 0, 0, inc, 4);
+        }
+
+        /* Stream ids run out after 2^30 requests: reconnect */
+        if (next_id > 0x7ffffff0)
+            break;
+    }
+
+    goto done;
+
+fail:
+    w->errors++;
+    rc = -1;
+done:
+    free(started);
+    forge_hpack_free(&enc);
+    close(fd);
+    return rc;
+}
+
+/* =========================================================
+   Driver
+   ========================================================= */
+
+static void *bench_worker(void *arg)
+{
+    BenchWorker *w = arg;
+
+    while (now_ns() < w->deadline_ns)
+    {
+        int rc = w->opt->h2 ? h2_connection(w) : h1_connection(w);
+        if (rc != 0)
+            usleep(1000); /* back off before redialing */
+    }
+    return NULL;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [-2] [-c conns] [-m streams] [-d seconds] "
+            "[host] [port] [path]\n"
+            "  -2  h2c with prior knowledge (default HTTP/1.1 keep-alive)\n"
+            "  -m  h2 requests in flight per connection (default 1)\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions opt = {"127.0.0.1", 8080, "/health", 8, 1, 5, 0};
+
+    int opt_ch;
+    while ((opt_ch = getopt(argc, argv, "2c:m:d:h")) != -1)
+    {
+        switch (opt_ch)
+        {
+        case '2':
+            opt.h2 = 1;
+            break;
+        case 'c':
+            opt.conns = atoi(optarg);
+            break;
+        case 'm':
+            opt.streams = atoi(optarg);
+            break;
+        case 'd':
+            opt.seconds = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind < argc)
+        opt.host = argv[optind++];
+    if (optind < argc)
+        opt.port = atoi(argv[optind++]);
+    if (optind < argc)
+        opt.path = argv[optind++];
+
+    if (opt.conns < 1 || opt.streams < 1 || opt.seconds < 1 ||
+        opt.streams > FORGE_H2_MAX_STREAMS)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    BenchWorker *workers = calloc((size_t)opt.conns, sizeof(*workers));
+    pthread_t *threads = calloc((size_t)opt.conns, sizeof(*threads));
+    uint64_t start = now_ns();
+
+    for (int i = 0; i < opt.conns; i++)
+    {
+        workers[i].opt = &opt;
+        workers[i].deadline_ns = start + (uint64_t)opt.seconds * 1000000000ULL;
+        pthread_create(&threads[i], NULL, bench_worker, &workers[i]);
+    }
+
+    uint64_t requests = 0, errors = 0, shed = 0;
+    size_t samples = 0;
+    for (int i = 0; i < opt.conns; i++)
+    {
+        pthread_join(threads[i], NULL);
+        requests += workers[i].requests;
+        errors += workers[i].errors;
+        shed += workers[i].shed;
+        samples += workers[i].lat_len;
+    }
+    double elapsed = (double)(now_ns() - start) / 1e9;
+
+    uint32_t *all = malloc((samples ? samples : 1) * sizeof(*all));
+    size_t n = 0;
+    double sum = 0;
+    for (int i = 0; i < opt.conns; i++)
+    {
+        for (size_t j = 0; j < workers[i].lat_len; j++)
+        {
+            all[n++] = workers[i].lat_us[j];
+            sum += workers[i].lat_us[j];
+        }
+        free(workers[i].lat_us);
+    }
+    qsort(all, n, sizeof(*all), cmp_u32);
+
+    printf("⚡ %s http://%s:%d%s  %d conn x %d in flight, %ds\n",
+           opt.h2 ? "h2c" : "HTTP/1.1",
+           opt.host, opt.port, opt.path,
+           opt.conns, opt.h2 ? opt.streams : 1, opt.seconds);
+    printf("   requests  %llu (%llu errors, %llu shed)\n",
+           (unsigned long long)requests, (unsigned long long)errors,
+           (unsigned long long)shed);
+    printf("   req/s     %.0f\n", (double)requests / elapsed);
+    if (n > 0)
+        printf("   latency   mean %.0fus  p50 %uus  p99 %uus  max %uus\n",
+               sum / (double)n, all[n / 2], all[n * 99 / 100], all[n - 1]);
+
+    free(all);
+    free(workers);
+    free(threads);
+    return errors && !requests ? 1 : 0;
+}
@@ -0,0 +1,604 @@
+// tools/forge_embed.c - Compile an assets directory into a forge_embed table (POSIX only)
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "forge_embed.h"
+
+/* =========================================================
+   Files
+   ========================================================= */
+
+#define MAX_SEED (1u << 20)
+
+typedef struct
+{
+    char *rel; /* path below the assets directory */
+    const char *content_type;
+    unsigned char *data;
+    size_t len;
+    unsigned char *gz; /* NULL: not worth compressing */
+    size_t gz_len;
+} EmbedFile;
+
+typedef struct
+{
+    char *path; /* URL path */
+    int file;
+} EmbedKey;
+
+static EmbedFile *files;
+static size_t file_count;
+static size_t file_cap;
+
+static const struct
+{
+    const char *ext;
+    const char *type;
+    int compressible;
+} types[] = {
+    {"html", "text/html; charset=utf-8", 1},
+    {"htm", "text/html; charset=utf-8", 1},
+    {"css", "text/css; charset=utf-8", 1},
+    {"js", "text/javascript; charset=utf-8", 1},
+    {"mjs", "text/javascript; charset=utf-8", 1},
+    {"json", "application/json", 1},
+    {"map", "application/json", 1},
+    {"txt", "text/plain; charset=utf-8", 1},
+    {"xml", "application/xml", 1},
+    {"svg", "image/svg+xml", 1},
+    {"wasm", "application/wasm", 1},
+    {"ico", "image/x-icon", 1},
+    {"png", "image/png", 0},
+    {"jpg", "image/jpeg", 0},
+    {"jpeg", "image/jpeg", 0},
+    {"gif", "image/gif", 0},
+    {"webp", "image/webp", 0},
+    {"avif", "image/avif", 0},
+    {"woff", "font/woff", 0},
+    {"woff2", "font/woff2", 0},
+};
+
+static const char *type_of(const char *rel, int *compressible)
+{
+    const char *dot = strrchr(rel, '.');
+    const char *slash = strrchr(rel, '/');
+
+    if (dot && (!slash || dot > slash))
+    {
+        for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+        {
+            if (strcasecmp(dot + 1, types[i].ext) == 0)
+            {
+                *compressible = types[i].compressible;
+                return types[i].type;
+            }
+        }
+    }
+
+    *compressible = 1;
+    return "application/octet-stream";
+}
+
+static unsigned char *read_file(const char *path, size_t *len)
+{
+    FILE *in = fopen(path, "rb");
+    if (!in)
+        return NULL;
+
+    size_t cap = 4096;
+    size_t used = 0;
+    unsigned char *buf = malloc(cap);
+
+    while (buf)
+    {
+        used += fread(buf + used, 1, cap - used, in);
+        if (used < cap)
+            break;
+
+        unsigned char *grown = realloc(buf, cap * 2);
+        if (!grown)
+        {
+            free(buf);
+            buf = NULL;
+            break;
+        }
+        buf = grown;
+        cap *= 2;
+    }
+
+    if (buf && ferror(in))
+    {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(in);
+    *len = used;
+    return buf;
+}
+
+/* `gzip -9 -n` of the file; NULL when gzip is missing or fails */
+static unsigned char *gzip_file(const char *path, size_t *len)
+{
+    int out[2];
+    if (pipe(out) != 0)
+        return NULL;
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(out[0]);
+        close(out[1]);
+        return NULL;
+    }
+
+    if (pid == 0)
+    {
+        if (!freopen(path, "rb", stdin) || dup2(out[1], STDOUT_FILENO) < 0)
+            _exit(127);
+        close(out[0]);
+        close(out[1]);
+        execlp("gzip", "gzip", "-9", "-n", "-c", (char *)NULL);
+        _exit(127);
+    }
+
+    close(out[1]);
+
+    size_t cap = 4096;
+    size_t used = 0;
+    unsigned char *buf = malloc(cap);
+    ssize_t n = 0;
+
+    while (buf && (n = read(out[0], buf + used, cap - used)) > 0)
+    {
+        used += (size_t)n;
+        if (used == cap)
+        {
+            unsigned char *grown = realloc(buf, cap * 2);
+            if (!grown)
+            {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+    }
+    close(out[0]);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!buf || n < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        free(buf);
+        return NULL;
+    }
+
+    *len = used;
+    return buf;
+}
+
+static int add_file(const char *path, const char *rel)
+{
+    if (file_count == file_cap)
+    {
+        size_t cap = file_cap ? file_cap * 2 : 64;
+        EmbedFile *grown = realloc(files, cap * sizeof(*grown));
+        if (!grown)
+            return -1;
+        files = grown;
+        file_cap = cap;
+    }
+
+    EmbedFile *f = &files[file_count];
+    memset(f, 0, sizeof(*f));
+    f->rel = strdup(rel);
+    f->data = read_file(path, &f->len);
+    if (!f->rel || !f->data)
+    {
+        perror(path);
+        return -1;
+    }
+
+    int compressible = 0;
+    f->content_type = type_of(rel, &compressible);
+
+    if (compressible && f->len > 0)
+    {
+        f->gz = gzip_file(path, &f->gz_len);
+
+        /* Only keep a variant that saves at least a tenth */
+        if (f->gz && f->gz_len > f->len - f->len / 10)
+        {
+            free(f->gz);
+            f->gz = NULL;
+        }
+    }
+
+    file_count++;
+    return 0;
+}
+
+/* Regular files below `root`/`rel`, hidden entries skipped */
+static int walk(const char *root, const char *rel)
+{
+    char dir_path[4096];
+    snprintf(dir_path, sizeof(dir_path), "%s%s%s", root, *rel ? "/" : "", rel);
+
+    DIR *dir = opendir(dir_path);
+    if (!dir)
+    {
+        perror(dir_path);
+        return -1;
+    }
+
+    struct dirent *e;
+    int rc = 0;
+
+    while (rc == 0 && (e = readdir(dir)) != NULL)
+    {
+        if (e->d_name[0] == '.')
+            continue;
+
+        char child[4096];
+        snprintf(child, sizeof(child), "%s%s%s", rel, *rel ? "/" : "", e->d_name);
+
+        char full[8192];
+        snprintf(full, sizeof(full), "%s/%s", root, child);
+
+        struct stat st;
+        if (stat(full, &st) != 0)
+            rc = -1;
+        else if (S_ISDIR(st.st_mode))
+            rc = walk(root, child);
+        else if (S_ISREG(st.st_mode))
+            rc = add_file(full, child);
+    }
+
+    closedir(dir);
+    return rc;
+}
+
+static int by_rel(const void *a, const void *b)
+{
+    return strcmp(((const EmbedFile *)a)->rel, ((const EmbedFile *)b)->rel);
+}
+
+/* =========================================================
+   Perfect Hash
+   ========================================================= */
+
+typedef struct
+{
+    size_t *keys;
+    size_t count;
+    size_t bucket;
+} HashBucket;
+
+static int by_size(const void *a, const void *b)
+{
+    const HashBucket *x = a;
+    const HashBucket *y = b;
+    if (x->count != y->count)
+        return x->count < y->count ? 1 : -1;
+    return x->bucket < y->bucket ? -1 : x->bucket > y->bucket;
+}
+
+/*
+ * Hash and displace: big buckets first, each gets the first seed
+ * that sends all its keys to distinct free slots. slot_of[k] is
+ * where key k ends up. Returns 0 / -1.
+ */
+static int build_hash(const EmbedKey *keys, size_t n, size_t nb,
+                      uint32_t *seeds, size_t *slot_of)
+{
+    HashBucket *buckets = calloc(nb, sizeof(*buckets));
+    size_t *members = malloc(n * sizeof(*members));
+    size_t *fill = calloc(nb, sizeof(*fill));
+    unsigned char *taken = calloc(n, 1);
+    size_t *trial = malloc(n * sizeof(*trial));
+    int rc = -1;
+
+    if (!buckets || !members || !fill || !taken || !trial)
+        goto out;
+
+    for (size_t k = 0; k < n; k++)
+        buckets[forge_embed_hash(keys[k].path, strlen(keys[k].path), 0) % nb].count++;
+
+    size_t offset = 0;
+    for (size_t b = 0; b < nb; b++)
+    {
+        buckets[b].keys = members + offset;
+        buckets[b].bucket = b;
+        offset += buckets[b].count;
+    }
+    for (size_t k = 0; k < n; k++)
+    {
+        size_t b = forge_embed_hash(keys[k].path, strlen(keys[k].path), 0) % nb;
+        buckets[b].keys[fill[b]++] = k;
+    }
+
+    qsort(buckets, nb, sizeof(*buckets), by_size);
+
+    for (size_t i = 0; i < nb && buckets[i].count > 0; i++)
+    {
+        HashBucket *b = &buckets[i];
+        uint32_t seed = 1;
+
+        for (; seed < MAX_SEED; seed++)
+        {
+            size_t placed = 0;
+            for (; placed < b->count; placed++)
+            {
+                const char *path = keys[b->keys[placed]].path;
+                size_t slot = forge_embed_hash(path, strlen(path), seed) % n;
+
+                int clash = taken[slot];
+                for (size_t j = 0; j < placed && !clash; j++)
+                    clash = trial[j] == slot;
+                if (clash)
+                    break;
+                trial[placed] = slot;
+            }
+            if (placed == b->count)
+                break;
+        }
+        if (seed == MAX_SEED)
+            goto out;
+
+        seeds[b->bucket] = seed;
+        for (size_t j = 0; j < b->count; j++)
+        {
+            taken[trial[j]] = 1;
+            slot_of[b->keys[j]] = trial[j];
+        }
+    }
+    rc = 0;
+
+out:
+    free(buckets);
+    free(members);
+    free(fill);
+    free(taken);
+    free(trial);
+    return rc;
+}
+
+/* =========================================================
+   Output
+   ========================================================= */
+
+static void emit_string(FILE *out, const char *s, size_t len)
+{
+    fputc('"', out);
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c == '\r')
+            fputs("\\r", out);
+        else if (c == '\n')
+            fputs("\\n", out);
+        else if (c < 0x20 || c >= 0x7f)
+            fprintf(out, "\\%03o", c);
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void emit_bytes(FILE *out, const char *name, const unsigned char *data, size_t len)
+{
+    fprintf(out, "static const unsigned char %s[] = {", name);
+    if (len == 0)
+        fputs("0", out);
+    for (size_t i = 0; i < len; i++)
+        fprintf(out, "%s0x%02x,", i % 16 ? "" : "\n    ", data[i]);
+    fputs("\n};\n\n", out);
+}
+
+static uint64_t fnv64(const unsigned char *data, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void emit_variant(FILE *out, const EmbedFile *f, int index, int gz)
+{
+    if (gz && !f->gz)
+    {
+        fputs("        {NULL, 0, NULL, 0, NULL, 0, NULL},\n", out);
+        return;
+    }
+
+    size_t len = gz ? f->gz_len : f->len;
+
+    char etag[48];
+    snprintf(etag, sizeof(etag), "\"%016llx%s\"",
+             (unsigned long long)fnv64(f->data, f->len), gz ? "-gz" : "");
+
+    char headers[256];
+    int headers_len = snprintf(headers, sizeof(headers), "ETag: %s\r\n%s%s", etag,
+                               f->gz ? "Vary: Accept-Encoding\r\n" : "",
+                               gz ? "Content-Encoding: gzip\r\n" : "");
+
+    char head[512];
+    int head_len = snprintf(head, sizeof(head),
+                            "HTTP/1.1 200 OK\r\nContent-Type: %s\r\n"
+                            "Content-Length: %zu\r\n%s",
+                            f->content_type, len, headers);
+
+    fputs("        {", out);
+    emit_string(out, head, (size_t)head_len);
+    fprintf(out, ", %d,\n         ", head_len);
+    emit_string(out, headers, (size_t)headers_len);
+    fprintf(out, ", %d,\n         file%d%s, %zu, ", headers_len, index, gz ? "_gz" : "", len);
+    emit_string(out, etag, strlen(etag));
+    fputs("},\n", out);
+}
+
+static int emit(FILE *out, const char *root, const char *symbol,
+                const EmbedKey *keys, size_t n, const size_t *slot_of,
+                const uint32_t *seeds, size_t nb)
+{
+    fprintf(out, "/* Generated by forge-embed from %s; do not edit. */\n", root);
+    fputs("#include \"forge_embed.h\"\n\n", out);
+
+    for (size_t i = 0; i < file_count; i++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "file%zu", i);
+        emit_bytes(out, name, files[i].data, files[i].len);
+        if (files[i].gz)
+        {
+            snprintf(name, sizeof(name), "file%zu_gz", i);
+            emit_bytes(out, name, files[i].gz, files[i].gz_len);
+        }
+    }
+
+    /* Assets in slot order */
+    fprintf(out, "static const ForgeEmbedAsset assets[%zu] = {\n", n);
+    for (size_t slot = 0; slot < n; slot++)
+    {
+        size_t k = 0;
+        while (slot_of[k] != slot)
+            k++;
+
+        const EmbedFile *f = &files[keys[k].file];
+        fputs("    {", out);
+        emit_string(out, keys[k].path, strlen(keys[k].path));
+        fputs(", ", out);
+        emit_string(out, f->content_type, strlen(f->content_type));
+        fputs(",\n", out);
+        emit_variant(out, f, keys[k].file, 0);
+        emit_variant(out, f, keys[k].file, 1);
+        fputs("    },\n", out);
+    }
+    fputs("};\n\n", out);
+
+    fprintf(out, "static const uint32_t seeds[%zu] = {", nb);
+    for (size_t b = 0; b < nb; b++)
+        fprintf(out, "%s%uu,", b % 8 ? " " : "\n    ", (unsigned)seeds[b]);
+    fputs("\n};\n\n", out);
+
+    fprintf(out, "const ForgeEmbedTable %s = {assets, %zu, seeds, %zu};\n",
+            symbol, n, nb);
+    return ferror(out) ? -1 : 0;
+}
+
+/* =========================================================
+   Main
+   ========================================================= */
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-n symbol] -o out.c <assets-dir>\n", argv0);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    const char *symbol = "forge_assets";
+    const char *output = NULL;
+    int opt_ch;
+
+    while ((opt_ch = getopt(argc, argv, "n:o:h")) != -1)
+    {
+        switch (opt_ch)
+        {
+        case 'n':
+            symbol = optarg;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (!output || optind + 1 != argc)
+        usage(argv[0]);
+
+    const char *root = argv[optind];
+    if (walk(root, "") != 0)
+        return 1;
+    if (file_count == 0)
+    {
+        fprintf(stderr, "❌ %s: no files to embed\n", root);
+        return 1;
+    }
+    qsort(files, file_count, sizeof(*files), by_rel);
+
+    /* Every file, plus each index.html again at its directory */
+    EmbedKey *keys = calloc(file_count * 2, sizeof(*keys));
+    if (!keys)
+        return 1;
+
+    size_t n = 0;
+    for (size_t i = 0; i < file_count; i++)
+    {
+        const char *rel = files[i].rel;
+        size_t rel_len = strlen(rel);
+
+        keys[n].path = malloc(rel_len + 2);
+        if (!keys[n].path)
+            return 1;
+        snprintf(keys[n].path, rel_len + 2, "/%s", rel);
+        keys[n++].file = (int)i;
+
+        const char *base = strrchr(rel, '/');
+        base = base ? base + 1 : rel;
+        if (strcmp(base, "index.html") == 0)
+        {
+            keys[n].path = strndup(keys[n - 1].path, (size_t)(base - rel) + 1);
+            if (!keys[n].path)
+                return 1;
+            keys[n++].file = (int)i;
+        }
+    }
+
+    size_t nb = (n + 3) / 4;
+    uint32_t *seeds = calloc(nb, sizeof(*seeds));
+    size_t *slot_of = calloc(n, sizeof(*slot_of));
+    if (!seeds || !slot_of)
+        return 1;
+
+    if (build_hash(keys, n, nb, seeds, slot_of) != 0)
+    {
+        fprintf(stderr, "❌ %s: no perfect hash found\n", root);
+        return 1;
+    }
+
+    FILE *out = fopen(output, "w");
+    if (!out)
+    {
+        perror(output);
+        return 1;
+    }
+    int rc = emit(out, root, symbol, keys, n, slot_of, seeds, nb);
+    if (fclose(out) != 0 || rc != 0)
+    {
+        fprintf(stderr, "❌ %s: write failed\n", output);
+        remove(output);
+        return 1;
+    }
+
+    size_t gz_count = 0;
+    for (size_t i = 0; i < file_count; i++)
+        gz_count += files[i].gz != NULL;
+    printf("✅ %s: %zu files (%zu gzipped), %zu paths\n", output, file_count, gz_count, n);
+    return 0;
+}
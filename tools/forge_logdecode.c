@@ -0,0 +1,32 @@
+// tools/forge_logdecode.c - Convert binary Forge access logs to text
+#include <stdio.h>
+#include <string.h>
+#include "forge_log.h"
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s <access.bin>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *in = strcmp(argv[1], "-") == 0 ? stdin : fopen(argv[1], "rb");
+    if (!in)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    long n = forge_access_log_decode(in, stdout);
+    if (in != stdin)
+        fclose(in);
+
+    if (n < 0)
+    {
+        fprintf(stderr, "❌ %s: not a Forge binary access log or truncated\n", argv[1]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,367 @@
+// tools/forge_zcbench.c - Sender CPU cost of copying vs MSG_ZEROCOPY per body size
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+
+#include "forge_zerocopy.h"
+
+/*
+ * Sends bodies of doubling sizes over TCP for a fixed time, once
+ * with plain send() and once with MSG_ZEROCOPY (at most
+ * FORGE_ZEROCOPY_PENDING bodies awaiting completion, as the server
+ * allows), and reports the sending thread's CPU time per byte. The
+ * crossover is the smallest size from which zero-copy stays
+ * cheaper; FORGE_ZEROCOPY_MIN should sit there.
+ *
+ * Loopback delivers by copying the pinned pages anyway, so run the
+ * sink on another host for numbers that mean anything:
+ *   peer$ forge-zcbench -s 9100
+ *   here$ forge-zcbench peer-ip 9100
+ */
+
+/* =========================================================
+   Options / Results
+   ========================================================= */
+
+typedef struct
+{
+    const char *host;
+    int port;
+    int sink_port; /* -s: only receive */
+    double seconds; /* per size and mode */
+    size_t min_size;
+    size_t max_size;
+} ZcOptions;
+
+typedef struct
+{
+    double mb_per_s;
+    double cpu_ns_per_kb;
+    int copied; /* kernel reported a deferred copy */
+} ZcResult;
+
+static uint64_t clock_ns(clockid_t id)
+{
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* =========================================================
+   Sink
+   ========================================================= */
+
+static void *drain(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+    size_t cap = 1 << 20;
+    char *buf = malloc(cap);
+    while (buf && read(fd, buf, cap) > 0)
+        ;
+    free(buf);
+    close(fd);
+    return NULL;
+}
+
+static int listen_on(int port, int *bound)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, 64) < 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &len) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    *bound = ntohs(addr.sin_port);
+    return fd;
+}
+
+static void *sink_main(void *arg)
+{
+    int listen_fd = (int)(intptr_t)arg;
+    while (1)
+    {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0)
+            continue;
+
+        pthread_t thread;
+        pthread_create(&thread, NULL, drain, (void *)(intptr_t)fd);
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+/* =========================================================
+   Sender
+   ========================================================= */
+
+static int dial(const ZcOptions *opt)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)opt->port);
+    inet_pton(AF_INET, opt->host, &addr.sin_addr);
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Completed notification ids; *copied set on a deferred copy */
+static uint32_t reap(int fd, uint32_t done, int *copied)
+{
+    while (1)
+    {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            return done;
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            struct sock_extended_err ee;
+            memcpy(&ee, CMSG_DATA(cm), sizeof(ee));
+            if (ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+            done = ee.ee_data + 1;
+            if (ee.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                *copied = 1;
+        }
+    }
+}
+
+static int run(const ZcOptions *opt, const char *body, size_t size,
+               int zerocopy, ZcResult *out)
+{
+    int fd = dial(opt);
+    if (fd < 0)
+        return -1;
+
+    int one = 1;
+    if (zerocopy && setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    uint32_t next = 0, done = 0;
+    uint64_t bytes = 0;
+    int copied = 0;
+
+    uint64_t wall0 = clock_ns(CLOCK_MONOTONIC);
+    uint64_t cpu0 = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    uint64_t deadline = wall0 + (uint64_t)(opt->seconds * 1e9);
+
+    while (clock_ns(CLOCK_MONOTONIC) < deadline)
+    {
+        /* The server's window: wait for completions beyond it */
+        while (zerocopy && next - done >= FORGE_ZEROCOPY_PENDING)
+        {
+            struct pollfd pfd = {fd, 0, 0};
+            poll(&pfd, 1, 100);
+            done = reap(fd, done, &copied);
+        }
+
+        size_t off = 0;
+        while (off < size)
+        {
+            ssize_t n = send(fd, body + off, size - off, zerocopy ? MSG_ZEROCOPY : 0);
+            if (n < 0 && (errno == EINTR || errno == ENOBUFS))
+            {
+                if (errno == ENOBUFS)
+                    done = reap(fd, done, &copied);
+                continue;
+            }
+            if (n <= 0)
+            {
+                close(fd);
+                return -1;
+            }
+            off += (size_t)n;
+            next += zerocopy;
+        }
+        bytes += size;
+
+        if (zerocopy)
+            done = reap(fd, done, &copied);
+    }
+
+    /* Reaping what is still in flight is part of the cost */
+    while (zerocopy && done != next && clock_ns(CLOCK_MONOTONIC) < deadline + 2000000000ULL)
+    {
+        struct pollfd pfd = {fd, 0, 0};
+        poll(&pfd, 1, 100);
+        done = reap(fd, done, &copied);
+    }
+
+    uint64_t cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu0;
+    uint64_t wall = clock_ns(CLOCK_MONOTONIC) - wall0;
+    close(fd);
+
+    out->mb_per_s = (double)bytes / 1e6 / ((double)wall / 1e9);
+    out->cpu_ns_per_kb = (double)cpu / ((double)bytes / 1024.0);
+    out->copied = copied;
+    return 0;
+}
+
+/* =========================================================
+   Main
+   ========================================================= */
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [-d seconds] [-m min_kb] [-M max_kb] [host port]\n"
+            "       %s -s port    (sink for a sender on another host)\n"
+            "Without host, a sink thread on loopback receives.\n",
+            argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+    ZcOptions opt = {"127.0.0.1", 0, 0, 1.0, 4 * 1024, 4 * 1024 * 1024};
+
+    int opt_ch;
+    while ((opt_ch = getopt(argc, argv, "s:d:m:M:h")) != -1)
+    {
+        switch (opt_ch)
+        {
+        case 's':
+            opt.sink_port = atoi(optarg);
+            break;
+        case 'd':
+            opt.seconds = atof(optarg);
+            break;
+        case 'm':
+            opt.min_size = (size_t)atol(optarg) * 1024;
+            break;
+        case 'M':
+            opt.max_size = (size_t)atol(optarg) * 1024;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind + 1 < argc)
+    {
+        opt.host = argv[optind];
+        opt.port = atoi(argv[optind + 1]);
+    }
+
+    if (opt.seconds <= 0 || opt.min_size == 0 || opt.max_size < opt.min_size)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (opt.sink_port > 0 || opt.port == 0)
+    {
+        int bound = 0;
+        int listen_fd = listen_on(opt.sink_port, &bound);
+        if (listen_fd < 0)
+        {
+            perror("listen");
+            return 1;
+        }
+
+        if (opt.sink_port > 0)
+        {
+            printf("🕳  sink on port %d\n", bound);
+            sink_main((void *)(intptr_t)listen_fd);
+            return 0;
+        }
+
+        pthread_t thread;
+        pthread_create(&thread, NULL, sink_main, (void *)(intptr_t)listen_fd);
+        opt.port = bound;
+    }
+
+    char *body = malloc(opt.max_size);
+    if (!body)
+        return 1;
+    for (size_t i = 0; i < opt.max_size; i++)
+        body[i] = (char)('a' + i % 26);
+
+    printf("⚡ send cost to %s:%d, %.1fs per point (threshold now %d KB)\n",
+           opt.host, opt.port, opt.seconds, FORGE_ZEROCOPY_MIN / 1024);
+    printf("   %8s  %12s %12s  %12s %12s\n",
+           "body", "copy MB/s", "ns/KB", "zc MB/s", "ns/KB");
+
+    size_t crossover = 0;
+    int copied = 0;
+    for (size_t size = opt.min_size; size <= opt.max_size; size *= 2)
+    {
+        ZcResult copy, zc;
+        if (run(&opt, body, size, 0, &copy) != 0 || run(&opt, body, size, 1, &zc) != 0)
+        {
+            fprintf(stderr, "send failed at %zu bytes: %s\n", size, strerror(errno));
+            return 1;
+        }
+        copied |= zc.copied;
+
+        /* Lowest size from which zero-copy wins every point */
+        if (zc.cpu_ns_per_kb < copy.cpu_ns_per_kb)
+        {
+            if (!crossover)
+                crossover = size;
+        }
+        else
+        {
+            crossover = 0;
+        }
+
+        printf("   %6zuKB  %12.0f %12.1f  %12.0f %12.1f%s\n",
+               size / 1024, copy.mb_per_s, copy.cpu_ns_per_kb,
+               zc.mb_per_s, zc.cpu_ns_per_kb, zc.copied ? "  (copied)" : "");
+    }
+
+    if (crossover)
+        printf("   crossover %zu KB\n", crossover / 1024);
+    else
+        printf("   no crossover in range\n");
+    if (copied)
+        printf("   the kernel copied zero-copy sends (loopback or no SG): "
+               "measure against a remote sink\n");
+
+    free(body);
+    return 0;
+}
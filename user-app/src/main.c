@@ -1,12 +1,65 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "forge_abi.h"
 #include "forge_server.h"
+#include "forge_log.h"
+#include "forge_http.h"
+#include "forge_router.h"
+
+#ifdef FORGE_EMBED_ASSETS
+#include "forge_embed.h"
+
+// Generated by `make app` from user-app/assets
+extern const ForgeEmbedTable forge_assets;
+#endif
 
 // ✅ C99 ABI check (compile-time failure if wrong version)
-#if FORGE_ABI_VERSION != 1
-#error "Forge ABI v1.0 required (got " #FORGE_ABI_VERSION ")"
+#if FORGE_ABI_VERSION != 6
+#error "Forge ABI v6 required (got " #FORGE_ABI_VERSION ")"
 #endif
 
+/* =========================================================
+   Application Routes / Middleware
+   ========================================================= */
+
+static const char *cors_origin;
+
+static void handle_hello(const ForgeHttpRequest *req, int client_socket)
+{
+    (void)req;
+    forge_send_json(client_socket, "200 OK", "{ \"hello\": \"forge\" }\n");
+}
+
+// CORS: tag every response, answer preflight requests directly
+static int cors(const ForgeHttpRequest *req, int client_socket)
+{
+    forge_response_header(client_socket, "Access-Control-Allow-Origin", cors_origin);
+
+    if (strcmp(req->method, "OPTIONS") == 0)
+    {
+        forge_response_header(client_socket, "Access-Control-Allow-Methods",
+                              "GET, POST, OPTIONS");
+        forge_send_text(client_socket, "204 No Content", "");
+        return FORGE_HALT;
+    }
+    return FORGE_NEXT;
+}
+
+// Reloadable routes and middleware: run again on SIGHUP
+static int register_routes(void *arg)
+{
+    (void)arg;
+    if (forge_router_add("GET", "/api/hello", handle_hello) != 0)
+        return -1;
+
+    // Optional CORS for browser clients on another origin
+    cors_origin = getenv("FORGE_CORS_ORIGIN");
+    if (cors_origin && forge_use(NULL, cors, NULL) != 0)
+        return -1;
+    return 0;
+}
+
 int main()
 {
     setbuf(stdout, NULL);
@@ -14,7 +67,73 @@ int main()
     printf("🌐 Starting HTTP server: http://localhost:8080\n");
 
     ForgeServer server = create_forge_server(8080, 10);
-    launch_server(&server);
+
+    // Optional AF_UNIX listener for a co-located reverse proxy
+    const char *unix_socket = getenv("FORGE_UNIX_SOCKET");
+    if (unix_socket && forge_server_listen_unix(&server, unix_socket) != 0)
+        return 1;
+
+    // Optional access log (FORGE_ACCESS_LOG_FORMAT=binary for compact records)
+    const char *access_log = getenv("FORGE_ACCESS_LOG");
+    if (access_log)
+    {
+        const char *fmt = getenv("FORGE_ACCESS_LOG_FORMAT");
+        ForgeLogFormat format = (fmt && strcmp(fmt, "binary") == 0)
+                                    ? FORGE_LOG_BINARY
+                                    : FORGE_LOG_TEXT;
+        if (forge_access_log_open(access_log, format) != 0)
+            return 1;
+    }
+
+    // Optional control-plane port: /health and /metrics on their own thread
+    const char *control_port = getenv("FORGE_CONTROL_PORT");
+    if (control_port && forge_server_listen_control(&server, atoi(control_port)) < 0)
+        return 1;
+
+    // Optional admission control tuning (FORGE_SHED_TARGET_MS=0 disables)
+    const char *shed_target = getenv("FORGE_SHED_TARGET_MS");
+    if (shed_target)
+        forge_server_set_admission((unsigned)atoi(shed_target), 100, 1);
+
+#ifdef FORGE_EMBED_ASSETS
+    // Static web UI served from the binary itself
+    if (forge_embed_register(&forge_assets) != 0)
+        return 1;
+#endif
+
+    if (forge_router_on_reload(register_routes, NULL) != 0)
+        return 1;
+
+    // FORGE_CPUS=auto or a list ("0-3,8") pins loops to CPUs; FORGE_STEER=1
+    // also hands connections to the loop on the CPU that received them
+    const char *cpus = getenv("FORGE_CPUS");
+    if (cpus)
+    {
+        int list[FORGE_MAX_WORKERS];
+        int count = 0;
+        if (strcmp(cpus, "auto") != 0)
+            count = forge_parse_cpu_list(cpus, list, FORGE_MAX_WORKERS);
+        if (count < 0 || forge_server_pin_cpus(count ? list : NULL, count) != 0)
+        {
+            fprintf(stderr, "FORGE_CPUS: cannot pin to %s\n", cpus);
+            return 1;
+        }
+    }
+    const char *steer = getenv("FORGE_STEER");
+    if (steer && atoi(steer) && forge_server_steer_connections(1) != 0)
+        fprintf(stderr, "FORGE_STEER: not supported here\n");
+
+    // FORGE_WORKERS=N forks N single-loop processes instead (0: one per CPU)
+    const char *workers = getenv("FORGE_WORKERS");
+    if (workers)
+        launch_server_workers(&server, atoi(workers));
+
+    // FORGE_CORES=N serves on N event loops (0: one per CPU)
+    const char *cores = getenv("FORGE_CORES");
+    if (cores)
+        launch_server_cores(&server, atoi(cores));
+    else
+        launch_server(&server);
 
     return 0;
 }